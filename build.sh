@@ -46,9 +46,9 @@ if [[ -z "$CC" ]]; then
 fi
 
 echo "Compiling core object files using $CC ..."
-$CC $CFLAGS -c -I$UTILS_PATH -I./src/ ./src/tensor.c -o ./build/tensor.obj
+$CC $CFLAGS -c -I$UTILS_PATH -I./src/ ./src/tensor.c -o ./build/tensor.obj -pthread
 echo "Compiling the tests..."
-$CC $CFLAGS -I$UTILS_PATH -I./src/ ./build/tensor.obj ./src/tests/run.c -o ./build/run_tests
+$CC $CFLAGS -I$UTILS_PATH -I./src/ ./build/tensor.obj ./src/tests/run.c -o ./build/run_tests -pthread
 echo "Compiled!"
 
 echo_cmd="echo"
@@ -77,7 +77,7 @@ for arg in "$@"; do
 
 	echo "Building and running example from: $example_name.c"
 
-	$CC $CFLAGS -I$UTILS_PATH -I./src/ ./build/tensor.obj ./src/example/"$example_name".c -o ./build/ex_"$example_name"
+	$CC $CFLAGS -I$UTILS_PATH -I./src/ ./build/tensor.obj ./src/example/"$example_name".c -o ./build/ex_"$example_name" -pthread
 	./build/ex_"$example_name"
     fi
 done
@@ -1,5 +1,13 @@
 #include "tensor.h"
 #include <stdio.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 
 void print_tensor_inx(Tensor_Inx inxs){
@@ -10,6 +18,14 @@ void print_tensor_inx(Tensor_Inx inxs){
   }
   printf(")");
 }
+void print_tensor_strides(Tensor_Strides strides){
+  printf("(");
+  for_slice(strides, i){
+    if(i != 0) printf(", ");
+    printf("%zd", strides.data[i]);
+  }
+  printf(")");
+}
 bool equal_tensor_inx(Tensor_Inx a, Tensor_Inx b){
   if(a.count != b.count) return false;
   for_slice(a, i){
@@ -19,52 +35,414 @@ bool equal_tensor_inx(Tensor_Inx a, Tensor_Inx b){
 }
 
 // Not to be used directly, just a helper fxn
-static void tensor_force_fix_stride(Tensor_Inx shape, Tensor_Inx stride){
+static void tensor_force_fix_stride(Tensor_Inx shape, Tensor_Strides stride){
   for_slice(stride, i_){
     const uptr i = stride.count - i_ - 1;
     if(i_ == 0) {
       stride.data[i] = 1;
       continue;
     }
-    stride.data[i] = stride.data[i+1] * shape.data[i+1];
+    stride.data[i] = stride.data[i+1] * (iptr)shape.data[i+1];
   }
 }
 
 // Not to be used directly, just a helper fxn
-Tensor tensor_alloc_(Alloc_Interface allocr, Tensor_Inx shape){
+// Sets the number of dimensions, the dimension arrays only need the allocator
+//   for tensors with more than TENSOR_INLINE_DIMS dimensions
+static void tensor_init_dims(Alloc_Interface allocr, Tensor* t, uptr ndim){
+  t->ndim = ndim;
+  t->dims_ext = nullptr;
+  if(ndim > TENSOR_INLINE_DIMS){
+    uptr_Slice ext = SLICE_ALLOC(allocr, uptr, 2 * ndim);
+    MEMCHK(ext.data);
+    t->dims_ext = ext.data;
+  }
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_deinit_dims(Alloc_Interface allocr, Tensor* t){
+  if(t->ndim > TENSOR_INLINE_DIMS){
+    uptr_Slice ext = {.data = t->dims_ext, .count = 2 * t->ndim};
+    SLICE_FREE(allocr, ext);
+  }
+  t->dims_ext = nullptr;
+}
+
+// Not to be used directly, just a helper fxn
+// A view for internal use only, 'scratch' (of 2 * ndim) holds the dimensions if they
+//   dont fit inline, so it must never be freed with 'tensor_free'
+static Tensor tensor_temp_view(f32_Slice storage, uptr offset, uptr ndim, uptr scratch[]){
+  Tensor t = {.storage = storage, .offset = offset, .ndim = ndim, .owner = false};
+  if(ndim > TENSOR_INLINE_DIMS) t.dims_ext = scratch;
+  return t;
+}
+
+// Arena allocator
+//   Allocations are bumped out of big blocks taken from the backing allocator, and
+//   freeing single allocations does nothing. Resetting to a mark drops everything
+//   allocated after it in O(1), the blocks are kept and reused by later allocations.
+#define TENSOR_ARENA_MIN_BLOCK 4096
+
+struct Tensor_Arena_Block {
+  Tensor_Arena_Block* next;
+  uptr_Slice mem;
+  // Bytes used in this block
+  uptr used;
+};
+DEF_SLICE(Tensor_Arena_Block);
+
+Tensor_Arena tensor_arena_init(Alloc_Interface backing, uptr block_size){
+  return (Tensor_Arena){
+    .backing = backing,
+    .block_size = (block_size < TENSOR_ARENA_MIN_BLOCK) ? TENSOR_ARENA_MIN_BLOCK : block_size,
+  };
+}
+
+void tensor_arena_deinit(Tensor_Arena* arena){
+  Tensor_Arena_Block* block = arena->first;
+  while(block != nullptr){
+    Tensor_Arena_Block_Slice node = {.data = block, .count = 1};
+    block = block->next;
+    SLICE_FREE(arena->backing, node.data->mem);
+    SLICE_FREE(arena->backing, node);
+  }
+  *arena = (Tensor_Arena){0};
+}
+
+// Not to be used directly, just a helper fxn
+// Bump allocates from the current block, moving on to the next (reused or new) one if needed
+static void* tensor_arena_bump(Tensor_Arena* arena, uptr size, uptr align){
+  if(align < sizeof(uptr)) align = sizeof(uptr);
+  assert(((void)"Alignment must be a power of 2", (align & (align - 1)) == 0));
+  Tensor_Arena_Block* block = arena->current;
+  while(block != nullptr){
+    const uptr base = (uptr)block->mem.data;
+    const uptr start = ((base + block->used + align - 1) & ~(align - 1)) - base;
+    if(start + size <= block->mem.count * sizeof(uptr)){
+      block->used = start + size;
+      arena->current = block;
+      return (char*)block->mem.data + start;
+    }
+    block = block->next;
+    // Blocks after the current one are left over from before a reset
+    if(block != nullptr) block->used = 0;
+  }
+
+  // No block has room, add a new one at the end of the chain
+  const uptr bytes = ((size + align) > arena->block_size) ? (size + align) : arena->block_size;
+  Tensor_Arena_Block_Slice node = SLICE_ALLOC(arena->backing, Tensor_Arena_Block, 1);
+  MEMCHK(node.data);
+  *node.data = (Tensor_Arena_Block){
+    .mem = SLICE_ALLOC(arena->backing, uptr, (bytes + sizeof(uptr) - 1) / sizeof(uptr)),
+  };
+  MEMCHK(node.data->mem.data);
+  if(arena->first == nullptr){
+    arena->first = node.data;
+  } else {
+    Tensor_Arena_Block* last = (arena->current != nullptr) ? arena->current : arena->first;
+    while(last->next != nullptr) last = last->next;
+    last->next = node.data;
+  }
+  arena->current = node.data;
+  return tensor_arena_bump(arena, size, align);
+}
+
+static void* tensor_arena_alloc_fn(void* data, size_t size, size_t align){
+  return tensor_arena_bump(data, size, align);
+}
+
+static void tensor_arena_free_fn(void* data, void* ptr){
+  (void)data, (void)ptr;
+}
+
+Alloc_Interface tensor_arena_allocator(Tensor_Arena* arena){
+  return (Alloc_Interface){
+    .optional_data = arena,
+    .alloc = tensor_arena_alloc_fn,
+    .free = tensor_arena_free_fn,
+  };
+}
+
+Tensor_Arena_Mark tensor_arena_mark(Tensor_Arena* arena){
+  return (Tensor_Arena_Mark){
+    .block = arena->current,
+    .used = (arena->current != nullptr) ? arena->current->used : 0,
+  };
+}
+
+void tensor_arena_reset(Tensor_Arena* arena, Tensor_Arena_Mark mark){
+  if(mark.block == nullptr){
+    // Marked before anything was allocated
+    arena->current = arena->first;
+    if(arena->current != nullptr) arena->current->used = 0;
+    return;
+  }
+  arena->current = mark.block;
+  mark.block->used = mark.used;
+}
+
+uptr tensor_arena_capacity(const Tensor_Arena* arena){
+  uptr bytes = 0;
+  for(const Tensor_Arena_Block* b = arena->first; b != nullptr; b = b->next)
+    bytes += b->mem.count * sizeof(uptr);
+  return bytes;
+}
+
+// Buffer pool
+//   Freed blocks are kept in free lists by size class and handed out again, so hot
+//   loops that keep allocating the same shapes skip the allocator (and the page faults
+//   of touching fresh memory). Each block has a header with its class, since
+//   'Alloc_Interface' frees dont carry a size. Classes split every power of 2 in 4.
+#define TENSOR_BUFFER_POOL_ALIGN 64
+#define TENSOR_BUFFER_POOL_MIN_BYTES 64
+#define TENSOR_BUFFER_POOL_MAX_LOG2 47
+#define TENSOR_BUFFER_POOL_CLASSES (4 * (TENSOR_BUFFER_POOL_MAX_LOG2 - 4))
+// Class of blocks that were too big, they always go back to the backing allocator
+#define TENSOR_BUFFER_POOL_UNPOOLED ((uptr)-1)
+
+typedef struct Tensor_Buffer_Chunk Tensor_Buffer_Chunk;
+struct Tensor_Buffer_Chunk {
+  _Alignas(TENSOR_BUFFER_POOL_ALIGN) Tensor_Buffer_Chunk* next;
+  uptr cls;
+  // Number of chunk sized units allocated, including this header
+  uptr units;
+};
+DEF_SLICE(Tensor_Buffer_Chunk);
+
+struct Tensor_Buffer_Pool {
+  Alloc_Interface backing;
+  uptr cap_bytes;
+  pthread_mutex_t lock;
+  Tensor_Buffer_Stats stats;
+  Tensor_Buffer_Chunk* free_lists[TENSOR_BUFFER_POOL_CLASSES];
+};
+DEF_SLICE(Tensor_Buffer_Pool);
+
+// Not to be used directly, just a helper fxn
+// Gives the size class of a request, and the bytes that class holds
+static uptr tensor_buffer_class(uptr bytes, uptr* class_bytes){
+  if(bytes < TENSOR_BUFFER_POOL_MIN_BYTES) bytes = TENSOR_BUFFER_POOL_MIN_BYTES;
+  // Octave of (bytes - 1), so that exact powers of 2 fall in the class below
+  const uptr p = (sizeof(unsigned long long) * 8 - 1) - (uptr)__builtin_clzll(bytes - 1);
+  if(p >= TENSOR_BUFFER_POOL_MAX_LOG2) return TENSOR_BUFFER_POOL_UNPOOLED;
+  const uptr sub = ((bytes - 1) >> (p - 2)) & 3;
+  *class_bytes = ((uptr)1 << p) + ((sub + 1) << (p - 2));
+  return (p - 5) * 4 + sub;
+}
+
+Tensor_Buffer_Pool* tensor_buffer_pool_create(Alloc_Interface backing, uptr cap_bytes){
+  Tensor_Buffer_Pool_Slice pool = SLICE_ALLOC(backing, Tensor_Buffer_Pool, 1);
+  MEMCHK(pool.data);
+  *pool.data = (Tensor_Buffer_Pool){.backing = backing, .cap_bytes = cap_bytes};
+  pthread_mutex_init(&pool.data->lock, nullptr);
+  return pool.data;
+}
+
+// Not to be used directly, just a helper fxn
+// Bytes a free chunk holds, this is what counts against the cap, not the requested size
+static uptr tensor_buffer_chunk_bytes(const Tensor_Buffer_Chunk* chunk){
+  return (chunk->units - 1) * sizeof(Tensor_Buffer_Chunk);
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_buffer_chunk_release(Alloc_Interface backing, Tensor_Buffer_Chunk* chunk){
+  Tensor_Buffer_Chunk_Slice mem = {.data = chunk, .count = chunk->units};
+  SLICE_FREE(backing, mem);
+}
+
+void tensor_buffer_pool_trim(Tensor_Buffer_Pool* pool){
+  pthread_mutex_lock(&pool->lock);
+  for(uptr c = 0; c < TENSOR_BUFFER_POOL_CLASSES; ++c){
+    while(pool->free_lists[c] != nullptr){
+      Tensor_Buffer_Chunk* chunk = pool->free_lists[c];
+      pool->free_lists[c] = chunk->next;
+      tensor_buffer_chunk_release(pool->backing, chunk);
+    }
+  }
+  pool->stats.retained_bytes = 0;
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void tensor_buffer_pool_destroy(Tensor_Buffer_Pool* pool){
+  tensor_buffer_pool_trim(pool);
+  pthread_mutex_destroy(&pool->lock);
+  const Alloc_Interface backing = pool->backing;
+  Tensor_Buffer_Pool_Slice mem = {.data = pool, .count = 1};
+  SLICE_FREE(backing, mem);
+}
+
+Tensor_Buffer_Stats tensor_buffer_pool_stats(Tensor_Buffer_Pool* pool){
+  pthread_mutex_lock(&pool->lock);
+  const Tensor_Buffer_Stats stats = pool->stats;
+  pthread_mutex_unlock(&pool->lock);
+  return stats;
+}
+
+static void* tensor_buffer_pool_alloc_fn(void* data, size_t size, size_t align){
+  Tensor_Buffer_Pool* pool = data;
+  assert(((void)"Alignment is too large for the pool", align <= TENSOR_BUFFER_POOL_ALIGN));
+  (void)align;
+  uptr class_bytes = size;
+  const uptr cls = tensor_buffer_class(size, &class_bytes);
+
+  if(cls != TENSOR_BUFFER_POOL_UNPOOLED){
+    pthread_mutex_lock(&pool->lock);
+    Tensor_Buffer_Chunk* chunk = pool->free_lists[cls];
+    if(chunk != nullptr){
+      pool->free_lists[cls] = chunk->next;
+      pool->stats.retained_bytes -= tensor_buffer_chunk_bytes(chunk);
+      pool->stats.hits++;
+    } else {
+      pool->stats.misses++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if(chunk != nullptr) return chunk + 1;
+  }
+
+  const uptr units = 1 + (class_bytes + sizeof(Tensor_Buffer_Chunk) - 1) / sizeof(Tensor_Buffer_Chunk);
+  Tensor_Buffer_Chunk_Slice mem = SLICE_ALLOC(pool->backing, Tensor_Buffer_Chunk, units);
+  if(mem.data == nullptr) return nullptr;
+  *mem.data = (Tensor_Buffer_Chunk){.cls = cls, .units = units};
+  return mem.data + 1;
+}
+
+static void tensor_buffer_pool_free_fn(void* data, void* ptr){
+  Tensor_Buffer_Pool* pool = data;
+  if(ptr == nullptr) return;
+  Tensor_Buffer_Chunk* chunk = (Tensor_Buffer_Chunk*)ptr - 1;
+  if(chunk->cls != TENSOR_BUFFER_POOL_UNPOOLED){
+    const uptr class_bytes = tensor_buffer_chunk_bytes(chunk);
+    pthread_mutex_lock(&pool->lock);
+    const bool keep = (pool->stats.retained_bytes + class_bytes) <= pool->cap_bytes;
+    if(keep){
+      chunk->next = pool->free_lists[chunk->cls];
+      pool->free_lists[chunk->cls] = chunk;
+      pool->stats.retained_bytes += class_bytes;
+      if(pool->stats.retained_bytes > pool->stats.peak_retained_bytes)
+	pool->stats.peak_retained_bytes = pool->stats.retained_bytes;
+    } else {
+      pool->stats.evictions++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if(keep) return;
+  }
+  tensor_buffer_chunk_release(pool->backing, chunk);
+}
+
+Alloc_Interface tensor_buffer_pool_allocator(Tensor_Buffer_Pool* pool){
+  return (Alloc_Interface){
+    .optional_data = pool,
+    .alloc = tensor_buffer_pool_alloc_fn,
+    .free = tensor_buffer_pool_free_fn,
+  };
+}
+
+Tensor tensor_alloc_pooled_(Tensor_Buffer_Pool* pool, Tensor_Inx shape){
+  return tensor_alloc_(tensor_buffer_pool_allocator(pool), shape);
+}
+
+// Shared storage
+//   Every tensor made by the library holds a reference to a 'Tensor_Storage', views
+//   just add another reference, and the memory is freed with the last reference.
+//   Counts are atomic, so tensors sharing a storage can be freed from any thread.
+//   Tensors over external memory (like stack tensors) have no storage object at all.
+struct Tensor_Storage {
+  atomic_size_t refs;
+  // Writers must call 'tensor_make_writable' first, which clones it if it is shared
+  atomic_bool cow;
+  Alloc_Interface allocr;
+  f32_Slice data;
+  // Set for storages over a mapped file, the whole mapping is unmapped instead of freed
+  void* mapping;
+  uptr mapping_bytes;
+};
+DEF_SLICE(Tensor_Storage);
+
+// Not to be used directly, just a helper fxn
+static Tensor_Storage* tensor_storage_new(Alloc_Interface allocr, uptr count){
+  Tensor_Storage_Slice header = SLICE_ALLOC(allocr, Tensor_Storage, 1);
+  MEMCHK(header.data);
+  f32_Slice data = SLICE_ALLOC(allocr, f32, count);
+  MEMCHK(data.data);
+  *header.data = (Tensor_Storage){.allocr = allocr, .data = data};
+  atomic_init(&header.data->refs, 1);
+  atomic_init(&header.data->cow, false);
+  return header.data;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_storage_retain(Tensor_Storage* st){
+  if(st != nullptr) atomic_fetch_add_explicit(&st->refs, 1, memory_order_relaxed);
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_storage_release(Tensor_Storage* st){
+  if(st == nullptr) return;
+  if(atomic_fetch_sub_explicit(&st->refs, 1, memory_order_acq_rel) != 1) return;
+  const Alloc_Interface allocr = st->allocr;
+  Tensor_Storage_Slice header = {.data = st, .count = 1};
+  if(st->mapping != nullptr) munmap(st->mapping, st->mapping_bytes);
+  else SLICE_FREE(allocr, st->data);
+  SLICE_FREE(allocr, header);
+}
+
+// Not to be used directly, just a helper fxn
+// Number of f32 units of storage holding 'count' elements of the dtype
+static uptr tensor_storage_units(Tensor_DType dtype, uptr count){
+  return (count * tensor_dtype_size(dtype) + sizeof(f32) - 1) / sizeof(f32);
+}
+
+uptr tensor_dtype_size(Tensor_DType dtype){
+  switch(dtype){
+  case TENSOR_F32: return sizeof(f32);
+  case TENSOR_F64: return sizeof(f64);
+  case TENSOR_F16: return sizeof(uint16_t);
+  case TENSOR_BF16: return sizeof(uint16_t);
+  case TENSOR_I32: return sizeof(int32_t);
+  case TENSOR_I8: return sizeof(int8_t);
+  default: assert(((void)"Invalid tensor dtype", false));
+  }
+  return 0;
+}
+
+const char* tensor_dtype_name(Tensor_DType dtype){
+  static const char* const names[TENSOR_DTYPE_COUNT] = {
+    [TENSOR_F32] = "f32", [TENSOR_F64] = "f64", [TENSOR_F16] = "f16",
+    [TENSOR_BF16] = "bf16", [TENSOR_I32] = "i32", [TENSOR_I8] = "i8",
+  };
+  assert(((void)"Invalid tensor dtype", (uptr)dtype < TENSOR_DTYPE_COUNT));
+  return names[dtype];
+}
+
+Tensor tensor_alloc_dtype_(Alloc_Interface allocr, Tensor_DType dtype, Tensor_Inx shape){
   // Find the final size
   uptr size = 1;
   for_slice(shape, s){
     size *= shape.data[s];
   }
 
-  // TODO:: If the shape.count is 0, decide if you want to always make it null explicitly
   // Allocate the tensor resources
   Tensor t = {
-    .storage = SLICE_ALLOC(allocr, f32, size),
-    .shape = SLICE_ALLOC(allocr, uptr, shape.count),
-    .stride = SLICE_ALLOC(allocr, uptr, shape.count),
-    .offset = SLICE_ALLOC(allocr, uptr, shape.count),
+    .shared = tensor_storage_new(allocr, tensor_storage_units(dtype, size)),
+    .dtype = dtype,
+    .offset = 0,
     .owner = true,
   };
-  MEMCHK(t.storage.data);
-  // Since if the shape is 0, the alloc function can return null or not
-  //  so check following only if the shape is nonzero length
-  if(shape.count > 0){
-    MEMCHK(t.shape.data);
-    MEMCHK(t.stride.data);
-    MEMCHK(t.offset.data);
-    // Form the shapes and strides
-    memcpy(t.shape.data, shape.data, uptr_slice_bytes(shape));
-    (void)memset(t.offset.data, 0, uptr_slice_bytes(t.offset));
-    tensor_force_fix_stride(t.shape, t.stride);
-  }
+  t.storage = (f32_Slice){.data = t.shared->data.data, .count = size};
+  tensor_init_dims(allocr, &t, shape.count);
+  // Form the shapes and strides
+  for_slice(shape, i) tensor_shape(t).data[i] = shape.data[i];
+  tensor_force_fix_stride(tensor_shape(t), tensor_stride(t));
   return t;
 }
 
+Tensor tensor_alloc_(Alloc_Interface allocr, Tensor_Inx shape){
+  return tensor_alloc_dtype_(allocr, TENSOR_F32, shape);
+}
+
 // To be used because of macro issues
 Tensor tensor_assume_contiguous_fix_stride(Tensor in){
-  tensor_force_fix_stride(in.shape, in.stride);
+  tensor_force_fix_stride(tensor_shape(in), tensor_stride(in));
   return in;
 }
 
@@ -79,19 +457,31 @@ Tensor tensor_create_(Alloc_Interface allocr, f32 fill_elem, Tensor_Inx shape){
 }
 
 
-f32* tensor_get_ptr_(Tensor t, Tensor_Inx inx){
-  // offset = sum(inx_i * stride_i), inx_i < shape_i
-  uptr offset = 0;
+// Not to be used directly, just a helper fxn
+// Position of the element at 'inx' in the storage
+static uptr tensor_elem_offset(Tensor t, Tensor_Inx inx){
+  // offset = base + sum(inx_i * stride_i), inx_i < shape_i, strides can be negative
+  iptr offset = (iptr)t.offset;
   // TODO:: Dont assert, return nullptr or something
-  assert(((void)"Shape of tensors cannot be different", inx.count == t.shape.count));
+  assert(((void)"Shape of tensors cannot be different", inx.count == t.ndim));
+  const uptr* shape = tensor_shape_ptr_(&t);
+  const iptr* stride = tensor_stride_ptr_(&t);
   for_slice(inx, i){
-    assert(((void)"Index must be inside size", inx.data[i] < t.shape.data[i]));
-    offset += (t.offset.data[i] + inx.data[i]) * t.stride.data[i];
+    assert(((void)"Index must be inside size", inx.data[i] < shape[i]));
+    offset += (iptr)inx.data[i] * stride[i];
   }
-  assert(((void)"Should not have happened", offset < t.storage.count));
-  return &t.storage.data[offset];
+  (void)shape;
+  assert(((void)"Should not have happened", offset >= 0 && (uptr)offset < t.storage.count));
+  return (uptr)offset;
+}
+
+f32* tensor_get_ptr_(Tensor t, Tensor_Inx inx){
+  assert(((void)"Only f32 tensors can be accessed directly, use 'tensor_get_value'",
+	  t.dtype == TENSOR_F32));
+  return &t.storage.data[tensor_elem_offset(t, inx)];
 }
 
+
 bool tensor_inx_in_range(Tensor_Inx inxs, Tensor_Inx shape){
   if(inxs.count != shape.count) return false;
   for_slice(inxs, i){
@@ -100,345 +490,6583 @@ bool tensor_inx_in_range(Tensor_Inx inxs, Tensor_Inx shape){
   return true;
 }
 
-void tensor_free(Alloc_Interface allocr, Tensor* t){
-  if(t->owner) SLICE_FREE(allocr, t->storage);
-  t->owner = false;
-  SLICE_FREE(allocr, t->shape);
-  SLICE_FREE(allocr, t->stride);
-  SLICE_FREE(allocr, t->offset);
-}
+// Internal strided loop engine
+//   All the validation and index math is done once while building a 'Tensor_Loop',
+//   after that elementwise ops only walk raw pointers with precomputed strides.
+//   Operand 0 is always the output tensor, the loop order follows its layout.
+#define TENSOR_LOOP_MAX_DIMS 32
+#define TENSOR_LOOP_MAX_OPS 16
 
-Tensor tensor_dupe(Alloc_Interface allocr, Tensor t){
-  Tensor out = {
-    .storage = make_copy_f32_slice(allocr, t.storage),
-    .shape = make_copy_uptr_slice(allocr, t.shape),
-    .stride = make_copy_uptr_slice(allocr, t.stride),
-    .offset = make_copy_uptr_slice(allocr, t.offset),
-    .owner = true,
-  };
-  MEMCHK(out.storage.data);
-  // Since if the shape is 0, the alloc function can return null or not
-  //  so check following only if the shape is nonzero length
-  if(t.shape.count > 0){
-    MEMCHK(out.shape.data);
-    MEMCHK(out.stride.data);
-    MEMCHK(out.offset.data);
-  }
-  return out;
-}
+typedef struct Tensor_Loop Tensor_Loop;
+struct Tensor_Loop {
+  // Dimensions after reordering and coalescing, innermost is the last one
+  // There is always at least 1 dimension, (0 dim tensors become shape (1))
+  uptr ndim;
+  uptr nops;
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  // Strides are in elements, of sizes 'elem_size' bytes (operands can differ in dtype)
+  iptr stride[TENSOR_LOOP_MAX_OPS][TENSOR_LOOP_MAX_DIMS];
+  char* base[TENSOR_LOOP_MAX_OPS];
+  uptr elem_size[TENSOR_LOOP_MAX_OPS];
+};
 
-Tensor tensor_contiguous(Alloc_Interface allocr, Tensor t){
-  // Create equivalent sized tensor
-  Tensor newt = tensor_alloc_(allocr, t.shape);
+// Processes 'count' elements along the innermost dimension, ptrs[i] advances by strides[i]
+// Pointers of operands that are not f32 point to elements of their own dtype
+typedef void Tensor_Loop_Kernel(void* ctx, uptr count, f32* const ptrs[], const iptr strides[]);
 
-  Tensor_Iter iter = tensor_iter_init(allocr, t);
-  while(tensor_iter_next(&iter)){
-    *tensor_get_ptr_(newt, iter.inx) = *tensor_get_ptr_(t, iter.inx);
-  }
-  tensor_iter_deinit(allocr, &iter);
+// Not to be used directly, just a helper fxn
+static void tensor_assert_f32(Tensor t){
+  assert(((void)"This operation only supports f32 tensors, convert with 'tensor_to_dtype'",
+	  t.dtype == TENSOR_F32));
+  (void)t;
+}
 
-  return newt;
+// Not to be used directly, just a helper fxn
+static f32* tensor_base_ptr(Tensor t){
+  tensor_assert_f32(t);
+  return t.storage.data + t.offset;
 }
 
-Tensor tensor_random_(Alloc_Interface allocr, f32 min_val, f32 max_val, Tensor_Inx shape){
-  Tensor rant = tensor_alloc_(allocr, shape);
+// Not to be used directly, just a helper fxn
+// Address of the element at index (0, 0, ...) for tensors of any dtype
+static char* tensor_raw_ptr(Tensor t){
+  return (char*)t.storage.data + t.offset * tensor_dtype_size(t.dtype);
+}
 
-  for_slice(rant.storage, i){
-    rant.storage.data[i] = ((rand() * 1.0) / (RAND_MAX-1)) * (max_val - min_val) + min_val;
+// Not to be used directly, just a helper fxn
+// Asserts once that every element reachable from the view lies inside the storage
+//   Negative strides reach below the offset, positive ones above it
+static void tensor_assert_view_in_storage(Tensor t){
+  iptr first = (iptr)t.offset;
+  iptr last = (iptr)t.offset;
+  for_slice(tensor_shape(t), i){
+    if(tensor_shape(t).data[i] == 0) return;
+    const iptr reach = (iptr)(tensor_shape(t).data[i] - 1) * tensor_stride(t).data[i];
+    if(reach < 0) first += reach;
+    else last += reach;
   }
-  return rant;
-  
+  assert(((void)"Should not have happened", first >= 0 && (uptr)last < t.storage.count));
+  (void)first, (void)last;
 }
 
-Tensor tensor_range_(Alloc_Interface allocr, f32 start_val, f32 step_size, Tensor_Inx shape){
-  Tensor rent = tensor_alloc_(allocr, shape);
-
-  for_slice(rent.storage, i){
-    rent.storage.data[i] = start_val;
-    start_val += step_size;
+// Checks if 'shape' can be broadcasted to 'to' (numpy rules, aligned from the right)
+static bool tensor_shape_broadcastable(Tensor_Inx shape, Tensor_Inx to){
+  if(shape.count > to.count) return false;
+  const uptr lead = to.count - shape.count;
+  for_slice(shape, j){
+    if(shape.data[j] != 1 && shape.data[j] != to.data[lead + j]) return false;
   }
-  return rent;
+  return true;
 }
 
-void tensor_print(Alloc_Interface allocr, Tensor t){
-  Tensor_Iter iter = tensor_iter_init(allocr, t);
-  while(tensor_iter_next(&iter)){
-    size_t zeros = 0;
-    for_slice(iter.inx, i_) {
-      uptr i = iter.inx.count - i_ - 1;
-      if(iter.inx.data[i] == 0) zeros++;
-      else break;
-    }
-    if(zeros > 0){
-      for_range(size_t, i, 0, iter.inx.count - zeros) printf(" ");
-      for_range(size_t, i, 0, zeros) printf("[");
-    }    
-
-    if(iter.inx.count > 0 && zeros == 0) printf(", ");
-    printf("%f", *tensor_get_ptr_(t, iter.inx));
-    
-    bool some_overflowed = false;
-    for_slice(iter.inx, i_){
-      uptr i = iter.inx.count - i_ - 1;
-      if(slice_inx(iter.inx, i) != (slice_inx(t.shape, i)-1)) break;
-      printf("]");
-      some_overflowed = true;
-    }
-    if(some_overflowed) printf("\n");    
-  }
-  tensor_iter_deinit(allocr, &iter);
+// Stride of 'in' along dimension 'i' of a broadcasted shape with 'ndim' dims
+//   missing and size 1 dimensions get stride 0, so no copy is ever made
+static iptr tensor_broadcast_stride(Tensor in, uptr ndim, uptr i){
+  if(i + in.ndim < ndim) return 0;
+  const uptr j = i + in.ndim - ndim;
+  return (tensor_shape(in).data[j] == 1) ? 0 : tensor_stride(in).data[j];
 }
 
-void tensor_permute_in_place(Tensor t, uptr inx1, uptr inx2){
-  assert(((void)"Index out of bounds", inx1 < t.shape.count));
-  assert(((void)"Index out of bounds", inx2 < t.shape.count));
+// Builds a loop over 'nops' tensors, ts[0] being the output
+// Other operands must have the output's shape or be broadcastable to it
+// Returns the total number of elements to be visited
+static uptr tensor_loop_init(Tensor_Loop* loop, uptr nops, const Tensor ts[]){
+  assert(((void)"Too many operands for a single tensor loop", nops > 0 && nops <= TENSOR_LOOP_MAX_OPS));
+  const Tensor_Inx shape = tensor_shape(ts[0]);
+  assert(((void)"Tensor has too many dimensions", shape.count <= TENSOR_LOOP_MAX_DIMS));
 
-  if(inx1 != inx2){
-    _swap(t.shape.data[inx1], t.shape.data[inx2]);
-    _swap(t.stride.data[inx1], t.stride.data[inx2]);
-    _swap(t.offset.data[inx1], t.offset.data[inx2]);
+  *loop = (Tensor_Loop){.nops = nops};
+  uptr total = 1;
+  for_range(uptr, k, 0, nops){
+    assert(((void)"Differently shaped tensors cannot be used in elementwise operation",
+	    tensor_shape_broadcastable(tensor_shape(ts[k]), shape)));
+    tensor_assert_view_in_storage(ts[k]);
+    loop->base[k] = tensor_raw_ptr(ts[k]);
+    loop->elem_size[k] = tensor_dtype_size(ts[k].dtype);
   }
-}
 
-Tensor tensor_permute(Alloc_Interface allocr, Tensor oldt, uptr inx1, uptr inx2){
-  Tensor newt = {
-    .storage = oldt.storage, //shares storage
-    .shape = make_copy_uptr_slice(allocr, oldt.shape),
-    .stride = make_copy_uptr_slice(allocr, oldt.stride),
-    .offset = make_copy_uptr_slice(allocr, oldt.offset),
-    .owner = false,
-  };
-  // Since if the shape is 0, the alloc function can return null or not
-  //  so check following only if the shape is nonzero length
-  if(oldt.shape.count > 0){
-    MEMCHK(newt.shape.data);
-    MEMCHK(newt.stride.data);
-    MEMCHK(newt.offset.data);
+  // Gather the non trivial dimensions
+  for_slice(shape, i){
+    total *= shape.data[i];
+    if(shape.data[i] == 1) continue;
+    const uptr d = loop->ndim++;
+    loop->shape[d] = shape.data[i];
+    for_range(uptr, k, 0, nops)
+      loop->stride[k][d] = tensor_broadcast_stride(ts[k], shape.count, i);
   }
 
-  tensor_permute_in_place(newt, inx1, inx2);
-
-  return newt;
-}
+  // Reorder so that the output's smallest stride is innermost (stable insertion sort)
+  for_range(uptr, i, 1, loop->ndim){
+    for(uptr j = i; j > 0; --j){
+      const iptr a = loop->stride[0][j-1], b = loop->stride[0][j];
+      if((a < 0 ? -a : a) >= (b < 0 ? -b : b)) break;
+      _swap(loop->shape[j-1], loop->shape[j]);
+      for_range(uptr, k, 0, nops) _swap(loop->stride[k][j-1], loop->stride[k][j]);
+    }
+  }
 
-Tensor tensor_slice_(Alloc_Interface allocr, Tensor src,
-		     Tensor_Inx start, Tensor_Inx end){
-  // Assert if indexes are of valid dimension
-  assert(((void)"Dimensions of starting tensor index must be same as tensor dimension",
-	  start.count == src.shape.count));
-  assert(((void)"Dimensions of ending tensor index must be same as tensor dimension",
-	  end.count == src.shape.count));
+  // Merge adjacent dimensions that are contiguous with each other for every operand
+  uptr nd = 0;
+  for_range(uptr, i, 0, loop->ndim){
+    bool can_merge = (nd > 0);
+    for_range(uptr, k, 0, nops){
+      if(!can_merge) break;
+      can_merge = (loop->stride[k][nd-1] == loop->stride[k][i] * (iptr)loop->shape[i]);
+    }
+    if(can_merge){
+      loop->shape[nd-1] *= loop->shape[i];
+      for_range(uptr, k, 0, nops) loop->stride[k][nd-1] = loop->stride[k][i];
+      continue;
+    }
+    loop->shape[nd] = loop->shape[i];
+    for_range(uptr, k, 0, nops) loop->stride[k][nd] = loop->stride[k][i];
+    nd++;
+  }
+  loop->ndim = nd;
 
-  // Assert if the indexes are in valid ranges
-  for_slice(src.shape, i){
-    assert(((void)"Starting index cannot be greater or equal to size of tensor",
-	    start.data[i] < src.shape.data[i]));
-    assert(((void)"Starting index cannot be greater than size of tensor",
-	    end.data[i] <= src.shape.data[i]));
+  // Scalars and all-ones shapes still visit one element
+  if(loop->ndim == 0){
+    loop->ndim = 1;
+    loop->shape[0] = 1;
+    for_range(uptr, k, 0, nops) loop->stride[k][0] = 1;
+  }
+  // Zero sized tensors have nothing to visit
+  if(total == 0){
+    loop->ndim = 1;
+    loop->shape[0] = 0;
   }
+  return total;
+}
 
-  // Create new non-owning tensor
+// Runs the kernel over the linear element range [begin, end) of the loop
+//   Partial rows at either end are handled, so ranges can be split anywhere
+static void tensor_loop_run(const Tensor_Loop* loop, uptr begin, uptr end,
+			    Tensor_Loop_Kernel* kernel, void* ctx){
+  const uptr inner = loop->ndim - 1;
+  const uptr row = loop->shape[inner];
+  if(begin >= end || row == 0) return;
 
-  Tensor dst = {
-    .storage = src.storage, //shares storage
-    .shape = make_copy_uptr_slice(allocr, src.shape),
-    .stride = make_copy_uptr_slice(allocr, src.stride),
-    .offset = make_copy_uptr_slice(allocr, src.offset),
-    .owner = false,
-  };
+  uptr inx[TENSOR_LOOP_MAX_DIMS];
+  char* ptrs[TENSOR_LOOP_MAX_OPS];
+  iptr inner_strides[TENSOR_LOOP_MAX_OPS];
+  // Outer strides in bytes, so that pointers of any dtype are stepped the same way
+  iptr steps[TENSOR_LOOP_MAX_OPS][TENSOR_LOOP_MAX_DIMS];
 
-  if(src.shape.count>0){
-    MEMCHK(dst.shape.data);
-    MEMCHK(dst.stride.data);
-    MEMCHK(dst.offset.data);
+  // Decompose the starting index only once, after that just step the pointers
+  uptr col = begin % row;
+  uptr rem = begin / row;
+  for_range(uptr, k, 0, loop->nops){
+    inner_strides[k] = loop->stride[k][inner];
+    ptrs[k] = loop->base[k];
+    for_range(uptr, d, 0, loop->ndim) steps[k][d] = loop->stride[k][d] * (iptr)loop->elem_size[k];
   }
-  // Slice-em
-  // shape = end - start, offset += start
-  for_slice(dst.shape, i){
-    dst.shape.data[i] = end.data[i] - start.data[i];
-    dst.offset.data[i] += start.data[i];
+  for(uptr d = inner; d-- > 0;){
+    inx[d] = rem % loop->shape[d];
+    rem /= loop->shape[d];
+    for_range(uptr, k, 0, loop->nops) ptrs[k] += (iptr)inx[d] * steps[k][d];
   }
 
-  return dst;
+  uptr left = end - begin;
+  while(left > 0){
+    const uptr count = ((row - col) < left) ? (row - col) : left;
+    f32* row_ptrs[TENSOR_LOOP_MAX_OPS];
+    for_range(uptr, k, 0, loop->nops) row_ptrs[k] = (f32*)(ptrs[k] + (iptr)col * steps[k][inner]);
+    kernel(ctx, count, row_ptrs, inner_strides);
+    left -= count;
+    col = 0;
+    for(uptr d = inner; d-- > 0;){
+      inx[d]++;
+      if(inx[d] < loop->shape[d]){
+	for_range(uptr, k, 0, loop->nops) ptrs[k] += steps[k][d];
+	break;
+      }
+      inx[d] = 0;
+      for_range(uptr, k, 0, loop->nops)
+	ptrs[k] -= (iptr)(loop->shape[d] - 1) * steps[k][d];
+    }
+  }
 }
 
-Tensor tensor_map_op_inp(Tensor_Iter* out_iter, Tensor_Slice ts, f32_binop* op){
-  // Maybe first assert that there are more than 1`tensors
-  assert(((void)"There has to be at least 2 tensors for this operation to have meaning",
-	  ts.count >= 2));
-  // Then assert that each tensor is of same shape
-  for_range(size_t, i, 1, ts.count){
-    assert(((void)"Differently shaped tensors cannot be used in elementwise operation", equal_tensor_inx(slice_inx(ts, 0).shape, slice_inx(ts, i).shape)));
-  }
+// Thread pool
+//   Persistent workers that are started lazily on the first parallel op.
+//   A job is a number of independent tasks, workers and the submitting thread
+//   claim tasks from a shared counter. Only one job runs at a time, if the pool
+//   is busy (or called from inside a task) the caller just runs everything itself.
+#define TENSOR_MAX_THREADS 256
+#define TENSOR_DEFAULT_PARALLEL_THRESHOLD (1 << 16)
+
+typedef void Tensor_Task_Fn(void* ctx, uptr task_inx);
+
+typedef struct Tensor_Pool Tensor_Pool;
+struct Tensor_Pool {
+  pthread_mutex_t lock;
+  pthread_cond_t work_cv;
+  pthread_cond_t done_cv;
+  pthread_mutex_t submit_lock;
+  pthread_t workers[TENSOR_MAX_THREADS];
+  uptr worker_count;
+  bool started;
+  bool quit;
+  // Current job, modified only under 'lock' while no worker is active
+  uptr generation;
+  uptr active;
+  Tensor_Task_Fn* fn;
+  void* ctx;
+  uptr task_count;
+  atomic_size_t next_task;
+  atomic_size_t done_tasks;
+  // Settings, 0 threads means the number of online cpus
+  uptr requested_threads;
+  uptr threshold;
+};
 
-  // Assert that the output tensor is also of required shape
-  assert(((void)"The output tensor should also be of the size of input tensors",
-	  equal_tensor_inx(slice_inx(ts,0).shape, out_iter->t.shape)));
-  while(tensor_iter_next(out_iter)){
-    *tensor_get_ptr_(out_iter->t, out_iter->inx) = *tensor_get_ptr_(ts.data[0], out_iter->inx);
-    for_range(size_t, i, 1, ts.count){
-      *tensor_get_ptr_(out_iter->t, out_iter->inx) =
-	op(*tensor_get_ptr_(out_iter->t, out_iter->inx),
-	   *tensor_get_ptr_(slice_inx(ts, i), out_iter->inx));
+static Tensor_Pool tensor_pool = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .work_cv = PTHREAD_COND_INITIALIZER,
+  .done_cv = PTHREAD_COND_INITIALIZER,
+  .submit_lock = PTHREAD_MUTEX_INITIALIZER,
+  .threshold = TENSOR_DEFAULT_PARALLEL_THRESHOLD,
+};
+
+static _Thread_local bool tensor_in_task = false;
+
+static void tensor_pool_claim_tasks(Tensor_Task_Fn* fn, void* ctx, uptr task_count){
+  uptr t;
+  while((t = atomic_fetch_add(&tensor_pool.next_task, 1)) < task_count){
+    fn(ctx, t);
+    if(atomic_fetch_add(&tensor_pool.done_tasks, 1) + 1 == task_count){
+      pthread_mutex_lock(&tensor_pool.lock);
+      pthread_cond_signal(&tensor_pool.done_cv);
+      pthread_mutex_unlock(&tensor_pool.lock);
     }
   }
-  return out_iter->t;
 }
 
-Tensor tensor_map_op_new(Alloc_Interface allocr, Tensor_Slice ts, f32_binop* op){
-  Tensor ans = tensor_alloc_(allocr, slice_inx(ts, 0).shape);
-  Tensor_Iter iter = tensor_iter_init(allocr, ans);
-  (void)tensor_map_op_inp(&iter, ts, op);
-  tensor_iter_deinit(allocr, &iter);
-  return ans;
-}
+static void* tensor_pool_worker(void* arg){
+  (void)arg;
+  tensor_in_task = true;
+  pthread_mutex_lock(&tensor_pool.lock);
+  // Jobs submitted before this worker existed are not its concern
+  uptr seen = tensor_pool.generation;
+  while(true){
+    while(!tensor_pool.quit && tensor_pool.generation == seen)
+      pthread_cond_wait(&tensor_pool.work_cv, &tensor_pool.lock);
+    if(tensor_pool.quit) break;
+    seen = tensor_pool.generation;
+    Tensor_Task_Fn* fn = tensor_pool.fn;
+    void* ctx = tensor_pool.ctx;
+    const uptr task_count = tensor_pool.task_count;
+    tensor_pool.active++;
+    pthread_mutex_unlock(&tensor_pool.lock);
 
-Tensor tensor_bin_op_new(Alloc_Interface allocr, Tensor t1, f32_binop* op, Tensor t2){
-  return tensor_map_op(allocr, MAKE_ARRAY_SLICE(Tensor, t1, t2), op);
+    tensor_pool_claim_tasks(fn, ctx, task_count);
+
+    pthread_mutex_lock(&tensor_pool.lock);
+    tensor_pool.active--;
+    if(tensor_pool.active == 0) pthread_cond_signal(&tensor_pool.done_cv);
+  }
+  pthread_mutex_unlock(&tensor_pool.lock);
+  return nullptr;
 }
-Tensor tensor_bin_op_inp(Tensor_Iter* out_iter, Tensor t1, f32_binop* op, Tensor t2){
-  return tensor_map_op(out_iter, MAKE_ARRAY_SLICE(Tensor, t1, t2), op);
+
+static uptr tensor_online_cpus(void){
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (uptr)n : 1;
 }
 
-f32 f32_add_op(f32 a, f32 b){
-  return a + b;
+uptr tensor_get_num_threads(void){
+  uptr n = tensor_pool.requested_threads;
+  if(n == 0) n = tensor_online_cpus();
+  return (n > TENSOR_MAX_THREADS) ? TENSOR_MAX_THREADS : n;
 }
 
-f32 f32_prod_op(f32 a, f32 b){
-  return a * b;
+// Expects 'submit_lock' to be held
+static void tensor_pool_stop(void){
+  if(!tensor_pool.started) return;
+  pthread_mutex_lock(&tensor_pool.lock);
+  tensor_pool.quit = true;
+  pthread_cond_broadcast(&tensor_pool.work_cv);
+  pthread_mutex_unlock(&tensor_pool.lock);
+  for_range(uptr, i, 0, tensor_pool.worker_count) pthread_join(tensor_pool.workers[i], nullptr);
+  tensor_pool.worker_count = 0;
+  tensor_pool.started = false;
+  tensor_pool.quit = false;
 }
 
-f32 f32_max_op(f32 a, f32 b){
-  return ((a>b)?a:b);
-};
+// Expects 'submit_lock' to be held
+static void tensor_pool_start(void){
+  if(tensor_pool.started) return;
+  tensor_pool.started = true;
+  const uptr count = tensor_get_num_threads() - 1;
+  for_range(uptr, i, 0, count){
+    if(pthread_create(&tensor_pool.workers[i], nullptr, tensor_pool_worker, nullptr) != 0) break;
+    tensor_pool.worker_count++;
+  }
+}
 
-f32 f32_min_op(f32 a, f32 b){
-  return ((a<b)?a:b);
+void tensor_set_num_threads(uptr count){
+  pthread_mutex_lock(&tensor_pool.submit_lock);
+  tensor_pool_stop();
+  tensor_pool.requested_threads = count;
+  pthread_mutex_unlock(&tensor_pool.submit_lock);
 }
-Tensor tensor_vector_op_inp(Tensor_Iter* out_iter, f32 sv, f32_binop* op, Tensor tv){
-  while(tensor_iter_next(out_iter)){
-    *tensor_get_ptr_(out_iter->t, out_iter->inx) = 
-      op(sv, *tensor_get_ptr_(tv, out_iter->inx));
-  }
-  return out_iter->t;
+
+void tensor_set_parallel_threshold(uptr elem_count){
+  tensor_pool.threshold = elem_count;
 }
-Tensor tensor_vector_op_new(Alloc_Interface allocr, f32 sv, f32_binop* op, Tensor tv){
-  Tensor ans = tensor_alloc_(allocr, tv.shape);
-  Tensor_Iter iter = tensor_iter_init(allocr, ans);
-  (void)tensor_vector_op(&iter, sv, op, tv);
-  tensor_iter_deinit(allocr, &iter);
-  return ans;
+
+void tensor_threads_shutdown(void){
+  pthread_mutex_lock(&tensor_pool.submit_lock);
+  tensor_pool_stop();
+  pthread_mutex_unlock(&tensor_pool.submit_lock);
 }
 
-Tensor tensor_reduce_op_inp(Tensor_Iter* out_iter, Tensor tv, uptr dim, f32_binop* op){
-  // For reduce operations to work the number of dimensions should be > 0
-  assert(((void)"Cannot do reduction on 0 dimensional tensors", tv.shape.count > 0));
+// Runs fn(ctx, 0..task_count-1), returns after every task is done
+static void tensor_parallel_for(uptr task_count, Tensor_Task_Fn* fn, void* ctx){
+  if(task_count == 0) return;
+  if(task_count == 1 || tensor_in_task || tensor_get_num_threads() <= 1 ||
+     pthread_mutex_trylock(&tensor_pool.submit_lock) != 0){
+    for_range(uptr, t, 0, task_count) fn(ctx, t);
+    return;
+  }
+  tensor_pool_start();
 
-  // Assert that the dim is in range
-  assert(((void)"The dim to work on should exist in input tensor",
-	  dim < tv.shape.count));
+  pthread_mutex_lock(&tensor_pool.lock);
+  while(tensor_pool.active > 0) pthread_cond_wait(&tensor_pool.done_cv, &tensor_pool.lock);
+  tensor_pool.fn = fn;
+  tensor_pool.ctx = ctx;
+  tensor_pool.task_count = task_count;
+  atomic_store(&tensor_pool.next_task, 0);
+  atomic_store(&tensor_pool.done_tasks, 0);
+  tensor_pool.generation++;
+  pthread_cond_broadcast(&tensor_pool.work_cv);
+  pthread_mutex_unlock(&tensor_pool.lock);
 
-  // Assert that out_iter's tensor's dim is 1 less
-  assert(((void)"The output tensor's dimension count should be 1 less than input",
-	  out_iter->t.shape.count == (tv.shape.count -1)));
+  tensor_in_task = true;
+  tensor_pool_claim_tasks(fn, ctx, task_count);
+  tensor_in_task = false;
 
-  // Assert that the input has at least 1 elem in the dim index
-  assert(((void)"The input tensor to reduce must have non-zero dim in the chosen index",
-	  slice_inx(tv.shape, dim) > 0));
+  pthread_mutex_lock(&tensor_pool.lock);
+  while(atomic_load(&tensor_pool.done_tasks) < task_count)
+    pthread_cond_wait(&tensor_pool.done_cv, &tensor_pool.lock);
+  pthread_mutex_unlock(&tensor_pool.lock);
+  pthread_mutex_unlock(&tensor_pool.submit_lock);
+}
 
-  // Assert that the out_iter's tensor's shape matches after removing the dim
-  for_slice(out_iter->t.shape, i){
-    if(i < dim){
-      assert(((void)"The dimension of output must match input except for the chosen dimension to work on",
-	      slice_inx(tv.shape, i) == slice_inx(out_iter->t.shape, i)));
-    } else if(i >= dim){
-      assert(((void)"The dimension of output must match input except for the chosen dimension to work on",
-	      slice_inx(tv.shape, i+1) == slice_inx(out_iter->t.shape, i)));
-    }
+// Number of tasks to split 'work' units into, 1 if it is not worth it
+static uptr tensor_parallel_task_count(uptr work){
+  if(work < tensor_pool.threshold || tensor_in_task) return 1;
+  const uptr threads = tensor_get_num_threads();
+  // Few tasks per thread so that uneven progress balances out
+  uptr tasks = threads * 4;
+  const uptr min_work = (tensor_pool.threshold / 4) + 1;
+  if(work / tasks < min_work) tasks = work / min_work;
+  return (tasks > 0) ? tasks : 1;
+}
+
+// Runs fn over count tasks, threaded only if 'work' is large enough
+static void tensor_parallel_for_work(uptr count, uptr work, Tensor_Task_Fn* fn, void* ctx){
+  if(tensor_parallel_task_count(work) <= 1){
+    for_range(uptr, t, 0, count) fn(ctx, t);
+    return;
   }
+  tensor_parallel_for(count, fn, ctx);
+}
 
-  while(tensor_iter_next(out_iter)){
-    // Extract the single dimension ni 'tv' corresponding to out_iter
-    // Do the reduce operation on that
-    uptr offset = 0;
-    for_slice(out_iter->inx, i){
-      if(i < dim) offset += (tv.offset.data[i] + out_iter->inx.data[i]) * tv.stride.data[i];
-      else if(i >= dim) offset += (tv.offset.data[i+1] + out_iter->inx.data[i]) * tv.stride.data[i+1];
-    }
+typedef struct Tensor_Par_Loop Tensor_Par_Loop;
+struct Tensor_Par_Loop {
+  const Tensor_Loop* loop;
+  uptr total;
+  uptr chunk;
+  Tensor_Loop_Kernel* kernel;
+  void* ctx;
+};
 
-    Tensor one_dim = {
-      .storage = init_f32_slice(tv.storage.data + offset, tv.storage.count-offset),
-      .shape = MAKE_ARRAY_SLICE(uptr, slice_inx(tv.shape, dim)),
-      .stride = MAKE_ARRAY_SLICE(uptr, slice_inx(tv.stride, dim)),
-      .offset = MAKE_ARRAY_SLICE(uptr, 0),
-      .owner = false,
-    };
+static void tensor_par_loop_task(void* ctx, uptr t){
+  const Tensor_Par_Loop* pl = ctx;
+  const uptr begin = t * pl->chunk;
+  const uptr end = ((begin + pl->chunk) < pl->total) ? (begin + pl->chunk) : pl->total;
+  tensor_loop_run(pl->loop, begin, end, pl->kernel, pl->ctx);
+}
 
-    *tensor_get_ptr_(out_iter->t, out_iter->inx) = tensor_get(one_dim, 0);
-    for_range(uptr, i, 1, slice_inx(tv.shape, dim)){
-      *tensor_get_ptr_(out_iter->t, out_iter->inx) =
-      op(*tensor_get_ptr_(out_iter->t, out_iter->inx),
-	 tensor_get(one_dim, i));
-    }
+// Runs the whole loop, splitting it across threads when it is large enough
+//   'cost' is the rough amount of work per element, in units of an elementwise op
+//   Chunks are whole outer rows when there are enough of them,
+//   otherwise flat element ranges rounded to cache line sized pieces
+static void tensor_loop_run_all(const Tensor_Loop* loop, uptr total, uptr cost,
+				Tensor_Loop_Kernel* kernel, void* ctx){
+  const uptr tasks = tensor_parallel_task_count(total * cost);
+  if(tasks <= 1){
+    tensor_loop_run(loop, 0, total, kernel, ctx);
+    return;
   }
-  
-  return out_iter->t;
+  const uptr row = loop->shape[loop->ndim - 1];
+  const uptr rows = total / row;
+  uptr chunk;
+  if(rows >= tasks) chunk = ((rows + tasks - 1) / tasks) * row;
+  else chunk = ((((total + tasks - 1) / tasks) + 15) / 16) * 16;
+  if(chunk == 0) chunk = 1;
+  Tensor_Par_Loop pl = {
+    .loop = loop, .total = total, .chunk = chunk, .kernel = kernel, .ctx = ctx,
+  };
+  tensor_parallel_for((total + chunk - 1) / chunk, tensor_par_loop_task, &pl);
+}
+
+// Leaves the iterator in the same state as if it was run till the end
+static void tensor_iter_finish(Tensor_Iter* iter){
+  iter->first_time = false;
+  if(tensor_iter_inx(*iter).count > 0){
+    for_slice(tensor_iter_inx(*iter), i) slice_inx(tensor_iter_inx(*iter), i) = 0;
+    slice_inx(tensor_iter_inx(*iter), 0) = slice_inx(tensor_shape(iter->t), 0);
+  }
+}
+
+// The predefined binops are recognized by their pointers and get their own kernels
+typedef enum F32_Builtin_Op F32_Builtin_Op;
+enum F32_Builtin_Op {
+  F32_OP_CUSTOM = 0,
+  F32_OP_ADD,
+  F32_OP_PROD,
+  F32_OP_MAX,
+  F32_OP_MIN,
+  F32_OP_COUNT,
+};
+
+static F32_Builtin_Op f32_builtin_op_of(f32_binop* op){
+  if(op == f32_add_op) return F32_OP_ADD;
+  if(op == f32_prod_op) return F32_OP_PROD;
+  if(op == f32_max_op) return F32_OP_MAX;
+  if(op == f32_min_op) return F32_OP_MIN;
+  return F32_OP_CUSTOM;
+}
+
+// Context passed to the elementwise kernels below
+typedef struct Tensor_Op_Ctx Tensor_Op_Ctx;
+struct Tensor_Op_Ctx {
+  f32_binop* op;
+  F32_Builtin_Op builtin;
+  f32 sv;
+};
+
+// out = in
+static void tensor_copy_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  (void)ctx;
+  f32* out = p[0];
+  const f32* in = p[1];
+  if(s[0] == 1 && s[1] == 1){
+    memmove(out, in, n * sizeof(f32));
+    return;
+  }
+  for_range(uptr, i, 0, n) out[(iptr)i * s[0]] = in[(iptr)i * s[1]];
+}
+
+// out = op(a, b)
+static void tensor_binop_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  f32_binop* op = ((Tensor_Op_Ctx*)ctx)->op;
+  f32* out = p[0];
+  const f32* a = p[1];
+  const f32* b = p[2];
+  if(s[0] == 1 && s[1] == 1 && s[2] == 1){
+    for_range(uptr, i, 0, n) out[i] = op(a[i], b[i]);
+    return;
+  }
+  for_range(uptr, i, 0, n) out[(iptr)i * s[0]] = op(a[(iptr)i * s[1]], b[(iptr)i * s[2]]);
+}
+
+// out = op(sv, a)
+static void tensor_vecop_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Op_Ctx* c = ctx;
+  f32* out = p[0];
+  const f32* a = p[1];
+  if(s[0] == 1 && s[1] == 1){
+    for_range(uptr, i, 0, n) out[i] = c->op(c->sv, a[i]);
+    return;
+  }
+  for_range(uptr, i, 0, n) out[(iptr)i * s[0]] = c->op(c->sv, a[(iptr)i * s[1]]);
+}
+
+// Kernels for the builtin ops over unit stride arrays
+//   out[i] = a[i] op b[i]   and   out[i] = sv op a[i]
+//   reduction folds x[0..n) (n > 0) into a single value
+typedef void F32_Bin_Kernel(uptr n, f32* out, const f32* a, const f32* b);
+typedef void F32_Vec_Kernel(uptr n, f32* out, f32 sv, const f32* a);
+typedef f32 F32_Red_Kernel(uptr n, const f32* x);
+
+typedef struct F32_Simd_Table F32_Simd_Table;
+struct F32_Simd_Table {
+  F32_Bin_Kernel* bin[F32_OP_COUNT];
+  F32_Vec_Kernel* vec[F32_OP_COUNT];
+  F32_Red_Kernel* red[F32_OP_COUNT];
+};
+
+static inline f32 f32_add_inl(f32 a, f32 b){ return a + b; }
+static inline f32 f32_prod_inl(f32 a, f32 b){ return a * b; }
+static inline f32 f32_max_inl(f32 a, f32 b){ return ((a>b)?a:b); }
+static inline f32 f32_min_inl(f32 a, f32 b){ return ((a<b)?a:b); }
+
+// Plain loops without any indirect call, compiler is free to vectorize these
+#define DEF_PLAIN_KERNELS(opname, scalar_op)				\
+  static void CONCAT(f32_bin_plain_, opname)(uptr n, f32* out, const f32* a, const f32* b){ \
+    for_range(uptr, i, 0, n) out[i] = scalar_op(a[i], b[i]);		\
+  }									\
+  static void CONCAT(f32_vec_plain_, opname)(uptr n, f32* out, f32 sv, const f32* a){ \
+    for_range(uptr, i, 0, n) out[i] = scalar_op(sv, a[i]);		\
+  }									\
+  /* Fixed 8 lane layout, so the result doesnt depend on the cpu */	\
+  static f32 CONCAT(f32_red_plain_, opname)(uptr n, const f32* x){	\
+    if(n < 8){								\
+      f32 acc = x[0];							\
+      for_range(uptr, i, 1, n) acc = scalar_op(acc, x[i]);		\
+      return acc;							\
+    }									\
+    f32 lanes[8];							\
+    for_range(uptr, l, 0, 8) lanes[l] = x[l];				\
+    uptr i = 8;								\
+    for(; i + 8 <= n; i += 8){						\
+      for_range(uptr, l, 0, 8) lanes[l] = scalar_op(lanes[l], x[i + l]); \
+    }									\
+    for_range(uptr, l, 0, 4) lanes[l] = scalar_op(lanes[l], lanes[l + 4]); \
+    lanes[0] = scalar_op(lanes[0], lanes[2]);				\
+    lanes[1] = scalar_op(lanes[1], lanes[3]);				\
+    f32 acc = scalar_op(lanes[0], lanes[1]);				\
+    for(; i < n; ++i) acc = scalar_op(acc, x[i]);			\
+    return acc;								\
+  }
+DEF_PLAIN_KERNELS(add, f32_add_inl)
+DEF_PLAIN_KERNELS(prod, f32_prod_inl)
+DEF_PLAIN_KERNELS(max, f32_max_inl)
+DEF_PLAIN_KERNELS(min, f32_min_inl)
+#undef DEF_PLAIN_KERNELS
+
+static const F32_Simd_Table f32_plain_table = {
+  .bin = {nullptr, f32_bin_plain_add, f32_bin_plain_prod, f32_bin_plain_max, f32_bin_plain_min},
+  .vec = {nullptr, f32_vec_plain_add, f32_vec_plain_prod, f32_vec_plain_max, f32_vec_plain_min},
+  .red = {nullptr, f32_red_plain_add, f32_red_plain_prod, f32_red_plain_max, f32_red_plain_min},
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TENSOR_HAS_X86_SIMD 1
+#include <immintrin.h>
+
+// The max/min intrinsics compute (a>b)?a:b and (a<b)?a:b, same as f32_max_op/f32_min_op
+#define DEF_SIMD_KERNELS(isa, target_str, width, vec_t, loadu, storeu, set1, vop, opname, scalar_op) \
+  __attribute__((target(target_str)))					\
+  static void CONCAT(CONCAT(f32_bin_, isa), opname)(uptr n, f32* out, const f32* a, const f32* b){ \
+    uptr i = 0;								\
+    for(; i + 2*(width) <= n; i += 2*(width)){				\
+      storeu(out + i, vop(loadu(a + i), loadu(b + i)));			\
+      storeu(out + i + (width), vop(loadu(a + i + (width)), loadu(b + i + (width)))); \
+    }									\
+    for(; i + (width) <= n; i += (width)) storeu(out + i, vop(loadu(a + i), loadu(b + i))); \
+    for(; i < n; ++i) out[i] = scalar_op(a[i], b[i]);			\
+  }									\
+  __attribute__((target(target_str)))					\
+  static void CONCAT(CONCAT(f32_vec_, isa), opname)(uptr n, f32* out, f32 sv, const f32* a){ \
+    const __typeof__(set1(sv)) vs = set1(sv);				\
+    uptr i = 0;								\
+    for(; i + 2*(width) <= n; i += 2*(width)){				\
+      storeu(out + i, vop(vs, loadu(a + i)));				\
+      storeu(out + i + (width), vop(vs, loadu(a + i + (width))));	\
+    }									\
+    for(; i + (width) <= n; i += (width)) storeu(out + i, vop(vs, loadu(a + i))); \
+    for(; i < n; ++i) out[i] = scalar_op(sv, a[i]);			\
+  }									\
+  __attribute__((target(target_str)))					\
+  static f32 CONCAT(CONCAT(f32_red_, isa), opname)(uptr n, const f32* x){ \
+    if(n < 4*(width)){							\
+      f32 acc = x[0];							\
+      for_range(uptr, i, 1, n) acc = scalar_op(acc, x[i]);		\
+      return acc;							\
+    }									\
+    vec_t a0 = loadu(x), a1 = loadu(x + (width));			\
+    vec_t a2 = loadu(x + 2*(width)), a3 = loadu(x + 3*(width));		\
+    uptr i = 4*(width);							\
+    for(; i + 4*(width) <= n; i += 4*(width)){				\
+      a0 = vop(a0, loadu(x + i));					\
+      a1 = vop(a1, loadu(x + i + (width)));				\
+      a2 = vop(a2, loadu(x + i + 2*(width)));				\
+      a3 = vop(a3, loadu(x + i + 3*(width)));				\
+    }									\
+    a0 = vop(vop(a0, a1), vop(a2, a3));					\
+    f32 lanes[width];							\
+    storeu(lanes, a0);							\
+    for(uptr w = (width)/2; w > 0; w /= 2){				\
+      for_range(uptr, l, 0, w) lanes[l] = scalar_op(lanes[l], lanes[l + w]); \
+    }									\
+    f32 acc = lanes[0];							\
+    for(; i < n; ++i) acc = scalar_op(acc, x[i]);			\
+    return acc;								\
+  }
+
+#define DEF_SIMD_ISA(isa, target_str, width, vec_t, loadu, storeu, set1, add, mul, max, min) \
+  DEF_SIMD_KERNELS(isa, target_str, width, vec_t, loadu, storeu, set1, add, _add, f32_add_inl) \
+  DEF_SIMD_KERNELS(isa, target_str, width, vec_t, loadu, storeu, set1, mul, _prod, f32_prod_inl) \
+  DEF_SIMD_KERNELS(isa, target_str, width, vec_t, loadu, storeu, set1, max, _max, f32_max_inl) \
+  DEF_SIMD_KERNELS(isa, target_str, width, vec_t, loadu, storeu, set1, min, _min, f32_min_inl) \
+  static const F32_Simd_Table CONCAT(CONCAT(f32_, isa), _table) = {	\
+    .bin = {nullptr, CONCAT(CONCAT(f32_bin_, isa), _add), CONCAT(CONCAT(f32_bin_, isa), _prod), \
+	    CONCAT(CONCAT(f32_bin_, isa), _max), CONCAT(CONCAT(f32_bin_, isa), _min)}, \
+    .vec = {nullptr, CONCAT(CONCAT(f32_vec_, isa), _add), CONCAT(CONCAT(f32_vec_, isa), _prod), \
+	    CONCAT(CONCAT(f32_vec_, isa), _max), CONCAT(CONCAT(f32_vec_, isa), _min)}, \
+    .red = {nullptr, CONCAT(CONCAT(f32_red_, isa), _add), CONCAT(CONCAT(f32_red_, isa), _prod), \
+	    CONCAT(CONCAT(f32_red_, isa), _max), CONCAT(CONCAT(f32_red_, isa), _min)}, \
+  };
+
+DEF_SIMD_ISA(sse, "sse", 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_set1_ps,
+	     _mm_add_ps, _mm_mul_ps, _mm_max_ps, _mm_min_ps)
+DEF_SIMD_ISA(avx2, "avx2", 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_set1_ps,
+	     _mm256_add_ps, _mm256_mul_ps, _mm256_max_ps, _mm256_min_ps)
+DEF_SIMD_ISA(avx512, "avx512f", 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_set1_ps,
+	     _mm512_add_ps, _mm512_mul_ps, _mm512_max_ps, _mm512_min_ps)
+#undef DEF_SIMD_ISA
+#undef DEF_SIMD_KERNELS
+#endif
+
+static const F32_Simd_Table* f32_simd_chosen = &f32_plain_table;
+static pthread_once_t f32_simd_once = PTHREAD_ONCE_INIT;
+
+// Not to be used directly, just a helper fxn
+static void f32_simd_choose(void){
+#ifdef TENSOR_HAS_X86_SIMD
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f")) f32_simd_chosen = &f32_avx512_table;
+  else if(__builtin_cpu_supports("avx2")) f32_simd_chosen = &f32_avx2_table;
+  else if(__builtin_cpu_supports("sse")) f32_simd_chosen = &f32_sse_table;
+#endif
+}
+
+// Picks the widest kernels the running cpu supports, decided only once
+//   pthread_once also makes the choice visible to threads asking at the same time
+static const F32_Simd_Table* f32_simd_table(void){
+  pthread_once(&f32_simd_once, f32_simd_choose);
+  return f32_simd_chosen;
+}
+
+// When set, reductions use the portable kernels with a fixed accumulation layout
+static bool tensor_deterministic = false;
+
+void tensor_set_deterministic(bool enable){
+  tensor_deterministic = enable;
+}
+
+static const F32_Simd_Table* f32_reduce_table(void){
+  return tensor_deterministic ? &f32_plain_table : f32_simd_table();
+}
+
+// Strided fallback for builtin ops, still avoids the indirect call per element
+#define BUILTIN_STRIDED_LOOP(builtin, out_expr, lhs, rhs)		\
+  switch(builtin){							\
+  case F32_OP_ADD: for_range(uptr, i, 0, n) out_expr = f32_add_inl(lhs, rhs); break; \
+  case F32_OP_PROD: for_range(uptr, i, 0, n) out_expr = f32_prod_inl(lhs, rhs); break; \
+  case F32_OP_MAX: for_range(uptr, i, 0, n) out_expr = f32_max_inl(lhs, rhs); break; \
+  case F32_OP_MIN: for_range(uptr, i, 0, n) out_expr = f32_min_inl(lhs, rhs); break; \
+  default: assert(((void)"Not a builtin op", false));		\
+  }
+
+// out = a op b, for builtin ops
+static void tensor_builtin_binop_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const F32_Builtin_Op builtin = ((Tensor_Op_Ctx*)ctx)->builtin;
+  f32* out = p[0];
+  const f32* a = p[1];
+  const f32* b = p[2];
+  if(s[0] == 1 && s[1] == 1 && s[2] == 1){
+    f32_simd_table()->bin[builtin](n, out, a, b);
+    return;
+  }
+  // One side broadcasted along the row is just a vectorized op with that scalar
+  if(s[0] == 1 && s[1] == 0 && s[2] == 1){
+    f32_simd_table()->vec[builtin](n, out, *a, b);
+    return;
+  }
+  if(s[0] == 1 && s[1] == 1 && s[2] == 0 &&
+     (builtin == F32_OP_ADD || builtin == F32_OP_PROD)){
+    f32_simd_table()->vec[builtin](n, out, *b, a);
+    return;
+  }
+  BUILTIN_STRIDED_LOOP(builtin, out[(iptr)i * s[0]], a[(iptr)i * s[1]], b[(iptr)i * s[2]]);
+}
+
+// out = sv op a, for builtin ops
+static void tensor_builtin_vecop_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Op_Ctx* c = ctx;
+  f32* out = p[0];
+  const f32* a = p[1];
+  if(s[0] == 1 && s[1] == 1){
+    f32_simd_table()->vec[c->builtin](n, out, c->sv, a);
+    return;
+  }
+  BUILTIN_STRIDED_LOOP(c->builtin, out[(iptr)i * s[0]], c->sv, a[(iptr)i * s[1]]);
+}
+#undef BUILTIN_STRIDED_LOOP
+
+// Element type conversions
+//   Non f32 operands of elementwise ops are converted in chunks into f32 buffers on the
+//   stack, the usual f32 kernels run on those, and the output chunk is converted back,
+//   so only the dtype's own bytes go through memory. Half conversions use F16C and
+//   AVX-512 BF16 when the cpu has them, the portable versions round exactly the same.
+#define TENSOR_DTYPE_CHUNK 256
+
+// Not to be used directly, just a helper fxn
+static f32 tensor_half_to_f32(uint16_t h){
+  const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t bits;
+  if(exp == 0x1f){
+    // Nans are quieted, same as VCVTPH2PS
+    bits = sign | 0x7f800000 | (mant << 13) | ((mant != 0) ? 0x400000 : 0);
+  } else if(exp != 0){
+    bits = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if(mant == 0){
+    bits = sign;
+  } else {
+    // Subnormal, normalize it
+    exp = 113;
+    while((mant & 0x400) == 0){
+      mant <<= 1;
+      exp--;
+    }
+    bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  f32 f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Not to be used directly, just a helper fxn
+// Rounds to nearest even, nans are kept quiet (same as VCVTPS2PH)
+static uint16_t tensor_f32_to_half(f32 f){
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  const uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+  const uint32_t ax = x & 0x7fffffff;
+  if(ax > 0x7f800000) return sign | 0x7e00 | (uint16_t)((ax >> 13) & 0x3ff);
+  // Halfway between the largest half (65504) and 65536 rounds up to infinity
+  if(ax >= 0x477ff000) return sign | 0x7c00;
+  if(ax < 0x38800000){
+    // Below the smallest normal half, round the mantissa into a subnormal
+    const uint32_t e = ax >> 23;
+    if(e < 102) return sign;
+    const uint32_t mant = (ax & 0x7fffff) | 0x800000;
+    const uint32_t shift = 126 - e;
+    uint32_t q = mant >> shift;
+    const uint32_t rem = mant & ((1u << shift) - 1);
+    const uint32_t half = 1u << (shift - 1);
+    if(rem > half || (rem == half && (q & 1))) q++;
+    return sign | (uint16_t)q;
+  }
+  // Rebias the exponent, a carry out of the mantissa correctly bumps it
+  const uint32_t r = ax + 0xfff + ((ax >> 13) & 1) - 0x38000000;
+  return sign | (uint16_t)(r >> 13);
+}
+
+// Not to be used directly, just a helper fxn
+static f32 tensor_bf16_to_f32(uint16_t h){
+  const uint32_t bits = (uint32_t)h << 16;
+  f32 f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+// Not to be used directly, just a helper fxn
+// Rounds to nearest even, subnormals become zero and nans are kept quiet (same as VCVTNEPS2BF16)
+static uint16_t tensor_f32_to_bf16(f32 f){
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  if((x & 0x7fffffff) > 0x7f800000) return (uint16_t)((x >> 16) | 0x40);
+  if((x & 0x7f800000) == 0) return (uint16_t)((x >> 16) & 0x8000);
+  x += 0x7fff + ((x >> 16) & 1);
+  return (uint16_t)(x >> 16);
+}
+
+// Not to be used directly, just a helper fxn
+// Truncates toward zero and saturates, nan becomes 0
+static int32_t tensor_f64_to_i32(f64 v){
+  if(v != v) return 0;
+  if(v >= 2147483647.0) return INT32_MAX;
+  if(v <= -2147483648.0) return INT32_MIN;
+  return (int32_t)v;
+}
+
+// Not to be used directly, just a helper fxn
+static int8_t tensor_f64_to_i8(f64 v){
+  if(v != v) return 0;
+  if(v >= 127.0) return INT8_MAX;
+  if(v <= -128.0) return INT8_MIN;
+  return (int8_t)v;
+}
+
+// Same as above, written with selects only so that loops over them vectorize
+static inline int32_t tensor_f32_to_i32(f32 v){
+  const int32_t i = (int32_t)((v > -2147483648.f && v < 2147483648.f) ? v : 0.f);
+  return (v >= 2147483648.f) ? INT32_MAX : ((v <= -2147483648.f) ? INT32_MIN : i);
+}
+static inline int8_t tensor_f32_to_i8(f32 v){
+  const f32 c = (v > 127.f) ? 127.f : ((v < -128.f) ? -128.f : v);
+  return (int8_t)(int32_t)((c == c) ? c : 0.f);
+}
+
+// Unit stride half conversions, picked once for the running cpu
+typedef struct Tensor_Half_Kernels Tensor_Half_Kernels;
+struct Tensor_Half_Kernels {
+  void (*f16_to_f32)(uptr n, const uint16_t* src, f32* dst);
+  void (*f32_to_f16)(uptr n, const f32* src, uint16_t* dst);
+  void (*bf16_to_f32)(uptr n, const uint16_t* src, f32* dst);
+  void (*f32_to_bf16)(uptr n, const f32* src, uint16_t* dst);
+};
+
+static void tensor_f16_to_f32_plain(uptr n, const uint16_t* src, f32* dst){
+  for_range(uptr, i, 0, n) dst[i] = tensor_half_to_f32(src[i]);
+}
+static void tensor_f32_to_f16_plain(uptr n, const f32* src, uint16_t* dst){
+  for_range(uptr, i, 0, n) dst[i] = tensor_f32_to_half(src[i]);
+}
+static void tensor_bf16_to_f32_plain(uptr n, const uint16_t* src, f32* dst){
+  for_range(uptr, i, 0, n) dst[i] = tensor_bf16_to_f32(src[i]);
+}
+static void tensor_f32_to_bf16_plain(uptr n, const f32* src, uint16_t* dst){
+  for_range(uptr, i, 0, n) dst[i] = tensor_f32_to_bf16(src[i]);
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+__attribute__((target("avx,f16c")))
+static void tensor_f16_to_f32_f16c(uptr n, const uint16_t* src, f32* dst){
+  uptr i = 0;
+  for(; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+  for(; i < n; ++i) dst[i] = tensor_half_to_f32(src[i]);
+}
+
+__attribute__((target("avx,f16c")))
+static void tensor_f32_to_f16_f16c(uptr n, const f32* src, uint16_t* dst){
+  uptr i = 0;
+  for(; i + 8 <= n; i += 8)
+    _mm_storeu_si128((__m128i*)(dst + i),
+		     _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+  for(; i < n; ++i) dst[i] = tensor_f32_to_half(src[i]);
+}
+
+// Widening bf16 is just a shift into the high half
+__attribute__((target("avx2")))
+static void tensor_bf16_to_f32_avx2(uptr n, const uint16_t* src, f32* dst){
+  uptr i = 0;
+  for(; i + 8 <= n; i += 8){
+    const __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + i)));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_slli_epi32(w, 16));
+  }
+  for(; i < n; ++i) dst[i] = tensor_bf16_to_f32(src[i]);
+}
+
+__attribute__((target("avx512f,avx512bf16")))
+static void tensor_f32_to_bf16_avx512(uptr n, const f32* src, uint16_t* dst){
+  uptr i = 0;
+  for(; i + 16 <= n; i += 16)
+    _mm256_storeu_si256((__m256i*)(dst + i), (__m256i)_mm512_cvtneps_pbh(_mm512_loadu_ps(src + i)));
+  for(; i < n; ++i) dst[i] = tensor_f32_to_bf16(src[i]);
+}
+#endif
+
+static Tensor_Half_Kernels tensor_half_kernels_chosen;
+static pthread_once_t tensor_half_kernels_once = PTHREAD_ONCE_INIT;
+
+// Not to be used directly, just a helper fxn
+static void tensor_half_kernels_choose(void){
+  Tensor_Half_Kernels k = {
+    .f16_to_f32 = tensor_f16_to_f32_plain,
+    .f32_to_f16 = tensor_f32_to_f16_plain,
+    .bf16_to_f32 = tensor_bf16_to_f32_plain,
+    .f32_to_bf16 = tensor_f32_to_bf16_plain,
+  };
+#ifdef TENSOR_HAS_X86_SIMD
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c")){
+    k.f16_to_f32 = tensor_f16_to_f32_f16c;
+    k.f32_to_f16 = tensor_f32_to_f16_f16c;
+  }
+  if(__builtin_cpu_supports("avx2")) k.bf16_to_f32 = tensor_bf16_to_f32_avx2;
+  if(__builtin_cpu_supports("avx512bf16")) k.f32_to_bf16 = tensor_f32_to_bf16_avx512;
+#endif
+  tensor_half_kernels_chosen = k;
+}
+
+// Chosen once for the running cpu, pthread_once also makes the choice visible to
+//   every thread that converts at the same time
+static const Tensor_Half_Kernels* tensor_half_kernels(void){
+  pthread_once(&tensor_half_kernels_once, tensor_half_kernels_choose);
+  return &tensor_half_kernels_chosen;
+}
+
+// Not to be used directly, just a helper fxn
+// dst[i * dst_stride] = src[i * src_stride] converted to f32, strides in elements
+static void tensor_dtype_load(Tensor_DType dtype, uptr n, const void* src, iptr src_stride,
+			      f32* dst, iptr dst_stride){
+  // Unit strides get their own loops, so that the compiler can vectorize them
+#define TENSOR_DTYPE_LOAD(T, conv)					\
+  if(unit) for_range(uptr, i, 0, n) dst[i] = conv(((const T*)src)[i]);	\
+  else for_range(uptr, i, 0, n) dst[(iptr)i * dst_stride] = conv(((const T*)src)[(iptr)i * src_stride])
+  const bool unit = (src_stride == 1 && dst_stride == 1);
+  switch(dtype){
+  case TENSOR_F32: TENSOR_DTYPE_LOAD(f32, (f32)); break;
+  case TENSOR_F64: TENSOR_DTYPE_LOAD(f64, (f32)); break;
+  case TENSOR_F16:
+    if(unit) tensor_half_kernels()->f16_to_f32(n, src, dst);
+    else for_range(uptr, i, 0, n)
+      dst[(iptr)i * dst_stride] = tensor_half_to_f32(((const uint16_t*)src)[(iptr)i * src_stride]);
+    break;
+  case TENSOR_BF16:
+    if(unit) tensor_half_kernels()->bf16_to_f32(n, src, dst);
+    else TENSOR_DTYPE_LOAD(uint16_t, tensor_bf16_to_f32);
+    break;
+  case TENSOR_I32: TENSOR_DTYPE_LOAD(int32_t, (f32)); break;
+  case TENSOR_I8: TENSOR_DTYPE_LOAD(int8_t, (f32)); break;
+  default: assert(((void)"Invalid tensor dtype", false));
+  }
+#undef TENSOR_DTYPE_LOAD
+}
+
+// Not to be used directly, just a helper fxn
+// dst[i * dst_stride] = src[i * src_stride] converted from f32, strides in elements
+static void tensor_dtype_store(Tensor_DType dtype, uptr n, const f32* src, iptr src_stride,
+			       void* dst, iptr dst_stride){
+#define TENSOR_DTYPE_STORE(T, conv)					\
+  if(unit) for_range(uptr, i, 0, n) ((T*)dst)[i] = conv(src[i]);		\
+  else for_range(uptr, i, 0, n) ((T*)dst)[(iptr)i * dst_stride] = conv(src[(iptr)i * src_stride])
+  const bool unit = (src_stride == 1 && dst_stride == 1);
+  switch(dtype){
+  case TENSOR_F32: TENSOR_DTYPE_STORE(f32, (f32)); break;
+  case TENSOR_F64: TENSOR_DTYPE_STORE(f64, (f64)); break;
+  case TENSOR_F16:
+    if(unit) tensor_half_kernels()->f32_to_f16(n, src, dst);
+    else for_range(uptr, i, 0, n) ((uint16_t*)dst)[(iptr)i * dst_stride] = tensor_f32_to_half(src[(iptr)i * src_stride]);
+    break;
+  case TENSOR_BF16:
+    if(unit) tensor_half_kernels()->f32_to_bf16(n, src, dst);
+    else for_range(uptr, i, 0, n) ((uint16_t*)dst)[(iptr)i * dst_stride] = tensor_f32_to_bf16(src[(iptr)i * src_stride]);
+    break;
+  case TENSOR_I32: TENSOR_DTYPE_STORE(int32_t, tensor_f32_to_i32); break;
+  case TENSOR_I8: TENSOR_DTYPE_STORE(int8_t, tensor_f32_to_i8); break;
+  default: assert(((void)"Invalid tensor dtype", false));
+  }
+#undef TENSOR_DTYPE_STORE
+}
+
+// Not to be used directly, just a helper fxn
+static f64 tensor_dtype_get(Tensor_DType dtype, const void* p){
+  switch(dtype){
+  case TENSOR_F32: return *(const f32*)p;
+  case TENSOR_F64: return *(const f64*)p;
+  case TENSOR_F16: return tensor_half_to_f32(*(const uint16_t*)p);
+  case TENSOR_BF16: return tensor_bf16_to_f32(*(const uint16_t*)p);
+  case TENSOR_I32: return *(const int32_t*)p;
+  case TENSOR_I8: return *(const int8_t*)p;
+  default: assert(((void)"Invalid tensor dtype", false));
+  }
+  return 0;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_dtype_set(Tensor_DType dtype, void* p, f64 v){
+  switch(dtype){
+  case TENSOR_F32: *(f32*)p = (f32)v; break;
+  case TENSOR_F64: *(f64*)p = v; break;
+  case TENSOR_F16: *(uint16_t*)p = tensor_f32_to_half((f32)v); break;
+  case TENSOR_BF16: *(uint16_t*)p = tensor_f32_to_bf16((f32)v); break;
+  case TENSOR_I32: *(int32_t*)p = tensor_f64_to_i32(v); break;
+  case TENSOR_I8: *(int8_t*)p = tensor_f64_to_i8(v); break;
+  default: assert(((void)"Invalid tensor dtype", false));
+  }
+}
+
+// Not to be used directly, just a helper fxn
+// Dtype that can hold the values of both, for the outputs of the '_new' ops
+static Tensor_DType tensor_dtype_promote(Tensor_DType a, Tensor_DType b){
+  if(a == b) return a;
+  if(a == TENSOR_F64 || b == TENSOR_F64) return TENSOR_F64;
+  const bool a_int = (a == TENSOR_I32 || a == TENSOR_I8);
+  const bool b_int = (b == TENSOR_I32 || b == TENSOR_I8);
+  if(a_int && b_int) return TENSOR_I32;
+  // Every i8 is exact in any float type
+  if(a == TENSOR_I8) return b;
+  if(b == TENSOR_I8) return a;
+  return TENSOR_F32;
+}
+
+typedef struct Tensor_Cast_Ctx Tensor_Cast_Ctx;
+struct Tensor_Cast_Ctx {
+  Tensor_DType out;
+  Tensor_DType in;
+};
+
+// out = in, between any dtypes, used in place of 'tensor_copy_kernel' for non f32 operands
+static void tensor_cast_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Cast_Ctx* c = ctx;
+  char* out = (char*)p[0];
+  const char* in = (const char*)p[1];
+  const uptr out_size = tensor_dtype_size(c->out);
+  const uptr in_size = tensor_dtype_size(c->in);
+  if(c->out == c->in){
+    // Same dtype is copied bitwise
+    if(s[0] == 1 && s[1] == 1){
+      memmove(out, in, n * out_size);
+      return;
+    }
+    for_range(uptr, i, 0, n)
+      memcpy(out + (iptr)i * s[0] * (iptr)out_size, in + (iptr)i * s[1] * (iptr)in_size, out_size);
+    return;
+  }
+  if(c->in == TENSOR_F32){
+    tensor_dtype_store(c->out, n, (const f32*)in, s[1], out, s[0]);
+    return;
+  }
+  if(c->out == TENSOR_F32){
+    tensor_dtype_load(c->in, n, in, s[1], (f32*)out, s[0]);
+    return;
+  }
+  if(c->out == TENSOR_F64 || c->out == TENSOR_I32 || c->in == TENSOR_F64 || c->in == TENSOR_I32){
+    // Not every value of these fits in f32, go through f64 instead
+    for_range(uptr, i, 0, n)
+      tensor_dtype_set(c->out, out + (iptr)i * s[0] * (iptr)out_size,
+		       tensor_dtype_get(c->in, in + (iptr)i * s[1] * (iptr)in_size));
+    return;
+  }
+  f32 buf[TENSOR_DTYPE_CHUNK];
+  for(uptr j = 0; j < n; j += TENSOR_DTYPE_CHUNK){
+    const uptr m = ((n - j) < TENSOR_DTYPE_CHUNK) ? (n - j) : TENSOR_DTYPE_CHUNK;
+    tensor_dtype_load(c->in, m, in + (iptr)j * s[1] * (iptr)in_size, s[1], buf, 1);
+    tensor_dtype_store(c->out, m, buf, 1, out + (iptr)j * s[0] * (iptr)out_size, s[0]);
+  }
+}
+
+typedef struct Tensor_Typed_Ctx Tensor_Typed_Ctx;
+struct Tensor_Typed_Ctx {
+  Tensor_Loop_Kernel* kernel;
+  void* ctx;
+  uptr nops;
+  Tensor_DType dtype[TENSOR_LOOP_MAX_OPS];
+};
+
+// Runs an f32 kernel over operands of any dtypes, TENSOR_DTYPE_CHUNK elements at a time
+//   f32 operands are passed as they are, the output (operand 0) is only written back
+static void tensor_typed_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Typed_Ctx* c = ctx;
+  f32 bufs[TENSOR_LOOP_MAX_OPS][TENSOR_DTYPE_CHUNK];
+  f32* ptrs[TENSOR_LOOP_MAX_OPS];
+  iptr strides[TENSOR_LOOP_MAX_OPS];
+  for(uptr j = 0; j < n; j += TENSOR_DTYPE_CHUNK){
+    const uptr m = ((n - j) < TENSOR_DTYPE_CHUNK) ? (n - j) : TENSOR_DTYPE_CHUNK;
+    for_range(uptr, k, 0, c->nops){
+      char* at = (char*)p[k] + (iptr)j * s[k] * (iptr)tensor_dtype_size(c->dtype[k]);
+      if(c->dtype[k] == TENSOR_F32){
+	ptrs[k] = (f32*)at;
+	strides[k] = s[k];
+	continue;
+      }
+      ptrs[k] = bufs[k];
+      strides[k] = (s[k] == 0) ? 0 : 1;
+      // Broadcasted operands are converted only once, and stay broadcasted for the kernel
+      if(k > 0) tensor_dtype_load(c->dtype[k], (s[k] == 0) ? 1 : m, at, s[k], bufs[k], 1);
+    }
+    c->kernel(c->ctx, m, ptrs, strides);
+    if(c->dtype[0] != TENSOR_F32){
+      tensor_dtype_store(c->dtype[0], m, bufs[0], 1,
+			 (char*)p[0] + (iptr)j * s[0] * (iptr)tensor_dtype_size(c->dtype[0]), s[0]);
+    }
+  }
+}
+
+// Tiled transposing copies
+//   Contiguous sources and sources with a contiguous inner dimension already become one
+//   or a few row memmoves once the loop is coalesced. Permuted views are the bad case, the
+//   source is then contiguous along some outer dimension of the loop and every element of a
+//   row would come from a different cache line, so those are copied as 2d transposes in
+//   square tiles instead. Rows of the transpose follow the source's contiguous dimension,
+//   columns the destination's.
+#define TENSOR_TRANSPOSE_TILE 32
+// Planes smaller than this on either side are left to the plain loop
+#define TENSOR_TRANSPOSE_MIN 8
+
+typedef struct Tensor_Transpose Tensor_Transpose;
+typedef void Tensor_Transpose_Fn(const Tensor_Transpose* tr, char* dst, const char* src,
+				 uptr rows, uptr cols);
+struct Tensor_Transpose {
+  Tensor_Transpose_Fn* fn;
+  char* dst;
+  const char* src;
+  uptr elem_size;
+  uptr rows;
+  uptr cols;
+  uptr bands;
+  // Strides are in bytes
+  iptr dst_row, dst_col;
+  iptr src_row, src_col;
+  // Remaining dimensions, the plane is transposed once for each index of these
+  uptr outer_ndim;
+  uptr outer_shape[TENSOR_LOOP_MAX_DIMS];
+  iptr outer_dst[TENSOR_LOOP_MAX_DIMS];
+  iptr outer_src[TENSOR_LOOP_MAX_DIMS];
+};
+
+// Not to be used directly, just a helper fxn
+static inline void tensor_transpose_tile_sized(const Tensor_Transpose* tr, char* dst, const char* src,
+					       uptr rows, uptr cols, uptr size){
+  for_range(uptr, r, 0, rows){
+    char* d = dst + (iptr)r * tr->dst_row;
+    const char* s = src + (iptr)r * tr->src_row;
+    for_range(uptr, c, 0, cols) memcpy(d + (iptr)c * tr->dst_col, s + (iptr)c * tr->src_col, size);
+  }
+}
+
+static void tensor_transpose_tile_plain(const Tensor_Transpose* tr, char* dst, const char* src,
+					uptr rows, uptr cols){
+  // Constant sizes so that every copy is a single move
+  switch(tr->elem_size){
+  case 1: tensor_transpose_tile_sized(tr, dst, src, rows, cols, 1); break;
+  case 2: tensor_transpose_tile_sized(tr, dst, src, rows, cols, 2); break;
+  case 4: tensor_transpose_tile_sized(tr, dst, src, rows, cols, 4); break;
+  case 8: tensor_transpose_tile_sized(tr, dst, src, rows, cols, 8); break;
+  default: tensor_transpose_tile_sized(tr, dst, src, rows, cols, tr->elem_size); break;
+  }
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+// 4 byte elements, contiguous along the rows of the source and the columns of the destination
+//   8 x 8 blocks are loaded as 8 source rows and stored as 8 destination rows,
+//   the shuffles only move bits around so this serves i32 as well as f32
+__attribute__((target("avx")))
+static void tensor_transpose_tile_avx(const Tensor_Transpose* tr, char* dst, const char* src,
+				      uptr rows, uptr cols){
+  uptr c = 0;
+  for(; c + 8 <= cols; c += 8){
+    uptr r = 0;
+    for(; r + 8 <= rows; r += 8){
+      const char* s = src + (iptr)c * tr->src_col + (iptr)r * 4;
+      char* d = dst + (iptr)r * tr->dst_row + (iptr)c * 4;
+      __m256 v[8], t[8];
+      for_range(uptr, k, 0, 8) v[k] = _mm256_loadu_ps((const f32*)(s + (iptr)k * tr->src_col));
+      t[0] = _mm256_unpacklo_ps(v[0], v[1]);
+      t[1] = _mm256_unpackhi_ps(v[0], v[1]);
+      t[2] = _mm256_unpacklo_ps(v[2], v[3]);
+      t[3] = _mm256_unpackhi_ps(v[2], v[3]);
+      t[4] = _mm256_unpacklo_ps(v[4], v[5]);
+      t[5] = _mm256_unpackhi_ps(v[4], v[5]);
+      t[6] = _mm256_unpacklo_ps(v[6], v[7]);
+      t[7] = _mm256_unpackhi_ps(v[6], v[7]);
+      v[0] = _mm256_shuffle_ps(t[0], t[2], _MM_SHUFFLE(1, 0, 1, 0));
+      v[1] = _mm256_shuffle_ps(t[0], t[2], _MM_SHUFFLE(3, 2, 3, 2));
+      v[2] = _mm256_shuffle_ps(t[1], t[3], _MM_SHUFFLE(1, 0, 1, 0));
+      v[3] = _mm256_shuffle_ps(t[1], t[3], _MM_SHUFFLE(3, 2, 3, 2));
+      v[4] = _mm256_shuffle_ps(t[4], t[6], _MM_SHUFFLE(1, 0, 1, 0));
+      v[5] = _mm256_shuffle_ps(t[4], t[6], _MM_SHUFFLE(3, 2, 3, 2));
+      v[6] = _mm256_shuffle_ps(t[5], t[7], _MM_SHUFFLE(1, 0, 1, 0));
+      v[7] = _mm256_shuffle_ps(t[5], t[7], _MM_SHUFFLE(3, 2, 3, 2));
+      for_range(uptr, k, 0, 4){
+	_mm256_storeu_ps((f32*)(d + (iptr)k * tr->dst_row), _mm256_permute2f128_ps(v[k], v[k + 4], 0x20));
+	_mm256_storeu_ps((f32*)(d + (iptr)(k + 4) * tr->dst_row), _mm256_permute2f128_ps(v[k], v[k + 4], 0x31));
+      }
+    }
+    if(r < rows)
+      tensor_transpose_tile_sized(tr, dst + (iptr)r * tr->dst_row + (iptr)c * 4,
+				  src + (iptr)r * 4 + (iptr)c * tr->src_col, rows - r, 8, 4);
+  }
+  if(c < cols)
+    tensor_transpose_tile_sized(tr, dst + (iptr)c * 4, src + (iptr)c * tr->src_col, rows, cols - c, 4);
+}
+#endif
+
+static void tensor_transpose_task(void* ctx, uptr t){
+  const Tensor_Transpose* tr = ctx;
+  uptr outer = t / tr->bands;
+  const uptr r0 = (t % tr->bands) * TENSOR_TRANSPOSE_TILE;
+  const uptr rows = ((tr->rows - r0) < TENSOR_TRANSPOSE_TILE) ? (tr->rows - r0) : TENSOR_TRANSPOSE_TILE;
+  char* dst = tr->dst + (iptr)r0 * tr->dst_row;
+  const char* src = tr->src + (iptr)r0 * tr->src_row;
+  for(uptr d = tr->outer_ndim; d-- > 0;){
+    const uptr i = outer % tr->outer_shape[d];
+    outer /= tr->outer_shape[d];
+    dst += (iptr)i * tr->outer_dst[d];
+    src += (iptr)i * tr->outer_src[d];
+  }
+  for(uptr c = 0; c < tr->cols; c += TENSOR_TRANSPOSE_TILE){
+    const uptr cols = ((tr->cols - c) < TENSOR_TRANSPOSE_TILE) ? (tr->cols - c) : TENSOR_TRANSPOSE_TILE;
+    tr->fn(tr, dst + (iptr)c * tr->dst_col, src + (iptr)c * tr->src_col, rows, cols);
+  }
+}
+
+// Not to be used directly, just a helper fxn
+// Runs a same dtype copy loop (operand 0 from operand 1) as tiled transposes
+// Returns false without copying anything if the layouts are not a permutation worth it
+static bool tensor_copy_transposed(const Tensor_Loop* loop, uptr total){
+  if(total == 0 || loop->ndim < 2) return false;
+  const uptr inner = loop->ndim - 1;
+  const iptr* ds = loop->stride[0];
+  const iptr* ss = loop->stride[1];
+#define TENSOR_ABS(x) (((x) < 0) ? -(x) : (x))
+  // The source's smallest (non broadcasted) stride, if it is not the innermost already
+  uptr p = inner;
+  for_range(uptr, d, 0, inner){
+    if(ss[d] == 0 || TENSOR_ABS(ss[d]) >= TENSOR_ABS(ss[inner])) continue;
+    if(p == inner || TENSOR_ABS(ss[d]) < TENSOR_ABS(ss[p])) p = d;
+  }
+#undef TENSOR_ABS
+  if(p == inner || loop->shape[p] < TENSOR_TRANSPOSE_MIN || loop->shape[inner] < TENSOR_TRANSPOSE_MIN)
+    return false;
+
+  const iptr size = (iptr)loop->elem_size[0];
+  Tensor_Transpose tr = {
+    .fn = tensor_transpose_tile_plain,
+    .dst = loop->base[0], .src = loop->base[1],
+    .elem_size = loop->elem_size[0],
+    .rows = loop->shape[p], .cols = loop->shape[inner],
+    .dst_row = ds[p] * size, .dst_col = ds[inner] * size,
+    .src_row = ss[p] * size, .src_col = ss[inner] * size,
+  };
+  tr.bands = (tr.rows + TENSOR_TRANSPOSE_TILE - 1) / TENSOR_TRANSPOSE_TILE;
+  uptr outer_count = 1;
+  for_range(uptr, d, 0, inner){
+    if(d == p) continue;
+    tr.outer_shape[tr.outer_ndim] = loop->shape[d];
+    tr.outer_dst[tr.outer_ndim] = ds[d] * size;
+    tr.outer_src[tr.outer_ndim] = ss[d] * size;
+    tr.outer_ndim++;
+    outer_count *= loop->shape[d];
+  }
+#ifdef TENSOR_HAS_X86_SIMD
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+  if(size == 4 && tr.src_row == 4 && tr.dst_col == 4 && __builtin_cpu_supports("avx"))
+    tr.fn = tensor_transpose_tile_avx;
+#endif
+  tensor_parallel_for_work(outer_count * tr.bands, total, tensor_transpose_task, &tr);
+  return true;
+}
+
+// Builds the loop and runs the kernel over the whole of it
+//   Operands of other dtypes than f32 go through 'tensor_typed_kernel'
+//   Copies ('tensor_copy_kernel') between the same dtypes may be run by 'tensor_copy_transposed'
+static void tensor_loop_apply(uptr nops, const Tensor ts[], Tensor_Loop_Kernel* kernel, void* ctx){
+  Tensor_Loop loop;
+  const uptr total = tensor_loop_init(&loop, nops, ts);
+  // Copies out of permuted views are transposed in tiles instead
+  if(kernel == tensor_copy_kernel && ts[0].dtype == ts[1].dtype && tensor_copy_transposed(&loop, total))
+    return;
+  bool typed = false;
+  for_range(uptr, k, 0, nops) typed = typed || (ts[k].dtype != TENSOR_F32);
+  if(!typed){
+    tensor_loop_run_all(&loop, total, 1, kernel, ctx);
+    return;
+  }
+  if(kernel == tensor_copy_kernel){
+    Tensor_Cast_Ctx cast = {.out = ts[0].dtype, .in = ts[1].dtype};
+    tensor_loop_run_all(&loop, total, 1, tensor_cast_kernel, &cast);
+    return;
+  }
+  Tensor_Typed_Ctx typed_ctx = {.kernel = kernel, .ctx = ctx, .nops = nops};
+  for_range(uptr, k, 0, nops) typed_ctx.dtype[k] = ts[k].dtype;
+  tensor_loop_run_all(&loop, total, 1, tensor_typed_kernel, &typed_ctx);
+}
+
+void tensor_free(Alloc_Interface allocr, Tensor* t){
+  tensor_storage_release(t->shared);
+  t->shared = nullptr;
+  t->storage = (f32_Slice){0};
+  t->owner = false;
+  tensor_deinit_dims(allocr, t);
+  t->ndim = 0;
+}
+
+uptr tensor_size(Tensor t){
+  uptr size = 1;
+  for_slice(tensor_shape(t), i){
+    size *= tensor_shape(t).data[i];
+  }
+  return size;
+}
+
+Tensor tensor_dupe(Alloc_Interface allocr, Tensor t){
+  Tensor out = t;
+  out.owner = true;
+  if(t.shared != nullptr && atomic_load(&t.shared->cow)){
+    // The copy is deferred until one of them is written into
+    tensor_storage_retain(t.shared);
+  } else {
+    out.shared = tensor_storage_new(allocr, tensor_storage_units(t.dtype, t.storage.count));
+    memcpy(out.shared->data.data, t.storage.data, t.storage.count * tensor_dtype_size(t.dtype));
+    out.storage = (f32_Slice){.data = out.shared->data.data, .count = t.storage.count};
+  }
+  tensor_init_dims(allocr, &out, t.ndim);
+  for_range(uptr, i, 0, t.ndim){
+    tensor_shape(out).data[i] = tensor_shape(t).data[i];
+    tensor_stride(out).data[i] = tensor_stride(t).data[i];
+  }
+  return out;
+}
+
+Tensor tensor_contiguous(Alloc_Interface allocr, Tensor t){
+  // Create equivalent sized tensor
+  Tensor newt = tensor_alloc_dtype_(allocr, t.dtype, tensor_shape(t));
+  tensor_loop_apply(2, (Tensor[]){newt, t}, tensor_copy_kernel, nullptr);
+  return newt;
+}
+
+Tensor tensor_to_dtype(Alloc_Interface allocr, Tensor t, Tensor_DType dtype){
+  Tensor newt = tensor_alloc_dtype_(allocr, dtype, tensor_shape(t));
+  tensor_loop_apply(2, (Tensor[]){newt, t}, tensor_copy_kernel, nullptr);
+  return newt;
+}
+
+void tensor_convert(Tensor_DType dst_dtype, void* dst, Tensor_DType src_dtype, const void* src, uptr count){
+  Tensor_Cast_Ctx cast = {.out = dst_dtype, .in = src_dtype};
+  tensor_cast_kernel(&cast, count, (f32* const[]){dst, (void*)src}, (const iptr[]){1, 1});
+}
+
+Tensor tensor_create_dtype_(Alloc_Interface allocr, Tensor_DType dtype, f64 fill_elem, Tensor_Inx shape){
+  Tensor t = tensor_alloc_dtype_(allocr, dtype, shape);
+  const uptr size = tensor_dtype_size(dtype);
+  char elem[sizeof(f64)];
+  tensor_dtype_set(dtype, elem, fill_elem);
+  for_slice(t.storage, i) memcpy((char*)t.storage.data + i * size, elem, size);
+  return t;
+}
+
+f64 tensor_get_value_(Tensor t, Tensor_Inx inx){
+  return tensor_dtype_get(t.dtype, (char*)t.storage.data + tensor_elem_offset(t, inx) * tensor_dtype_size(t.dtype));
+}
+
+void tensor_set_value_(Tensor t, Tensor_Inx inx, f64 value){
+  tensor_dtype_set(t.dtype, (char*)t.storage.data + tensor_elem_offset(t, inx) * tensor_dtype_size(t.dtype), value);
+}
+
+Tensor tensor_range_(Alloc_Interface allocr, f32 start_val, f32 step_size, Tensor_Inx shape){
+  Tensor rent = tensor_alloc_(allocr, shape);
+
+  for_slice(rent.storage, i){
+    rent.storage.data[i] = start_val;
+    start_val += step_size;
+  }
+  return rent;
+}
+
+// Printing
+//   Output is collected in a small staging buffer, and goes either to the caller's
+//   buffer (truncated like snprintf) or to a FILE* in big writes. Elements are reached
+//   through the strides while walking the dimensions recursively, and summarized
+//   dimensions only visit their edge items.
+#define TENSOR_PRINT_STAGE 4096
+// Up to this precision floats are formatted by hand, where the math is exact
+#define TENSOR_PRINT_FAST_PRECISION 9
+#define TENSOR_PRINT_MAX_PRECISION 64
+// Enough for any f64 with the max precision
+#define TENSOR_PRINT_MAX_ITEM 384
+
+typedef struct Tensor_Printer Tensor_Printer;
+struct Tensor_Printer {
+  Tensor_Print_Options opts;
+  FILE* file;
+  char* buf;
+  uptr buf_size;
+  // Total characters produced, even the ones that didnt fit in 'buf'
+  uptr len;
+  bool failed;
+  uptr ndim;
+  const uptr* shape;
+  const iptr* stride;
+  Tensor_DType dtype;
+  uptr elem_size;
+  bool summarize;
+  // Pending '[' of dimensions that start at the next element
+  uptr opens;
+  bool newline;
+  bool first;
+  uptr column;
+  uptr staged;
+  char stage[TENSOR_PRINT_STAGE];
+};
+
+// Not to be used directly, just a helper fxn
+static void tensor_printer_flush(Tensor_Printer* p){
+  if(p->staged == 0) return;
+  if(p->file != nullptr){
+    if(fwrite(p->stage, 1, p->staged, p->file) != p->staged) p->failed = true;
+  } else if(p->len < p->buf_size){
+    const uptr room = p->buf_size - 1 - p->len;
+    memcpy(p->buf + p->len, p->stage, (p->staged < room) ? p->staged : room);
+  }
+  p->len += p->staged;
+  p->staged = 0;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_printer_write(Tensor_Printer* p, const char* str, uptr n){
+  uptr i = n;
+  while(i > 0 && str[i - 1] != '\n') i--;
+  p->column = (i > 0) ? (n - i) : (p->column + n);
+  while(n > 0){
+    if(p->staged == TENSOR_PRINT_STAGE) tensor_printer_flush(p);
+    const uptr room = TENSOR_PRINT_STAGE - p->staged;
+    const uptr chunk = (n < room) ? n : room;
+    memcpy(p->stage + p->staged, str, chunk);
+    p->staged += chunk;
+    str += chunk;
+    n -= chunk;
+  }
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_printer_repeat(Tensor_Printer* p, char c, uptr n){
+  char run[64];
+  memset(run, c, sizeof(run));
+  for(; n > sizeof(run); n -= sizeof(run)) tensor_printer_write(p, run, sizeof(run));
+  tensor_printer_write(p, run, n);
+}
+
+// Not to be used directly, just a helper fxn
+// Same text as printf("%.*f"), returns the length
+static uptr tensor_format_f32(char out[TENSOR_PRINT_MAX_ITEM], f32 v, uptr precision){
+  static const uint32_t powers[TENSOR_PRINT_FAST_PRECISION + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+  };
+  static const char pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  const double x = (double)v;
+  // Integer part must fit in 64 bits, others take the slow path
+  const double a = signbit(x) ? -x : x;
+  if(precision > TENSOR_PRINT_FAST_PRECISION || !isfinite(x) || a >= 1e18)
+    return (uptr)snprintf(out, TENSOR_PRINT_MAX_ITEM, "%.*f", (int)precision, x);
+
+  uptr len = 0;
+  if(signbit(x)) out[len++] = '-';
+  uint64_t ip = (uint64_t)a;
+  const uint32_t scale = powers[precision];
+  // (a - ip) has at most 24 significant bits, so the product is exact and can be
+  //   rounded half to even like printf does
+  const double scaled = (a - (double)ip) * (double)scale;
+  uint32_t fp = (uint32_t)scaled;
+  const double rem = scaled - (double)fp;
+  // With no digits after the point, the tie is broken by the integer part
+  if(rem > 0.5 || (rem == 0.5 && (((precision == 0) ? (uint32_t)ip : fp) & 1))) fp++;
+  if(fp >= scale){
+    fp -= scale;
+    ip++;
+  }
+
+  // Digits are produced two at a time from the right
+  char digits[24];
+  uptr n = sizeof(digits);
+  while(ip >= 100){
+    memcpy(digits + (n -= 2), pairs + 2 * (ip % 100), 2);
+    ip /= 100;
+  }
+  if(ip >= 10) memcpy(digits + (n -= 2), pairs + 2 * ip, 2);
+  else digits[--n] = (char)('0' + ip);
+  memcpy(out + len, digits + n, sizeof(digits) - n);
+  len += sizeof(digits) - n;
+  if(precision > 0){
+    out[len++] = '.';
+    uptr i = precision;
+    for(; i >= 2; i -= 2){
+      memcpy(out + len + i - 2, pairs + 2 * (fp % 100), 2);
+      fp /= 100;
+    }
+    if(i == 1) out[len] = (char)('0' + fp);
+    len += precision;
+  }
+  return len;
+}
+
+// Not to be used directly, just a helper fxn
+// Writes what comes before an element, pending newline, indentation and brackets or a separator
+static void tensor_printer_prefix(Tensor_Printer* p, uptr item_len){
+  if(p->newline){
+    tensor_printer_write(p, "\n", 1);
+    p->newline = false;
+  }
+  if(p->opens > 0){
+    tensor_printer_repeat(p, ' ', p->ndim - p->opens);
+    tensor_printer_repeat(p, '[', p->opens);
+    p->opens = 0;
+  } else if(!p->first){
+    // Wrapping long rows, continuing under the first element
+    if(p->opts.line_width > 0 && (p->column + 2 + item_len + 1) > p->opts.line_width){
+      tensor_printer_write(p, ",\n", 2);
+      tensor_printer_repeat(p, ' ', p->ndim);
+    } else {
+      tensor_printer_write(p, ", ", 2);
+    }
+  }
+  p->first = false;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_printer_dim(Tensor_Printer* p, uptr d, const char* base){
+  if(d == p->ndim){
+    char text[TENSOR_PRINT_MAX_ITEM];
+    uptr n;
+    // Integers print without a fraction, and f64 needs all its digits
+    switch(p->dtype){
+    case TENSOR_I32: case TENSOR_I8:
+      n = (uptr)snprintf(text, sizeof(text), "%d", (int)tensor_dtype_get(p->dtype, base));
+      break;
+    case TENSOR_F64:
+      n = (uptr)snprintf(text, sizeof(text), "%.*f", (int)p->opts.precision, *(const f64*)base);
+      break;
+    default:
+      n = tensor_format_f32(text, (f32)tensor_dtype_get(p->dtype, base), p->opts.precision);
+    }
+    tensor_printer_prefix(p, n);
+    tensor_printer_write(p, text, n);
+    return;
+  }
+  const uptr size = p->shape[d];
+  const uptr edge = p->opts.edge_items;
+  const bool skip = p->summarize && (size > 2 * edge);
+  p->opens++;
+  for(uptr i = 0; i < size; ++i){
+    if(skip && i == edge){
+      if(d + 1 == p->ndim){
+	tensor_printer_prefix(p, 3);
+	tensor_printer_write(p, "...", 3);
+      } else {
+	tensor_printer_write(p, "\n", 1);
+	tensor_printer_repeat(p, ' ', d + 1);
+	tensor_printer_write(p, "...", 3);
+	p->newline = true;
+      }
+      i = size - edge;
+    }
+    tensor_printer_dim(p, d + 1, base + (iptr)i * p->stride[d] * (iptr)p->elem_size);
+  }
+  tensor_printer_write(p, "]", 1);
+  p->newline = true;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_printer_run(Tensor_Printer* p, Tensor t){
+  p->ndim = t.ndim;
+  p->shape = tensor_shape_ptr_(&t);
+  p->stride = tensor_stride_ptr_(&t);
+  p->dtype = t.dtype;
+  p->elem_size = tensor_dtype_size(t.dtype);
+  p->first = true;
+  const uptr size = tensor_size(t);
+  p->summarize = (p->opts.threshold > 0) && (size > p->opts.threshold);
+  // Empty tensors print nothing
+  if(size > 0){
+    tensor_assert_view_in_storage(t);
+    tensor_printer_dim(p, 0, tensor_raw_ptr(t));
+    if(p->newline) tensor_printer_write(p, "\n", 1);
+  }
+  tensor_printer_flush(p);
+}
+
+uptr tensor_format(char* buf, uptr buf_size, Tensor t, Tensor_Print_Options opts){
+  Tensor_Printer p = {.opts = opts, .buf = buf, .buf_size = buf_size};
+  if(p.opts.precision > TENSOR_PRINT_MAX_PRECISION) p.opts.precision = TENSOR_PRINT_MAX_PRECISION;
+  tensor_printer_run(&p, t);
+  if(buf_size > 0) buf[(p.len < buf_size) ? p.len : (buf_size - 1)] = '\0';
+  return p.len;
+}
+
+bool tensor_fprint(FILE* file, Tensor t, Tensor_Print_Options opts){
+  Tensor_Printer p = {.opts = opts, .file = file};
+  if(p.opts.precision > TENSOR_PRINT_MAX_PRECISION) p.opts.precision = TENSOR_PRINT_MAX_PRECISION;
+  tensor_printer_run(&p, t);
+  return !p.failed;
+}
+
+void tensor_print(Alloc_Interface allocr, Tensor t){
+  (void)allocr;
+  (void)tensor_fprint(stdout, t, TENSOR_PRINT_DEFAULTS);
+}
+
+void tensor_permute_in_place(Tensor* t, uptr inx1, uptr inx2){
+  assert(((void)"Index out of bounds", inx1 < t->ndim));
+  assert(((void)"Index out of bounds", inx2 < t->ndim));
+
+  if(inx1 != inx2){
+    _swap(tensor_shape(*t).data[inx1], tensor_shape(*t).data[inx2]);
+    _swap(tensor_stride(*t).data[inx1], tensor_stride(*t).data[inx2]);
+  }
+}
+
+// Not to be used directly, just a helper fxn
+// New non-owning tensor sharing the storage, with its own copy of the dimensions
+static Tensor tensor_view_of(Alloc_Interface allocr, Tensor src){
+  Tensor dst = src;
+  dst.owner = false;
+  tensor_storage_retain(src.shared);
+  tensor_init_dims(allocr, &dst, src.ndim);
+  for_range(uptr, i, 0, src.ndim){
+    tensor_shape(dst).data[i] = tensor_shape(src).data[i];
+    tensor_stride(dst).data[i] = tensor_stride(src).data[i];
+  }
+  return dst;
+}
+
+Tensor tensor_permute(Alloc_Interface allocr, Tensor oldt, uptr inx1, uptr inx2){
+  Tensor newt = tensor_view_of(allocr, oldt); //shares storage
+  tensor_permute_in_place(&newt, inx1, inx2);
+  return newt;
+}
+
+Tensor tensor_share(Alloc_Interface allocr, Tensor t){
+  return tensor_view_of(allocr, t);
+}
+
+uptr tensor_storage_refs(Tensor t){
+  return (t.shared != nullptr) ? atomic_load(&t.shared->refs) : 0;
+}
+
+void tensor_set_copy_on_write(Tensor t, bool enable){
+  assert(((void)"Only tensors made by the library have a shared storage", t.shared != nullptr));
+  atomic_store(&t.shared->cow, enable);
+}
+
+bool tensor_make_writable(Alloc_Interface allocr, Tensor* t){
+  if(t->shared == nullptr || !atomic_load(&t->shared->cow) ||
+     atomic_load_explicit(&t->shared->refs, memory_order_acquire) == 1) return false;
+  // Only the viewed elements are cloned, into a new contiguous storage
+  Tensor copy = tensor_contiguous(allocr, *t);
+  atomic_store(&copy.shared->cow, true);
+  tensor_storage_release(t->shared);
+  t->shared = copy.shared;
+  t->storage = copy.storage;
+  t->offset = 0;
+  t->owner = true;
+  tensor_force_fix_stride(tensor_shape(*t), tensor_stride(*t));
+  tensor_deinit_dims(allocr, &copy);
+  return true;
+}
+
+// Not to be used directly, just a helper fxn
+// Outputs of the inplace ops must not be copy on write storages shared with others
+static void tensor_assert_writable(Tensor t){
+  assert(((void)"Shared copy on write tensors must be made writable ('tensor_make_writable') before writing into them",
+	  t.shared == nullptr || !atomic_load(&t.shared->cow) || atomic_load(&t.shared->refs) == 1));
+  (void)t;
+}
+
+// Not to be used directly, just a helper fxn
+// Inplace ops write through the iterator's tensor, if that is a shared copy on write
+//   storage the viewed span is cloned first. Strides are kept as they are, since the
+//   iterator may share them with the tensor it was made from, only the offset moves
+static void tensor_iter_make_writable(Tensor_Iter* iter){
+  Tensor* t = &iter->t;
+  if(t->shared == nullptr || !atomic_load(&t->shared->cow) ||
+     atomic_load_explicit(&t->shared->refs, memory_order_acquire) == 1) return;
+  tensor_assert_view_in_storage(*t);
+  iptr lowest = 0, highest = 0;
+  for_slice(tensor_shape(*t), i){
+    const uptr size = slice_inx(tensor_shape(*t), i);
+    const iptr stride = slice_inx(tensor_stride(*t), i);
+    if(size == 0) return;
+    if(stride < 0) lowest += (iptr)(size - 1) * stride;
+    else highest += (iptr)(size - 1) * stride;
+  }
+  const uptr count = (uptr)(highest - lowest) + 1;
+  const uptr elem = tensor_dtype_size(t->dtype);
+  Tensor_Storage* st = tensor_storage_new(t->shared->allocr, tensor_storage_units(t->dtype, count));
+  atomic_store(&st->cow, true);
+  memcpy(st->data.data, (const char*)t->storage.data + (iptr)(t->offset * elem) + lowest * (iptr)elem,
+	 count * elem);
+  if(iter->owns_storage) tensor_storage_release(t->shared);
+  t->shared = st;
+  t->storage = st->data;
+  t->offset = (uptr)(-lowest);
+  t->owner = true;
+  iter->owns_storage = true;
+  tensor_assert_writable(*t);
+}
+
+// Random numbers
+//   Philox4x32-10 turns block number c (a 64 bit counter) under a 64 bit key into 4
+//   words, always the same ones, so any part of a fill can be generated on its own.
+//   Words come in groups of 64 from 16 consecutive blocks, stored word major (the first
+//   words of the 16 blocks, then the second words ..) as the SIMD kernels produce them.
+//   Fills take whole groups from the counter and split them into chunks across threads.
+#define TENSOR_RNG_GROUP 64
+#define TENSOR_RNG_CHUNK 1024
+
+#define TENSOR_PHILOX_M0 0xD2511F53u
+#define TENSOR_PHILOX_M1 0xCD9E8D57u
+#define TENSOR_PHILOX_W0 0x9E3779B9u
+#define TENSOR_PHILOX_W1 0xBB67AE85u
+
+// Generates 'groups' groups of words into 'out', from blocks starting at 'counter'
+typedef void Tensor_Philox_Fn(uint64_t key, uint64_t counter, uptr groups, uint32_t* out);
+
+static void tensor_philox_plain(uint64_t key, uint64_t counter, uptr groups, uint32_t* out){
+  for_range(uptr, g, 0, groups){
+    for_range(uptr, l, 0, 16){
+      const uint64_t ctr = counter + g * 16 + l;
+      uint32_t c0 = (uint32_t)ctr, c1 = (uint32_t)(ctr >> 32), c2 = 0, c3 = 0;
+      uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+      for_range(uptr, r, 0, 10){
+	const uint64_t p0 = (uint64_t)TENSOR_PHILOX_M0 * c0;
+	const uint64_t p1 = (uint64_t)TENSOR_PHILOX_M1 * c2;
+	c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+	c1 = (uint32_t)p1;
+	c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+	c3 = (uint32_t)p0;
+	k0 += TENSOR_PHILOX_W0;
+	k1 += TENSOR_PHILOX_W1;
+      }
+      uint32_t* o = out + g * TENSOR_RNG_GROUP + l;
+      o[0] = c0, o[16] = c1, o[32] = c2, o[48] = c3;
+    }
+  }
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+// High halves of the 32 x 32 bit products, from the even and odd lanes separately
+__attribute__((target("avx2")))
+static inline __m256i tensor_mulhi_epu32_avx2(__m256i a, __m256i b){
+  const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+  const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+__attribute__((target("avx2")))
+static void tensor_philox_avx2(uint64_t key, uint64_t counter, uptr groups, uint32_t* out){
+  const __m256i m0 = _mm256_set1_epi32((int)TENSOR_PHILOX_M0);
+  const __m256i m1 = _mm256_set1_epi32((int)TENSOR_PHILOX_M1);
+  const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+  for_range(uptr, h, 0, 2 * groups){
+    const uint64_t base = counter + h * 8;
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)base), lane);
+    // Lanes whose low word wrapped around carry into the high word (unsigned c0 < lane)
+    const __m256i carry = _mm256_cmpgt_epi32(_mm256_xor_si256(lane, sign), _mm256_xor_si256(c0, sign));
+    __m256i c1 = _mm256_sub_epi32(_mm256_set1_epi32((int)(uint32_t)(base >> 32)), carry);
+    __m256i c2 = _mm256_setzero_si256(), c3 = _mm256_setzero_si256();
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    for_range(uptr, r, 0, 10){
+      const __m256i hi0 = tensor_mulhi_epu32_avx2(c0, m0), lo0 = _mm256_mullo_epi32(c0, m0);
+      const __m256i hi1 = tensor_mulhi_epu32_avx2(c2, m1), lo1 = _mm256_mullo_epi32(c2, m1);
+      c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+      c1 = lo1;
+      c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+      c3 = lo0;
+      k0 += TENSOR_PHILOX_W0;
+      k1 += TENSOR_PHILOX_W1;
+    }
+    uint32_t* o = out + (h / 2) * TENSOR_RNG_GROUP + (h % 2) * 8;
+    _mm256_storeu_si256((__m256i*)(o + 0), c0);
+    _mm256_storeu_si256((__m256i*)(o + 16), c1);
+    _mm256_storeu_si256((__m256i*)(o + 32), c2);
+    _mm256_storeu_si256((__m256i*)(o + 48), c3);
+  }
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i tensor_mulhi_epu32_avx512(__m512i a, __m512i b){
+  const __m512i even = _mm512_srli_epi64(_mm512_mul_epu32(a, b), 32);
+  const __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+  return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+}
+
+__attribute__((target("avx512f")))
+static void tensor_philox_avx512(uint64_t key, uint64_t counter, uptr groups, uint32_t* out){
+  const __m512i m0 = _mm512_set1_epi32((int)TENSOR_PHILOX_M0);
+  const __m512i m1 = _mm512_set1_epi32((int)TENSOR_PHILOX_M1);
+  for_range(uptr, g, 0, groups){
+    const uint64_t base = counter + g * 16;
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i c0 = _mm512_add_epi32(_mm512_set1_epi32((int)(uint32_t)base), lane);
+    const __mmask16 carry = _mm512_cmplt_epu32_mask(c0, lane);
+    const __m512i hi = _mm512_set1_epi32((int)(uint32_t)(base >> 32));
+    __m512i c1 = _mm512_mask_add_epi32(hi, carry, hi, _mm512_set1_epi32(1));
+    __m512i c2 = _mm512_setzero_si512(), c3 = _mm512_setzero_si512();
+    uint32_t k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+    for_range(uptr, r, 0, 10){
+      const __m512i hi0 = tensor_mulhi_epu32_avx512(c0, m0), lo0 = _mm512_mullo_epi32(c0, m0);
+      const __m512i hi1 = tensor_mulhi_epu32_avx512(c2, m1), lo1 = _mm512_mullo_epi32(c2, m1);
+      c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32((int)k0));
+      c1 = lo1;
+      c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32((int)k1));
+      c3 = lo0;
+      k0 += TENSOR_PHILOX_W0;
+      k1 += TENSOR_PHILOX_W1;
+    }
+    uint32_t* o = out + g * TENSOR_RNG_GROUP;
+    _mm512_storeu_si512(o + 0, c0);
+    _mm512_storeu_si512(o + 16, c1);
+    _mm512_storeu_si512(o + 32, c2);
+    _mm512_storeu_si512(o + 48, c3);
+  }
+}
+#endif
+
+static Tensor_Philox_Fn* tensor_philox_fn(void){
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx512f")) return tensor_philox_avx512;
+  if(__builtin_cpu_supports("avx2")) return tensor_philox_avx2;
+#endif
+  return tensor_philox_plain;
+}
+
+// Uniform in [0, 1) from the top 24 bits of a word, and in (0, 1) from the top 23
+//   The open one needs a spare bit, (2^24 - 1 + 0.5) / 2^24 would round up to 1
+static inline f32 tensor_rng_unit(uint32_t w){
+  return (f32)(int32_t)(w >> 8) * 0x1p-24f;
+}
+static inline f32 tensor_rng_open_unit(uint32_t w){
+  return ((f32)(int32_t)(w >> 9) + 0.5f) * 0x1p-23f;
+}
+
+// Natural log of positive normal floats (cephes logf), libm is not needed this way
+static inline f32 tensor_rng_log(f32 x){
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  // x = m * 2^e, with m in [sqrt(1/2), sqrt(2))
+  int32_t e = (int32_t)(bits >> 23) - 126;
+  bits = (bits & 0x007FFFFFu) | 0x3F000000u;
+  f32 m;
+  memcpy(&m, &bits, sizeof(m));
+  const bool small = (m < 0.70710678f);
+  e -= small;
+  m = small ? (m + m - 1.f) : (m - 1.f);
+  const f32 z = m * m;
+  f32 y = 7.0376836292e-2f;
+  y = y * m - 1.1514610310e-1f;
+  y = y * m + 1.1676998740e-1f;
+  y = y * m - 1.2420140846e-1f;
+  y = y * m + 1.4249322787e-1f;
+  y = y * m - 1.6668057665e-1f;
+  y = y * m + 2.0000714765e-1f;
+  y = y * m - 2.4999993993e-1f;
+  y = y * m + 3.3333331174e-1f;
+  y = y * m * z - 2.12194440e-4f * (f32)e - 0.5f * z;
+  return m + y + 0.693359375f * (f32)e;
+}
+
+// Square root of positive floats, Newton steps from the bit trick estimate of 1/sqrt(x)
+static inline f32 tensor_rng_sqrt(f32 x){
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5F3759DFu - (bits >> 1);
+  f32 y;
+  memcpy(&y, &bits, sizeof(y));
+  y = y * (1.5f - 0.5f * x * y * y);
+  y = y * (1.5f - 0.5f * x * y * y);
+  y = y * (1.5f - 0.5f * x * y * y);
+  return x * y;
+}
+
+// Inverse of the standard normal cdf for u in (0, 1), as sqrt(2) * erfinv(2u - 1) with
+//   the single precision erfinv of M. Giles. 4u(1 - u) is 1 - (2u - 1)^2 without the
+//   cancellation near the tails
+static inline f32 tensor_rng_ndtri(f32 u){
+  const f32 w = -tensor_rng_log(4.f * u * (1.f - u));
+  const f32 wc = w - 2.5f;
+  f32 pc = 2.81022636e-08f;
+  pc = 3.43273939e-07f + pc * wc;
+  pc = -3.5233877e-06f + pc * wc;
+  pc = -4.39150654e-06f + pc * wc;
+  pc = 0.00021858087f + pc * wc;
+  pc = -0.00125372503f + pc * wc;
+  pc = -0.00417768164f + pc * wc;
+  pc = 0.246640727f + pc * wc;
+  pc = 1.50140941f + pc * wc;
+  const f32 wt = tensor_rng_sqrt(w) - 3.f;
+  f32 pt = -0.000200214257f;
+  pt = 0.000100950558f + pt * wt;
+  pt = 0.00134934322f + pt * wt;
+  pt = -0.00367342844f + pt * wt;
+  pt = 0.00573950773f + pt * wt;
+  pt = -0.0076224613f + pt * wt;
+  pt = 0.00943887047f + pt * wt;
+  pt = 1.00167406f + pt * wt;
+  pt = 2.83297682f + pt * wt;
+  return 1.41421356f * ((w < 5.f) ? pc : pt) * (2.f * u - 1.f);
+}
+
+// Not to be used directly, just a helper fxn
+// exp(x) for x < 1, only used for the few cdf values of a fill
+static f64 tensor_rng_exp(f64 x){
+  if(x < -700.0) return 0.0;
+  const f64 kf = x * 1.4426950408889634;
+  const int64_t k = (int64_t)(kf + ((kf >= 0.0) ? 0.5 : -0.5));
+  const f64 r = x - (f64)k * 0.6931471805599453;
+  f64 sum = 1.0, term = 1.0;
+  for_range(int, n, 1, 14){
+    term *= r / n;
+    sum += term;
+  }
+  const uint64_t bits = (uint64_t)(k + 1023) << 52;
+  f64 scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return sum * scale;
+}
+
+// Not to be used directly, just a helper fxn
+// Standard normal cdf, through the erfc approximation of Numerical Recipes
+//   (relative error below 1.2e-7, enough for f32 values)
+static f64 tensor_rng_ndtr(f64 x){
+  const f64 z = ((x < 0.0) ? -x : x) / 1.4142135623730951;
+  const f64 t = 1.0 / (1.0 + 0.5 * z);
+  const f64 erfc = t * tensor_rng_exp(-z * z - 1.26551223 + t * (1.00002368 + t * (0.37409196 + t * (0.09678418 +
+    t * (-0.18628806 + t * (0.27886807 + t * (-1.13520398 + t * (1.48851587 + t * (-0.82215223 + t * 0.17087277)))))))));
+  return (x >= 0.0) ? (1.0 - 0.5 * erfc) : (0.5 * erfc);
+}
+
+typedef enum Tensor_Rng_Dist Tensor_Rng_Dist;
+enum Tensor_Rng_Dist {
+  TENSOR_RNG_UNIFORM = 0,
+  TENSOR_RNG_NORMAL,
+  TENSOR_RNG_BERNOULLI,
+  TENSOR_RNG_TRUNCATED_NORMAL,
+};
+
+typedef struct Tensor_Rng_Fill Tensor_Rng_Fill;
+// Turns TENSOR_RNG_CHUNK words into values
+typedef void Tensor_Rng_Transform_Fn(const Tensor_Rng_Fill* f, const uint32_t* words, f32* out);
+
+struct Tensor_Rng_Fill {
+  Tensor_Rng_Dist dist;
+  Tensor_Philox_Fn* philox;
+  Tensor_Rng_Transform_Fn* transform;
+  uint64_t key;
+  uint64_t counter;
+  f32* out;
+  uptr count;
+  // Value = a + b * x, x being uniform or standard normal
+  f32 a, b;
+  // Bernoulli: probability of 1
+  f32 p;
+  // Truncated normal: cdf range to invert, limits of the standard values, and their sign
+  f32 cdf_lo, cdf_hi, z_lo, z_hi, sign;
+};
+
+static void tensor_rng_transform_plain(const Tensor_Rng_Fill* f, const uint32_t* words, f32* out){
+  const f32 a = f->a, b = f->b;
+  switch(f->dist){
+  case TENSOR_RNG_UNIFORM:
+    for_range(uptr, i, 0, TENSOR_RNG_CHUNK) out[i] = a + b * tensor_rng_unit(words[i]);
+    break;
+  case TENSOR_RNG_NORMAL:
+    for_range(uptr, i, 0, TENSOR_RNG_CHUNK) out[i] = a + b * tensor_rng_ndtri(tensor_rng_open_unit(words[i]));
+    break;
+  case TENSOR_RNG_BERNOULLI:
+    for_range(uptr, i, 0, TENSOR_RNG_CHUNK) out[i] = (tensor_rng_unit(words[i]) < f->p) ? 1.f : 0.f;
+    break;
+  case TENSOR_RNG_TRUNCATED_NORMAL: {
+    const f32 cdf_range = f->cdf_hi - f->cdf_lo, sb = f->sign * b;
+    for_range(uptr, i, 0, TENSOR_RNG_CHUNK){
+      f32 z = tensor_rng_ndtri(f->cdf_lo + cdf_range * tensor_rng_open_unit(words[i]));
+      z = (z < f->z_lo) ? f->z_lo : ((z > f->z_hi) ? f->z_hi : z);
+      out[i] = a + sb * z;
+    }
+  } break;
+  }
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+// The same operations as the scalar versions, in the same order, so on a given build
+//   the values are the same for any thread count and either path. Builds that let the
+//   compiler fuse multiplies and adds (like -march=native) can differ from others in
+//   the last bits. Only AVX2 is used, as the AVX-512 target would fuse them too
+#define TENSOR_RNG_SET1(v) _mm256_set1_ps(v)
+#define TENSOR_RNG_ISET1(v) _mm256_set1_epi32((int)(v))
+
+__attribute__((target("avx2")))
+static inline __m256 tensor_rng_log_avx2(__m256 x){
+  const __m256i bits = _mm256_castps_si256(x);
+  __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), TENSOR_RNG_ISET1(126));
+  __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, TENSOR_RNG_ISET1(0x007FFFFFu)),
+						 TENSOR_RNG_ISET1(0x3F000000u)));
+  const __m256 small = _mm256_cmp_ps(m, TENSOR_RNG_SET1(0.70710678f), _CMP_LT_OQ);
+  e = _mm256_add_epi32(e, _mm256_castps_si256(small));
+  m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), TENSOR_RNG_SET1(1.f));
+  const __m256 z = _mm256_mul_ps(m, m);
+  __m256 y = TENSOR_RNG_SET1(7.0376836292e-2f);
+  y = _mm256_sub_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(1.1514610310e-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(1.1676998740e-1f));
+  y = _mm256_sub_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(1.2420140846e-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(1.4249322787e-1f));
+  y = _mm256_sub_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(1.6668057665e-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(2.0000714765e-1f));
+  y = _mm256_sub_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(2.4999993993e-1f));
+  y = _mm256_add_ps(_mm256_mul_ps(y, m), TENSOR_RNG_SET1(3.3333331174e-1f));
+  const __m256 fe = _mm256_cvtepi32_ps(e);
+  y = _mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(y, m), z),
+				  _mm256_mul_ps(TENSOR_RNG_SET1(2.12194440e-4f), fe)),
+		    _mm256_mul_ps(TENSOR_RNG_SET1(0.5f), z));
+  return _mm256_add_ps(_mm256_add_ps(m, y), _mm256_mul_ps(TENSOR_RNG_SET1(0.693359375f), fe));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 tensor_rng_sqrt_avx2(__m256 x){
+  __m256 y = _mm256_castsi256_ps(_mm256_sub_epi32(TENSOR_RNG_ISET1(0x5F3759DFu),
+						  _mm256_srli_epi32(_mm256_castps_si256(x), 1)));
+  const __m256 hx = _mm256_mul_ps(TENSOR_RNG_SET1(0.5f), x);
+  for_range(int, it, 0, 3)
+    y = _mm256_mul_ps(y, _mm256_sub_ps(TENSOR_RNG_SET1(1.5f), _mm256_mul_ps(_mm256_mul_ps(hx, y), y)));
+  return _mm256_mul_ps(x, y);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 tensor_rng_ndtri_avx2(__m256 u){
+  const __m256 one = TENSOR_RNG_SET1(1.f);
+  const __m256 w = _mm256_xor_ps(TENSOR_RNG_SET1(-0.f), tensor_rng_log_avx2(
+      _mm256_mul_ps(_mm256_mul_ps(TENSOR_RNG_SET1(4.f), u), _mm256_sub_ps(one, u))));
+  const __m256 wc = _mm256_sub_ps(w, TENSOR_RNG_SET1(2.5f));
+  static const f32 cc[] = {3.43273939e-07f, -3.5233877e-06f, -4.39150654e-06f, 0.00021858087f,
+    -0.00125372503f, -0.00417768164f, 0.246640727f, 1.50140941f};
+  __m256 pc = TENSOR_RNG_SET1(2.81022636e-08f);
+  for_range(uptr, k, 0, 8) pc = _mm256_add_ps(TENSOR_RNG_SET1(cc[k]), _mm256_mul_ps(pc, wc));
+  const __m256 wt = _mm256_sub_ps(tensor_rng_sqrt_avx2(w), TENSOR_RNG_SET1(3.f));
+  static const f32 ct[] = {0.000100950558f, 0.00134934322f, -0.00367342844f, 0.00573950773f,
+    -0.0076224613f, 0.00943887047f, 1.00167406f, 2.83297682f};
+  __m256 pt = TENSOR_RNG_SET1(-0.000200214257f);
+  for_range(uptr, k, 0, 8) pt = _mm256_add_ps(TENSOR_RNG_SET1(ct[k]), _mm256_mul_ps(pt, wt));
+  const __m256 p = _mm256_blendv_ps(pt, pc, _mm256_cmp_ps(w, TENSOR_RNG_SET1(5.f), _CMP_LT_OQ));
+  return _mm256_mul_ps(_mm256_mul_ps(TENSOR_RNG_SET1(1.41421356f), p),
+		       _mm256_sub_ps(_mm256_mul_ps(TENSOR_RNG_SET1(2.f), u), one));
+}
+
+__attribute__((target("avx2")))
+static void tensor_rng_transform_avx2(const Tensor_Rng_Fill* f, const uint32_t* words, f32* out){
+  const __m256 a = TENSOR_RNG_SET1(f->a), b = TENSOR_RNG_SET1(f->b);
+  const __m256 scale = TENSOR_RNG_SET1(0x1p-24f), half = TENSOR_RNG_SET1(0.5f);
+  const __m256 open_scale = TENSOR_RNG_SET1(0x1p-23f);
+#define TENSOR_RNG_WORDS(i, shift)					\
+  _mm256_cvtepi32_ps(_mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(words + (i))), (shift)))
+  switch(f->dist){
+  case TENSOR_RNG_UNIFORM:
+    for(uptr i = 0; i < TENSOR_RNG_CHUNK; i += 8)
+      _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(b, _mm256_mul_ps(TENSOR_RNG_WORDS(i, 8), scale))));
+    break;
+  case TENSOR_RNG_NORMAL:
+    for(uptr i = 0; i < TENSOR_RNG_CHUNK; i += 8){
+      const __m256 u = _mm256_mul_ps(_mm256_add_ps(TENSOR_RNG_WORDS(i, 9), half), open_scale);
+      _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(b, tensor_rng_ndtri_avx2(u))));
+    }
+    break;
+  case TENSOR_RNG_BERNOULLI: {
+    const __m256 p = TENSOR_RNG_SET1(f->p), one = TENSOR_RNG_SET1(1.f);
+    for(uptr i = 0; i < TENSOR_RNG_CHUNK; i += 8){
+      const __m256 u = _mm256_mul_ps(TENSOR_RNG_WORDS(i, 8), scale);
+      _mm256_storeu_ps(out + i, _mm256_and_ps(_mm256_cmp_ps(u, p, _CMP_LT_OQ), one));
+    }
+  } break;
+  case TENSOR_RNG_TRUNCATED_NORMAL: {
+    const __m256 cdf_lo = TENSOR_RNG_SET1(f->cdf_lo), cdf_range = TENSOR_RNG_SET1(f->cdf_hi - f->cdf_lo);
+    const __m256 z_lo = TENSOR_RNG_SET1(f->z_lo), z_hi = TENSOR_RNG_SET1(f->z_hi);
+    const __m256 sb = TENSOR_RNG_SET1(f->sign * f->b);
+    for(uptr i = 0; i < TENSOR_RNG_CHUNK; i += 8){
+      const __m256 u = _mm256_mul_ps(_mm256_add_ps(TENSOR_RNG_WORDS(i, 9), half), open_scale);
+      __m256 z = tensor_rng_ndtri_avx2(_mm256_add_ps(cdf_lo, _mm256_mul_ps(cdf_range, u)));
+      z = _mm256_blendv_ps(z, z_lo, _mm256_cmp_ps(z, z_lo, _CMP_LT_OQ));
+      z = _mm256_blendv_ps(z, z_hi, _mm256_cmp_ps(z, z_hi, _CMP_GT_OQ));
+      _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(sb, z)));
+    }
+  } break;
+  }
+#undef TENSOR_RNG_WORDS
+}
+#undef TENSOR_RNG_ISET1
+#undef TENSOR_RNG_SET1
+#endif
+
+static Tensor_Rng_Transform_Fn* tensor_rng_transform_fn(void){
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx2")) return tensor_rng_transform_avx2;
+#endif
+  return tensor_rng_transform_plain;
+}
+
+static void tensor_rng_fill_task(void* ctx, uptr chunk){
+  const Tensor_Rng_Fill* f = ctx;
+  uint32_t words[TENSOR_RNG_CHUNK];
+  f32 vals[TENSOR_RNG_CHUNK];
+  const uptr begin = chunk * TENSOR_RNG_CHUNK;
+  const uptr n = ((f->count - begin) < TENSOR_RNG_CHUNK) ? (f->count - begin) : TENSOR_RNG_CHUNK;
+  f->philox(f->key, f->counter + (begin / TENSOR_RNG_GROUP) * 16, TENSOR_RNG_CHUNK / TENSOR_RNG_GROUP, words);
+  if(n == TENSOR_RNG_CHUNK){
+    f->transform(f, words, f->out + begin);
+  } else {
+    f->transform(f, words, vals);
+    memcpy(f->out + begin, vals, n * sizeof(f32));
+  }
+}
+
+static _Atomic uint64_t tensor_rng_key = 0;
+static _Atomic uint64_t tensor_rng_counter = 0;
+
+Tensor_Rng tensor_rng_init(uint64_t seed){
+  return (Tensor_Rng){.key = seed, .counter = 0};
+}
+
+void tensor_random_seed(uint64_t seed){
+  atomic_store(&tensor_rng_key, seed);
+  atomic_store(&tensor_rng_counter, 0);
+}
+
+// Not to be used directly, just a helper fxn
+// Takes the blocks for 'count' values from 'rng' (or the global generator) and fills 't'
+static void tensor_rng_fill(Tensor_Rng* rng, Tensor* tp, Tensor_Rng_Fill f){
+  // A shared copy on write storage is cloned first, with the allocator it was made with
+  if(tp->shared != nullptr) (void)tensor_make_writable(tp->shared->allocr, tp);
+  const Tensor t = *tp;
+  tensor_assert_writable(t);
+  tensor_assert_view_in_storage(t);
+  f.count = tensor_size(t);
+  const uint64_t blocks = ((f.count + TENSOR_RNG_GROUP - 1) / TENSOR_RNG_GROUP) * 16;
+  if(rng == nullptr){
+    f.key = atomic_load(&tensor_rng_key);
+    f.counter = atomic_fetch_add(&tensor_rng_counter, blocks);
+  } else {
+    f.key = rng->key;
+    f.counter = rng->counter;
+    rng->counter += blocks;
+  }
+  f.philox = tensor_philox_fn();
+  f.transform = tensor_rng_transform_fn();
+
+  // Written directly when 't' is row major f32, otherwise through a temporary
+  bool direct = (t.dtype == TENSOR_F32);
+  iptr stride = 1;
+  for(uptr i = t.ndim; i-- > 0;){
+    if(tensor_shape(t).data[i] != 1 && tensor_stride(t).data[i] != stride) direct = false;
+    stride *= (iptr)tensor_shape(t).data[i];
+  }
+  const Alloc_Interface scratch = gen_std_allocator();
+  Tensor tmp = {0};
+  if(direct){
+    f.out = t.storage.data + t.offset;
+  } else {
+    tmp = tensor_alloc_(scratch, tensor_shape(t));
+    f.out = tmp.storage.data;
+  }
+  const uptr chunks = (f.count + TENSOR_RNG_CHUNK - 1) / TENSOR_RNG_CHUNK;
+  // Generating a value costs about as much as a few elementwise ops
+  tensor_parallel_for_work(chunks, 8 * f.count, tensor_rng_fill_task, &f);
+  if(!direct){
+    tensor_loop_apply(2, (Tensor[]){t, tmp}, tensor_copy_kernel, nullptr);
+    tensor_free(scratch, &tmp);
+  }
+}
+
+void tensor_fill_uniform(Tensor_Rng* rng, Tensor* t, f32 min_val, f32 max_val){
+  tensor_rng_fill(rng, t, (Tensor_Rng_Fill){.dist = TENSOR_RNG_UNIFORM, .a = min_val, .b = max_val - min_val});
+}
+
+void tensor_fill_normal(Tensor_Rng* rng, Tensor* t, f32 mean, f32 std){
+  tensor_rng_fill(rng, t, (Tensor_Rng_Fill){.dist = TENSOR_RNG_NORMAL, .a = mean, .b = std});
+}
+
+void tensor_fill_bernoulli(Tensor_Rng* rng, Tensor* t, f32 p){
+  tensor_rng_fill(rng, t, (Tensor_Rng_Fill){.dist = TENSOR_RNG_BERNOULLI, .p = p});
+}
+
+void tensor_fill_truncated_normal(Tensor_Rng* rng, Tensor* t, f32 mean, f32 std, f32 min_val, f32 max_val){
+  assert(((void)"Truncated normal needs a positive std and min_val <= max_val",
+	  std > 0.f && min_val <= max_val));
+  f64 lo = ((f64)min_val - mean) / std, hi = ((f64)max_val - mean) / std;
+  // Values are drawn from the lower tail (the range is mirrored if needed), where the
+  //   cdf is small and keeps its precision in f32
+  f32 sign = 1.f;
+  if(lo + hi > 0.0){
+    const f64 l = lo;
+    lo = -hi, hi = -l, sign = -1.f;
+  }
+  tensor_rng_fill(rng, t, (Tensor_Rng_Fill){
+      .dist = TENSOR_RNG_TRUNCATED_NORMAL, .a = mean, .b = std, .sign = sign,
+      .cdf_lo = (f32)tensor_rng_ndtr(lo), .cdf_hi = (f32)tensor_rng_ndtr(hi),
+      .z_lo = (f32)lo, .z_hi = (f32)hi,
+    });
+}
+
+Tensor tensor_random_(Alloc_Interface allocr, f32 min_val, f32 max_val, Tensor_Inx shape){
+  Tensor t = tensor_alloc_(allocr, shape);
+  tensor_fill_uniform(nullptr, &t, min_val, max_val);
+  return t;
+}
+
+Tensor tensor_random_normal_(Alloc_Interface allocr, f32 mean, f32 std, Tensor_Inx shape){
+  Tensor t = tensor_alloc_(allocr, shape);
+  tensor_fill_normal(nullptr, &t, mean, std);
+  return t;
+}
+
+Tensor tensor_random_bernoulli_(Alloc_Interface allocr, f32 p, Tensor_Inx shape){
+  Tensor t = tensor_alloc_(allocr, shape);
+  tensor_fill_bernoulli(nullptr, &t, p);
+  return t;
+}
+
+Tensor tensor_random_truncated_normal_(Alloc_Interface allocr, f32 mean, f32 std,
+				       f32 min_val, f32 max_val, Tensor_Inx shape){
+  Tensor t = tensor_alloc_(allocr, shape);
+  tensor_fill_truncated_normal(nullptr, &t, mean, std, min_val, max_val);
+  return t;
+}
+
+// Not to be used directly, just a helper fxn
+// Slices [start, end) of every dimension, taking every step'th element (null steps are all 1)
+//   Negative steps walk the range backwards from its last element, so no copy is needed either way
+static Tensor tensor_slice_stepped(Alloc_Interface allocr, Tensor src,
+				  Tensor_Inx start, Tensor_Inx end, const iptr* steps){
+  // Assert if indexes are of valid dimension
+  assert(((void)"Dimensions of starting tensor index must be same as tensor dimension",
+	  start.count == src.ndim));
+  assert(((void)"Dimensions of ending tensor index must be same as tensor dimension",
+	  end.count == src.ndim));
+
+  // Assert if the indexes are in valid ranges
+  for_slice(tensor_shape(src), i){
+    assert(((void)"Starting index cannot be greater or equal to size of tensor",
+	    start.data[i] < tensor_shape(src).data[i]));
+    assert(((void)"Starting index cannot be greater than size of tensor",
+	    end.data[i] <= tensor_shape(src).data[i]));
+    assert(((void)"Ending index cannot be less than the starting index", start.data[i] <= end.data[i]));
+    assert(((void)"Step of a slice cannot be 0", steps == nullptr || steps[i] != 0));
+  }
+
+  // Create new non-owning tensor
+  Tensor dst = tensor_view_of(allocr, src); //shares storage
+
+  // Slice-em
+  // shape = ceil((end - start) / |step|), offset += first . stride, stride *= step
+  iptr offset = (iptr)dst.offset;
+  for_slice(tensor_shape(dst), i){
+    const iptr step = (steps == nullptr) ? 1 : steps[i];
+    const uptr size = end.data[i] - start.data[i];
+    const uptr mag = (uptr)((step < 0) ? -step : step);
+    const uptr first = (step > 0 || size == 0) ? start.data[i] : (end.data[i] - 1);
+    tensor_shape(dst).data[i] = (size + mag - 1) / mag;
+    offset += (iptr)first * tensor_stride(dst).data[i];
+    tensor_stride(dst).data[i] *= step;
+  }
+  dst.offset = (uptr)offset;
+
+  return dst;
+}
+
+Tensor tensor_slice_(Alloc_Interface allocr, Tensor src,
+		     Tensor_Inx start, Tensor_Inx end){
+  return tensor_slice_stepped(allocr, src, start, end, nullptr);
+}
+
+Tensor tensor_slice_step_(Alloc_Interface allocr, Tensor src,
+			  Tensor_Inx start, Tensor_Inx end, Tensor_Strides steps){
+  assert(((void)"Dimensions of the steps must be same as tensor dimension", steps.count == src.ndim));
+  return tensor_slice_stepped(allocr, src, start, end, steps.data);
+}
+
+void tensor_flip_in_place(Tensor* t, uptr dim){
+  assert(((void)"Index out of bounds", dim < t->ndim));
+  // Index 0 moves to the last element, and the stride walks back from there
+  const uptr size = tensor_shape(*t).data[dim];
+  if(size == 0) return;
+  t->offset = (uptr)((iptr)t->offset + (iptr)(size - 1) * tensor_stride(*t).data[dim]);
+  tensor_stride(*t).data[dim] = -tensor_stride(*t).data[dim];
+}
+
+Tensor tensor_flip(Alloc_Interface allocr, Tensor t, uptr dim){
+  Tensor newt = tensor_view_of(allocr, t); //shares storage
+  tensor_flip_in_place(&newt, dim);
+  return newt;
+}
+
+// Not to be used directly, just a helper fxn
+// New non-owning tensor sharing the storage, with 'ndim' dimensions left for the caller to fill
+static Tensor tensor_view_with_ndim(Alloc_Interface allocr, Tensor src, uptr ndim){
+  Tensor dst = {
+    .storage = src.storage, //shares storage
+    .dtype = src.dtype,
+    .shared = src.shared,
+    .offset = src.offset,
+    .owner = false,
+  };
+  tensor_storage_retain(src.shared);
+  tensor_init_dims(allocr, &dst, ndim);
+  return dst;
+}
+
+Tensor tensor_expand_(Alloc_Interface allocr, Tensor src, Tensor_Inx shape){
+  assert(((void)"Tensor cannot be expanded to the given shape",
+	  tensor_shape_broadcastable(tensor_shape(src), shape)));
+
+  // Create new non-owning tensor, repeated dimensions just get 0 stride
+  Tensor dst = tensor_view_with_ndim(allocr, src, shape.count);
+  for_slice(shape, i){
+    tensor_shape(dst).data[i] = shape.data[i];
+    tensor_stride(dst).data[i] = tensor_broadcast_stride(src, shape.count, i);
+  }
+  return dst;
+}
+
+// Not to be used directly, just a helper fxn
+// Strides for 'shape' that walk the elements of 't' in the same row major order, if there are any
+//   Dimensions of both are grouped into runs with equal products, each run of 't' has to be
+//   contiguous within itself, and the new strides of a run are counted up from its last stride
+static bool tensor_reshape_strides(Tensor t, Tensor_Inx shape, iptr strides[]){
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  uptr old_shape[TENSOR_LOOP_MAX_DIMS];
+  iptr old_stride[TENSOR_LOOP_MAX_DIMS];
+  uptr old_ndim = 0;
+  // Size 1 dimensions can be placed anywhere, so they dont take part
+  for_slice(tensor_shape(t), i){
+    if(tensor_shape(t).data[i] == 1) continue;
+    old_shape[old_ndim] = tensor_shape(t).data[i];
+    old_stride[old_ndim] = tensor_stride(t).data[i];
+    old_ndim++;
+  }
+
+  uptr oi = 0, oj = 1, ni = 0, nj = 1;
+  while(ni < shape.count && oi < old_ndim){
+    uptr np = shape.data[ni];
+    uptr op = old_shape[oi];
+    while(np != op){
+      if(np < op) np *= shape.data[nj++];
+      else op *= old_shape[oj++];
+    }
+    for_range(uptr, k, oi, oj - 1){
+      if(old_stride[k] != (iptr)old_shape[k + 1] * old_stride[k + 1]) return false;
+    }
+    strides[nj - 1] = old_stride[oj - 1];
+    for(uptr k = nj - 1; k > ni; --k) strides[k - 1] = strides[k] * (iptr)shape.data[k];
+    ni = nj++;
+    oi = oj++;
+  }
+  // Leftover size 1 dimensions
+  const iptr last = (ni > 0) ? strides[ni - 1] : 1;
+  for_range(uptr, k, ni, shape.count) strides[k] = last;
+  return true;
+}
+
+Tensor tensor_reshape_(Alloc_Interface allocr, Tensor t, Tensor_Inx shape, bool* copied){
+  assert(((void)"Tensor has too many dimensions", shape.count <= TENSOR_LOOP_MAX_DIMS));
+  uptr dims[TENSOR_LOOP_MAX_DIMS];
+  uptr known = 1;
+  uptr infer = shape.count;
+  for_slice(shape, i){
+    dims[i] = shape.data[i];
+    if(shape.data[i] != TENSOR_INFER_DIM){
+      known *= shape.data[i];
+      continue;
+    }
+    assert(((void)"Only one dimension can be inferred", infer == shape.count));
+    infer = i;
+  }
+  const uptr total = tensor_size(t);
+  if(infer < shape.count){
+    assert(((void)"Cannot infer the dimension from the other dimensions",
+	    known != 0 && total % known == 0));
+    dims[infer] = total / known;
+  } else {
+    assert(((void)"Reshaping cannot change the number of elements", known == total));
+  }
+  const Tensor_Inx new_shape = {.data = dims, .count = shape.count};
+
+  iptr strides[TENSOR_LOOP_MAX_DIMS];
+  bool view = true;
+  if(total == 0) tensor_force_fix_stride(new_shape, (Tensor_Strides){.data = strides, .count = shape.count});
+  else view = tensor_reshape_strides(t, new_shape, strides);
+  if(copied != nullptr) *copied = !view;
+
+  if(view){
+    Tensor dst = tensor_view_with_ndim(allocr, t, shape.count); //shares storage
+    for_slice(new_shape, i){
+      tensor_shape(dst).data[i] = dims[i];
+      tensor_stride(dst).data[i] = strides[i];
+    }
+    return dst;
+  }
+  // Strides do not allow it, so the elements are copied in row major order first
+  Tensor dst = tensor_contiguous(allocr, t);
+  tensor_deinit_dims(allocr, &dst);
+  tensor_init_dims(allocr, &dst, shape.count);
+  for_slice(new_shape, i) tensor_shape(dst).data[i] = dims[i];
+  tensor_force_fix_stride(tensor_shape(dst), tensor_stride(dst));
+  return dst;
+}
+
+Tensor tensor_view_as(Alloc_Interface allocr, Tensor t, Tensor like, bool* copied){
+  return tensor_reshape_(allocr, t, tensor_shape(like), copied);
+}
+
+Tensor tensor_flatten(Alloc_Interface allocr, Tensor t, uptr start_dim, uptr end_dim, bool* copied){
+  // 0 dim tensors become a single element 1 dim tensor
+  if(t.ndim == 0) return tensor_reshape(allocr, t, copied, 1);
+  assert(((void)"Index out of bounds", end_dim < t.ndim));
+  assert(((void)"Starting dimension cannot be after the ending one", start_dim <= end_dim));
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  uptr dims[TENSOR_LOOP_MAX_DIMS];
+  uptr ndim = 0;
+  for_slice(tensor_shape(t), i){
+    if(i <= start_dim || i > end_dim) dims[ndim++] = tensor_shape(t).data[i];
+    else dims[ndim - 1] *= tensor_shape(t).data[i];
+  }
+  return tensor_reshape_(allocr, t, (Tensor_Inx){.data = dims, .count = ndim}, copied);
+}
+
+Tensor tensor_squeeze(Alloc_Interface allocr, Tensor t, uptr dim){
+  assert(((void)"Index out of bounds", dim == TENSOR_SQUEEZE_ALL || dim < t.ndim));
+  assert(((void)"Only size 1 dimensions can be squeezed",
+	  dim == TENSOR_SQUEEZE_ALL || tensor_shape(t).data[dim] == 1));
+  uptr ndim = 0;
+  for_slice(tensor_shape(t), i){
+    if(tensor_shape(t).data[i] != 1 || (dim != TENSOR_SQUEEZE_ALL && i != dim)) ndim++;
+  }
+  Tensor dst = tensor_view_with_ndim(allocr, t, ndim); //shares storage
+  uptr j = 0;
+  for_slice(tensor_shape(t), i){
+    if(tensor_shape(t).data[i] == 1 && (dim == TENSOR_SQUEEZE_ALL || i == dim)) continue;
+    tensor_shape(dst).data[j] = tensor_shape(t).data[i];
+    tensor_stride(dst).data[j] = tensor_stride(t).data[i];
+    j++;
+  }
+  return dst;
+}
+
+Tensor tensor_unsqueeze(Alloc_Interface allocr, Tensor t, uptr dim){
+  assert(((void)"Index out of bounds", dim <= t.ndim));
+  Tensor dst = tensor_view_with_ndim(allocr, t, t.ndim + 1); //shares storage
+  for_range(uptr, i, 0, t.ndim + 1){
+    if(i == dim){
+      // Stride of a size 1 dimension is never used, keep it as if it was contiguous
+      tensor_shape(dst).data[i] = 1;
+      tensor_stride(dst).data[i] = (i < t.ndim) ? (iptr)tensor_shape(t).data[i] * tensor_stride(t).data[i] : 1;
+      continue;
+    }
+    const uptr j = (i < dim) ? i : (i - 1);
+    tensor_shape(dst).data[i] = tensor_shape(t).data[j];
+    tensor_stride(dst).data[i] = tensor_stride(t).data[j];
+  }
+  return dst;
+}
+
+Tensor tensor_map_op_inp(Tensor_Iter* out_iter, Tensor_Slice ts, f32_binop* op){
+  tensor_iter_make_writable(out_iter);
+  // Maybe first assert that there are more than 1`tensors
+  assert(((void)"There has to be at least 2 tensors for this operation to have meaning",
+	  ts.count >= 2));
+  // Then assert that each tensor broadcasts to the output's shape
+  //   (size 1 or missing leading dimensions are repeated without any copy)
+  for_slice(ts, i){
+    assert(((void)"The input tensors should be broadcastable to the output tensor",
+	    tensor_shape_broadcastable(tensor_shape(slice_inx(ts, i)), tensor_shape(out_iter->t))));
+  }
+
+  // First pass combines the first two operands, rest are folded into the output one by one
+  Tensor_Op_Ctx ctx = {.op = op, .builtin = f32_builtin_op_of(op)};
+  Tensor_Loop_Kernel* kernel = ((ctx.builtin == F32_OP_CUSTOM) ?
+				tensor_binop_kernel : tensor_builtin_binop_kernel);
+  tensor_loop_apply(3, (Tensor[]){out_iter->t, slice_inx(ts, 0), slice_inx(ts, 1)},
+		    kernel, &ctx);
+  for_range(size_t, i, 2, ts.count){
+    tensor_loop_apply(3, (Tensor[]){out_iter->t, out_iter->t, slice_inx(ts, i)},
+		      kernel, &ctx);
+  }
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+// Not to be used directly, just a helper fxn
+// Broadcasts the shape 'out' of 'ndim' dims together with 'shape', returns the new dimension count
+static uptr tensor_broadcast_shape_into(uptr out[TENSOR_LOOP_MAX_DIMS], uptr ndim, Tensor_Inx shape){
+  assert(((void)"Tensor has too many dimensions", shape.count <= TENSOR_LOOP_MAX_DIMS));
+  if(shape.count > ndim){
+    const uptr extra = shape.count - ndim;
+    for(uptr d = ndim; d-- > 0;) out[d + extra] = out[d];
+    for_range(uptr, d, 0, extra) out[d] = 1;
+    ndim = shape.count;
+  }
+  const uptr lead = ndim - shape.count;
+  for_slice(shape, j){
+    if(shape.data[j] == 1) continue;
+    assert(((void)"Tensors of these shapes cannot be broadcasted together",
+	    out[lead + j] == 1 || out[lead + j] == shape.data[j]));
+    out[lead + j] = shape.data[j];
+  }
+  return ndim;
+}
+
+// Not to be used directly, just a helper fxn
+// Writes the broadcasted shape of all the tensors into 'out', returns its dimension count
+static uptr tensor_broadcast_shapes(Tensor_Slice ts, uptr out[TENSOR_LOOP_MAX_DIMS]){
+  uptr ndim = 0;
+  for_slice(ts, i) ndim = tensor_broadcast_shape_into(out, ndim, tensor_shape(slice_inx(ts, i)));
+  return ndim;
+}
+
+Tensor tensor_map_op_new(Alloc_Interface allocr, Tensor_Slice ts, f32_binop* op){
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  const uptr ndim = tensor_broadcast_shapes(ts, shape);
+  Tensor_DType dtype = slice_inx(ts, 0).dtype;
+  for_slice(ts, i) dtype = tensor_dtype_promote(dtype, slice_inx(ts, i).dtype);
+  Tensor ans = tensor_alloc_dtype_(allocr, dtype, init_uptr_slice(shape, ndim));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_map_op_inp(&iter, ts, op);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+Tensor tensor_bin_op_new(Alloc_Interface allocr, Tensor t1, f32_binop* op, Tensor t2){
+  return tensor_map_op(allocr, MAKE_ARRAY_SLICE(Tensor, t1, t2), op);
+}
+Tensor tensor_bin_op_inp(Tensor_Iter* out_iter, Tensor t1, f32_binop* op, Tensor t2){
+  return tensor_map_op(out_iter, MAKE_ARRAY_SLICE(Tensor, t1, t2), op);
+}
+
+f32 f32_add_op(f32 a, f32 b){
+  return a + b;
+}
+
+f32 f32_prod_op(f32 a, f32 b){
+  return a * b;
+}
+
+f32 f32_max_op(f32 a, f32 b){
+  return ((a>b)?a:b);
+};
+
+f32 f32_min_op(f32 a, f32 b){
+  return ((a<b)?a:b);
+}
+Tensor tensor_vector_op_inp(Tensor_Iter* out_iter, f32 sv, f32_binop* op, Tensor tv){
+  tensor_iter_make_writable(out_iter);
+  Tensor_Op_Ctx ctx = {.op = op, .builtin = f32_builtin_op_of(op), .sv = sv};
+  tensor_loop_apply(2, (Tensor[]){out_iter->t, tv},
+		    ((ctx.builtin == F32_OP_CUSTOM) ? tensor_vecop_kernel : tensor_builtin_vecop_kernel),
+		    &ctx);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+Tensor tensor_vector_op_new(Alloc_Interface allocr, f32 sv, f32_binop* op, Tensor tv){
+  Tensor ans = tensor_alloc_dtype_(allocr, tv.dtype, tensor_shape(tv));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_vector_op(&iter, sv, op, tv);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Reduction engine
+//   The kept dimensions of input and output are walked by a 'Tensor_Loop', and each
+//   output element folds one row of the reduced dimension.
+//   Builtin ops fold rows as a fixed pairwise tree over blocks of the row, with SIMD
+//   at the leaves. The tree only depends on the row length, so splitting the top of
+//   the tree across threads gives bitwise identical results for any thread count.
+//   Custom ops are always folded left to right, as op(op(x0, x1), x2)...
+#define TENSOR_REDUCE_BLOCK 1024
+// Rows of the reduced dimension folded sequentially before pairing in column mode
+#define TENSOR_REDUCE_COL_BLOCK 64
+// Number of output columns accumulated together in column mode
+#define TENSOR_REDUCE_COL_WIDTH 256
+// Max number of subtrees a single long row is split into
+#define TENSOR_REDUCE_MAX_SPLITS 256
+
+typedef struct Tensor_Reduce_Ctx Tensor_Reduce_Ctx;
+struct Tensor_Reduce_Ctx {
+  f32_binop* op;
+  F32_Builtin_Op builtin;
+  F32_Red_Kernel* leaf;
+  F32_Bin_Kernel* bin;
+  uptr len;
+  iptr rstride;
+  // Reduced dim is strided but the kept one is not, vectorize across the kept dim
+  //   decided once for the whole loop so that thread splits dont change the results
+  bool col_mode;
+  // Used only by 'tensor_reduce_typed_kernel'
+  Tensor_DType in_dtype;
+  Tensor_DType out_dtype;
+};
+
+static inline f32 f32_builtin_apply(F32_Builtin_Op builtin, f32 a, f32 b){
+  switch(builtin){
+  case F32_OP_ADD: return f32_add_inl(a, b);
+  case F32_OP_PROD: return f32_prod_inl(a, b);
+  case F32_OP_MAX: return f32_max_inl(a, b);
+  case F32_OP_MIN: return f32_min_inl(a, b);
+  default: assert(((void)"Not a builtin op", false));
+  }
+  return a;
+}
+
+// Left fold of n (> 0) elements with stride s
+static f32 f32_fold_seq(const Tensor_Reduce_Ctx* c, const f32* x, uptr n, iptr s){
+  f32 acc = x[0];
+  if(c->builtin == F32_OP_CUSTOM){
+    for_range(uptr, i, 1, n) acc = c->op(acc, x[(iptr)i * s]);
+  } else {
+    for_range(uptr, i, 1, n) acc = f32_builtin_apply(c->builtin, acc, x[(iptr)i * s]);
+  }
+  return acc;
+}
+
+// Index where the pairwise tree splits a row of n elements (n > TENSOR_REDUCE_BLOCK)
+static uptr f32_tree_split(uptr n){
+  const uptr blocks = (n + TENSOR_REDUCE_BLOCK - 1) / TENSOR_REDUCE_BLOCK;
+  return (blocks / 2) * TENSOR_REDUCE_BLOCK;
+}
+
+// Strided leaf for builtin ops, same 8 lane layout as the portable unit stride kernels
+static f32 f32_fold_lanes_strided(F32_Builtin_Op builtin, const f32* x, uptr n, iptr s){
+  if(n < 8){
+    f32 acc = x[0];
+    for_range(uptr, i, 1, n) acc = f32_builtin_apply(builtin, acc, x[(iptr)i * s]);
+    return acc;
+  }
+  f32 lanes[8];
+  for_range(uptr, l, 0, 8) lanes[l] = x[(iptr)l * s];
+  uptr i = 8;
+  for(; i + 8 <= n; i += 8){
+    for_range(uptr, l, 0, 8) lanes[l] = f32_builtin_apply(builtin, lanes[l], x[(iptr)(i + l) * s]);
+  }
+  for(uptr w = 4; w > 0; w /= 2){
+    for_range(uptr, l, 0, w) lanes[l] = f32_builtin_apply(builtin, lanes[l], lanes[l + w]);
+  }
+  f32 acc = lanes[0];
+  for(; i < n; ++i) acc = f32_builtin_apply(builtin, acc, x[(iptr)i * s]);
+  return acc;
+}
+
+static f32 f32_reduce_tree(const Tensor_Reduce_Ctx* c, const f32* x, uptr n, iptr s){
+  if(n <= TENSOR_REDUCE_BLOCK){
+    if(s == 1) return c->leaf(n, x);
+    return f32_fold_lanes_strided(c->builtin, x, n, s);
+  }
+  const uptr half = f32_tree_split(n);
+  return f32_builtin_apply(c->builtin, f32_reduce_tree(c, x, half, s),
+			   f32_reduce_tree(c, x + (iptr)half * s, n - half, s));
+}
+
+// Folds a single row of the reduced dimension
+static f32 f32_reduce_row(const Tensor_Reduce_Ctx* c, const f32* x){
+  if(c->builtin == F32_OP_CUSTOM) return f32_fold_seq(c, x, c->len, c->rstride);
+  return f32_reduce_tree(c, x, c->len, c->rstride);
+}
+
+// Folds 'cols' unit stride columns over the reduced dimension into acc
+//   acc[j] = fold over r of x[r*rs + j], rows are paired as a tree for builtin ops
+static void f32_reduce_cols(const Tensor_Reduce_Ctx* c, f32* acc, const f32* x, uptr cols, uptr rows){
+  memcpy(acc, x, cols * sizeof(f32));
+  if(c->builtin == F32_OP_CUSTOM){
+    for_range(uptr, r, 1, rows){
+      const f32* xr = x + (iptr)r * c->rstride;
+      for_range(uptr, j, 0, cols) acc[j] = c->op(acc[j], xr[j]);
+    }
+    return;
+  }
+  if(rows <= TENSOR_REDUCE_COL_BLOCK){
+    for_range(uptr, r, 1, rows) c->bin(cols, acc, acc, x + (iptr)r * c->rstride);
+    return;
+  }
+  const uptr blocks = (rows + TENSOR_REDUCE_COL_BLOCK - 1) / TENSOR_REDUCE_COL_BLOCK;
+  const uptr half = (blocks / 2) * TENSOR_REDUCE_COL_BLOCK;
+  f32 rest[TENSOR_REDUCE_COL_WIDTH];
+  f32_reduce_cols(c, acc, x, cols, half);
+  f32_reduce_cols(c, rest, x + (iptr)half * c->rstride, cols, rows - half);
+  c->bin(cols, acc, acc, rest);
+}
+
+// Loop kernel, p[0] is the output, p[1] is the input at index 0 of the reduced dimension
+static void tensor_reduce_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Reduce_Ctx* c = ctx;
+  f32* out = p[0];
+  const f32* in = p[1];
+
+  if(c->col_mode){
+    f32 acc[TENSOR_REDUCE_COL_WIDTH];
+    for(uptr j = 0; j < n; j += TENSOR_REDUCE_COL_WIDTH){
+      const uptr cols = ((n - j) < TENSOR_REDUCE_COL_WIDTH) ? (n - j) : TENSOR_REDUCE_COL_WIDTH;
+      f32_reduce_cols(c, acc, in + j, cols, c->len);
+      for_range(uptr, k, 0, cols) out[(iptr)(j + k) * s[0]] = acc[k];
+    }
+    return;
+  }
+  for_range(uptr, i, 0, n) out[(iptr)i * s[0]] = f32_reduce_row(c, in + (iptr)i * s[1]);
+}
+
+// Pairwise tree over a row of a non f32 input, each leaf is converted into f32 first
+//   The tree is the same as in 'f32_reduce_tree', so the result is the same as reducing
+//   an f32 copy of the input, with the reduced dimension contiguous
+static f32 f32_reduce_typed_tree(const Tensor_Reduce_Ctx* c, const char* x, uptr n){
+  if(n <= TENSOR_REDUCE_BLOCK){
+    f32 buf[TENSOR_REDUCE_BLOCK];
+    tensor_dtype_load(c->in_dtype, n, x, c->rstride, buf, 1);
+    return c->leaf(n, buf);
+  }
+  const uptr half = f32_tree_split(n);
+  const iptr step = (iptr)half * c->rstride * (iptr)tensor_dtype_size(c->in_dtype);
+  return f32_builtin_apply(c->builtin, f32_reduce_typed_tree(c, x, half),
+			   f32_reduce_typed_tree(c, x + step, n - half));
+}
+
+// Loop kernel for inputs of other dtypes than f32, p[0] and p[1] point to their own dtypes
+static void tensor_reduce_typed_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Reduce_Ctx* c = ctx;
+  const iptr in_size = (iptr)tensor_dtype_size(c->in_dtype);
+  const iptr out_size = (iptr)tensor_dtype_size(c->out_dtype);
+  for_range(uptr, i, 0, n){
+    const char* row = (const char*)p[1] + (iptr)i * s[1] * in_size;
+    f32 acc;
+    if(c->builtin != F32_OP_CUSTOM){
+      acc = f32_reduce_typed_tree(c, row, c->len);
+    } else {
+      // Custom ops are folded left to right, a block of converted elements at a time
+      f32 buf[TENSOR_REDUCE_BLOCK];
+      for(uptr j = 0; j < c->len; j += TENSOR_REDUCE_BLOCK){
+	const uptr m = ((c->len - j) < TENSOR_REDUCE_BLOCK) ? (c->len - j) : TENSOR_REDUCE_BLOCK;
+	tensor_dtype_load(c->in_dtype, m, row + (iptr)j * c->rstride * in_size, c->rstride, buf, 1);
+	uptr k = 0;
+	if(j == 0) acc = buf[k++];
+	for(; k < m; ++k) acc = c->op(acc, buf[k]);
+      }
+    }
+    tensor_dtype_store(c->out_dtype, 1, &acc, 1, (char*)p[0] + (iptr)i * s[0] * out_size, 1);
+  }
+}
+
+// Splitting a single long row into the subtrees at some depth of the pairwise tree
+typedef struct Tensor_Reduce_Split Tensor_Reduce_Split;
+struct Tensor_Reduce_Split {
+  const Tensor_Reduce_Ctx* c;
+  uptr count;
+  const f32* ptrs[TENSOR_REDUCE_MAX_SPLITS];
+  uptr lens[TENSOR_REDUCE_MAX_SPLITS];
+  f32 results[TENSOR_REDUCE_MAX_SPLITS];
+};
+
+static void tensor_reduce_split_collect(Tensor_Reduce_Split* sp, const f32* x, uptr n, uptr depth){
+  if(depth == 0 || n <= TENSOR_REDUCE_BLOCK){
+    sp->ptrs[sp->count] = x;
+    sp->lens[sp->count] = n;
+    sp->count++;
+    return;
+  }
+  const uptr half = f32_tree_split(n);
+  tensor_reduce_split_collect(sp, x, half, depth - 1);
+  tensor_reduce_split_collect(sp, x + (iptr)half * sp->c->rstride, n - half, depth - 1);
+}
+
+// Combines the subtree results exactly the way 'f32_reduce_tree' would
+static f32 tensor_reduce_split_combine(const Tensor_Reduce_Split* sp, uptr n, uptr depth, uptr* cursor){
+  if(depth == 0 || n <= TENSOR_REDUCE_BLOCK) return sp->results[(*cursor)++];
+  const uptr half = f32_tree_split(n);
+  const f32 left = tensor_reduce_split_combine(sp, half, depth - 1, cursor);
+  const f32 right = tensor_reduce_split_combine(sp, n - half, depth - 1, cursor);
+  return f32_builtin_apply(sp->c->builtin, left, right);
+}
+
+static void tensor_reduce_split_task(void* ctx, uptr t){
+  Tensor_Reduce_Split* sp = ctx;
+  sp->results[t] = f32_reduce_tree(sp->c, sp->ptrs[t], sp->lens[t], sp->c->rstride);
+}
+
+// Loop kernel for few outputs with long rows, each row is split across threads
+static void tensor_reduce_long_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Reduce_Ctx* c = ctx;
+  uptr depth = 0;
+  while(((uptr)1 << (depth + 1)) <= TENSOR_REDUCE_MAX_SPLITS &&
+	((uptr)1 << depth) < tensor_parallel_task_count(c->len)) depth++;
+  for_range(uptr, i, 0, n){
+    Tensor_Reduce_Split sp = {.c = c};
+    tensor_reduce_split_collect(&sp, p[1] + (iptr)i * s[1], c->len, depth);
+    tensor_parallel_for(sp.count, tensor_reduce_split_task, &sp);
+    uptr cursor = 0;
+    p[0][(iptr)i * s[0]] = tensor_reduce_split_combine(&sp, c->len, depth, &cursor);
+  }
+}
+
+Tensor tensor_reduce_op_inp(Tensor_Iter* out_iter, Tensor tv, uptr dim, f32_binop* op){
+  tensor_iter_make_writable(out_iter);
+  // For reduce operations to work the number of dimensions should be > 0
+  assert(((void)"Cannot do reduction on 0 dimensional tensors", tv.ndim > 0));
+
+  // Assert that the dim is in range
+  assert(((void)"The dim to work on should exist in input tensor",
+	  dim < tv.ndim));
+
+  // Assert that out_iter's tensor's dim is 1 less
+  assert(((void)"The output tensor's dimension count should be 1 less than input",
+	  out_iter->t.ndim == (tv.ndim -1)));
+
+  // Assert that the input has at least 1 elem in the dim index
+  assert(((void)"The input tensor to reduce must have non-zero dim in the chosen index",
+	  slice_inx(tensor_shape(tv), dim) > 0));
+
+  // Assert that the out_iter's tensor's shape matches after removing the dim
+  for_slice(tensor_shape(out_iter->t), i){
+    if(i < dim){
+      assert(((void)"The dimension of output must match input except for the chosen dimension to work on",
+	      slice_inx(tensor_shape(tv), i) == slice_inx(tensor_shape(out_iter->t), i)));
+    } else if(i >= dim){
+      assert(((void)"The dimension of output must match input except for the chosen dimension to work on",
+	      slice_inx(tensor_shape(tv), i+1) == slice_inx(tensor_shape(out_iter->t), i)));
+    }
+  }
+  assert(((void)"Tensor has too many dimensions", tv.ndim <= TENSOR_LOOP_MAX_DIMS));
+  tensor_assert_view_in_storage(tv);
+
+  // View of the input with the reduced dimension removed, starting at its index 0
+  uptr kept_dims[2 * TENSOR_LOOP_MAX_DIMS];
+  Tensor kept = tensor_temp_view(tv.storage, tv.offset, out_iter->t.ndim, kept_dims);
+  kept.dtype = tv.dtype;
+  for_slice(tensor_shape(kept), i){
+    const uptr j = (i < dim) ? i : (i + 1);
+    tensor_shape(kept).data[i] = slice_inx(tensor_shape(tv), j);
+    tensor_stride(kept).data[i] = slice_inx(tensor_stride(tv), j);
+  }
+
+  Tensor_Reduce_Ctx ctx = {
+    .op = op,
+    .builtin = f32_builtin_op_of(op),
+    .len = slice_inx(tensor_shape(tv), dim),
+    .rstride = slice_inx(tensor_stride(tv), dim),
+  };
+  if(ctx.builtin != F32_OP_CUSTOM){
+    ctx.leaf = f32_reduce_table()->red[ctx.builtin];
+    ctx.bin = f32_reduce_table()->bin[ctx.builtin];
+  }
+
+  Tensor_Loop loop;
+  const uptr total = tensor_loop_init(&loop, 2, (Tensor[]){out_iter->t, kept});
+  if(tv.dtype != TENSOR_F32){
+    ctx.in_dtype = tv.dtype;
+    ctx.out_dtype = out_iter->t.dtype;
+    tensor_loop_run_all(&loop, total, ctx.len, tensor_reduce_typed_kernel, &ctx);
+    tensor_iter_finish(out_iter);
+    return out_iter->t;
+  }
+  ctx.col_mode = (loop.stride[1][loop.ndim - 1] == 1 && ctx.rstride != 1 &&
+		  loop.shape[loop.ndim - 1] >= 8);
+  // Too few outputs to keep threads busy, split within each row instead
+  //   Not for col_mode, its rows are paired in blocks of columns, which the split doesnt follow
+  const bool split_rows = (ctx.builtin != F32_OP_CUSTOM && !ctx.col_mode &&
+			   total < tensor_get_num_threads() && ctx.len > TENSOR_REDUCE_BLOCK);
+  Tensor_Loop_Kernel* kernel = split_rows ? tensor_reduce_long_kernel : tensor_reduce_kernel;
+  void* kernel_ctx = &ctx;
+  // Only the output needs converting, the usual kernels write into it through buffers
+  Tensor_Typed_Ctx typed = {.kernel = kernel, .ctx = &ctx, .nops = 2, .dtype = {out_iter->t.dtype, TENSOR_F32}};
+  if(out_iter->t.dtype != TENSOR_F32){
+    kernel = tensor_typed_kernel;
+    kernel_ctx = &typed;
+  }
+  if(split_rows) tensor_loop_run(&loop, 0, total, kernel, kernel_ctx);
+  else tensor_loop_run_all(&loop, total, ctx.len, kernel, kernel_ctx);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
 }
 
 Tensor tensor_reduce_op_new(Alloc_Interface allocr, Tensor tv, uptr dim, f32_binop* op){
   assert(((void)"Input tensor must be at least 1 dimensional",
-	  tv.shape.count > 0));
-  Tensor_Inx out_shape = SLICE_ALLOC(allocr, uptr, tv.shape.count - 1);
-  if(out_shape.count > 0) MEMCHK(out_shape.data);
+	  tv.ndim > 0));
+  assert(((void)"Tensor has too many dimensions", tv.ndim <= TENSOR_LOOP_MAX_DIMS));
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  Tensor_Inx out_shape = init_uptr_slice(shape, tv.ndim - 1);
+
+  for_slice(out_shape, i){
+    if(i < dim) slice_inx(out_shape, i) = slice_inx(tensor_shape(tv), i);
+    else if(i >= dim) slice_inx(out_shape, i) = slice_inx(tensor_shape(tv), i+1);
+  }
+  Tensor ans = tensor_alloc_dtype_(allocr, tv.dtype, out_shape);
+
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_reduce_op(&iter, tv, dim, op);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;  
+}
+
+// Sliding windows
+//   'tensor_unfold' only changes the strides, window i along 'dim' starts step * i elements
+//   later and the window itself walks the old stride of 'dim'. Pooling folds the op over
+//   the window positions, each position k is the whole strided view of the k'th elements of
+//   all the windows, so every fold is one elementwise pass through the loop engine.
+//   Rolling sums update each window from the previous one instead, see below.
+
+// Not to be used directly, just a helper fxn
+// Number of windows of 'size' elements, starting every 'step' elements, along 'dim'
+static uptr tensor_window_count(Tensor t, uptr dim, uptr size, uptr step){
+  assert(((void)"The dim to work on should exist in input tensor", dim < t.ndim));
+  assert(((void)"Window size and step must be at least 1", size > 0 && step > 0));
+  assert(((void)"Window cannot be larger than the dimension", size <= tensor_shape(t).data[dim]));
+  return (tensor_shape(t).data[dim] - size) / step + 1;
+}
+
+Tensor tensor_unfold(Alloc_Interface allocr, Tensor t, uptr dim, uptr size, uptr step){
+  const uptr count = tensor_window_count(t, dim, size, step);
+  Tensor dst = tensor_view_with_ndim(allocr, t, t.ndim + 1); //shares storage
+  for_slice(tensor_shape(t), i){
+    tensor_shape(dst).data[i] = tensor_shape(t).data[i];
+    tensor_stride(dst).data[i] = tensor_stride(t).data[i];
+  }
+  tensor_shape(dst).data[dim] = count;
+  tensor_stride(dst).data[dim] = tensor_stride(t).data[dim] * (iptr)step;
+  tensor_shape(dst).data[t.ndim] = size;
+  tensor_stride(dst).data[t.ndim] = tensor_stride(t).data[dim];
+  return dst;
+}
+
+// Not to be used directly, just a helper fxn
+// The k'th element of every window, as a view shaped like the pooled output
+static Tensor tensor_window_view(Tensor t, uptr dim, uptr k, uptr count, uptr step, uptr scratch[]){
+  Tensor v = tensor_temp_view(t.storage, t.offset, t.ndim, scratch);
+  v.dtype = t.dtype;
+  for_slice(tensor_shape(t), i){
+    tensor_shape(v).data[i] = tensor_shape(t).data[i];
+    tensor_stride(v).data[i] = tensor_stride(t).data[i];
+  }
+  v.offset = (uptr)((iptr)t.offset + (iptr)k * tensor_stride(t).data[dim]);
+  tensor_shape(v).data[dim] = count;
+  tensor_stride(v).data[dim] = tensor_stride(t).data[dim] * (iptr)step;
+  return v;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_pool_check(Tensor out, Tensor t, uptr dim, uptr count){
+  assert(((void)"The output tensor should have the same dimension count as input", out.ndim == t.ndim));
+  for_slice(tensor_shape(t), i){
+    assert(((void)"The output must have the shape of the input, with the number of windows along the dim",
+	    tensor_shape(out).data[i] == ((i == dim) ? count : tensor_shape(t).data[i])));
+  }
+  (void)out, (void)t, (void)dim, (void)count;
+}
+
+Tensor tensor_pool_op_inp(Tensor_Iter* out_iter, Tensor t, uptr dim, uptr size, uptr step, f32_binop* op){
+  tensor_iter_make_writable(out_iter);
+  const uptr count = tensor_window_count(t, dim, size, step);
+  tensor_pool_check(out_iter->t, t, dim, count);
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+
+  uptr scratch[2][2 * TENSOR_LOOP_MAX_DIMS];
+  const Tensor first = tensor_window_view(t, dim, 0, count, step, scratch[0]);
+  if(size == 1){
+    tensor_loop_apply(2, (Tensor[]){out_iter->t, first}, tensor_copy_kernel, nullptr);
+    tensor_iter_finish(out_iter);
+    return out_iter->t;
+  }
+  // First pass combines the first two positions, rest are folded into the output one by one
+  Tensor_Op_Ctx ctx = {.op = op, .builtin = f32_builtin_op_of(op)};
+  Tensor_Loop_Kernel* kernel = ((ctx.builtin == F32_OP_CUSTOM) ?
+				tensor_binop_kernel : tensor_builtin_binop_kernel);
+  Tensor next = tensor_window_view(t, dim, 1, count, step, scratch[1]);
+  tensor_loop_apply(3, (Tensor[]){out_iter->t, first, next}, kernel, &ctx);
+  for_range(uptr, k, 2, size){
+    next = tensor_window_view(t, dim, k, count, step, scratch[1]);
+    tensor_loop_apply(3, (Tensor[]){out_iter->t, out_iter->t, next}, kernel, &ctx);
+  }
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+// Not to be used directly, just a helper fxn
+// Allocates the output of pooling along 'dim'
+static Tensor tensor_pool_alloc(Alloc_Interface allocr, Tensor t, uptr dim, uptr size, uptr step){
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  for_slice(tensor_shape(t), i) shape[i] = tensor_shape(t).data[i];
+  shape[dim] = tensor_window_count(t, dim, size, step);
+  return tensor_alloc_dtype_(allocr, t.dtype, init_uptr_slice(shape, t.ndim));
+}
+
+Tensor tensor_pool_op_new(Alloc_Interface allocr, Tensor t, uptr dim, uptr size, uptr step, f32_binop* op){
+  Tensor ans = tensor_pool_alloc(allocr, t, dim, size, step);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_pool_op(&iter, t, dim, size, step, op);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+Tensor tensor_avg_pool_inp(Tensor_Iter* out_iter, Tensor t, uptr dim, uptr size, uptr step){
+  (void)tensor_pool_op(out_iter, t, dim, size, step, f32_add_op);
+  return tensor_vprod(out_iter, 1.f / (f32)size, out_iter->t);
+}
+
+Tensor tensor_avg_pool_new(Alloc_Interface allocr, Tensor t, uptr dim, uptr size, uptr step){
+  Tensor ans = tensor_pool_alloc(allocr, t, dim, size, step);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_avg_pool(&iter, t, dim, size, step);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// 2d pooling is done as the pass along the last dim, then the pass along the one before
+Tensor tensor_pool2d_op_inp(Tensor_Iter* out_iter, Tensor t, uptr size_h, uptr size_w,
+			    uptr step_h, uptr step_w, f32_binop* op){
+  assert(((void)"2d pooling needs at least 2 dimensions", t.ndim >= 2));
+  const Alloc_Interface scratch = gen_std_allocator();
+  Tensor rows = tensor_pool_op(scratch, t, t.ndim - 1, size_w, step_w, op);
+  (void)tensor_pool_op(out_iter, rows, t.ndim - 2, size_h, step_h, op);
+  tensor_free(scratch, &rows);
+  return out_iter->t;
+}
+
+Tensor tensor_pool2d_op_new(Alloc_Interface allocr, Tensor t, uptr size_h, uptr size_w,
+			    uptr step_h, uptr step_w, f32_binop* op){
+  assert(((void)"2d pooling needs at least 2 dimensions", t.ndim >= 2));
+  Tensor rows = tensor_pool_op(allocr, t, t.ndim - 1, size_w, step_w, op);
+  Tensor ans = tensor_pool_op(allocr, rows, t.ndim - 2, size_h, step_h, op);
+  tensor_free(allocr, &rows);
+  return ans;
+}
+
+Tensor tensor_avg_pool2d_inp(Tensor_Iter* out_iter, Tensor t, uptr size_h, uptr size_w,
+			     uptr step_h, uptr step_w){
+  (void)tensor_pool2d_op(out_iter, t, size_h, size_w, step_h, step_w, f32_add_op);
+  return tensor_vprod(out_iter, 1.f / (f32)(size_h * size_w), out_iter->t);
+}
+
+Tensor tensor_avg_pool2d_new(Alloc_Interface allocr, Tensor t, uptr size_h, uptr size_w,
+			     uptr step_h, uptr step_w){
+  Tensor ans = tensor_pool2d_op(allocr, t, size_h, size_w, step_h, step_w, f32_add_op);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_vprod(&iter, 1.f / (f32)(size_h * size_w), ans);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Rolling sums
+//   Each line along 'dim' is scanned once, every window sum is the previous one plus the
+//   element entering and minus the one leaving, kept in f64 so the error doesnt build up.
+//   The lines are walked by a 'Tensor_Loop' over the other dimensions, and blocks of
+//   neighbouring lines are scanned side by side so that their reads stay close together.
+#define TENSOR_ROLL_BLOCK 64
+
+typedef struct Tensor_Roll_Ctx Tensor_Roll_Ctx;
+struct Tensor_Roll_Ctx {
+  uptr len;
+  uptr window;
+  // Strides along the rolled dimension
+  iptr in_stride;
+  iptr out_stride;
+  // 1 for sums, 1 / window for means
+  f64 scale;
+};
+
+// out[i] = scale * (in[i] + ... + in[i + window - 1]) along each of the 'n' lines
+static void tensor_roll_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Roll_Ctx* c = ctx;
+  const uptr count = c->len - c->window + 1;
+  f64 acc[TENSOR_ROLL_BLOCK];
+  for(uptr j0 = 0; j0 < n; j0 += TENSOR_ROLL_BLOCK){
+    const uptr m = ((n - j0) < TENSOR_ROLL_BLOCK) ? (n - j0) : TENSOR_ROLL_BLOCK;
+    f32* out = p[0] + (iptr)j0 * s[0];
+    const f32* in = p[1] + (iptr)j0 * s[1];
+    for_range(uptr, j, 0, m) acc[j] = 0.0;
+    for_range(uptr, w, 0, c->window){
+      const f32* x = in + (iptr)w * c->in_stride;
+      for_range(uptr, j, 0, m) acc[j] += x[(iptr)j * s[1]];
+    }
+    for_range(uptr, j, 0, m) out[(iptr)j * s[0]] = (f32)(acc[j] * c->scale);
+    for_range(uptr, i, 1, count){
+      const f32* enter = in + (iptr)(i + c->window - 1) * c->in_stride;
+      const f32* leave = in + (iptr)(i - 1) * c->in_stride;
+      f32* o = out + (iptr)i * c->out_stride;
+      for_range(uptr, j, 0, m){
+	acc[j] += (f64)enter[(iptr)j * s[1]] - (f64)leave[(iptr)j * s[1]];
+	o[(iptr)j * s[0]] = (f32)(acc[j] * c->scale);
+      }
+    }
+  }
+}
+
+// Not to be used directly, just a helper fxn
+// View of 't' with 'dim' removed, 'scratch' is as in 'tensor_temp_view'
+static Tensor tensor_without_dim(Tensor t, uptr dim, uptr scratch[]){
+  Tensor v = tensor_temp_view(t.storage, t.offset, t.ndim - 1, scratch);
+  v.dtype = t.dtype;
+  for_slice(tensor_shape(v), i){
+    const uptr j = (i < dim) ? i : (i + 1);
+    tensor_shape(v).data[i] = tensor_shape(t).data[j];
+    tensor_stride(v).data[i] = tensor_stride(t).data[j];
+  }
+  return v;
+}
+
+// Not to be used directly, just a helper fxn
+static Tensor tensor_rolling_run(Tensor_Iter* out_iter, Tensor t, uptr dim, uptr window, f64 scale){
+  tensor_iter_make_writable(out_iter);
+  tensor_assert_f32(t);
+  tensor_assert_f32(out_iter->t);
+  const uptr count = tensor_window_count(t, dim, window, 1);
+  tensor_pool_check(out_iter->t, t, dim, count);
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  tensor_assert_view_in_storage(t);
+  tensor_assert_view_in_storage(out_iter->t);
+
+  uptr in_scratch[2 * TENSOR_LOOP_MAX_DIMS], out_scratch[2 * TENSOR_LOOP_MAX_DIMS];
+  Tensor_Roll_Ctx ctx = {
+    .len = tensor_shape(t).data[dim],
+    .window = window,
+    .in_stride = tensor_stride(t).data[dim],
+    .out_stride = tensor_stride(out_iter->t).data[dim],
+    .scale = scale,
+  };
+  Tensor_Loop loop;
+  const uptr lines = tensor_loop_init(&loop, 2, (Tensor[]){tensor_without_dim(out_iter->t, dim, out_scratch),
+							   tensor_without_dim(t, dim, in_scratch)});
+  tensor_loop_run_all(&loop, lines, ctx.len, tensor_roll_kernel, &ctx);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+Tensor tensor_rolling_sum_inp(Tensor_Iter* out_iter, Tensor t, uptr dim, uptr window){
+  return tensor_rolling_run(out_iter, t, dim, window, 1.0);
+}
+
+Tensor tensor_rolling_sum_new(Alloc_Interface allocr, Tensor t, uptr dim, uptr window){
+  Tensor ans = tensor_pool_alloc(allocr, t, dim, window, 1);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_rolling_sum(&iter, t, dim, window);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+Tensor tensor_rolling_mean_inp(Tensor_Iter* out_iter, Tensor t, uptr dim, uptr window){
+  return tensor_rolling_run(out_iter, t, dim, window, 1.0 / (f64)window);
+}
+
+Tensor tensor_rolling_mean_new(Alloc_Interface allocr, Tensor t, uptr dim, uptr window){
+  Tensor ans = tensor_pool_alloc(allocr, t, dim, window, 1);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_rolling_mean(&iter, t, dim, window);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Softmax
+//   Each line along 'dim' is read once for its max, then once more for the sum of the
+//   exponentials of (x - max), which softmax also stores and scales in place while they are
+//   still in cache. Lines that are contiguous are vectorized along themselves, lines side by
+//   side in memory (a dim that is not the innermost) are done TENSOR_SOFTMAX_BLOCK at a time
+//   with the elementwise kernels across them, anything else falls back to scalar loops.
+//   The lines are split across threads by the loop engine.
+#define TENSOR_SOFTMAX_BLOCK 64
+
+// exp(x) (cephes expf), exactly 0 below the smallest normal result, so that -inf gives 0
+static inline f32 tensor_exp(f32 x){
+  if(!(x >= -87.33654f)) return (x != x) ? x : 0.f;
+  if(x > 88.37626f) x = 88.37626f;
+  const f32 kf = (f32)(int32_t)(x * 1.44269504f + ((x < 0.f) ? -0.5f : 0.5f));
+  const f32 r = x - kf * 0.693359375f + kf * 2.12194440e-4f;
+  f32 p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  const uint32_t bits = (uint32_t)((int32_t)kf + 127) << 23;
+  f32 scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return (p * r * r + r + 1.f) * scale;
+}
+
+// out[i] = exp(x[i] - shift) if 'out' is not null, returns their sum
+typedef f32 Tensor_Exp_Sum_Fn(uptr n, f32* out, const f32* x, f32 shift);
+// out[i] = exp(x[i] - shift[i])
+typedef void Tensor_Exp_Sub_Fn(uptr n, f32* out, const f32* x, const f32* shift);
+
+static f32 tensor_exp_sum_plain(uptr n, f32* out, const f32* x, f32 shift){
+  f32 sum = 0.f;
+  for_range(uptr, i, 0, n){
+    const f32 e = tensor_exp(x[i] - shift);
+    if(out != nullptr) out[i] = e;
+    sum += e;
+  }
+  return sum;
+}
+
+static void tensor_exp_sub_plain(uptr n, f32* out, const f32* x, const f32* shift){
+  for_range(uptr, i, 0, n) out[i] = tensor_exp(x[i] - shift[i]);
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+__attribute__((target("avx2,fma")))
+static inline __m256 tensor_exp_avx2(__m256 x){
+  const __m256 lo = _mm256_set1_ps(-87.33654f);
+  const __m256 zero = _mm256_cmp_ps(x, lo, _CMP_LT_OQ);
+  // NaNs pass through the min and max as the second operand
+  x = _mm256_max_ps(lo, _mm256_min_ps(_mm256_set1_ps(88.37626f), x));
+  const __m256 kf = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)),
+				    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(kf, _mm256_set1_ps(0.693359375f), x);
+  r = _mm256_fmadd_ps(kf, _mm256_set1_ps(2.12194440e-4f), r);
+  __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+  const __m256 y = _mm256_add_ps(_mm256_fmadd_ps(_mm256_mul_ps(p, r), r, r), _mm256_set1_ps(1.f));
+  const __m256i k = _mm256_add_epi32(_mm256_cvtps_epi32(kf), _mm256_set1_epi32(127));
+  return _mm256_andnot_ps(zero, _mm256_mul_ps(y, _mm256_castsi256_ps(_mm256_slli_epi32(k, 23))));
+}
+
+__attribute__((target("avx2,fma")))
+static f32 tensor_exp_sum_avx2(uptr n, f32* out, const f32* x, f32 shift){
+  const __m256 vs = _mm256_set1_ps(shift);
+  __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+  uptr i = 0;
+  for(; i + 16 <= n; i += 16){
+    const __m256 e0 = tensor_exp_avx2(_mm256_sub_ps(_mm256_loadu_ps(x + i), vs));
+    const __m256 e1 = tensor_exp_avx2(_mm256_sub_ps(_mm256_loadu_ps(x + i + 8), vs));
+    if(out != nullptr){
+      _mm256_storeu_ps(out + i, e0);
+      _mm256_storeu_ps(out + i + 8, e1);
+    }
+    a0 = _mm256_add_ps(a0, e0);
+    a1 = _mm256_add_ps(a1, e1);
+  }
+  for(; i < n; i += 8){
+    // Masked lanes are neither read nor written, and are zeroed before the sum
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(((n - i) < 8) ? (n - i) : 8)),
+					    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256 e = _mm256_and_ps(_mm256_castsi256_ps(mask),
+				   tensor_exp_avx2(_mm256_sub_ps(_mm256_maskload_ps(x + i, mask), vs)));
+    if(out != nullptr) _mm256_maskstore_ps(out + i, mask, e);
+    a0 = _mm256_add_ps(a0, e);
+  }
+  f32 lanes[8];
+  _mm256_storeu_ps(lanes, _mm256_add_ps(a0, a1));
+  return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+__attribute__((target("avx2,fma")))
+static void tensor_exp_sub_avx2(uptr n, f32* out, const f32* x, const f32* shift){
+  uptr i = 0;
+  for(; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(out + i, tensor_exp_avx2(_mm256_sub_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(shift + i))));
+  for(; i < n; ++i) out[i] = tensor_exp(x[i] - shift[i]);
+}
+#endif
+
+typedef enum Tensor_Softmax_Kind Tensor_Softmax_Kind;
+enum Tensor_Softmax_Kind {
+  TENSOR_SOFTMAX,
+  TENSOR_LOG_SOFTMAX,
+  TENSOR_LOGSUMEXP,
+};
+
+typedef struct Tensor_Softmax_Ctx Tensor_Softmax_Ctx;
+struct Tensor_Softmax_Ctx {
+  Tensor_Softmax_Kind kind;
+  uptr len;
+  // Strides along the dimension, the output one is unused for logsumexp
+  iptr in_stride;
+  iptr out_stride;
+  const F32_Simd_Table* table;
+  Tensor_Exp_Sum_Fn* exp_sum;
+  Tensor_Exp_Sub_Fn* exp_sub;
+};
+
+// Not to be used directly, just a helper fxn
+// Scalar version for any strides, one line at a time
+static void tensor_softmax_line(const Tensor_Softmax_Ctx* c, f32* out, const f32* x){
+  f32 m = x[0];
+  for_range(uptr, k, 1, c->len) m = f32_max_inl(m, x[(iptr)k * c->in_stride]);
+  f32 sum = 0.f;
+  for_range(uptr, k, 0, c->len){
+    const f32 e = tensor_exp(x[(iptr)k * c->in_stride] - m);
+    if(c->kind == TENSOR_SOFTMAX) out[(iptr)k * c->out_stride] = e;
+    sum += e;
+  }
+  if(c->kind == TENSOR_LOGSUMEXP){
+    *out = m + tensor_rng_log(sum);
+  } else if(c->kind == TENSOR_LOG_SOFTMAX){
+    const f32 ls = tensor_rng_log(sum);
+    for_range(uptr, k, 0, c->len) out[(iptr)k * c->out_stride] = (x[(iptr)k * c->in_stride] - m) - ls;
+  } else {
+    const f32 inv = 1.f / sum;
+    for_range(uptr, k, 0, c->len) out[(iptr)k * c->out_stride] *= inv;
+  }
+}
+
+// p[0] and p[1] point at the start of 'n' lines of the output and the input
+static void tensor_softmax_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Softmax_Ctx* c = ctx;
+  const F32_Simd_Table* tb = c->table;
+  const bool whole = (c->kind == TENSOR_LOGSUMEXP);
+  if(c->in_stride == 1 && (whole || c->out_stride == 1)){
+    for_range(uptr, j, 0, n){
+      f32* out = p[0] + (iptr)j * s[0];
+      const f32* x = p[1] + (iptr)j * s[1];
+      const f32 m = tb->red[F32_OP_MAX](c->len, x);
+      const f32 sum = c->exp_sum(c->len, (c->kind == TENSOR_SOFTMAX) ? out : nullptr, x, m);
+      if(c->kind == TENSOR_SOFTMAX) tb->vec[F32_OP_PROD](c->len, out, 1.f / sum, out);
+      else if(c->kind == TENSOR_LOG_SOFTMAX){
+	// (x - max) - log(sum), as subtracting their sum would round to the size of x
+	tb->vec[F32_OP_ADD](c->len, out, -m, x);
+	tb->vec[F32_OP_ADD](c->len, out, -tensor_rng_log(sum), out);
+      } else {
+	*out = m + tensor_rng_log(sum);
+      }
+    }
+    return;
+  }
+  if(s[1] != 1 || (!whole && s[0] != 1)){
+    for_range(uptr, j, 0, n) tensor_softmax_line(c, p[0] + (iptr)j * s[0], p[1] + (iptr)j * s[1]);
+    return;
+  }
+  // Lines next to each other, every step along the dim is a contiguous row of them
+  f32 m[TENSOR_SOFTMAX_BLOCK], sum[TENSOR_SOFTMAX_BLOCK], tmp[TENSOR_SOFTMAX_BLOCK];
+  for(uptr j0 = 0; j0 < n; j0 += TENSOR_SOFTMAX_BLOCK){
+    const uptr b = ((n - j0) < TENSOR_SOFTMAX_BLOCK) ? (n - j0) : TENSOR_SOFTMAX_BLOCK;
+    f32* out = p[0] + (iptr)j0 * (whole ? s[0] : 1);
+    const f32* x = p[1] + j0;
+    memcpy(m, x, b * sizeof(f32));
+    for_range(uptr, k, 1, c->len) tb->bin[F32_OP_MAX](b, m, m, x + (iptr)k * c->in_stride);
+    memset(sum, 0, b * sizeof(f32));
+    for_range(uptr, k, 0, c->len){
+      f32* e = (c->kind == TENSOR_SOFTMAX) ? (out + (iptr)k * c->out_stride) : tmp;
+      c->exp_sub(b, e, x + (iptr)k * c->in_stride, m);
+      tb->bin[F32_OP_ADD](b, sum, sum, e);
+    }
+    if(c->kind == TENSOR_SOFTMAX){
+      for_range(uptr, j, 0, b) sum[j] = 1.f / sum[j];
+      for_range(uptr, k, 0, c->len){
+	f32* o = out + (iptr)k * c->out_stride;
+	tb->bin[F32_OP_PROD](b, o, o, sum);
+      }
+    } else if(c->kind == TENSOR_LOG_SOFTMAX){
+      for_range(uptr, j, 0, b){
+	m[j] = -m[j];
+	sum[j] = -tensor_rng_log(sum[j]);
+      }
+      for_range(uptr, k, 0, c->len){
+	f32* o = out + (iptr)k * c->out_stride;
+	tb->bin[F32_OP_ADD](b, o, x + (iptr)k * c->in_stride, m);
+	tb->bin[F32_OP_ADD](b, o, o, sum);
+      }
+    } else {
+      for_range(uptr, j, 0, b) out[(iptr)j * s[0]] = m[j] + tensor_rng_log(sum[j]);
+    }
+  }
+}
+
+// Not to be used directly, just a helper fxn
+// 'out' is shaped like 't', or like 't' without 'dim' for logsumexp
+static Tensor tensor_softmax_run(Tensor_Iter* out_iter, Tensor t, uptr dim, Tensor_Softmax_Kind kind){
+  tensor_iter_make_writable(out_iter);
+  tensor_assert_f32(t);
+  tensor_assert_f32(out_iter->t);
+  const Tensor out = out_iter->t;
+  assert(((void)"The dim to work on should exist in input tensor", dim < t.ndim));
+  assert(((void)"The input must have non-zero length along the chosen dim", tensor_shape(t).data[dim] > 0));
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  if(kind == TENSOR_LOGSUMEXP){
+    assert(((void)"The output tensor's dimension count should be 1 less than input", out.ndim + 1 == t.ndim));
+    for_slice(tensor_shape(out), i){
+      assert(((void)"The dimension of output must match input except for the chosen dimension to work on",
+	      tensor_shape(out).data[i] == tensor_shape(t).data[(i < dim) ? i : (i + 1)]));
+    }
+  } else {
+    tensor_pool_check(out, t, dim, tensor_shape(t).data[dim]);
+  }
+  tensor_assert_view_in_storage(t);
+  tensor_assert_view_in_storage(out);
+
+  Tensor_Softmax_Ctx ctx = {
+    .kind = kind,
+    .len = tensor_shape(t).data[dim],
+    .in_stride = tensor_stride(t).data[dim],
+    .out_stride = (kind == TENSOR_LOGSUMEXP) ? 0 : tensor_stride(out).data[dim],
+    .table = f32_simd_table(),
+    .exp_sum = tensor_exp_sum_plain,
+    .exp_sub = tensor_exp_sub_plain,
+  };
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+    ctx.exp_sum = tensor_exp_sum_avx2;
+    ctx.exp_sub = tensor_exp_sub_avx2;
+  }
+#endif
+  uptr in_scratch[2 * TENSOR_LOOP_MAX_DIMS], out_scratch[2 * TENSOR_LOOP_MAX_DIMS];
+  Tensor_Loop loop;
+  const uptr lines = tensor_loop_init(&loop, 2, (Tensor[]){
+      (kind == TENSOR_LOGSUMEXP) ? out : tensor_without_dim(out, dim, out_scratch),
+      tensor_without_dim(t, dim, in_scratch)});
+  // An exponential is worth about 8 elementwise ops
+  tensor_loop_run_all(&loop, lines, 8 * ctx.len, tensor_softmax_kernel, &ctx);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+Tensor tensor_softmax_inp(Tensor_Iter* out_iter, Tensor t, uptr dim){
+  return tensor_softmax_run(out_iter, t, dim, TENSOR_SOFTMAX);
+}
+
+Tensor tensor_softmax_new(Alloc_Interface allocr, Tensor t, uptr dim){
+  Tensor ans = tensor_alloc_(allocr, tensor_shape(t));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_softmax_inp(&iter, t, dim);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+Tensor tensor_log_softmax_inp(Tensor_Iter* out_iter, Tensor t, uptr dim){
+  return tensor_softmax_run(out_iter, t, dim, TENSOR_LOG_SOFTMAX);
+}
+
+Tensor tensor_log_softmax_new(Alloc_Interface allocr, Tensor t, uptr dim){
+  Tensor ans = tensor_alloc_(allocr, tensor_shape(t));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_log_softmax_inp(&iter, t, dim);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+Tensor tensor_logsumexp_inp(Tensor_Iter* out_iter, Tensor t, uptr dim){
+  return tensor_softmax_run(out_iter, t, dim, TENSOR_LOGSUMEXP);
+}
+
+Tensor tensor_logsumexp_new(Alloc_Interface allocr, Tensor t, uptr dim){
+  assert(((void)"The dim to work on should exist in input tensor", dim < t.ndim));
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  for_range(uptr, i, 0, t.ndim - 1) shape[i] = tensor_shape(t).data[(i < dim) ? i : (i + 1)];
+  Tensor ans = tensor_alloc_(allocr, init_uptr_slice(shape, t.ndim - 1));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_logsumexp_inp(&iter, t, dim);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Matrix multiplication
+//   Blocked GEMM in the usual way: for each KC deep slab of the K dimension, A is
+//   packed into MR row panels and B into NR column panels (reading any strides, so
+//   permuted and sliced views need no copy), then a register blocked microkernel
+//   computes MR x NR tiles of C. Tiles of MC rows x TENSOR_GEMM_NT columns are
+//   split across threads, packed panels are shared between them.
+#define TENSOR_GEMM_KC 256
+#define TENSOR_GEMM_MC 96
+#define TENSOR_GEMM_NC 3072
+#define TENSOR_GEMM_NT 256
+#define TENSOR_GEMM_MAX_MR 8
+#define TENSOR_GEMM_MAX_NR 32
+// Below this many multiply-adds packing is not worth it
+#define TENSOR_GEMM_SMALL (32 * 32 * 32)
+
+// Computes c[MR*NR] (row major) = A panel times B panel over kc
+typedef void Tensor_Gemm_Micro(uptr kc, const f32* ap, const f32* bp, f32* c);
+
+typedef struct Tensor_Gemm_Kernel Tensor_Gemm_Kernel;
+struct Tensor_Gemm_Kernel {
+  uptr mr;
+  uptr nr;
+  Tensor_Gemm_Micro* fn;
+};
+
+static void tensor_gemm_micro_plain(uptr kc, const f32* ap, const f32* bp, f32* c){
+  f32 acc[4][8] = {0};
+  for_range(uptr, k, 0, kc){
+    for_range(uptr, r, 0, 4){
+      const f32 a = ap[k*4 + r];
+      for_range(uptr, j, 0, 8) acc[r][j] += a * bp[k*8 + j];
+    }
+  }
+  memcpy(c, acc, sizeof(acc));
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+// 6 x 16 tile, 12 ymm accumulators
+__attribute__((target("avx2,fma")))
+static void tensor_gemm_micro_avx2(uptr kc, const f32* ap, const f32* bp, f32* c){
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+  for_range(uptr, k, 0, kc){
+    const __m256 b0 = _mm256_loadu_ps(bp + k*16);
+    const __m256 b1 = _mm256_loadu_ps(bp + k*16 + 8);
+    const f32* a = ap + k*6;
+    __m256 av;
+    av = _mm256_broadcast_ss(a + 0); c00 = _mm256_fmadd_ps(av, b0, c00); c01 = _mm256_fmadd_ps(av, b1, c01);
+    av = _mm256_broadcast_ss(a + 1); c10 = _mm256_fmadd_ps(av, b0, c10); c11 = _mm256_fmadd_ps(av, b1, c11);
+    av = _mm256_broadcast_ss(a + 2); c20 = _mm256_fmadd_ps(av, b0, c20); c21 = _mm256_fmadd_ps(av, b1, c21);
+    av = _mm256_broadcast_ss(a + 3); c30 = _mm256_fmadd_ps(av, b0, c30); c31 = _mm256_fmadd_ps(av, b1, c31);
+    av = _mm256_broadcast_ss(a + 4); c40 = _mm256_fmadd_ps(av, b0, c40); c41 = _mm256_fmadd_ps(av, b1, c41);
+    av = _mm256_broadcast_ss(a + 5); c50 = _mm256_fmadd_ps(av, b0, c50); c51 = _mm256_fmadd_ps(av, b1, c51);
+  }
+  _mm256_storeu_ps(c + 0*16, c00); _mm256_storeu_ps(c + 0*16 + 8, c01);
+  _mm256_storeu_ps(c + 1*16, c10); _mm256_storeu_ps(c + 1*16 + 8, c11);
+  _mm256_storeu_ps(c + 2*16, c20); _mm256_storeu_ps(c + 2*16 + 8, c21);
+  _mm256_storeu_ps(c + 3*16, c30); _mm256_storeu_ps(c + 3*16 + 8, c31);
+  _mm256_storeu_ps(c + 4*16, c40); _mm256_storeu_ps(c + 4*16 + 8, c41);
+  _mm256_storeu_ps(c + 5*16, c50); _mm256_storeu_ps(c + 5*16 + 8, c51);
+}
+
+// 6 x 32 tile, 12 zmm accumulators
+__attribute__((target("avx512f")))
+static void tensor_gemm_micro_avx512(uptr kc, const f32* ap, const f32* bp, f32* c){
+  __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+  __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+  __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+  __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+  __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+  __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+  for_range(uptr, k, 0, kc){
+    const __m512 b0 = _mm512_loadu_ps(bp + k*32);
+    const __m512 b1 = _mm512_loadu_ps(bp + k*32 + 16);
+    const f32* a = ap + k*6;
+    __m512 av;
+    av = _mm512_set1_ps(a[0]); c00 = _mm512_fmadd_ps(av, b0, c00); c01 = _mm512_fmadd_ps(av, b1, c01);
+    av = _mm512_set1_ps(a[1]); c10 = _mm512_fmadd_ps(av, b0, c10); c11 = _mm512_fmadd_ps(av, b1, c11);
+    av = _mm512_set1_ps(a[2]); c20 = _mm512_fmadd_ps(av, b0, c20); c21 = _mm512_fmadd_ps(av, b1, c21);
+    av = _mm512_set1_ps(a[3]); c30 = _mm512_fmadd_ps(av, b0, c30); c31 = _mm512_fmadd_ps(av, b1, c31);
+    av = _mm512_set1_ps(a[4]); c40 = _mm512_fmadd_ps(av, b0, c40); c41 = _mm512_fmadd_ps(av, b1, c41);
+    av = _mm512_set1_ps(a[5]); c50 = _mm512_fmadd_ps(av, b0, c50); c51 = _mm512_fmadd_ps(av, b1, c51);
+  }
+  _mm512_storeu_ps(c + 0*32, c00); _mm512_storeu_ps(c + 0*32 + 16, c01);
+  _mm512_storeu_ps(c + 1*32, c10); _mm512_storeu_ps(c + 1*32 + 16, c11);
+  _mm512_storeu_ps(c + 2*32, c20); _mm512_storeu_ps(c + 2*32 + 16, c21);
+  _mm512_storeu_ps(c + 3*32, c30); _mm512_storeu_ps(c + 3*32 + 16, c31);
+  _mm512_storeu_ps(c + 4*32, c40); _mm512_storeu_ps(c + 4*32 + 16, c41);
+  _mm512_storeu_ps(c + 5*32, c50); _mm512_storeu_ps(c + 5*32 + 16, c51);
+}
+#endif
+
+static Tensor_Gemm_Kernel tensor_gemm_kernel(void){
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx512f"))
+    return (Tensor_Gemm_Kernel){.mr = 6, .nr = 32, .fn = tensor_gemm_micro_avx512};
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return (Tensor_Gemm_Kernel){.mr = 6, .nr = 16, .fn = tensor_gemm_micro_avx2};
+#endif
+  return (Tensor_Gemm_Kernel){.mr = 4, .nr = 8, .fn = tensor_gemm_micro_plain};
+}
+
+// A single strided matrix, element (i, j) is at data[i*rs + j*cs]
+typedef struct Tensor_Mat Tensor_Mat;
+struct Tensor_Mat {
+  f32* data;
+  uptr rows;
+  uptr cols;
+  iptr rs;
+  iptr cs;
+};
+
+// Not to be used directly, just a helper fxn
+// Views the last two dims of 't' as a matrix, at index 0 of the other dims
+static Tensor_Mat tensor_mat_of(Tensor t){
+  const uptr n = t.ndim;
+  return (Tensor_Mat){
+    .data = tensor_base_ptr(t),
+    .rows = tensor_shape(t).data[n-2], .cols = tensor_shape(t).data[n-1],
+    .rs = tensor_stride(t).data[n-2], .cs = tensor_stride(t).data[n-1],
+  };
+}
+
+// C = A * B directly, for small sizes where packing does not pay off
+static void tensor_gemm_small(Tensor_Mat c, Tensor_Mat a, Tensor_Mat b){
+  const uptr m = c.rows, n = c.cols, kk = a.cols;
+  for_range(uptr, i, 0, m){
+    f32* crow = c.data + (iptr)i * c.rs;
+    for_range(uptr, j, 0, n) crow[(iptr)j * c.cs] = 0.f;
+    for_range(uptr, k, 0, kk){
+      const f32 av = a.data[(iptr)i * a.rs + (iptr)k * a.cs];
+      const f32* brow = b.data + (iptr)k * b.rs;
+      if(c.cs == 1 && b.cs == 1){
+	for_range(uptr, j, 0, n) crow[j] += av * brow[j];
+      } else {
+	for_range(uptr, j, 0, n) crow[(iptr)j * c.cs] += av * brow[(iptr)j * b.cs];
+      }
+    }
+  }
+}
+
+typedef struct Tensor_Gemm Tensor_Gemm;
+struct Tensor_Gemm {
+  Tensor_Gemm_Kernel kern;
+  Tensor_Mat a, b, c;
+  // Current block
+  uptr pc, kc, jc, nc;
+  bool accumulate;
+  f32* apack;
+  f32* bpack;
+  uptr m_tiles, n_tiles;
+};
+
+// Packs MR rows of A starting at row i0 (zero padded past the last row)
+static void tensor_gemm_pack_a_task(void* ctx, uptr panel){
+  const Tensor_Gemm* g = ctx;
+  const uptr mr = g->kern.mr;
+  const uptr i0 = panel * mr;
+  f32* dst = g->apack + panel * mr * g->kc;
+  const uptr rows = ((g->a.rows - i0) < mr) ? (g->a.rows - i0) : mr;
+  const f32* src = g->a.data + (iptr)i0 * g->a.rs + (iptr)g->pc * g->a.cs;
+  for_range(uptr, r, 0, rows){
+    const f32* s = src + (iptr)r * g->a.rs;
+    for_range(uptr, k, 0, g->kc) dst[k*mr + r] = s[(iptr)k * g->a.cs];
+  }
+  for_range(uptr, r, rows, mr){
+    for_range(uptr, k, 0, g->kc) dst[k*mr + r] = 0.f;
+  }
+}
+
+// Packs NR columns of B starting at column jc + j0 (zero padded)
+static void tensor_gemm_pack_b_task(void* ctx, uptr panel){
+  const Tensor_Gemm* g = ctx;
+  const uptr nr = g->kern.nr;
+  const uptr j0 = panel * nr;
+  f32* dst = g->bpack + panel * nr * g->kc;
+  const uptr cols = ((g->nc - j0) < nr) ? (g->nc - j0) : nr;
+  const f32* src = g->b.data + (iptr)g->pc * g->b.rs + (iptr)(g->jc + j0) * g->b.cs;
+  for_range(uptr, k, 0, g->kc){
+    const f32* s = src + (iptr)k * g->b.rs;
+    f32* d = dst + k*nr;
+    if(g->b.cs == 1 && cols == nr){
+      memcpy(d, s, nr * sizeof(f32));
+      continue;
+    }
+    for_range(uptr, j, 0, cols) d[j] = s[(iptr)j * g->b.cs];
+    for_range(uptr, j, cols, nr) d[j] = 0.f;
+  }
+}
+
+// Computes one MC x NT tile of C for the current block
+static void tensor_gemm_tile_task(void* ctx, uptr tile){
+  const Tensor_Gemm* g = ctx;
+  const uptr mr = g->kern.mr, nr = g->kern.nr;
+  const uptr ti = tile / g->n_tiles, tj = tile % g->n_tiles;
+  const uptr i_begin = ti * TENSOR_GEMM_MC;
+  const uptr i_end = ((i_begin + TENSOR_GEMM_MC) < g->c.rows) ? (i_begin + TENSOR_GEMM_MC) : g->c.rows;
+  const uptr j_begin = tj * TENSOR_GEMM_NT;
+  const uptr j_end = ((j_begin + TENSOR_GEMM_NT) < g->nc) ? (j_begin + TENSOR_GEMM_NT) : g->nc;
+
+  f32 tmp[TENSOR_GEMM_MAX_MR * TENSOR_GEMM_MAX_NR];
+  for(uptr j = j_begin; j < j_end; j += nr){
+    const f32* bp = g->bpack + (j / nr) * nr * g->kc;
+    const uptr cols = ((j_end - j) < nr) ? (j_end - j) : nr;
+    for(uptr i = i_begin; i < i_end; i += mr){
+      const f32* ap = g->apack + (i / mr) * mr * g->kc;
+      const uptr rows = ((i_end - i) < mr) ? (i_end - i) : mr;
+      g->kern.fn(g->kc, ap, bp, tmp);
+      f32* c = g->c.data + (iptr)i * g->c.rs + (iptr)(g->jc + j) * g->c.cs;
+      for_range(uptr, r, 0, rows){
+	f32* crow = c + (iptr)r * g->c.rs;
+	const f32* trow = tmp + r * nr;
+	if(g->c.cs == 1){
+	  if(g->accumulate) for_range(uptr, q, 0, cols) crow[q] += trow[q];
+	  else for_range(uptr, q, 0, cols) crow[q] = trow[q];
+	} else {
+	  if(g->accumulate) for_range(uptr, q, 0, cols) crow[(iptr)q * g->c.cs] += trow[q];
+	  else for_range(uptr, q, 0, cols) crow[(iptr)q * g->c.cs] = trow[q];
+	}
+      }
+    }
+  }
+}
+
+// Sizes of the packing buffers 'tensor_gemm_run' needs
+static uptr tensor_gemm_apack_count(Tensor_Gemm_Kernel kern, uptr m, uptr k){
+  const uptr kc = (k < TENSOR_GEMM_KC) ? k : TENSOR_GEMM_KC;
+  return ((m + kern.mr - 1) / kern.mr) * kern.mr * kc;
+}
+static uptr tensor_gemm_bpack_count(Tensor_Gemm_Kernel kern, uptr n, uptr k){
+  const uptr kc = (k < TENSOR_GEMM_KC) ? k : TENSOR_GEMM_KC;
+  const uptr nc = (n < TENSOR_GEMM_NC) ? n : TENSOR_GEMM_NC;
+  return ((nc + kern.nr - 1) / kern.nr) * kern.nr * kc;
+}
+
+// C = A * B through the packed path, with caller provided packing buffers
+static void tensor_gemm_run(Tensor_Gemm_Kernel kern, Tensor_Mat c, Tensor_Mat a, Tensor_Mat b,
+			    f32* apack, f32* bpack){
+  const uptr m = c.rows, n = c.cols, kk = a.cols;
+  Tensor_Gemm g = {.kern = kern, .a = a, .b = b, .c = c, .apack = apack, .bpack = bpack};
+  const uptr mr = g.kern.mr, nr = g.kern.nr;
+  const uptr m_panels = (m + mr - 1) / mr;
+  g.m_tiles = (m + TENSOR_GEMM_MC - 1) / TENSOR_GEMM_MC;
+
+  for(uptr pc = 0; pc < kk; pc += TENSOR_GEMM_KC){
+    g.pc = pc;
+    g.kc = ((kk - pc) < TENSOR_GEMM_KC) ? (kk - pc) : TENSOR_GEMM_KC;
+    g.accumulate = (pc > 0);
+    tensor_parallel_for_work(m_panels, m * g.kc, tensor_gemm_pack_a_task, &g);
+    for(uptr jc = 0; jc < n; jc += TENSOR_GEMM_NC){
+      g.jc = jc;
+      g.nc = ((n - jc) < TENSOR_GEMM_NC) ? (n - jc) : TENSOR_GEMM_NC;
+      g.n_tiles = (g.nc + TENSOR_GEMM_NT - 1) / TENSOR_GEMM_NT;
+      tensor_parallel_for_work((g.nc + nr - 1) / nr, g.nc * g.kc, tensor_gemm_pack_b_task, &g);
+      tensor_parallel_for_work(g.m_tiles * g.n_tiles, m * g.nc * g.kc, tensor_gemm_tile_task, &g);
+    }
+  }
+}
+
+static bool tensor_gemm_is_small(uptr m, uptr n, uptr k){
+  return (k == 0 || m * n * k <= TENSOR_GEMM_SMALL);
+}
+
+// C = A * B, scratch space for the packed panels comes from 'allocr'
+static void tensor_gemm(Alloc_Interface allocr, Tensor_Mat c, Tensor_Mat a, Tensor_Mat b){
+  const uptr m = c.rows, n = c.cols, kk = a.cols;
+  if(m == 0 || n == 0) return;
+  if(tensor_gemm_is_small(m, n, kk)){
+    tensor_gemm_small(c, a, b);
+    return;
+  }
+  const Tensor_Gemm_Kernel kern = tensor_gemm_kernel();
+  f32_Slice apack = SLICE_ALLOC(allocr, f32, tensor_gemm_apack_count(kern, m, kk));
+  f32_Slice bpack = SLICE_ALLOC(allocr, f32, tensor_gemm_bpack_count(kern, n, kk));
+  MEMCHK(apack.data);
+  MEMCHK(bpack.data);
+  tensor_gemm_run(kern, c, a, b, apack.data, bpack.data);
+  SLICE_FREE(allocr, bpack);
+  SLICE_FREE(allocr, apack);
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_matmul_check(Tensor out, Tensor a, Tensor b){
+  assert(((void)"Matrix multiplication needs 2 dimensional tensors",
+	  a.ndim == 2 && b.ndim == 2));
+  assert(((void)"Inner dimensions of the matrices must match",
+	  slice_inx(tensor_shape(a), 1) == slice_inx(tensor_shape(b), 0)));
+  assert(((void)"The output tensor must be of shape (rows of a, cols of b)",
+	  out.ndim == 2 && slice_inx(tensor_shape(out), 0) == slice_inx(tensor_shape(a), 0) &&
+	  slice_inx(tensor_shape(out), 1) == slice_inx(tensor_shape(b), 1)));
+  tensor_assert_view_in_storage(a);
+  tensor_assert_view_in_storage(b);
+  tensor_assert_view_in_storage(out);
+  (void)out, (void)a, (void)b;
+}
+
+Tensor tensor_matmul_inp(Tensor_Iter* out_iter, Tensor a, Tensor b){
+  tensor_iter_make_writable(out_iter);
+  tensor_matmul_check(out_iter->t, a, b);
+  tensor_gemm(gen_std_allocator(), tensor_mat_of(out_iter->t),
+	      tensor_mat_of(a), tensor_mat_of(b));
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+Tensor tensor_matmul_new(Alloc_Interface allocr, Tensor a, Tensor b){
+  assert(((void)"Matrix multiplication needs 2 dimensional tensors",
+	  a.ndim == 2 && b.ndim == 2));
+  Tensor ans = tensor_alloc(allocr, slice_inx(tensor_shape(a), 0), slice_inx(tensor_shape(b), 1));
+  tensor_matmul_check(ans, a, b);
+  tensor_gemm(allocr, tensor_mat_of(ans), tensor_mat_of(a), tensor_mat_of(b));
+  return ans;
+}
+
+// Batched matrix multiplication
+//   The leading (batch) dimensions of the three operands are walked by a 'Tensor_Loop'
+//   built over views of just those dimensions, so any strides (and broadcasting) work.
+//   With enough batches, whole batches are split across threads and every product runs
+//   serially inside its task; otherwise batches run one after another and each product
+//   is threaded internally. Small products skip packing altogether.
+typedef struct Tensor_Bmm Tensor_Bmm;
+struct Tensor_Bmm {
+  // Matrix parts, 'data' is replaced by the start of each batch
+  Tensor_Mat a, b, c;
+  Tensor_Gemm_Kernel kern;
+  bool small;
+};
+
+// Not to be used directly, just a helper fxn
+// View of just the leading dimensions, sharing the storage, 'scratch' is as in 'tensor_temp_view'
+static Tensor tensor_lead_view(Tensor t, uptr scratch[]){
+  Tensor lead = tensor_temp_view(t.storage, t.offset, t.ndim - 2, scratch);
+  for_range(uptr, i, 0, lead.ndim){
+    tensor_shape(lead).data[i] = tensor_shape(t).data[i];
+    tensor_stride(lead).data[i] = tensor_stride(t).data[i];
+  }
+  return lead;
+}
+
+static Tensor_Mat tensor_mat_at(Tensor_Mat m, f32* base){
+  m.data = base;
+  return m;
+}
+
+// Loop kernel, p[] point at the start of batches of c, a and b
+static void tensor_bmm_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Bmm* bm = ctx;
+  if(bm->c.rows == 0 || bm->c.cols == 0) return;
+  if(bm->small){
+    for_range(uptr, i, 0, n){
+      tensor_gemm_small(tensor_mat_at(bm->c, p[0] + (iptr)i * s[0]),
+			tensor_mat_at(bm->a, p[1] + (iptr)i * s[1]),
+			tensor_mat_at(bm->b, p[2] + (iptr)i * s[2]));
+    }
+    return;
+  }
+  // Packing buffers are reused for every batch of this run
+  const Alloc_Interface scratch = gen_std_allocator();
+  f32_Slice apack = SLICE_ALLOC(scratch, f32, tensor_gemm_apack_count(bm->kern, bm->c.rows, bm->a.cols));
+  f32_Slice bpack = SLICE_ALLOC(scratch, f32, tensor_gemm_bpack_count(bm->kern, bm->c.cols, bm->a.cols));
+  MEMCHK(apack.data);
+  MEMCHK(bpack.data);
+  for_range(uptr, i, 0, n){
+    tensor_gemm_run(bm->kern,
+		    tensor_mat_at(bm->c, p[0] + (iptr)i * s[0]),
+		    tensor_mat_at(bm->a, p[1] + (iptr)i * s[1]),
+		    tensor_mat_at(bm->b, p[2] + (iptr)i * s[2]),
+		    apack.data, bpack.data);
+  }
+  SLICE_FREE(scratch, bpack);
+  SLICE_FREE(scratch, apack);
+}
+
+Tensor tensor_bmm_inp(Tensor_Iter* out_iter, Tensor a, Tensor b){
+  tensor_iter_make_writable(out_iter);
+  const Tensor out = out_iter->t;
+  assert(((void)"Batched matrix multiplication needs at least 2 dimensional tensors",
+	  a.ndim >= 2 && b.ndim >= 2 && out.ndim >= 2));
+  const uptr m = slice_inx(tensor_shape(a), a.ndim - 2);
+  const uptr k = slice_inx(tensor_shape(a), a.ndim - 1);
+  const uptr n = slice_inx(tensor_shape(b), b.ndim - 1);
+  assert(((void)"Inner dimensions of the matrices must match",
+	  slice_inx(tensor_shape(b), b.ndim - 2) == k));
+  assert(((void)"The output tensor must end with (rows of a, cols of b)",
+	  slice_inx(tensor_shape(out), out.ndim - 2) == m &&
+	  slice_inx(tensor_shape(out), out.ndim - 1) == n));
+  tensor_assert_view_in_storage(a);
+  tensor_assert_view_in_storage(b);
+  tensor_assert_view_in_storage(out);
+
+  Tensor_Bmm bm = {
+    .a = tensor_mat_of(a), .b = tensor_mat_of(b), .c = tensor_mat_of(out),
+    .kern = tensor_gemm_kernel(),
+    .small = tensor_gemm_is_small(m, n, k),
+  };
+  // Leading dims of the inputs broadcast to the output's
+  Tensor_Loop loop;
+  uptr lead_dims[3][2 * TENSOR_LOOP_MAX_DIMS];
+  const uptr batches = tensor_loop_init(&loop, 3, (Tensor[]){tensor_lead_view(out, lead_dims[0]),
+      tensor_lead_view(a, lead_dims[1]), tensor_lead_view(b, lead_dims[2])});
+  const uptr cost = m * n * ((k > 0) ? k : 1);
+  if(batches >= tensor_get_num_threads()){
+    tensor_loop_run_all(&loop, batches, cost, tensor_bmm_kernel, &bm);
+  } else {
+    tensor_loop_run(&loop, 0, batches, tensor_bmm_kernel, &bm);
+  }
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+Tensor tensor_bmm_new(Alloc_Interface allocr, Tensor a, Tensor b){
+  assert(((void)"Batched matrix multiplication needs at least 2 dimensional tensors",
+	  a.ndim >= 2 && b.ndim >= 2));
+  uptr shape[TENSOR_LOOP_MAX_DIMS + 2];
+  const uptr lead = tensor_broadcast_shape_into(shape, tensor_broadcast_shape_into(shape, 0,
+      init_uptr_slice(tensor_shape(a).data, a.ndim - 2)), init_uptr_slice(tensor_shape(b).data, b.ndim - 2));
+  shape[lead] = slice_inx(tensor_shape(a), a.ndim - 2);
+  shape[lead + 1] = slice_inx(tensor_shape(b), b.ndim - 1);
+  Tensor ans = tensor_alloc_(allocr, init_uptr_slice(shape, lead + 2));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_bmm_inp(&iter, a, b);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Convolutions
+//   Inputs are (n, c_in, h, w) and weights (c_out, c_in / groups, kh, kw) in any layout, a
+//   channels last input is just a view whose channels have the smallest stride. 1d ones are
+//   run as 2d with h = 1. Wide enough convolutions are matrix products: for each image,
+//   group and block of output rows the input patches are gathered into a column matrix
+//   (im2col) and multiplied with the packed weights by the GEMM above. Patches are rows of
+//   that matrix when the channels are contiguous and columns otherwise, so the gather copies
+//   contiguous runs either way, and 1x1 convolutions without padding read the input as is.
+//   With too few channels per group for the GEMM to pay off (depthwise convolutions, single
+//   output channels) a direct kernel sums the taps of a row of outputs in registers instead,
+//   or of all the channels of a pixel for depthwise ones in channels last.
+// Elements of the column matrix per block, fewer rows are gathered at once above this
+#define TENSOR_CONV_COLS_MAX (1 << 20)
+// Direct kernel below this many output channels per group, or this many taps per output
+#define TENSOR_CONV_DIRECT_COUT 4
+#define TENSOR_CONV_DIRECT_TAPS 8
+// Output rows per task of the direct kernel
+#define TENSOR_CONV_DIRECT_ROWS 4
+
+typedef struct Tensor_Conv Tensor_Conv;
+struct Tensor_Conv {
+  f32* in;
+  f32* out;
+  // Strides of the (n, c, h, w) dimensions, h strides are 0 for 1d
+  iptr is[4];
+  iptr os[4];
+  uptr n, h, w, oh, ow;
+  uptr kh, kw, sh, sw, ph, pw, dh, dw;
+  uptr groups, cig, cog;
+  // Taps of each output, cig * kh * kw
+  uptr k;
+  bool channels_last;
+  // 1x1, no padding, the input itself is the column matrix
+  bool pointwise;
+  // k weights of every output channel, in the order of the columns (c, i, j), or (i, j, c)
+  //   when channels last
+  f32* wpack;
+  // Output rows gathered at once, and blocks of them per image
+  uptr rows, blocks;
+  // Work units (image, group, block) done by each task
+  uptr unit_chunk;
+  Tensor_Gemm_Kernel kern;
+};
+
+// Not to be used directly, just a helper fxn
+// Output length along a dimension, 'len' long with 'pad' zeros on both sides
+static uptr tensor_conv_out_len(uptr len, uptr ksize, uptr step, uptr pad, uptr dil){
+  assert(((void)"Convolution strides and dilations must be at least 1", step > 0 && dil > 0));
+  assert(((void)"Convolution kernel cannot be larger than the padded input",
+	  ksize > 0 && (ksize - 1) * dil + 1 <= len + 2 * pad));
+  return (len + 2 * pad - (ksize - 1) * dil - 1) / step + 1;
+}
+
+// Not to be used directly, just a helper fxn
+// Range [lo, hi) of outputs o whose input o * step + tap - pad is inside [0, in_count)
+static void tensor_conv_valid(uptr* lo, uptr* hi, uptr out_count, uptr in_count,
+			      uptr step, uptr pad, uptr tap){
+  uptr l = (pad > tap) ? (pad - tap + step - 1) / step : 0;
+  uptr h = (in_count + pad > tap) ? (in_count + pad - tap - 1) / step + 1 : 0;
+  if(h > out_count) h = out_count;
+  if(l > h) l = h;
+  *lo = l;
+  *hi = h;
+}
+
+// Gathering the patches of one block
+typedef struct Tensor_Conv_Gather Tensor_Conv_Gather;
+struct Tensor_Conv_Gather {
+  const Tensor_Conv* cv;
+  f32* cols;
+  // Input at the image and first channel of the group
+  const f32* in;
+  uptr oh0, rows;
+};
+
+// Fills a row of the column matrix, that is tap 'line' of every patch (k, rows * ow)
+//   or patch 'line' when channels last (rows * ow, k)
+static void tensor_conv_gather_task(void* ctx, uptr line){
+  const Tensor_Conv_Gather* ga = ctx;
+  const Tensor_Conv* cv = ga->cv;
+  if(cv->channels_last){
+    const uptr r = line / cv->ow, q = line % cv->ow;
+    f32* dst = ga->cols + line * cv->k;
+    for_range(uptr, i, 0, cv->kh){
+      const uptr y = (ga->oh0 + r) * cv->sh + i * cv->dh;
+      const bool row_ok = (y >= cv->ph && y - cv->ph < cv->h);
+      for_range(uptr, j, 0, cv->kw){
+	f32* d = dst + (i * cv->kw + j) * cv->cig;
+	const uptr x = q * cv->sw + j * cv->dw;
+	if(!row_ok || x < cv->pw || x - cv->pw >= cv->w){
+	  memset(d, 0, cv->cig * sizeof(f32));
+	  continue;
+	}
+	const f32* src = ga->in + (iptr)(y - cv->ph) * cv->is[2] + (iptr)(x - cv->pw) * cv->is[3];
+	if(cv->is[1] == 1) memcpy(d, src, cv->cig * sizeof(f32));
+	else for_range(uptr, c, 0, cv->cig) d[c] = src[(iptr)c * cv->is[1]];
+      }
+    }
+    return;
+  }
+  const uptr c = line / (cv->kh * cv->kw), i = (line / cv->kw) % cv->kh, j = line % cv->kw;
+  uptr lo, hi;
+  tensor_conv_valid(&lo, &hi, cv->ow, cv->w, cv->sw, cv->pw, j * cv->dw);
+  const iptr step = (iptr)cv->sw * cv->is[3];
+  for_range(uptr, r, 0, ga->rows){
+    f32* dst = ga->cols + (line * ga->rows + r) * cv->ow;
+    const uptr y = (ga->oh0 + r) * cv->sh + i * cv->dh;
+    if(lo == hi || y < cv->ph || y - cv->ph >= cv->h){
+      memset(dst, 0, cv->ow * sizeof(f32));
+      continue;
+    }
+    const f32* src = ga->in + (iptr)c * cv->is[1] + (iptr)(y - cv->ph) * cv->is[2] +
+      (iptr)(lo * cv->sw + j * cv->dw - cv->pw) * cv->is[3];
+    for_range(uptr, q, 0, lo) dst[q] = 0.f;
+    if(step == 1) memcpy(dst + lo, src, (hi - lo) * sizeof(f32));
+    else for_range(uptr, q, lo, hi) dst[q] = src[(iptr)(q - lo) * step];
+    for_range(uptr, q, hi, cv->ow) dst[q] = 0.f;
+  }
+}
+
+// Computes the outputs of one (image, group, block of rows) unit as a single matrix product
+static void tensor_conv_gemm_unit(const Tensor_Conv* cv, uptr unit, f32* cols, f32* apack, f32* bpack){
+  const uptr b = unit % cv->blocks;
+  const uptr g = (unit / cv->blocks) % cv->groups;
+  const uptr img = unit / (cv->blocks * cv->groups);
+  const uptr oh0 = b * cv->rows;
+  const uptr rows = ((cv->oh - oh0) < cv->rows) ? (cv->oh - oh0) : cv->rows;
+  const uptr p_count = rows * cv->ow;
+  f32* in = cv->in + (iptr)img * cv->is[0] + (iptr)(g * cv->cig) * cv->is[1];
+  f32* wg = cv->wpack + g * cv->cog * cv->k;
+  f32* out = cv->out + (iptr)img * cv->os[0] + (iptr)(g * cv->cog) * cv->os[1] + (iptr)oh0 * cv->os[2];
+
+  Tensor_Mat patches;
+  if(cv->pointwise){
+    f32* start = in + (iptr)(oh0 * cv->sh) * cv->is[2];
+    const iptr step = (iptr)cv->sw * cv->is[3];
+    patches = (cv->channels_last ?
+	       (Tensor_Mat){.data = start, .rows = p_count, .cols = cv->k, .rs = step, .cs = cv->is[1]} :
+	       (Tensor_Mat){.data = start, .rows = cv->k, .cols = p_count, .rs = cv->is[1], .cs = step});
+  } else {
+    Tensor_Conv_Gather ga = {.cv = cv, .cols = cols, .in = in, .oh0 = oh0, .rows = rows};
+    tensor_parallel_for_work(cv->channels_last ? p_count : cv->k, p_count * cv->k,
+			     tensor_conv_gather_task, &ga);
+    patches = (cv->channels_last ?
+	       (Tensor_Mat){.data = cols, .rows = p_count, .cols = cv->k, .rs = (iptr)cv->k, .cs = 1} :
+	       (Tensor_Mat){.data = cols, .rows = cv->k, .cols = p_count, .rs = (iptr)p_count, .cs = 1});
+  }
+  Tensor_Mat a, bm, c;
+  if(cv->channels_last){
+    a = patches;
+    bm = (Tensor_Mat){.data = wg, .rows = cv->k, .cols = cv->cog, .rs = 1, .cs = (iptr)cv->k};
+    c = (Tensor_Mat){.data = out, .rows = p_count, .cols = cv->cog, .rs = cv->os[3], .cs = cv->os[1]};
+  } else {
+    a = (Tensor_Mat){.data = wg, .rows = cv->cog, .cols = cv->k, .rs = (iptr)cv->k, .cs = 1};
+    bm = patches;
+    c = (Tensor_Mat){.data = out, .rows = cv->cog, .cols = p_count, .rs = cv->os[1], .cs = cv->os[3]};
+  }
+  if(tensor_gemm_is_small(c.rows, c.cols, cv->k)) tensor_gemm_small(c, a, bm);
+  else tensor_gemm_run(cv->kern, c, a, bm, apack, bpack);
+}
+
+// Runs the units of chunk 't', with the buffers shared between them
+static void tensor_conv_gemm_task(void* ctx, uptr t){
+  const Tensor_Conv* cv = ctx;
+  const uptr units = cv->n * cv->groups * cv->blocks;
+  const uptr begin = t * cv->unit_chunk;
+  const uptr end = ((units - begin) < cv->unit_chunk) ? units : (begin + cv->unit_chunk);
+  const uptr p_max = cv->rows * cv->ow;
+  const uptr m = cv->channels_last ? p_max : cv->cog;
+  const uptr n = cv->channels_last ? cv->cog : p_max;
+  const Alloc_Interface scratch = gen_std_allocator();
+  f32_Slice cols = SLICE_ALLOC(scratch, f32, cv->pointwise ? 1 : p_max * cv->k);
+  f32_Slice apack = SLICE_ALLOC(scratch, f32, tensor_gemm_apack_count(cv->kern, m, cv->k));
+  f32_Slice bpack = SLICE_ALLOC(scratch, f32, tensor_gemm_bpack_count(cv->kern, n, cv->k));
+  MEMCHK(cols.data);
+  MEMCHK(apack.data);
+  MEMCHK(bpack.data);
+  for_range(uptr, u, begin, end) tensor_conv_gemm_unit(cv, u, cols.data, apack.data, bpack.data);
+  SLICE_FREE(scratch, bpack);
+  SLICE_FREE(scratch, apack);
+  SLICE_FREE(scratch, cols);
+}
+
+// One input element per output of a row, for a single weight
+typedef struct Tensor_Conv_Tap Tensor_Conv_Tap;
+struct Tensor_Conv_Tap {
+  // Start of the input row, and the element read by the first interior output
+  const f32* row;
+  const f32* p;
+  // Offset of the tap along the row, j * dw
+  uptr x;
+  f32 w;
+};
+DEF_SLICE(Tensor_Conv_Tap);
+
+// out[q] = sum of taps[t].w * taps[t].p[q * step], for the outputs that need no padding
+typedef void Tensor_Conv_Row_Fn(uptr count, const Tensor_Conv_Tap* taps, uptr tap_count,
+				iptr step, f32* out);
+
+static void tensor_conv_row_plain(uptr count, const Tensor_Conv_Tap* taps, uptr tap_count,
+				  iptr step, f32* out){
+  for_range(uptr, q, 0, count) out[q] = 0.f;
+  for_range(uptr, t, 0, tap_count){
+    const f32 w = taps[t].w;
+    const f32* p = taps[t].p;
+    for_range(uptr, q, 0, count) out[q] += w * p[(iptr)q * step];
+  }
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+// 32 outputs at a time in 4 ymm accumulators, for contiguous rows
+__attribute__((target("avx2,fma")))
+static void tensor_conv_row_avx2(uptr count, const Tensor_Conv_Tap* taps, uptr tap_count,
+				 iptr step, f32* out){
+  if(step != 1){
+    tensor_conv_row_plain(count, taps, tap_count, step, out);
+    return;
+  }
+  uptr q = 0;
+  for(; q + 32 <= count; q += 32){
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+    for_range(uptr, t, 0, tap_count){
+      const __m256 wv = _mm256_set1_ps(taps[t].w);
+      const f32* p = taps[t].p + q;
+      a0 = _mm256_fmadd_ps(wv, _mm256_loadu_ps(p), a0);
+      a1 = _mm256_fmadd_ps(wv, _mm256_loadu_ps(p + 8), a1);
+      a2 = _mm256_fmadd_ps(wv, _mm256_loadu_ps(p + 16), a2);
+      a3 = _mm256_fmadd_ps(wv, _mm256_loadu_ps(p + 24), a3);
+    }
+    _mm256_storeu_ps(out + q, a0);
+    _mm256_storeu_ps(out + q + 8, a1);
+    _mm256_storeu_ps(out + q + 16, a2);
+    _mm256_storeu_ps(out + q + 24, a3);
+  }
+  for(; q + 8 <= count; q += 8){
+    __m256 a0 = _mm256_setzero_ps();
+    for_range(uptr, t, 0, tap_count)
+      a0 = _mm256_fmadd_ps(_mm256_set1_ps(taps[t].w), _mm256_loadu_ps(taps[t].p + q), a0);
+    _mm256_storeu_ps(out + q, a0);
+  }
+  if(q < count){
+    // Masked lanes are never touched, so the reads stay inside the rows
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - q)),
+					    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256 a0 = _mm256_setzero_ps();
+    for_range(uptr, t, 0, tap_count)
+      a0 = _mm256_fmadd_ps(_mm256_set1_ps(taps[t].w), _mm256_maskload_ps(taps[t].p + q, mask), a0);
+    _mm256_maskstore_ps(out + q, mask, a0);
+  }
+}
+#endif
+
+static Tensor_Conv_Row_Fn* tensor_conv_row_kernel(void){
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return tensor_conv_row_avx2;
+#endif
+  return tensor_conv_row_plain;
+}
+
+// Depthwise convolutions of channels last tensors sum whole pixels instead, their channels
+//   are contiguous in the input, the output and the tap major packed weights
+typedef struct Tensor_Conv_Pixel_Tap Tensor_Conv_Pixel_Tap;
+struct Tensor_Conv_Pixel_Tap {
+  const f32* in;
+  const f32* w;
+};
+DEF_SLICE(Tensor_Conv_Pixel_Tap);
+
+// out[c] = sum of taps[t].w[c] * taps[t].in[c], for 'count' channels
+typedef void Tensor_Conv_Pixel_Fn(uptr count, const Tensor_Conv_Pixel_Tap* taps, uptr tap_count, f32* out);
+
+static void tensor_conv_pixel_plain(uptr count, const Tensor_Conv_Pixel_Tap* taps, uptr tap_count, f32* out){
+  for_range(uptr, c, 0, count) out[c] = 0.f;
+  for_range(uptr, t, 0, tap_count){
+    for_range(uptr, c, 0, count) out[c] += taps[t].w[c] * taps[t].in[c];
+  }
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+__attribute__((target("avx2,fma")))
+static void tensor_conv_pixel_avx2(uptr count, const Tensor_Conv_Pixel_Tap* taps, uptr tap_count, f32* out){
+  uptr c = 0;
+  for(; c + 32 <= count; c += 32){
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+    for_range(uptr, t, 0, tap_count){
+      const f32* x = taps[t].in + c;
+      const f32* w = taps[t].w + c;
+      a0 = _mm256_fmadd_ps(_mm256_loadu_ps(w), _mm256_loadu_ps(x), a0);
+      a1 = _mm256_fmadd_ps(_mm256_loadu_ps(w + 8), _mm256_loadu_ps(x + 8), a1);
+      a2 = _mm256_fmadd_ps(_mm256_loadu_ps(w + 16), _mm256_loadu_ps(x + 16), a2);
+      a3 = _mm256_fmadd_ps(_mm256_loadu_ps(w + 24), _mm256_loadu_ps(x + 24), a3);
+    }
+    _mm256_storeu_ps(out + c, a0);
+    _mm256_storeu_ps(out + c + 8, a1);
+    _mm256_storeu_ps(out + c + 16, a2);
+    _mm256_storeu_ps(out + c + 24, a3);
+  }
+  for(; c + 8 <= count; c += 8){
+    __m256 a0 = _mm256_setzero_ps();
+    for_range(uptr, t, 0, tap_count)
+      a0 = _mm256_fmadd_ps(_mm256_loadu_ps(taps[t].w + c), _mm256_loadu_ps(taps[t].in + c), a0);
+    _mm256_storeu_ps(out + c, a0);
+  }
+  if(c < count){
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(count - c)),
+					    _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256 a0 = _mm256_setzero_ps();
+    for_range(uptr, t, 0, tap_count)
+      a0 = _mm256_fmadd_ps(_mm256_maskload_ps(taps[t].w + c, mask), _mm256_maskload_ps(taps[t].in + c, mask), a0);
+    _mm256_maskstore_ps(out + c, mask, a0);
+  }
+}
+#endif
+
+static Tensor_Conv_Pixel_Fn* tensor_conv_pixel_kernel(void){
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return tensor_conv_pixel_avx2;
+#endif
+  return tensor_conv_pixel_plain;
+}
+
+typedef struct Tensor_Conv_Direct Tensor_Conv_Direct;
+struct Tensor_Conv_Direct {
+  const Tensor_Conv* cv;
+  Tensor_Conv_Row_Fn* row_fn;
+  Tensor_Conv_Pixel_Fn* pixel_fn;
+  uptr bands;
+};
+
+// Computes TENSOR_CONV_DIRECT_ROWS rows of all channels of one image, for depthwise channels last
+static void tensor_conv_pixel_task(void* ctx, uptr task){
+  const Tensor_Conv_Direct* di = ctx;
+  const Tensor_Conv* cv = di->cv;
+  const uptr band = task % di->bands, img = task / di->bands;
+  const uptr oh_end = (((band + 1) * TENSOR_CONV_DIRECT_ROWS) < cv->oh) ?
+    ((band + 1) * TENSOR_CONV_DIRECT_ROWS) : cv->oh;
+  const Alloc_Interface scratch = gen_std_allocator();
+  Tensor_Conv_Pixel_Tap_Slice taps = SLICE_ALLOC(scratch, Tensor_Conv_Pixel_Tap, cv->k);
+  MEMCHK(taps.data);
+  for_range(uptr, oh, band * TENSOR_CONV_DIRECT_ROWS, oh_end){
+    for_range(uptr, ow, 0, cv->ow){
+      uptr count = 0;
+      for_range(uptr, i, 0, cv->kh){
+	const uptr y = oh * cv->sh + i * cv->dh;
+	if(y < cv->ph || y - cv->ph >= cv->h) continue;
+	for_range(uptr, j, 0, cv->kw){
+	  const uptr x = ow * cv->sw + j * cv->dw;
+	  if(x < cv->pw || x - cv->pw >= cv->w) continue;
+	  taps.data[count++] = (Tensor_Conv_Pixel_Tap){
+	    .in = cv->in + (iptr)img * cv->is[0] + (iptr)(y - cv->ph) * cv->is[2] + (iptr)(x - cv->pw) * cv->is[3],
+	    .w = cv->wpack + (i * cv->kw + j) * cv->groups,
+	  };
+	}
+      }
+      di->pixel_fn(cv->groups, taps.data, count,
+		   cv->out + (iptr)img * cv->os[0] + (iptr)oh * cv->os[2] + (iptr)ow * cv->os[3]);
+    }
+  }
+  SLICE_FREE(scratch, taps);
+}
+
+// Computes TENSOR_CONV_DIRECT_ROWS rows of one output channel of one image
+static void tensor_conv_direct_task(void* ctx, uptr task){
+  const Tensor_Conv_Direct* di = ctx;
+  const Tensor_Conv* cv = di->cv;
+  const uptr band = task % di->bands;
+  const uptr co = (task / di->bands) % (cv->groups * cv->cog);
+  const uptr img = task / (di->bands * cv->groups * cv->cog);
+  const uptr g = co / cv->cog;
+  const uptr oh_end = (((band + 1) * TENSOR_CONV_DIRECT_ROWS) < cv->oh) ?
+    ((band + 1) * TENSOR_CONV_DIRECT_ROWS) : cv->oh;
+  const f32* in = cv->in + (iptr)img * cv->is[0] + (iptr)(g * cv->cig) * cv->is[1];
+  const f32* wts = cv->wpack + co * cv->k;
+  const iptr step = (iptr)cv->sw * cv->is[3];
+
+  // Outputs between 'lo' and 'hi' read no padding for any tap along the row
+  uptr lo, hi, lo_last, hi_first;
+  tensor_conv_valid(&lo, &hi_first, cv->ow, cv->w, cv->sw, cv->pw, 0);
+  tensor_conv_valid(&lo_last, &hi, cv->ow, cv->w, cv->sw, cv->pw, (cv->kw - 1) * cv->dw);
+  if(hi < lo) hi = lo;
+
+  const Alloc_Interface scratch = gen_std_allocator();
+  Tensor_Conv_Tap_Slice taps = SLICE_ALLOC(scratch, Tensor_Conv_Tap, cv->k);
+  f32_Slice buf = SLICE_ALLOC(scratch, f32, cv->ow);
+  MEMCHK(taps.data);
+  MEMCHK(buf.data);
+  for_range(uptr, oh, band * TENSOR_CONV_DIRECT_ROWS, oh_end){
+    uptr count = 0;
+    for_range(uptr, c, 0, cv->cig){
+      for_range(uptr, i, 0, cv->kh){
+	const uptr y = oh * cv->sh + i * cv->dh;
+	if(y < cv->ph || y - cv->ph >= cv->h) continue;
+	const f32* row = in + (iptr)c * cv->is[1] + (iptr)(y - cv->ph) * cv->is[2];
+	for_range(uptr, j, 0, cv->kw){
+	  const uptr x = j * cv->dw;
+	  taps.data[count++] = (Tensor_Conv_Tap){
+	    .row = row, .x = x, .w = wts[(c * cv->kh + i) * cv->kw + j],
+	    .p = (lo < hi) ? (row + (iptr)(lo * cv->sw + x - cv->pw) * cv->is[3]) : row,
+	  };
+	}
+      }
+    }
+    f32* out = cv->out + (iptr)img * cv->os[0] + (iptr)co * cv->os[1] + (iptr)oh * cv->os[2];
+    f32* dst = (cv->os[3] == 1) ? out : buf.data;
+    di->row_fn(hi - lo, taps.data, count, step, dst + lo);
+    for_range(uptr, q, 0, cv->ow){
+      if(q == lo) q = hi;
+      if(q >= cv->ow) break;
+      f32 acc = 0.f;
+      for_range(uptr, t, 0, count){
+	const uptr x = q * cv->sw + taps.data[t].x;
+	if(x < cv->pw || x - cv->pw >= cv->w) continue;
+	acc += taps.data[t].w * taps.data[t].row[(iptr)(x - cv->pw) * cv->is[3]];
+      }
+      dst[q] = acc;
+    }
+    if(dst != out) for_range(uptr, q, 0, cv->ow) out[(iptr)q * cv->os[3]] = dst[q];
+  }
+  SLICE_FREE(scratch, buf);
+  SLICE_FREE(scratch, taps);
+}
+
+// Not to be used directly, just a helper fxn
+// Reads the operands of a convolution with 'spatial' (1 or 2) dimensions after the channels
+static Tensor_Conv tensor_conv_setup(Tensor out, Tensor in, Tensor wt, Tensor_Conv_Options opts, uptr spatial){
+  const uptr nd = spatial + 2;
+  assert(((void)"Convolution input and weights need (n, c, ...) and (c_out, c_in / groups, ...) dimensions",
+	  in.ndim == nd && wt.ndim == nd));
+  assert(((void)"Convolution output needs as many dimensions as the input", out.ndim == nd));
+  tensor_assert_f32(in);
+  tensor_assert_f32(wt);
+  tensor_assert_f32(out);
+  tensor_assert_view_in_storage(in);
+  tensor_assert_view_in_storage(wt);
+  tensor_assert_view_in_storage(out);
+  const uptr c_in = tensor_shape(in).data[1], c_out = tensor_shape(wt).data[0];
+  assert(((void)"Convolution groups must divide both the input and output channels",
+	  opts.groups > 0 && c_in % opts.groups == 0 && c_out % opts.groups == 0));
+  assert(((void)"Convolution weights must have c_in / groups input channels",
+	  tensor_shape(wt).data[1] * opts.groups == c_in));
+
+  Tensor_Conv cv = {
+    .in = tensor_base_ptr(in), .out = tensor_base_ptr(out),
+    .is = {tensor_stride(in).data[0], tensor_stride(in).data[1],
+	   (spatial == 2) ? tensor_stride(in).data[2] : 0, tensor_stride(in).data[nd - 1]},
+    .os = {tensor_stride(out).data[0], tensor_stride(out).data[1],
+	   (spatial == 2) ? tensor_stride(out).data[2] : 0, tensor_stride(out).data[nd - 1]},
+    .n = tensor_shape(in).data[0],
+    .h = (spatial == 2) ? tensor_shape(in).data[2] : 1,
+    .w = tensor_shape(in).data[nd - 1],
+    .kh = (spatial == 2) ? tensor_shape(wt).data[2] : 1,
+    .kw = tensor_shape(wt).data[nd - 1],
+    .sh = (spatial == 2) ? opts.stride[0] : 1,
+    .sw = opts.stride[spatial - 1],
+    .ph = (spatial == 2) ? opts.padding[0] : 0,
+    .pw = opts.padding[spatial - 1],
+    .dh = (spatial == 2) ? opts.dilation[0] : 1,
+    .dw = opts.dilation[spatial - 1],
+    .groups = opts.groups, .cig = c_in / opts.groups, .cog = c_out / opts.groups,
+  };
+  cv.oh = tensor_conv_out_len(cv.h, cv.kh, cv.sh, cv.ph, cv.dh);
+  cv.ow = tensor_conv_out_len(cv.w, cv.kw, cv.sw, cv.pw, cv.dw);
+  cv.k = cv.cig * cv.kh * cv.kw;
+  assert(((void)"Convolution output must be of shape (n, c_out, output lengths ...)",
+	  tensor_shape(out).data[0] == cv.n && tensor_shape(out).data[1] == c_out &&
+	  (spatial == 1 || tensor_shape(out).data[2] == cv.oh) &&
+	  tensor_shape(out).data[nd - 1] == cv.ow));
+  const iptr ic = cv.is[1], iw = cv.is[3];
+  cv.channels_last = (((ic < 0) ? -ic : ic) < ((iw < 0) ? -iw : iw));
+  cv.pointwise = (cv.kh == 1 && cv.kw == 1 && cv.ph == 0 && cv.pw == 0);
+  return cv;
+}
+
+// Orders of the packed weights
+typedef enum Tensor_Conv_Pack Tensor_Conv_Pack;
+enum Tensor_Conv_Pack {
+  // k weights of each output channel as (c, i, j), for the GEMM and the row kernel
+  TENSOR_CONV_PACK_CIJ,
+  // Same, as (i, j, c), for the GEMM of channels last inputs
+  TENSOR_CONV_PACK_IJC,
+  // Weights of all the channels for each tap (i, j), for the pixel kernel
+  TENSOR_CONV_PACK_TAPS,
+};
+
+// Not to be used directly, just a helper fxn
+static void tensor_conv_pack_weights(Tensor_Conv* cv, Tensor wt, f32* dst, Tensor_Conv_Pack order){
+  const f32* src = tensor_base_ptr(wt);
+  const iptr* ws = tensor_stride(wt).data;
+  const iptr wh = (wt.ndim == 4) ? ws[2] : 0, ww = ws[wt.ndim - 1];
+  const uptr c_out = cv->groups * cv->cog;
+  for_range(uptr, co, 0, c_out){
+    for_range(uptr, c, 0, cv->cig){
+      for_range(uptr, i, 0, cv->kh){
+	for_range(uptr, j, 0, cv->kw){
+	  uptr at = co * cv->k + (c * cv->kh + i) * cv->kw + j;
+	  if(order == TENSOR_CONV_PACK_IJC) at = co * cv->k + (i * cv->kw + j) * cv->cig + c;
+	  if(order == TENSOR_CONV_PACK_TAPS) at = ((i * cv->kw + j) * cv->cig + c) * c_out + co;
+	  dst[at] = src[(iptr)co * ws[0] + (iptr)c * ws[1] + (iptr)i * wh + (iptr)j * ww];
+	}
+      }
+    }
+  }
+  cv->wpack = dst;
+}
+
+// Not to be used directly, just a helper fxn
+static Tensor tensor_conv_run(Tensor_Iter* out_iter, Tensor in, Tensor wt, Tensor_Conv_Options opts, uptr spatial){
+  tensor_iter_make_writable(out_iter);
+  Tensor_Conv cv = tensor_conv_setup(out_iter->t, in, wt, opts, spatial);
+  const uptr total = cv.n * cv.groups * cv.cog * cv.oh * cv.ow;
+  if(total == 0){
+    tensor_iter_finish(out_iter);
+    return out_iter->t;
+  }
+  const Alloc_Interface scratch = gen_std_allocator();
+  f32_Slice wpack = SLICE_ALLOC(scratch, f32, cv.groups * cv.cog * cv.k);
+  MEMCHK(wpack.data);
+
+  if(cv.channels_last && cv.cig == 1 && cv.cog == 1 && cv.is[1] == 1 && cv.os[1] == 1){
+    tensor_conv_pack_weights(&cv, wt, wpack.data, TENSOR_CONV_PACK_TAPS);
+    Tensor_Conv_Direct di = {
+      .cv = &cv, .pixel_fn = tensor_conv_pixel_kernel(),
+      .bands = (cv.oh + TENSOR_CONV_DIRECT_ROWS - 1) / TENSOR_CONV_DIRECT_ROWS,
+    };
+    tensor_parallel_for_work(cv.n * di.bands, total * cv.k, tensor_conv_pixel_task, &di);
+  } else if(cv.cog < TENSOR_CONV_DIRECT_COUT || cv.k < TENSOR_CONV_DIRECT_TAPS){
+    tensor_conv_pack_weights(&cv, wt, wpack.data, TENSOR_CONV_PACK_CIJ);
+    Tensor_Conv_Direct di = {
+      .cv = &cv, .row_fn = tensor_conv_row_kernel(),
+      .bands = (cv.oh + TENSOR_CONV_DIRECT_ROWS - 1) / TENSOR_CONV_DIRECT_ROWS,
+    };
+    tensor_parallel_for_work(cv.n * cv.groups * cv.cog * di.bands, total * cv.k,
+			     tensor_conv_direct_task, &di);
+  } else {
+    tensor_conv_pack_weights(&cv, wt, wpack.data, cv.channels_last ? TENSOR_CONV_PACK_IJC : TENSOR_CONV_PACK_CIJ);
+    cv.kern = tensor_gemm_kernel();
+    // Rows of a block are one matrix dimension only if they follow each other in memory
+    const bool out_rows = (cv.os[2] == (iptr)cv.ow * cv.os[3]);
+    const bool in_rows = (!cv.pointwise || cv.is[2] * (iptr)cv.sh == (iptr)(cv.ow * cv.sw) * cv.is[3]);
+    cv.rows = 1;
+    if(out_rows && in_rows){
+      cv.rows = cv.pointwise ? cv.oh : (TENSOR_CONV_COLS_MAX / (cv.k * cv.ow));
+      cv.rows = (cv.rows < 1) ? 1 : ((cv.rows > cv.oh) ? cv.oh : cv.rows);
+    }
+    cv.blocks = (cv.oh + cv.rows - 1) / cv.rows;
+    // Like 'tensor_bmm', with enough units each task runs its own ones serially
+    const uptr units = cv.n * cv.groups * cv.blocks;
+    const uptr threads = tensor_get_num_threads();
+    if(units >= threads){
+      const uptr tasks = (units < 4 * threads) ? units : (4 * threads);
+      cv.unit_chunk = (units + tasks - 1) / tasks;
+      tensor_parallel_for_work((units + cv.unit_chunk - 1) / cv.unit_chunk, total * cv.k,
+			       tensor_conv_gemm_task, &cv);
+    } else {
+      cv.unit_chunk = units;
+      tensor_conv_gemm_task(&cv, 0);
+    }
+  }
+  SLICE_FREE(scratch, wpack);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+// Not to be used directly, just a helper fxn
+// Allocates the output, in the channels last layout if the input is
+static Tensor tensor_conv_alloc(Alloc_Interface allocr, Tensor in, Tensor wt, Tensor_Conv_Options opts, uptr spatial){
+  const uptr nd = spatial + 2;
+  assert(((void)"Convolution input and weights need (n, c, ...) and (c_out, c_in / groups, ...) dimensions",
+	  in.ndim == nd && wt.ndim == nd));
+  uptr len[2];
+  for_range(uptr, d, 0, spatial){
+    len[d] = tensor_conv_out_len(tensor_shape(in).data[2 + d], tensor_shape(wt).data[2 + d],
+				 opts.stride[d], opts.padding[d], opts.dilation[d]);
+  }
+  const uptr n = tensor_shape(in).data[0], c = tensor_shape(wt).data[0];
+  const iptr ic = tensor_stride(in).data[1], iw = tensor_stride(in).data[nd - 1];
+  if(((ic < 0) ? -ic : ic) >= ((iw < 0) ? -iw : iw)){
+    return (spatial == 2) ? tensor_alloc(allocr, n, c, len[0], len[1]) : tensor_alloc(allocr, n, c, len[0]);
+  }
+  // (n, ..., c) permuted back to (n, c, ...)
+  Tensor ans = (spatial == 2) ? tensor_alloc(allocr, n, len[0], len[1], c) : tensor_alloc(allocr, n, len[0], c);
+  for_range(uptr, d, 1, nd - 1) tensor_permute_in_place(&ans, nd - d, nd - d - 1);
+  return ans;
+}
+
+Tensor tensor_conv1d_inp(Tensor_Iter* out_iter, Tensor in, Tensor weight, Tensor_Conv_Options opts){
+  return tensor_conv_run(out_iter, in, weight, opts, 1);
+}
+
+Tensor tensor_conv1d_new(Alloc_Interface allocr, Tensor in, Tensor weight, Tensor_Conv_Options opts){
+  Tensor ans = tensor_conv_alloc(allocr, in, weight, opts, 1);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_conv1d_inp(&iter, in, weight, opts);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+Tensor tensor_conv2d_inp(Tensor_Iter* out_iter, Tensor in, Tensor weight, Tensor_Conv_Options opts){
+  return tensor_conv_run(out_iter, in, weight, opts, 2);
+}
+
+Tensor tensor_conv2d_new(Alloc_Interface allocr, Tensor in, Tensor weight, Tensor_Conv_Options opts){
+  Tensor ans = tensor_conv_alloc(allocr, in, weight, opts, 2);
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_conv2d_inp(&iter, in, weight, opts);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Integer matrix multiplication
+//   Same blocking and threading as the f32 GEMM above, but K is packed in groups of 4
+//   so that microkernels can take 4 byte dot products into i32 lanes (VNNI vpdpbusd,
+//   or vpmaddwd on sign extended bytes with plain AVX2). Products are exact, sums wrap
+//   like i32 additions, so the result is exact whenever it fits in an i32.
+//   vpdpbusd multiplies unsigned by signed bytes, so for those kernels A is packed as
+//   a + 128 and 128 times the column sums of the B panel is subtracted afterwards.
+//   (vpmaddubsw is avoided, it saturates its i16 sums)
+#define TENSOR_IGEMM_KC 1024
+
+// Computes c[MR*NR] (row major) = A panel times B panel over kq groups of 4
+typedef void Tensor_Igemm_Micro(uptr kq, const int8_t* ap, const int8_t* bp, int32_t* c);
+
+typedef struct Tensor_Igemm_Kernel Tensor_Igemm_Kernel;
+struct Tensor_Igemm_Kernel {
+  uptr mr;
+  uptr nr;
+  // A is packed biased by 128, as unsigned bytes
+  bool a_biased;
+  Tensor_Igemm_Micro* fn;
+};
+
+static void tensor_igemm_micro_plain(uptr kq, const int8_t* ap, const int8_t* bp, int32_t* c){
+  uint32_t acc[4][8] = {0};
+  for_range(uptr, q, 0, kq){
+    for_range(uptr, r, 0, 4){
+      const int8_t* a = ap + q*16 + r*4;
+      for_range(uptr, j, 0, 8){
+	const int8_t* b = bp + q*32 + j*4;
+	acc[r][j] += (uint32_t)(a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3]);
+      }
+    }
+  }
+  memcpy(c, acc, sizeof(acc));
+}
+
+#ifdef TENSOR_HAS_X86_SIMD
+// 4 x 8 tile, each accumulator holds (k0 k1, k2 k3) pair sums of 4 columns
+__attribute__((target("avx2")))
+static void tensor_igemm_micro_avx2(uptr kq, const int8_t* ap, const int8_t* bp, int32_t* c){
+  __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+  __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+  __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+  __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+  for_range(uptr, q, 0, kq){
+    const __m256i b = _mm256_loadu_si256((const __m256i*)(bp + q*32));
+    const __m256i b0 = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(b));
+    const __m256i b1 = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(b, 1));
+    const int8_t* a = ap + q*16;
+    int32_t a4;
+    __m256i av;
+#define TENSOR_IGEMM_AVX2_ROW(r, acc0, acc1)				\
+    memcpy(&a4, a + (r)*4, 4);						\
+    av = _mm256_broadcastq_epi64(_mm_cvtepi8_epi16(_mm_cvtsi32_si128(a4))); \
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(av, b0));		\
+    acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(av, b1));
+    TENSOR_IGEMM_AVX2_ROW(0, c00, c01);
+    TENSOR_IGEMM_AVX2_ROW(1, c10, c11);
+    TENSOR_IGEMM_AVX2_ROW(2, c20, c21);
+    TENSOR_IGEMM_AVX2_ROW(3, c30, c31);
+#undef TENSOR_IGEMM_AVX2_ROW
+  }
+  // Pair sums of columns (0 1 4 5 | 2 3 6 7) after hadd, put back in order
+#define TENSOR_IGEMM_AVX2_STORE(r, acc0, acc1)				\
+  _mm256_storeu_si256((__m256i*)(c + (r)*8),				\
+		      _mm256_permute4x64_epi64(_mm256_hadd_epi32(acc0, acc1), _MM_SHUFFLE(3, 1, 2, 0)));
+  TENSOR_IGEMM_AVX2_STORE(0, c00, c01);
+  TENSOR_IGEMM_AVX2_STORE(1, c10, c11);
+  TENSOR_IGEMM_AVX2_STORE(2, c20, c21);
+  TENSOR_IGEMM_AVX2_STORE(3, c30, c31);
+#undef TENSOR_IGEMM_AVX2_STORE
+}
+
+// 6 x 16 tile, 12 ymm accumulators, a is biased
+__attribute__((target("avx2,avxvnni")))
+static void tensor_igemm_micro_avxvnni(uptr kq, const int8_t* ap, const int8_t* bp, int32_t* c){
+  __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+  __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+  __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+  __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+  __m256i c40 = _mm256_setzero_si256(), c41 = _mm256_setzero_si256();
+  __m256i c50 = _mm256_setzero_si256(), c51 = _mm256_setzero_si256();
+  for_range(uptr, q, 0, kq){
+    const __m256i b0 = _mm256_loadu_si256((const __m256i*)(bp + q*64));
+    const __m256i b1 = _mm256_loadu_si256((const __m256i*)(bp + q*64 + 32));
+    const int8_t* a = ap + q*24;
+    int32_t a4;
+    __m256i av;
+#define TENSOR_IGEMM_VNNI_ROW(r, acc0, acc1)			\
+    memcpy(&a4, a + (r)*4, 4);					\
+    av = _mm256_set1_epi32(a4);					\
+    acc0 = _mm256_dpbusd_avx_epi32(acc0, av, b0);		\
+    acc1 = _mm256_dpbusd_avx_epi32(acc1, av, b1);
+    TENSOR_IGEMM_VNNI_ROW(0, c00, c01);
+    TENSOR_IGEMM_VNNI_ROW(1, c10, c11);
+    TENSOR_IGEMM_VNNI_ROW(2, c20, c21);
+    TENSOR_IGEMM_VNNI_ROW(3, c30, c31);
+    TENSOR_IGEMM_VNNI_ROW(4, c40, c41);
+    TENSOR_IGEMM_VNNI_ROW(5, c50, c51);
+#undef TENSOR_IGEMM_VNNI_ROW
+  }
+  _mm256_storeu_si256((__m256i*)(c + 0*16), c00); _mm256_storeu_si256((__m256i*)(c + 0*16 + 8), c01);
+  _mm256_storeu_si256((__m256i*)(c + 1*16), c10); _mm256_storeu_si256((__m256i*)(c + 1*16 + 8), c11);
+  _mm256_storeu_si256((__m256i*)(c + 2*16), c20); _mm256_storeu_si256((__m256i*)(c + 2*16 + 8), c21);
+  _mm256_storeu_si256((__m256i*)(c + 3*16), c30); _mm256_storeu_si256((__m256i*)(c + 3*16 + 8), c31);
+  _mm256_storeu_si256((__m256i*)(c + 4*16), c40); _mm256_storeu_si256((__m256i*)(c + 4*16 + 8), c41);
+  _mm256_storeu_si256((__m256i*)(c + 5*16), c50); _mm256_storeu_si256((__m256i*)(c + 5*16 + 8), c51);
+}
+
+// 6 x 32 tile, 12 zmm accumulators, a is biased
+__attribute__((target("avx512f,avx512vnni")))
+static void tensor_igemm_micro_avx512vnni(uptr kq, const int8_t* ap, const int8_t* bp, int32_t* c){
+  __m512i c00 = _mm512_setzero_si512(), c01 = _mm512_setzero_si512();
+  __m512i c10 = _mm512_setzero_si512(), c11 = _mm512_setzero_si512();
+  __m512i c20 = _mm512_setzero_si512(), c21 = _mm512_setzero_si512();
+  __m512i c30 = _mm512_setzero_si512(), c31 = _mm512_setzero_si512();
+  __m512i c40 = _mm512_setzero_si512(), c41 = _mm512_setzero_si512();
+  __m512i c50 = _mm512_setzero_si512(), c51 = _mm512_setzero_si512();
+  for_range(uptr, q, 0, kq){
+    const __m512i b0 = _mm512_loadu_si512(bp + q*128);
+    const __m512i b1 = _mm512_loadu_si512(bp + q*128 + 64);
+    const int8_t* a = ap + q*24;
+    int32_t a4;
+    __m512i av;
+#define TENSOR_IGEMM_VNNI_ROW(r, acc0, acc1)			\
+    memcpy(&a4, a + (r)*4, 4);					\
+    av = _mm512_set1_epi32(a4);					\
+    acc0 = _mm512_dpbusd_epi32(acc0, av, b0);			\
+    acc1 = _mm512_dpbusd_epi32(acc1, av, b1);
+    TENSOR_IGEMM_VNNI_ROW(0, c00, c01);
+    TENSOR_IGEMM_VNNI_ROW(1, c10, c11);
+    TENSOR_IGEMM_VNNI_ROW(2, c20, c21);
+    TENSOR_IGEMM_VNNI_ROW(3, c30, c31);
+    TENSOR_IGEMM_VNNI_ROW(4, c40, c41);
+    TENSOR_IGEMM_VNNI_ROW(5, c50, c51);
+#undef TENSOR_IGEMM_VNNI_ROW
+  }
+  _mm512_storeu_si512(c + 0*32, c00); _mm512_storeu_si512(c + 0*32 + 16, c01);
+  _mm512_storeu_si512(c + 1*32, c10); _mm512_storeu_si512(c + 1*32 + 16, c11);
+  _mm512_storeu_si512(c + 2*32, c20); _mm512_storeu_si512(c + 2*32 + 16, c21);
+  _mm512_storeu_si512(c + 3*32, c30); _mm512_storeu_si512(c + 3*32 + 16, c31);
+  _mm512_storeu_si512(c + 4*32, c40); _mm512_storeu_si512(c + 4*32 + 16, c41);
+  _mm512_storeu_si512(c + 5*32, c50); _mm512_storeu_si512(c + 5*32 + 16, c51);
+}
+#endif
+
+static Tensor_Igemm_Kernel tensor_igemm_kernel(void){
+  (void)f32_simd_table(); // Makes sure cpu features are initialized
+#ifdef TENSOR_HAS_X86_SIMD
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vnni"))
+    return (Tensor_Igemm_Kernel){.mr = 6, .nr = 32, .a_biased = true, .fn = tensor_igemm_micro_avx512vnni};
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("avxvnni"))
+    return (Tensor_Igemm_Kernel){.mr = 6, .nr = 16, .a_biased = true, .fn = tensor_igemm_micro_avxvnni};
+  if(__builtin_cpu_supports("avx2"))
+    return (Tensor_Igemm_Kernel){.mr = 4, .nr = 8, .a_biased = false, .fn = tensor_igemm_micro_avx2};
+#endif
+  return (Tensor_Igemm_Kernel){.mr = 4, .nr = 8, .a_biased = false, .fn = tensor_igemm_micro_plain};
+}
+
+// A strided i8 or i32 matrix, element (i, j) is element i*rs + j*cs from data
+typedef struct Tensor_Imat Tensor_Imat;
+struct Tensor_Imat {
+  void* data;
+  uptr rows;
+  uptr cols;
+  iptr rs;
+  iptr cs;
+};
+
+// Not to be used directly, just a helper fxn
+// Same as 'tensor_mat_of' for integer tensors
+static Tensor_Imat tensor_imat_of(Tensor t){
+  const uptr n = t.ndim;
+  return (Tensor_Imat){
+    .data = tensor_raw_ptr(t),
+    .rows = tensor_shape(t).data[n-2], .cols = tensor_shape(t).data[n-1],
+    .rs = tensor_stride(t).data[n-2], .cs = tensor_stride(t).data[n-1],
+  };
+}
+
+// C = A * B directly, for small sizes where packing does not pay off
+static void tensor_igemm_small(Tensor_Imat c, Tensor_Imat a, Tensor_Imat b){
+  const int8_t* ad = a.data;
+  const int8_t* bd = b.data;
+  int32_t* cd = c.data;
+  for_range(uptr, i, 0, c.rows){
+    for_range(uptr, j, 0, c.cols){
+      int64_t acc = 0;
+      for_range(uptr, k, 0, a.cols)
+	acc += ad[(iptr)i * a.rs + (iptr)k * a.cs] * bd[(iptr)k * b.rs + (iptr)j * b.cs];
+      cd[(iptr)i * c.rs + (iptr)j * c.cs] = (int32_t)acc;
+    }
+  }
+}
+
+typedef struct Tensor_Igemm Tensor_Igemm;
+struct Tensor_Igemm {
+  Tensor_Igemm_Kernel kern;
+  Tensor_Imat a, b, c;
+  // Current block, kq is kc rounded up to groups of 4
+  uptr pc, kc, kq, jc, nc;
+  bool accumulate;
+  int8_t* apack;
+  int8_t* bpack;
+  // Sums of the packed columns of B, for removing the bias of A
+  int32_t* bsum;
+  uptr m_tiles, n_tiles;
+};
+
+// Packs MR rows of A starting at row i0, as [k / 4][MR][k % 4] (zero padded)
+static void tensor_igemm_pack_a_task(void* ctx, uptr panel){
+  const Tensor_Igemm* g = ctx;
+  const uptr mr = g->kern.mr;
+  const uptr i0 = panel * mr;
+  int8_t* dst = g->apack + panel * mr * g->kq * 4;
+  const uptr rows = ((g->a.rows - i0) < mr) ? (g->a.rows - i0) : mr;
+  const int8_t* src = (const int8_t*)g->a.data + (iptr)i0 * g->a.rs + (iptr)g->pc * g->a.cs;
+  const uint8_t bias = g->kern.a_biased ? 0x80 : 0;
+  memset(dst, 0, mr * g->kq * 4);
+  for_range(uptr, r, 0, rows){
+    const int8_t* s = src + (iptr)r * g->a.rs;
+    for_range(uptr, k, 0, g->kc)
+      dst[(k/4)*mr*4 + r*4 + k%4] = (int8_t)((uint8_t)s[(iptr)k * g->a.cs] ^ bias);
+  }
+}
+
+// Packs NR columns of B starting at column jc + j0, as [k / 4][NR][k % 4] (zero padded)
+static void tensor_igemm_pack_b_task(void* ctx, uptr panel){
+  const Tensor_Igemm* g = ctx;
+  const uptr nr = g->kern.nr;
+  const uptr j0 = panel * nr;
+  int8_t* dst = g->bpack + panel * nr * g->kq * 4;
+  int32_t* sums = g->bsum + panel * nr;
+  const uptr cols = ((g->nc - j0) < nr) ? (g->nc - j0) : nr;
+  const int8_t* src = (const int8_t*)g->b.data + (iptr)g->pc * g->b.rs + (iptr)(g->jc + j0) * g->b.cs;
+  memset(dst, 0, nr * g->kq * 4);
+  for_range(uptr, j, 0, nr) sums[j] = 0;
+  for_range(uptr, j, 0, cols){
+    const int8_t* s = src + (iptr)j * g->b.cs;
+    int32_t sum = 0;
+    for_range(uptr, k, 0, g->kc){
+      const int8_t v = s[(iptr)k * g->b.rs];
+      dst[(k/4)*nr*4 + j*4 + k%4] = v;
+      sum += v;
+    }
+    sums[j] = sum;
+  }
+}
+
+// Computes one MC x NT tile of C for the current block
+static void tensor_igemm_tile_task(void* ctx, uptr tile){
+  const Tensor_Igemm* g = ctx;
+  const uptr mr = g->kern.mr, nr = g->kern.nr;
+  const uptr ti = tile / g->n_tiles, tj = tile % g->n_tiles;
+  const uptr i_begin = ti * TENSOR_GEMM_MC;
+  const uptr i_end = ((i_begin + TENSOR_GEMM_MC) < g->c.rows) ? (i_begin + TENSOR_GEMM_MC) : g->c.rows;
+  const uptr j_begin = tj * TENSOR_GEMM_NT;
+  const uptr j_end = ((j_begin + TENSOR_GEMM_NT) < g->nc) ? (j_begin + TENSOR_GEMM_NT) : g->nc;
+
+  int32_t tmp[TENSOR_GEMM_MAX_MR * TENSOR_GEMM_MAX_NR];
+  uint32_t bias[TENSOR_GEMM_MAX_NR] = {0};
+  for(uptr j = j_begin; j < j_end; j += nr){
+    const int8_t* bp = g->bpack + (j / nr) * nr * g->kq * 4;
+    const uptr cols = ((j_end - j) < nr) ? (j_end - j) : nr;
+    if(g->kern.a_biased){
+      for_range(uptr, q, 0, cols) bias[q] = 128u * (uint32_t)g->bsum[j + q];
+    }
+    for(uptr i = i_begin; i < i_end; i += mr){
+      const int8_t* ap = g->apack + (i / mr) * mr * g->kq * 4;
+      const uptr rows = ((i_end - i) < mr) ? (i_end - i) : mr;
+      g->kern.fn(g->kq, ap, bp, tmp);
+      int32_t* c = (int32_t*)g->c.data + (iptr)i * g->c.rs + (iptr)(g->jc + j) * g->c.cs;
+      for_range(uptr, r, 0, rows){
+	int32_t* crow = c + (iptr)r * g->c.rs;
+	const int32_t* trow = tmp + r * nr;
+	for_range(uptr, q, 0, cols){
+	  // Unsigned so that wrapping is well defined
+	  uint32_t v = (uint32_t)trow[q] - bias[q];
+	  if(g->accumulate) v += (uint32_t)crow[(iptr)q * g->c.cs];
+	  crow[(iptr)q * g->c.cs] = (int32_t)v;
+	}
+      }
+    }
+  }
+}
+
+// C = A * B, scratch space for the packed panels comes from 'allocr'
+static void tensor_igemm(Alloc_Interface allocr, Tensor_Imat c, Tensor_Imat a, Tensor_Imat b){
+  const uptr m = c.rows, n = c.cols, kk = a.cols;
+  if(m == 0 || n == 0) return;
+  if(tensor_gemm_is_small(m, n, kk)){
+    tensor_igemm_small(c, a, b);
+    return;
+  }
+  Tensor_Igemm g = {.kern = tensor_igemm_kernel(), .a = a, .b = b, .c = c};
+  const uptr mr = g.kern.mr, nr = g.kern.nr;
+  const uptr m_panels = (m + mr - 1) / mr;
+  const uptr n_panels = (((n < TENSOR_GEMM_NC) ? n : TENSOR_GEMM_NC) + nr - 1) / nr;
+  const uptr kq_max = (((kk < TENSOR_IGEMM_KC) ? kk : TENSOR_IGEMM_KC) + 3) / 4;
+  // Packing buffers hold bytes, taken in f32 units
+  f32_Slice apack = SLICE_ALLOC(allocr, f32, m_panels * mr * kq_max);
+  f32_Slice bpack = SLICE_ALLOC(allocr, f32, n_panels * nr * (kq_max + 1));
+  MEMCHK(apack.data);
+  MEMCHK(bpack.data);
+  g.apack = (int8_t*)apack.data;
+  g.bpack = (int8_t*)bpack.data;
+  g.bsum = (int32_t*)(bpack.data + n_panels * nr * kq_max);
+  g.m_tiles = (m + TENSOR_GEMM_MC - 1) / TENSOR_GEMM_MC;
+
+  for(uptr pc = 0; pc < kk; pc += TENSOR_IGEMM_KC){
+    g.pc = pc;
+    g.kc = ((kk - pc) < TENSOR_IGEMM_KC) ? (kk - pc) : TENSOR_IGEMM_KC;
+    g.kq = (g.kc + 3) / 4;
+    g.accumulate = (pc > 0);
+    tensor_parallel_for_work(m_panels, m * g.kc, tensor_igemm_pack_a_task, &g);
+    for(uptr jc = 0; jc < n; jc += TENSOR_GEMM_NC){
+      g.jc = jc;
+      g.nc = ((n - jc) < TENSOR_GEMM_NC) ? (n - jc) : TENSOR_GEMM_NC;
+      g.n_tiles = (g.nc + TENSOR_GEMM_NT - 1) / TENSOR_GEMM_NT;
+      tensor_parallel_for_work((g.nc + nr - 1) / nr, g.nc * g.kc, tensor_igemm_pack_b_task, &g);
+      // Integer products are about 4 times cheaper than f32 ones
+      tensor_parallel_for_work(g.m_tiles * g.n_tiles, m * g.nc * g.kc / 4, tensor_igemm_tile_task, &g);
+    }
+  }
+  SLICE_FREE(allocr, bpack);
+  SLICE_FREE(allocr, apack);
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_matmul_i8_check(Tensor out, Tensor a, Tensor b){
+  assert(((void)"Integer matrix multiplication needs i8 inputs and an i32 output",
+	  a.dtype == TENSOR_I8 && b.dtype == TENSOR_I8 && out.dtype == TENSOR_I32));
+  tensor_matmul_check(out, a, b);
+  (void)out, (void)a, (void)b;
+}
+
+Tensor tensor_matmul_i8_inp(Tensor_Iter* out_iter, Tensor a, Tensor b){
+  tensor_iter_make_writable(out_iter);
+  tensor_matmul_i8_check(out_iter->t, a, b);
+  tensor_igemm(gen_std_allocator(), tensor_imat_of(out_iter->t), tensor_imat_of(a), tensor_imat_of(b));
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+Tensor tensor_matmul_i8_new(Alloc_Interface allocr, Tensor a, Tensor b){
+  assert(((void)"Matrix multiplication needs 2 dimensional tensors",
+	  a.ndim == 2 && b.ndim == 2));
+  Tensor ans = tensor_alloc_dtype(allocr, TENSOR_I32, slice_inx(tensor_shape(a), 0), slice_inx(tensor_shape(b), 1));
+  tensor_matmul_i8_check(ans, a, b);
+  tensor_igemm(allocr, tensor_imat_of(ans), tensor_imat_of(a), tensor_imat_of(b));
+  return ans;
+}
+
+// Quantized tensors
+//   Scales and zero points are fitted to the min and max of each channel, found by
+//   reducing the other dimensions one at a time. Quantizing and dequantizing are loops
+//   over the values and views of the per channel tensors broadcasted along 'axis'.
+
+// Not to be used directly, just a helper fxn
+// View of the per channel tensor 'c' (1 dim) broadcastable to 't', varying only along 'axis'
+static Tensor tensor_channel_view(Tensor c, Tensor t, uptr axis, uptr scratch[]){
+  Tensor v = tensor_temp_view(c.storage, c.offset, t.ndim, scratch);
+  v.dtype = c.dtype;
+  for_range(uptr, i, 0, t.ndim){
+    tensor_shape(v).data[i] = (i == axis) ? slice_inx(tensor_shape(c), 0) : 1;
+    tensor_stride(v).data[i] = (i == axis) ? slice_inx(tensor_stride(c), 0) : 0;
+  }
+  return v;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_quantized_check(Tensor_Quantized q){
+  assert(((void)"Quantized values must be i8", q.values.dtype == TENSOR_I8));
+  assert(((void)"Quantization axis must be a dimension of the values",
+	  q.axis == TENSOR_QUANT_PER_TENSOR || q.axis < q.values.ndim));
+  const uptr channels = (q.axis == TENSOR_QUANT_PER_TENSOR) ? 1 : slice_inx(tensor_shape(q.values), q.axis);
+  assert(((void)"Scales must be f32 and zero points i32, with one of each per channel",
+	  q.scales.dtype == TENSOR_F32 && q.zero_points.dtype == TENSOR_I32 &&
+	  q.scales.ndim == 1 && q.zero_points.ndim == 1 &&
+	  slice_inx(tensor_shape(q.scales), 0) == channels &&
+	  slice_inx(tensor_shape(q.zero_points), 0) == channels));
+  (void)q, (void)channels;
+}
+
+// Loop kernel, p = {out (i8), values, scales, zero points}
+static void tensor_quantize_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  (void)ctx;
+  for_range(uptr, i, 0, n){
+    const f32 v = p[1][(iptr)i * s[1]] / p[2][(iptr)i * s[2]] + p[3][(iptr)i * s[3]];
+    const f32 c = (v > 127.f) ? 127.f : ((v < -128.f) ? -128.f : v);
+    // Rounds to nearest even, the conversion to i8 after is then exact
+    p[0][(iptr)i * s[0]] = (c + 12582912.f) - 12582912.f;
+  }
+}
+
+// Loop kernel, p = {out, quantized values, scales, zero points}
+static void tensor_dequantize_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  (void)ctx;
+  for_range(uptr, i, 0, n)
+    p[0][(iptr)i * s[0]] = (p[1][(iptr)i * s[1]] - p[3][(iptr)i * s[3]]) * p[2][(iptr)i * s[2]];
+}
+
+Tensor_Quantized tensor_quantize_with(Alloc_Interface allocr, Tensor t, uptr axis, Tensor scales, Tensor zero_points){
+  Tensor_Quantized q = {
+    .values = tensor_alloc_dtype_(allocr, TENSOR_I8, tensor_shape(t)),
+    .axis = axis,
+    .scales = tensor_contiguous(allocr, scales),
+    .zero_points = tensor_contiguous(allocr, zero_points),
+  };
+  tensor_quantized_check(q);
+  uptr scratch[2][2 * TENSOR_LOOP_MAX_DIMS];
+  tensor_loop_apply(4, (Tensor[]){q.values, t, tensor_channel_view(q.scales, t, axis, scratch[0]),
+      tensor_channel_view(q.zero_points, t, axis, scratch[1])}, tensor_quantize_kernel, nullptr);
+  return q;
+}
+
+Tensor_Quantized tensor_quantize(Alloc_Interface allocr, Tensor t, uptr axis, bool symmetric){
+  assert(((void)"Quantization axis must be a dimension of the tensor",
+	  axis == TENSOR_QUANT_PER_TENSOR || axis < t.ndim));
+  // Min and max of every channel, other dims reduced from the last one
+  Tensor lo = t, hi = t;
+  for(uptr d = t.ndim; d-- > 0;){
+    if(d == axis) continue;
+    Tensor lo_next = tensor_rmin(allocr, lo, d);
+    Tensor hi_next = tensor_rmax(allocr, hi, d);
+    if(lo.storage.data != t.storage.data){
+      tensor_free(allocr, &lo);
+      tensor_free(allocr, &hi);
+    }
+    lo = lo_next, hi = hi_next;
+  }
+  const uptr channels = (axis == TENSOR_QUANT_PER_TENSOR) ? 1 : slice_inx(tensor_shape(t), axis);
+  Tensor scales = tensor_alloc(allocr, channels);
+  Tensor zero_points = tensor_alloc_dtype(allocr, TENSOR_I32, channels);
+  for_range(uptr, c, 0, channels){
+    const uptr inx[1] = {c};
+    const Tensor_Inx at = {.data = (uptr*)inx, .count = lo.ndim};
+    f64 mn = tensor_get_value_(lo, at), mx = tensor_get_value_(hi, at);
+    // Zero must stay exactly representable, empty channels give an infinite range
+    mn = (mn < 0.0) ? mn : 0.0;
+    mx = (mx > 0.0) ? mx : 0.0;
+    f64 scale = 0.0, zp = 0.0;
+    if(symmetric){
+      scale = ((-mn > mx) ? -mn : mx) / 127.0;
+    } else {
+      scale = (mx - mn) / 255.0;
+    }
+    if(!(scale > 0.0 && scale < 1e30)) scale = 1.0;
+    if(!symmetric){
+      zp = -128.0 - mn / scale;
+      zp = (zp > 127.0) ? 127.0 : zp;
+      zp = (f64)((int32_t)(zp + 128.5) - 128);
+    }
+    slice_inx(scales.storage, c) = (f32)scale;
+    tensor_set_value(zero_points, zp, c);
+  }
+  if(lo.storage.data != t.storage.data){
+    tensor_free(allocr, &lo);
+    tensor_free(allocr, &hi);
+  }
+  Tensor_Quantized q = tensor_quantize_with(allocr, t, axis, scales, zero_points);
+  tensor_free(allocr, &zero_points);
+  tensor_free(allocr, &scales);
+  return q;
+}
+
+Tensor tensor_dequantize(Alloc_Interface allocr, Tensor_Quantized q){
+  tensor_quantized_check(q);
+  Tensor ans = tensor_alloc_(allocr, tensor_shape(q.values));
+  uptr scratch[2][2 * TENSOR_LOOP_MAX_DIMS];
+  tensor_loop_apply(4, (Tensor[]){ans, q.values, tensor_channel_view(q.scales, q.values, q.axis, scratch[0]),
+      tensor_channel_view(q.zero_points, q.values, q.axis, scratch[1])}, tensor_dequantize_kernel, nullptr);
+  return ans;
+}
+
+void tensor_quantized_free(Alloc_Interface allocr, Tensor_Quantized* q){
+  tensor_free(allocr, &q->zero_points);
+  tensor_free(allocr, &q->scales);
+  tensor_free(allocr, &q->values);
+}
+
+// Not to be used directly, just a helper fxn
+// Sums of the rows (dim = 1) or columns (dim = 0) of an i8 matrix
+static void tensor_i8_sums(Tensor_Imat a, uptr dim, int64_t* sums){
+  const int8_t* d = a.data;
+  const uptr outer = (dim == 1) ? a.rows : a.cols, inner = (dim == 1) ? a.cols : a.rows;
+  const iptr os = (dim == 1) ? a.rs : a.cs, is = (dim == 1) ? a.cs : a.rs;
+  for_range(uptr, i, 0, outer){
+    int64_t sum = 0;
+    for_range(uptr, k, 0, inner) sum += d[(iptr)i * os + (iptr)k * is];
+    sums[i] = sum;
+  }
+}
+
+Tensor tensor_qmatmul_inp(Tensor_Iter* out_iter, Tensor_Quantized a, Tensor_Quantized b){
+  tensor_iter_make_writable(out_iter);
+  const Tensor out = out_iter->t;
+  tensor_assert_f32(out);
+  tensor_quantized_check(a);
+  tensor_quantized_check(b);
+  assert(((void)"Quantized matrix multiplication needs scales per tensor, per row of a, or per column of b",
+	  (a.axis == TENSOR_QUANT_PER_TENSOR || a.axis == 0) &&
+	  (b.axis == TENSOR_QUANT_PER_TENSOR || b.axis == 1)));
+  const Alloc_Interface scratch = gen_std_allocator();
+  Tensor acc = tensor_alloc_dtype(scratch, TENSOR_I32, slice_inx(tensor_shape(out), 0), slice_inx(tensor_shape(out), 1));
+  Tensor_Iter acc_iter = tensor_iter_init(scratch, acc);
+  (void)tensor_matmul_i8_inp(&acc_iter, a.values, b.values);
+  tensor_iter_deinit(scratch, &acc_iter);
+
+  // (a - za)(b - zb) summed over k = ab - zb * rowsum(a) - za * colsum(b) + k * za * zb
+  const Tensor_Imat am = tensor_imat_of(a.values), bm = tensor_imat_of(b.values);
+  const uptr m = am.rows, n = bm.cols, kk = am.cols;
+  uptr_Slice sums = SLICE_ALLOC(scratch, uptr, m + n);
+  MEMCHK(sums.data);
+  int64_t* rsum = (int64_t*)sums.data;
+  int64_t* csum = rsum + m;
+  tensor_i8_sums(am, 1, rsum);
+  tensor_i8_sums(bm, 0, csum);
+  const int32_t* accd = (const int32_t*)tensor_raw_ptr(acc);
+  f32* outd = tensor_base_ptr(out);
+  for_range(uptr, i, 0, m){
+    const uptr ai = (a.axis == 0) ? i : 0;
+    const f64 sa = tensor_base_ptr(a.scales)[(iptr)ai * slice_inx(tensor_stride(a.scales), 0)];
+    const int64_t za = ((const int32_t*)tensor_raw_ptr(a.zero_points))[(iptr)ai * slice_inx(tensor_stride(a.zero_points), 0)];
+    for_range(uptr, j, 0, n){
+      const uptr bj = (b.axis == 1) ? j : 0;
+      const f64 sb = tensor_base_ptr(b.scales)[(iptr)bj * slice_inx(tensor_stride(b.scales), 0)];
+      const int64_t zb = ((const int32_t*)tensor_raw_ptr(b.zero_points))[(iptr)bj * slice_inx(tensor_stride(b.zero_points), 0)];
+      const int64_t v = accd[i * n + j] - zb * rsum[i] - za * csum[j] + (int64_t)kk * za * zb;
+      outd[(iptr)i * slice_inx(tensor_stride(out), 0) + (iptr)j * slice_inx(tensor_stride(out), 1)] =
+	(f32)(sa * sb * (f64)v);
+    }
+  }
+  SLICE_FREE(scratch, sums);
+  tensor_free(scratch, &acc);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+Tensor tensor_qmatmul_new(Alloc_Interface allocr, Tensor_Quantized a, Tensor_Quantized b){
+  assert(((void)"Matrix multiplication needs 2 dimensional tensors",
+	  a.values.ndim == 2 && b.values.ndim == 2));
+  Tensor ans = tensor_alloc(allocr, slice_inx(tensor_shape(a.values), 0), slice_inx(tensor_shape(b.values), 1));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_qmatmul_inp(&iter, a, b);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
+
+// Lazy expressions
+//   'tensor_lazy_*' calls only record nodes of an expression DAG, nothing is computed
+//   until 'tensor_force'. Forcing compiles the elementwise part of the expression into
+//   a small program, that is run over tiles of TENSOR_EXPR_TILE elements by a single
+//   'Tensor_Loop' over the output and every leaf. So intermediate results only ever
+//   live in tile sized stack buffers, and every input is read once.
+//   A reduction at the root folds its fused input tile by tile too. Reductions anywhere
+//   else, and subexpressions that dont fit in a program, are first materialized into
+//   temporaries owned by their node.
+#define TENSOR_EXPR_MAX_NODES (TENSOR_LOOP_MAX_OPS - 1)
+#define TENSOR_EXPR_TILE 256
+
+typedef enum Tensor_Expr_Kind Tensor_Expr_Kind;
+enum Tensor_Expr_Kind {
+  TENSOR_EXPR_LEAF = 0,
+  TENSOR_EXPR_BIN_OP,
+  TENSOR_EXPR_VECTOR_OP,
+  TENSOR_EXPR_REDUCE_OP,
+};
+
+struct Tensor_Expr {
+  Tensor_Expr_Kind kind;
+  Tensor_Expr* a;
+  Tensor_Expr* b;
+  f32_binop* op;
+  f32 sv;
+  uptr dim;
+  uptr ndim;
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  // Leaves refer to user tensors, other nodes get one when they are materialized
+  Tensor t;
+  bool has_tensor;
+  Alloc_Interface allocr;
+  // Every node of the graph, for freeing
+  Tensor_Expr* next;
+};
+DEF_SLICE(Tensor_Expr);
+
+Tensor_Graph tensor_graph_init(Alloc_Interface allocr){
+  return (Tensor_Graph){.allocr = allocr, .nodes = nullptr};
+}
+
+void tensor_graph_deinit(Tensor_Graph* graph){
+  while(graph->nodes != nullptr){
+    Tensor_Expr_Slice node = {.data = graph->nodes, .count = 1};
+    graph->nodes = node.data->next;
+    if(node.data->kind != TENSOR_EXPR_LEAF && node.data->has_tensor)
+      tensor_free(graph->allocr, &node.data->t);
+    SLICE_FREE(graph->allocr, node);
+  }
+}
+
+// Not to be used directly, just a helper fxn
+static Tensor_Expr* tensor_expr_push(Tensor_Graph* graph, Tensor_Expr_Kind kind, Tensor_Inx shape){
+  assert(((void)"Tensor has too many dimensions", shape.count <= TENSOR_LOOP_MAX_DIMS));
+  Tensor_Expr_Slice node = SLICE_ALLOC(graph->allocr, Tensor_Expr, 1);
+  MEMCHK(node.data);
+  *node.data = (Tensor_Expr){
+    .kind = kind,
+    .ndim = shape.count,
+    .allocr = graph->allocr,
+    .next = graph->nodes,
+  };
+  for_slice(shape, i) node.data->shape[i] = shape.data[i];
+  graph->nodes = node.data;
+  return node.data;
+}
+
+Tensor_Inx tensor_expr_shape(Tensor_Expr* expr){
+  return init_uptr_slice(expr->shape, expr->ndim);
+}
+
+Tensor_Expr* tensor_lazy(Tensor_Graph* graph, Tensor t){
+  tensor_assert_f32(t);
+  Tensor_Expr* e = tensor_expr_push(graph, TENSOR_EXPR_LEAF, tensor_shape(t));
+  e->t = t;
+  e->has_tensor = true;
+  return e;
+}
+
+Tensor_Expr* tensor_lazy_bin_op(Tensor_Graph* graph, Tensor_Expr* a, f32_binop* op, Tensor_Expr* b){
+  // Shapes are broadcasted like in 'tensor_map_op'
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  const uptr ndim = tensor_broadcast_shape_into(shape, tensor_broadcast_shape_into(shape, 0, tensor_expr_shape(a)),
+						  tensor_expr_shape(b));
+  Tensor_Expr* e = tensor_expr_push(graph, TENSOR_EXPR_BIN_OP, init_uptr_slice(shape, ndim));
+  e->a = a;
+  e->b = b;
+  e->op = op;
+  return e;
+}
+
+Tensor_Expr* tensor_lazy_vector_op(Tensor_Graph* graph, f32 sv, f32_binop* op, Tensor_Expr* a){
+  Tensor_Expr* e = tensor_expr_push(graph, TENSOR_EXPR_VECTOR_OP, tensor_expr_shape(a));
+  e->a = a;
+  e->op = op;
+  e->sv = sv;
+  return e;
+}
+
+Tensor_Expr* tensor_lazy_reduce_op(Tensor_Graph* graph, Tensor_Expr* a, uptr dim, f32_binop* op){
+  assert(((void)"The dim to work on should exist in input tensor", dim < a->ndim));
+  assert(((void)"The input tensor to reduce must have non-zero dim in the chosen index",
+	  a->shape[dim] > 0));
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  for_range(uptr, i, 0, a->ndim - 1) shape[i] = a->shape[(i < dim) ? i : (i + 1)];
+  Tensor_Expr* e = tensor_expr_push(graph, TENSOR_EXPR_REDUCE_OP, init_uptr_slice(shape, a->ndim - 1));
+  e->a = a;
+  e->op = op;
+  e->dim = dim;
+  return e;
+}
+
+// Compiled elementwise program, nodes are in evaluation order, the last one is the result
+typedef struct Tensor_Fused Tensor_Fused;
+struct Tensor_Fused {
+  uptr count;
+  const Tensor_Expr* nodes[TENSOR_EXPR_MAX_NODES];
+  Tensor_Expr_Kind kind[TENSOR_EXPR_MAX_NODES];
+  F32_Builtin_Op builtin[TENSOR_EXPR_MAX_NODES];
+  // Leaf index for leaves, positions of the operands for the others
+  uptr arg[TENSOR_EXPR_MAX_NODES][2];
+  uptr leaf_count;
+  Tensor leaves[TENSOR_EXPR_MAX_NODES];
+  const F32_Simd_Table* table;
+  // Only for a reduction at the root, strides of the leaves along the reduced dim
+  Tensor_Reduce_Ctx red;
+  iptr rstride[TENSOR_EXPR_MAX_NODES];
+  bool col_mode;
+};
+
+// Upper bound of the nodes a subexpression adds to a program, stops counting at 'cap'
+static uptr tensor_expr_size(const Tensor_Expr* e, uptr cap){
+  if(e->has_tensor || e->kind == TENSOR_EXPR_REDUCE_OP) return 1;
+  uptr size = 1 + tensor_expr_size(e->a, cap);
+  if(size < cap && e->kind == TENSOR_EXPR_BIN_OP) size += tensor_expr_size(e->b, cap - size);
+  return (size < cap) ? size : cap;
+}
+
+static void tensor_expr_materialize(Tensor_Expr* e){
+  Tensor t = tensor_alloc_(e->allocr, tensor_expr_shape(e));
+  Tensor_Iter iter = tensor_iter_init(e->allocr, t);
+  (void)tensor_force_inp(&iter, e);
+  tensor_iter_deinit(e->allocr, &iter);
+  e->t = t;
+  e->has_tensor = true;
+}
+
+// Adds the node (after its operands) to the program, returns its position
+// 'reserve' is the number of slots that must be left for the nodes still to come
+static uptr tensor_fused_add(Tensor_Fused* f, Tensor_Expr* e, uptr reserve){
+  for_range(uptr, i, 0, f->count){
+    if(f->nodes[i] == e) return i;
+  }
+  if(!e->has_tensor && e->kind == TENSOR_EXPR_REDUCE_OP) tensor_expr_materialize(e);
+  // The root always fits, its operands are made to leave room for it
+  if(!e->has_tensor && reserve > 0 &&
+     f->count + tensor_expr_size(e, TENSOR_EXPR_MAX_NODES + 1) + reserve > TENSOR_EXPR_MAX_NODES)
+    tensor_expr_materialize(e);
+
+  uptr arg[2] = {0};
+  if(e->has_tensor){
+    arg[0] = f->leaf_count;
+    f->leaves[f->leaf_count++] = e->t;
+  } else {
+    const bool binary = (e->kind == TENSOR_EXPR_BIN_OP);
+    arg[0] = tensor_fused_add(f, e->a, reserve + 1 + (binary ? 1 : 0));
+    if(binary) arg[1] = tensor_fused_add(f, e->b, reserve + 1);
+  }
+  const uptr pos = f->count++;
+  assert(((void)"Should not have happened", pos < TENSOR_EXPR_MAX_NODES));
+  f->nodes[pos] = e;
+  f->kind[pos] = e->has_tensor ? TENSOR_EXPR_LEAF : e->kind;
+  f->builtin[pos] = e->has_tensor ? F32_OP_CUSTOM : f32_builtin_op_of(e->op);
+  f->arg[pos][0] = arg[0];
+  f->arg[pos][1] = arg[1];
+  return pos;
+}
+
+// Runs the program for n (<= TENSOR_EXPR_TILE) elements, leaf k starts at lp[k] with stride ls[k]
+// Returns the values of the last node, either in 'bufs' or a unit stride leaf itself
+static const f32* tensor_fused_eval(const Tensor_Fused* f, uptr n, f32* const lp[], const iptr ls[],
+				    f32 bufs[][TENSOR_EXPR_TILE]){
+  const f32* vals[TENSOR_EXPR_MAX_NODES];
+  for_range(uptr, i, 0, f->count){
+    f32* dst = bufs[i];
+    const F32_Builtin_Op builtin = f->builtin[i];
+    f32_binop* op = f->nodes[i]->op;
+    switch(f->kind[i]){
+    case TENSOR_EXPR_LEAF: {
+      const uptr k = f->arg[i][0];
+      const f32* src = lp[k];
+      const iptr s = ls[k];
+      if(s == 1){
+	vals[i] = src;
+	continue;
+      }
+      for_range(uptr, j, 0, n) dst[j] = src[(iptr)j * s];
+    } break;
+    case TENSOR_EXPR_BIN_OP: {
+      const f32* a = vals[f->arg[i][0]];
+      const f32* b = vals[f->arg[i][1]];
+      if(builtin != F32_OP_CUSTOM) f->table->bin[builtin](n, dst, a, b);
+      else for_range(uptr, j, 0, n) dst[j] = op(a[j], b[j]);
+    } break;
+    case TENSOR_EXPR_VECTOR_OP: {
+      const f32 sv = f->nodes[i]->sv;
+      const f32* a = vals[f->arg[i][0]];
+      if(builtin != F32_OP_CUSTOM) f->table->vec[builtin](n, dst, sv, a);
+      else for_range(uptr, j, 0, n) dst[j] = op(sv, a[j]);
+    } break;
+    default: assert(((void)"Should not have happened", false));
+    }
+    vals[i] = dst;
+  }
+  return vals[f->count - 1];
+}
+
+// Loop kernel, p[0] is the output, p[1..] are the leaves
+static void tensor_fused_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Fused* f = ctx;
+  f32 bufs[TENSOR_EXPR_MAX_NODES][TENSOR_EXPR_TILE];
+  f32* lp[TENSOR_EXPR_MAX_NODES];
+  for(uptr j = 0; j < n; j += TENSOR_EXPR_TILE){
+    const uptr cnt = ((n - j) < TENSOR_EXPR_TILE) ? (n - j) : TENSOR_EXPR_TILE;
+    for_range(uptr, k, 0, f->leaf_count) lp[k] = p[k + 1] + (iptr)j * s[k + 1];
+    const f32* res = tensor_fused_eval(f, cnt, lp, s + 1, bufs);
+    f32* out = p[0] + (iptr)j * s[0];
+    // The output may be one of the leaves, but only ever at the same elements
+    if(s[0] == 1) memmove(out, res, cnt * sizeof(f32));
+    else for_range(uptr, i, 0, cnt) out[(iptr)i * s[0]] = res[i];
+  }
+}
+
+// Folds 'rows' rows of the reduced dim starting at r0 into acc, for 'cnt' columns
+//   same pairing of rows as 'f32_reduce_cols'
+static void tensor_fused_cols(const Tensor_Fused* f, f32* acc, f32* const base[], const iptr ls[],
+			      uptr r0, uptr rows, uptr cnt, f32 bufs[][TENSOR_EXPR_TILE]){
+  const Tensor_Reduce_Ctx* c = &f->red;
+  if(c->builtin != F32_OP_CUSTOM && rows > TENSOR_REDUCE_COL_BLOCK){
+    const uptr blocks = (rows + TENSOR_REDUCE_COL_BLOCK - 1) / TENSOR_REDUCE_COL_BLOCK;
+    const uptr half = (blocks / 2) * TENSOR_REDUCE_COL_BLOCK;
+    f32 rest[TENSOR_EXPR_TILE];
+    tensor_fused_cols(f, acc, base, ls, r0, half, cnt, bufs);
+    tensor_fused_cols(f, rest, base, ls, r0 + half, rows - half, cnt, bufs);
+    c->bin(cnt, acc, acc, rest);
+    return;
+  }
+  f32* lp[TENSOR_EXPR_MAX_NODES];
+  for_range(uptr, r, r0, r0 + rows){
+    for_range(uptr, k, 0, f->leaf_count) lp[k] = base[k] + (iptr)r * f->rstride[k];
+    const f32* res = tensor_fused_eval(f, cnt, lp, ls, bufs);
+    if(r == r0) memcpy(acc, res, cnt * sizeof(f32));
+    else if(c->builtin != F32_OP_CUSTOM) c->bin(cnt, acc, acc, res);
+    else for_range(uptr, j, 0, cnt) acc[j] = c->op(acc[j], res[j]);
+  }
+}
+
+// Folds the whole reduced dim for a single output
+//   builtin ops pair the tiles as a tree, custom ops are folded in order
+static f32 tensor_fused_row(const Tensor_Fused* f, f32* const base[], f32 bufs[][TENSOR_EXPR_TILE]){
+  const Tensor_Reduce_Ctx* c = &f->red;
+  f32* lp[TENSOR_EXPR_MAX_NODES];
+  // Partial results waiting to be paired, with their levels in the tree
+  f32 parts[64];
+  uptr levels[64];
+  uptr depth = 0;
+  f32 acc = 0.f;
+  for(uptr r = 0; r < c->len; r += TENSOR_EXPR_TILE){
+    const uptr cnt = ((c->len - r) < TENSOR_EXPR_TILE) ? (c->len - r) : TENSOR_EXPR_TILE;
+    for_range(uptr, k, 0, f->leaf_count) lp[k] = base[k] + (iptr)r * f->rstride[k];
+    const f32* res = tensor_fused_eval(f, cnt, lp, f->rstride, bufs);
+    if(c->builtin == F32_OP_CUSTOM){
+      uptr j = 0;
+      if(r == 0) acc = res[j++];
+      for(; j < cnt; ++j) acc = c->op(acc, res[j]);
+      continue;
+    }
+    f32 part = c->leaf(cnt, res);
+    uptr level = 0;
+    while(depth > 0 && levels[depth - 1] == level){
+      part = f32_builtin_apply(c->builtin, parts[--depth], part);
+      level++;
+    }
+    parts[depth] = part;
+    levels[depth] = level;
+    depth++;
+  }
+  if(c->builtin == F32_OP_CUSTOM) return acc;
+  acc = parts[--depth];
+  while(depth > 0) acc = f32_builtin_apply(c->builtin, parts[--depth], acc);
+  return acc;
+}
+
+// Loop kernel, p[0] is the output, p[1..] are the leaves at index 0 of the reduced dim
+static void tensor_fused_reduce_kernel(void* ctx, uptr n, f32* const p[], const iptr s[]){
+  const Tensor_Fused* f = ctx;
+  f32 bufs[TENSOR_EXPR_MAX_NODES][TENSOR_EXPR_TILE];
+  f32* base[TENSOR_EXPR_MAX_NODES];
+  if(f->col_mode){
+    f32 acc[TENSOR_EXPR_TILE];
+    for(uptr j = 0; j < n; j += TENSOR_EXPR_TILE){
+      const uptr cnt = ((n - j) < TENSOR_EXPR_TILE) ? (n - j) : TENSOR_EXPR_TILE;
+      for_range(uptr, k, 0, f->leaf_count) base[k] = p[k + 1] + (iptr)j * s[k + 1];
+      tensor_fused_cols(f, acc, base, s + 1, 0, f->red.len, cnt, bufs);
+      for_range(uptr, i, 0, cnt) p[0][(iptr)(j + i) * s[0]] = acc[i];
+    }
+    return;
+  }
+  for_range(uptr, i, 0, n){
+    for_range(uptr, k, 0, f->leaf_count) base[k] = p[k + 1] + (iptr)i * s[k + 1];
+    p[0][(iptr)i * s[0]] = tensor_fused_row(f, base, bufs);
+  }
+}
+
+// Runs a reduction whose input is the fused program 'f', into 'out'
+static void tensor_fused_reduce(Tensor_Fused* f, Tensor out, const Tensor_Expr* e){
+  const Tensor_Expr* in = e->a;
+  f->red = (Tensor_Reduce_Ctx){
+    .op = e->op,
+    .builtin = f32_builtin_op_of(e->op),
+    .len = in->shape[e->dim],
+  };
+  if(f->red.builtin != F32_OP_CUSTOM){
+    f->red.leaf = f32_reduce_table()->red[f->red.builtin];
+    f->red.bin = f32_reduce_table()->bin[f->red.builtin];
+  }
 
-  for_slice(out_shape, i){
-    if(i < dim) slice_inx(out_shape, i) = slice_inx(tv.shape, i);
-    else if(i >= dim) slice_inx(out_shape, i) = slice_inx(tv.shape, i+1);
+  // Views of the leaves broadcasted to the reduce input, with the reduced dim removed
+  Tensor ts[TENSOR_LOOP_MAX_OPS] = {out};
+  uptr kept_dims[TENSOR_EXPR_MAX_NODES][2 * TENSOR_LOOP_MAX_DIMS];
+  bool unit_rstride = false;
+  for_range(uptr, k, 0, f->leaf_count){
+    const Tensor leaf = f->leaves[k];
+    tensor_assert_view_in_storage(leaf);
+    Tensor kept = tensor_temp_view(leaf.storage, leaf.offset, out.ndim, kept_dims[k]);
+    for_range(uptr, i, 0, in->ndim){
+      const iptr stride = tensor_broadcast_stride(leaf, in->ndim, i);
+      if(i == e->dim){
+	f->rstride[k] = stride;
+	continue;
+      }
+      const uptr j = (i < e->dim) ? i : (i - 1);
+      tensor_shape(kept).data[j] = in->shape[i];
+      tensor_stride(kept).data[j] = stride;
+    }
+    unit_rstride = unit_rstride || (f->rstride[k] == 1);
+    ts[k + 1] = kept;
+  }
+
+  Tensor_Loop loop;
+  const uptr total = tensor_loop_init(&loop, f->leaf_count + 1, ts);
+  // Vectorize across the kept dim only when no leaf is contiguous along the reduced one
+  bool unit_inner = false;
+  for_range(uptr, k, 0, f->leaf_count) unit_inner = unit_inner || (loop.stride[k + 1][loop.ndim - 1] == 1);
+  f->col_mode = (!unit_rstride && unit_inner && loop.shape[loop.ndim - 1] >= 8);
+  tensor_loop_run_all(&loop, total, f->red.len * f->count, tensor_fused_reduce_kernel, f);
+}
+
+Tensor tensor_force_inp(Tensor_Iter* out_iter, Tensor_Expr* expr){
+  tensor_iter_make_writable(out_iter);
+  assert(((void)"The output tensor must have the shape of the expression",
+	  equal_tensor_inx(tensor_shape(out_iter->t), tensor_expr_shape(expr))));
+  if(expr->has_tensor){
+    tensor_loop_apply(2, (Tensor[]){out_iter->t, expr->t}, tensor_copy_kernel, nullptr);
+    tensor_iter_finish(out_iter);
+    return out_iter->t;
+  }
+
+  Tensor_Fused f = {.table = f32_simd_table()};
+  const bool reduce = (expr->kind == TENSOR_EXPR_REDUCE_OP);
+  (void)tensor_fused_add(&f, reduce ? expr->a : expr, 0);
+  if(reduce){
+    tensor_fused_reduce(&f, out_iter->t, expr);
+  } else {
+    Tensor ts[TENSOR_LOOP_MAX_OPS] = {out_iter->t};
+    for_range(uptr, k, 0, f.leaf_count) ts[k + 1] = f.leaves[k];
+    Tensor_Loop loop;
+    const uptr total = tensor_loop_init(&loop, f.leaf_count + 1, ts);
+    tensor_loop_run_all(&loop, total, f.count, tensor_fused_kernel, &f);
   }
-  Tensor ans = tensor_alloc_(allocr, out_shape);
-  SLICE_FREE(allocr, out_shape);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
 
+Tensor tensor_force_new(Alloc_Interface allocr, Tensor_Expr* expr){
+  Tensor ans = tensor_alloc_(allocr, tensor_expr_shape(expr));
   Tensor_Iter iter = tensor_iter_init(allocr, ans);
-  (void)tensor_reduce_op(&iter, tv, dim, op);
+  (void)tensor_force_inp(&iter, expr);
   tensor_iter_deinit(allocr, &iter);
-  return ans;  
+  return ans;
 }
 
 Tensor_Iter tensor_iter_init(Alloc_Interface allocr, Tensor t){
   Tensor_Iter iter = {
     .t = t,
-    .inx = SLICE_ALLOC(allocr, uptr, t.shape.count),
     .first_time = true,
   };
-  if(t.shape.count > 0) MEMCHK(iter.inx.data);
+  // Index is inline unless there are too many dimensions
+  if(t.ndim > TENSOR_INLINE_DIMS){
+    uptr_Slice ext = SLICE_ALLOC(allocr, uptr, t.ndim);
+    MEMCHK(ext.data);
+    iter.inx_ext = ext.data;
+  }
   return iter;
 }
 
 void tensor_iter_deinit(Alloc_Interface allocr, Tensor_Iter* iter){
-  SLICE_FREE(allocr, iter->inx);
+  if(iter->owns_storage) tensor_storage_release(iter->t.shared);
+  if(iter->t.ndim > TENSOR_INLINE_DIMS){
+    uptr_Slice ext = {.data = iter->inx_ext, .count = iter->t.ndim};
+    SLICE_FREE(allocr, ext);
+  }
   *iter = (Tensor_Iter){0};
 }
 bool tensor_iter_next(Tensor_Iter* iter){
   if(iter->first_time){
-    for_slice(iter->inx, i) slice_inx(iter->inx, i) = 0;
+    for_slice(tensor_iter_inx(*iter), i) slice_inx(tensor_iter_inx(*iter), i) = 0;
     iter->first_time = false;
-    // TODO:: Handle the cases where the tensor is of 0 size (not 0 dim)
-    // 0 dim tensor should work fine
-    return true;
+    // 0 dim tensor has exactly one element, 0 sized tensor has none
+    return (tensor_size(iter->t) > 0);
+  }
+  // Increment with carry, the first index reaching its size marks the end
+  for_slice(tensor_iter_inx(*iter), i_){
+    uptr i = tensor_iter_inx(*iter).count - i_ - 1;
+    slice_inx(tensor_iter_inx(*iter), i) += 1;
+    if(slice_inx(tensor_iter_inx(*iter), i) < slice_inx(tensor_shape(iter->t), i)) return true;
+    if(i == 0) return false;
+    slice_inx(tensor_iter_inx(*iter), i) = 0;
+  }
+  return false;
+}
+
+// File IO
+//   Header, then shape and stride (in elements) of 'ndim' u64 each, then the raw
+//   elements starting at a 64 byte aligned offset, so the data of a mapped file
+//   can be used in place. Everything is stored in native byte order.
+#define TENSOR_FILE_MAGIC "CTENSOR"
+#define TENSOR_FILE_VERSION 1
+#define TENSOR_FILE_ALIGN 64
+#define TENSOR_FILE_DTYPE_F32 0
+
+typedef struct Tensor_File_Header Tensor_File_Header;
+struct Tensor_File_Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t dtype;
+  uint64_t ndim;
+  // Byte offset of the first element, and the number of elements stored
+  uint64_t data_offset;
+  uint64_t count;
+};
+static_assert(sizeof(uptr) == sizeof(uint64_t), "Dimensions are stored as u64");
+
+// Not to be used directly, just a helper fxn
+static uptr tensor_file_data_offset(uptr ndim){
+  const uptr bytes = sizeof(Tensor_File_Header) + 2 * ndim * sizeof(uptr);
+  return (bytes + TENSOR_FILE_ALIGN - 1) & ~(uptr)(TENSOR_FILE_ALIGN - 1);
+}
+
+// Not to be used directly, just a helper fxn
+// Checks the header against the size of the file
+static bool tensor_file_header_valid(const Tensor_File_Header* h, uptr file_bytes){
+  if(memcmp(h->magic, TENSOR_FILE_MAGIC, sizeof(h->magic)) != 0) return false;
+  if(h->version != TENSOR_FILE_VERSION || h->dtype != TENSOR_FILE_DTYPE_F32) return false;
+  if(h->ndim > file_bytes || h->data_offset < tensor_file_data_offset(h->ndim)) return false;
+  if(h->data_offset % TENSOR_FILE_ALIGN != 0 || h->data_offset > file_bytes) return false;
+  return h->count <= (file_bytes - h->data_offset) / sizeof(f32);
+}
+
+// Not to be used directly, just a helper fxn
+// Copies the dimensions into 't', and checks that the view stays inside 'count' elements
+//   Strides may be negative, so the lowest and highest reachable offsets are both
+//   tracked, in overflow checked signed arithmetic so that crafted files cant wrap them
+static bool tensor_file_read_dims(Tensor* t, const uptr* dims, uptr count){
+  iptr lowest = 0, highest = 0;
+  uptr elems = 1;
+  bool empty = false;
+  for_slice(tensor_shape(*t), i){
+    const iptr stride = (iptr)dims[t->ndim + i];
+    slice_inx(tensor_shape(*t), i) = dims[i];
+    slice_inx(tensor_stride(*t), i) = stride;
+    if(__builtin_mul_overflow(elems, dims[i], &elems)) return false;
+    if(dims[i] == 0){
+      empty = true;
+      continue;
+    }
+    iptr reach;
+    if(__builtin_mul_overflow(dims[i] - 1, stride, &reach)) return false;
+    if(reach < 0 && __builtin_add_overflow(lowest, reach, &lowest)) return false;
+    if(reach > 0 && __builtin_add_overflow(highest, reach, &highest)) return false;
+  }
+  return empty || (lowest >= 0 && (uptr)highest < count);
+}
+
+bool tensor_save(Alloc_Interface allocr, Tensor t, const char* path){
+  tensor_assert_f32(t);
+  FILE* file = fopen(path, "wb");
+  if(file == nullptr) return false;
+
+  const uptr count = tensor_size(t);
+  const Tensor_File_Header header = {
+    .magic = TENSOR_FILE_MAGIC,
+    .version = TENSOR_FILE_VERSION,
+    .dtype = TENSOR_FILE_DTYPE_F32,
+    .ndim = t.ndim,
+    .data_offset = tensor_file_data_offset(t.ndim),
+    .count = count,
+  };
+
+  // Data is always written contiguously, so the strides written are the row major ones
+  uptr_Slice dims = SLICE_ALLOC(allocr, uptr, 2 * t.ndim);
+  if(t.ndim > 0) MEMCHK(dims.data);
+  bool contiguous = true;
+  uptr stride = 1;
+  for_slice(tensor_shape(t), i_){
+    const uptr i = t.ndim - i_ - 1;
+    const uptr size = slice_inx(tensor_shape(t), i);
+    if(size != 1 && slice_inx(tensor_stride(t), i) != (iptr)stride) contiguous = false;
+    slice_inx(dims, i) = size;
+    slice_inx(dims, t.ndim + i) = stride;
+    stride *= size;
+  }
+
+  static const char padding[TENSOR_FILE_ALIGN] = {0};
+  bool ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+  ok = ok && (fwrite(dims.data, sizeof(uptr), dims.count, file) == dims.count);
+  const uptr pad = header.data_offset - sizeof(header) - uptr_slice_bytes(dims);
+  ok = ok && (fwrite(padding, 1, pad, file) == pad);
+  SLICE_FREE(allocr, dims);
+
+  if(ok && count > 0){
+    if(contiguous){
+      ok = (fwrite(tensor_base_ptr(t), sizeof(f32), count, file) == count);
+    } else {
+      Tensor copy = tensor_contiguous(allocr, t);
+      ok = (fwrite(copy.storage.data, sizeof(f32), count, file) == count);
+      tensor_free(allocr, &copy);
+    }
+  }
+  if(fclose(file) != 0) ok = false;
+  return ok;
+}
+
+bool tensor_load(Alloc_Interface allocr, const char* path, Tensor* out){
+  *out = (Tensor){0};
+  FILE* file = fopen(path, "rb");
+  if(file == nullptr) return false;
+
+  struct stat info;
+  Tensor_File_Header header;
+  if(fstat(fileno(file), &info) != 0 ||
+     fread(&header, sizeof(header), 1, file) != 1 ||
+     !tensor_file_header_valid(&header, (uptr)info.st_size)){
+    fclose(file);
+    return false;
+  }
+
+  uptr_Slice dims = SLICE_ALLOC(allocr, uptr, 2 * header.ndim);
+  if(dims.count > 0) MEMCHK(dims.data);
+  Tensor t = {
+    .shared = tensor_storage_new(allocr, header.count),
+    .owner = true,
+  };
+  t.storage = t.shared->data;
+  tensor_init_dims(allocr, &t, header.ndim);
+
+  bool ok = (fread(dims.data, sizeof(uptr), dims.count, file) == dims.count);
+  ok = ok && tensor_file_read_dims(&t, dims.data, header.count);
+  ok = ok && (fseek(file, header.data_offset, SEEK_SET) == 0);
+  ok = ok && (fread(t.storage.data, sizeof(f32), header.count, file) == header.count);
+  SLICE_FREE(allocr, dims);
+  fclose(file);
+
+  if(!ok){
+    tensor_free(allocr, &t);
+    return false;
+  }
+  *out = t;
+  return true;
+}
+
+// Not to be used directly, just a helper fxn
+// Maps the whole file privately, pages come from the page cache and are only copied
+//   if written into. Returns nullptr on failure.
+static void* tensor_map_file(const char* path, uptr* bytes){
+  const int fd = open(path, O_RDONLY);
+  if(fd < 0) return nullptr;
+  struct stat info;
+  if(fstat(fd, &info) != 0 || info.st_size <= 0){
+    close(fd);
+    return nullptr;
+  }
+  *bytes = (uptr)info.st_size;
+  void* mapping = mmap(nullptr, *bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return (mapping == MAP_FAILED) ? nullptr : mapping;
+}
+
+// Not to be used directly, just a helper fxn
+// Storage over 'count' elements at 'data' inside the mapping, which it takes over
+static Tensor_Storage* tensor_storage_mapped(Alloc_Interface allocr, void* mapping, uptr bytes,
+					     f32* data, uptr count){
+  Tensor_Storage_Slice st = SLICE_ALLOC(allocr, Tensor_Storage, 1);
+  MEMCHK(st.data);
+  *st.data = (Tensor_Storage){
+    .allocr = allocr,
+    .data = {.data = data, .count = count},
+    .mapping = mapping,
+    .mapping_bytes = bytes,
+  };
+  atomic_init(&st.data->refs, 1);
+  atomic_init(&st.data->cow, false);
+  return st.data;
+}
+
+bool tensor_load_mmap(Alloc_Interface allocr, const char* path, Tensor* out){
+  *out = (Tensor){0};
+  uptr bytes = 0;
+  void* mapping = tensor_map_file(path, &bytes);
+  if(mapping == nullptr) return false;
+
+  const Tensor_File_Header* header = mapping;
+  if(bytes < sizeof(*header) || !tensor_file_header_valid(header, bytes)){
+    munmap(mapping, bytes);
+    return false;
+  }
+
+  Tensor t = {
+    .shared = tensor_storage_mapped(allocr, mapping, bytes,
+				    (f32*)((char*)mapping + header->data_offset), header->count),
+    .owner = false,
+  };
+  t.storage = t.shared->data;
+  tensor_init_dims(allocr, &t, header->ndim);
+  if(!tensor_file_read_dims(&t, (const uptr*)(header + 1), header->count)){
+    tensor_free(allocr, &t);
+    return false;
+  }
+  *out = t;
+  return true;
+}
+
+// NumPy files
+//   A .npy file is a magic string, a python dict literal with the dtype, order and shape,
+//   padded so that the data starts 64 byte aligned, then the raw data.
+//   A .npz file is a zip archive of .npy files, only uncompressed (stored) ones are read.
+//   f32 data in native byte order is used in place from a mapping of the file, other
+//   dtypes are converted into a new storage straight from the mapping.
+#define TENSOR_NPY_MAGIC "\x93NUMPY"
+#define TENSOR_NPY_MAGIC_LEN 6
+#define TENSOR_NPY_ALIGN 64
+
+typedef struct Tensor_Npy_Info Tensor_Npy_Info;
+struct Tensor_Npy_Info {
+  // One of 'f', 'i', 'u', 'b', and the size of elements in bytes
+  char kind;
+  uptr elem_size;
+  bool swap_bytes;
+  bool fortran_order;
+  uptr ndim;
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  uptr count;
+  // Position of the data from the start of the .npy bytes
+  uptr data_offset;
+};
+
+// Not to be used directly, just a helper fxn
+static bool tensor_host_little_endian(void){
+  const uint16_t probe = 1;
+  return *(const unsigned char*)&probe == 1;
+}
+
+// Not to be used directly, just a helper fxn
+static uptr tensor_get_le(const unsigned char* p, uptr bytes){
+  uptr v = 0;
+  for(uptr i = 0; i < bytes; ++i) v |= (uptr)p[i] << (8 * i);
+  return v;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_put_le(unsigned char* p, uptr v, uptr bytes){
+  for(uptr i = 0; i < bytes; ++i) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+// Not to be used directly, just a helper fxn
+// Finds "'key':" in the header dict and returns the text after it, or nullptr
+static const char* tensor_npy_find_key(const char* dict, uptr len, const char* key){
+  const uptr key_len = strlen(key);
+  for(uptr i = 0; i + key_len + 2 <= len; ++i){
+    if((dict[i] == '\'' || dict[i] == '"') && memcmp(dict + i + 1, key, key_len) == 0 &&
+       dict[i + 1 + key_len] == dict[i]){
+      const char* p = dict + i + key_len + 2;
+      while(p < dict + len && (*p == ' ' || *p == ':')) p++;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+// Not to be used directly, just a helper fxn
+// Parses the header of the .npy at 'bytes', with 'avail' bytes in total
+static bool tensor_npy_parse(const unsigned char* bytes, uptr avail, Tensor_Npy_Info* info){
+  *info = (Tensor_Npy_Info){0};
+  if(avail < TENSOR_NPY_MAGIC_LEN + 4 || memcmp(bytes, TENSOR_NPY_MAGIC, TENSOR_NPY_MAGIC_LEN) != 0)
+    return false;
+  const unsigned char major = bytes[TENSOR_NPY_MAGIC_LEN];
+  uptr dict_len = 0, dict_start = 0;
+  if(major == 1){
+    dict_len = tensor_get_le(bytes + 8, 2);
+    dict_start = 10;
+  } else if(major == 2 || major == 3){
+    if(avail < 12) return false;
+    dict_len = tensor_get_le(bytes + 8, 4);
+    dict_start = 12;
+  } else {
+    return false;
+  }
+  if(dict_start + dict_len > avail) return false;
+  const char* dict = (const char*)bytes + dict_start;
+  const char* end = dict + dict_len;
+  info->data_offset = dict_start + dict_len;
+
+  // dtype, like '<f4'
+  const char* descr = tensor_npy_find_key(dict, dict_len, "descr");
+  if(descr == nullptr || descr + 4 > end || (*descr != '\'' && *descr != '"')) return false;
+  const char order = descr[1];
+  info->kind = descr[2];
+  info->elem_size = 0;
+  for(const char* p = descr + 3; p < end && *p >= '0' && *p <= '9'; ++p){
+    info->elem_size = info->elem_size * 10 + (uptr)(*p - '0');
+    if(info->elem_size > 8) return false;
+  }
+  if(order == '<') info->swap_bytes = !tensor_host_little_endian();
+  else if(order == '>') info->swap_bytes = tensor_host_little_endian();
+  else if(order != '|' && order != '=') return false;
+  switch(info->kind){
+  case 'f': if(info->elem_size != 2 && info->elem_size != 4 && info->elem_size != 8) return false; break;
+  case 'i': case 'u':
+    if(info->elem_size != 1 && info->elem_size != 2 && info->elem_size != 4 && info->elem_size != 8)
+      return false;
+    break;
+  case 'b': if(info->elem_size != 1) return false; break;
+  default: return false;
+  }
+
+  const char* fortran = tensor_npy_find_key(dict, dict_len, "fortran_order");
+  if(fortran == nullptr) return false;
+  info->fortran_order = (fortran + 4 <= end) && (memcmp(fortran, "True", 4) == 0);
+
+  // shape, like (3, 4) or (5,) or ()
+  const char* p = tensor_npy_find_key(dict, dict_len, "shape");
+  if(p == nullptr || p >= end || *p != '(') return false;
+  p++;
+  info->count = 1;
+  while(p < end && *p != ')'){
+    if(*p == ' ' || *p == ',' || *p == 'L'){
+      p++;
+      continue;
+    }
+    if(*p < '0' || *p > '9' || info->ndim >= TENSOR_LOOP_MAX_DIMS) return false;
+    // Crafted shapes must not wrap the count, it is what gets checked against the data size
+    uptr v = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p){
+      if(__builtin_mul_overflow(v, (uptr)10, &v) || __builtin_add_overflow(v, (uptr)(*p - '0'), &v))
+	return false;
+    }
+    info->shape[info->ndim++] = v;
+    if(__builtin_mul_overflow(info->count, v, &info->count)) return false;
+  }
+  if(p >= end) return false;
+  return info->count <= (avail - info->data_offset) / info->elem_size;
+}
+
+// Not to be used directly, just a helper fxn
+// Converts 'count' elements of the npy dtype into f32, in a single pass over the source
+static void tensor_npy_convert(f32* dst, const unsigned char* src, uptr count, const Tensor_Npy_Info* info){
+#define TENSOR_NPY_CONVERT(T)					\
+  for(uptr i = 0; i < count; ++i){				\
+    T v;							\
+    memcpy(&v, src + i * sizeof(T), sizeof(T));		\
+    dst[i] = (f32)v;						\
+  }
+
+  if(info->swap_bytes && info->elem_size > 1){
+    // Slow path, bytes are gathered in reverse order first
+    for(uptr i = 0; i < count; ++i){
+      unsigned char buf[8];
+      for(uptr b = 0; b < info->elem_size; ++b)
+	buf[b] = src[i * info->elem_size + info->elem_size - b - 1];
+      Tensor_Npy_Info native = *info;
+      native.swap_bytes = false;
+      tensor_npy_convert(dst + i, buf, 1, &native);
+    }
+    return;
+  }
+  switch(info->kind){
+  case 'f':
+    if(info->elem_size == 4){
+      memcpy(dst, src, count * sizeof(f32));
+    } else if(info->elem_size == 8){
+      TENSOR_NPY_CONVERT(f64);
+    } else {
+      for(uptr i = 0; i < count; ++i){
+	uint16_t v;
+	memcpy(&v, src + i * sizeof(v), sizeof(v));
+	dst[i] = tensor_half_to_f32(v);
+      }
+    }
+    break;
+  case 'i':
+    if(info->elem_size == 1) { TENSOR_NPY_CONVERT(int8_t); }
+    else if(info->elem_size == 2) { TENSOR_NPY_CONVERT(int16_t); }
+    else if(info->elem_size == 4) { TENSOR_NPY_CONVERT(int32_t); }
+    else { TENSOR_NPY_CONVERT(int64_t); }
+    break;
+  case 'u':
+    if(info->elem_size == 1) { TENSOR_NPY_CONVERT(uint8_t); }
+    else if(info->elem_size == 2) { TENSOR_NPY_CONVERT(uint16_t); }
+    else if(info->elem_size == 4) { TENSOR_NPY_CONVERT(uint32_t); }
+    else { TENSOR_NPY_CONVERT(uint64_t); }
+    break;
+  case 'b':
+    for(uptr i = 0; i < count; ++i) dst[i] = (src[i] != 0) ? 1.f : 0.f;
+    break;
+  }
+#undef TENSOR_NPY_CONVERT
+}
+
+// Not to be used directly, just a helper fxn
+// Makes a tensor of the .npy at 'npy' inside the mapping, the mapping is taken over
+static bool tensor_npy_from_mapping(Alloc_Interface allocr, void* mapping, uptr bytes,
+				    const unsigned char* npy, uptr npy_bytes, Tensor* out){
+  Tensor_Npy_Info info;
+  if(!tensor_npy_parse(npy, npy_bytes, &info)){
+    munmap(mapping, bytes);
+    return false;
+  }
+  const unsigned char* data = npy + info.data_offset;
+  Tensor t = {0};
+  if(info.kind == 'f' && info.elem_size == sizeof(f32) && !info.swap_bytes &&
+     ((uptr)data % _Alignof(f32)) == 0){
+    // No copy at all, the storage is the mapped data
+    t.shared = tensor_storage_mapped(allocr, mapping, bytes, (f32*)data, info.count);
+    t.owner = false;
+  } else {
+    t.shared = tensor_storage_new(allocr, info.count);
+    t.owner = true;
+    tensor_npy_convert(t.shared->data.data, data, info.count, &info);
+    munmap(mapping, bytes);
+  }
+  t.storage = t.shared->data;
+  tensor_init_dims(allocr, &t, info.ndim);
+
+  // Fortran order is the same layout with the strides going the other way
+  iptr stride = 1;
+  for_slice(tensor_shape(t), i_){
+    const uptr i = info.fortran_order ? i_ : (t.ndim - i_ - 1);
+    slice_inx(tensor_shape(t), i) = info.shape[i];
+    slice_inx(tensor_stride(t), i) = stride;
+    stride *= (iptr)info.shape[i];
+  }
+  *out = t;
+  return true;
+}
+
+bool tensor_load_npy(Alloc_Interface allocr, const char* path, Tensor* out){
+  *out = (Tensor){0};
+  uptr bytes = 0;
+  void* mapping = tensor_map_file(path, &bytes);
+  if(mapping == nullptr) return false;
+  return tensor_npy_from_mapping(allocr, mapping, bytes, mapping, bytes, out);
+}
+
+// Zip structures used by .npz, all little endian
+#define TENSOR_ZIP_LOCAL_SIG 0x04034b50
+#define TENSOR_ZIP_CENTRAL_SIG 0x02014b50
+#define TENSOR_ZIP_END_SIG 0x06054b50
+#define TENSOR_ZIP_LOCAL_SIZE 30
+#define TENSOR_ZIP_CENTRAL_SIZE 46
+#define TENSOR_ZIP_END_SIZE 22
+// Extra field used to pad the data of stored members to be aligned
+#define TENSOR_ZIP_PAD_ID 0x7470
+
+bool tensor_load_npz(Alloc_Interface allocr, const char* path, const char* name, Tensor* out){
+  *out = (Tensor){0};
+  uptr bytes = 0;
+  unsigned char* mapping = tensor_map_file(path, &bytes);
+  if(mapping == nullptr) return false;
+
+  // The end record is at the end, only followed by a comment
+  uptr end = bytes;
+  bool found = false;
+  while(end >= TENSOR_ZIP_END_SIZE && (bytes - end) <= (0xffff + TENSOR_ZIP_END_SIZE)){
+    end--;
+    if(end + TENSOR_ZIP_END_SIZE <= bytes && tensor_get_le(mapping + end, 4) == TENSOR_ZIP_END_SIG){
+      found = true;
+      break;
+    }
+  }
+  if(!found){
+    munmap(mapping, bytes);
+    return false;
+  }
+
+  const uptr entries = tensor_get_le(mapping + end + 10, 2);
+  uptr pos = tensor_get_le(mapping + end + 16, 4);
+  const uptr name_len = strlen(name);
+  for(uptr e = 0; e < entries; ++e){
+    if(pos + TENSOR_ZIP_CENTRAL_SIZE > bytes ||
+       tensor_get_le(mapping + pos, 4) != TENSOR_ZIP_CENTRAL_SIG) break;
+    const uptr method = tensor_get_le(mapping + pos + 10, 2);
+    const uptr size = tensor_get_le(mapping + pos + 24, 4);
+    const uptr entry_name_len = tensor_get_le(mapping + pos + 28, 2);
+    const uptr skip = tensor_get_le(mapping + pos + 30, 2) + tensor_get_le(mapping + pos + 32, 2);
+    const uptr local = tensor_get_le(mapping + pos + 42, 4);
+    const char* entry_name = (const char*)mapping + pos + TENSOR_ZIP_CENTRAL_SIZE;
+    if(pos + TENSOR_ZIP_CENTRAL_SIZE + entry_name_len > bytes) break;
+
+    // Members are named 'name.npy', the extension is optional while searching
+    const bool match = (entry_name_len >= name_len) &&
+      (memcmp(entry_name, name, name_len) == 0) &&
+      ((entry_name_len == name_len) ||
+       ((entry_name_len == name_len + 4) && (memcmp(entry_name + name_len, ".npy", 4) == 0)));
+    if(match){
+      if(method != 0 || local + TENSOR_ZIP_LOCAL_SIZE > bytes) break;
+      const uptr data = local + TENSOR_ZIP_LOCAL_SIZE +
+	tensor_get_le(mapping + local + 26, 2) + tensor_get_le(mapping + local + 28, 2);
+      if(data + size > bytes) break;
+      return tensor_npy_from_mapping(allocr, mapping, bytes, mapping + data, size, out);
+    }
+    pos += TENSOR_ZIP_CENTRAL_SIZE + entry_name_len + skip;
+  }
+  munmap(mapping, bytes);
+  return false;
+}
+
+// Not to be used directly, just a helper fxn
+static uint32_t tensor_crc32(uint32_t crc, const void* data, uptr bytes){
+  static uint32_t table[256];
+  static atomic_bool table_ready = false;
+  if(!atomic_load_explicit(&table_ready, memory_order_acquire)){
+    // Racing threads would all write the same values
+    for(uint32_t i = 0; i < 256; ++i){
+      uint32_t c = i;
+      for(int k = 0; k < 8; ++k) c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+      table[i] = c;
+    }
+    atomic_store_explicit(&table_ready, true, memory_order_release);
+  }
+  const unsigned char* p = data;
+  crc = ~crc;
+  for(uptr i = 0; i < bytes; ++i) crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+// Not to be used directly, just a helper fxn
+// Writes the bytes, updating the crc and the count of bytes written
+static bool tensor_write_tracked(FILE* file, const void* data, uptr bytes, uint32_t* crc, uptr* written){
+  if(bytes == 0) return true;
+  *crc = tensor_crc32(*crc, data, bytes);
+  *written += bytes;
+  return fwrite(data, 1, bytes, file) == bytes;
+}
+
+// Not to be used directly, just a helper fxn
+// Writes 't' as .npy, row major or column major if it is already laid out so
+static bool tensor_npy_write(Alloc_Interface allocr, FILE* file, Tensor t, uint32_t* crc, uptr* written){
+  tensor_assert_f32(t);
+  bool c_order = true, f_order = true;
+  iptr c_stride = 1, f_stride = 1;
+  for_slice(tensor_shape(t), i){
+    const uptr ci = t.ndim - i - 1;
+    if(slice_inx(tensor_shape(t), ci) != 1 && slice_inx(tensor_stride(t), ci) != c_stride) c_order = false;
+    if(slice_inx(tensor_shape(t), i) != 1 && slice_inx(tensor_stride(t), i) != f_stride) f_order = false;
+    c_stride *= (iptr)slice_inx(tensor_shape(t), ci);
+    f_stride *= (iptr)slice_inx(tensor_shape(t), i);
+  }
+  const bool fortran = !c_order && f_order;
+
+  char dict[64 + 24 * TENSOR_LOOP_MAX_DIMS + TENSOR_NPY_ALIGN];
+  assert(((void)"Tensor has too many dimensions", t.ndim <= TENSOR_LOOP_MAX_DIMS));
+  int len = snprintf(dict, sizeof(dict), "{'descr': '%cf4', 'fortran_order': %s, 'shape': (",
+		     tensor_host_little_endian() ? '<' : '>', fortran ? "True" : "False");
+  for_slice(tensor_shape(t), i)
+    len += snprintf(dict + len, sizeof(dict) - (uptr)len, "%zu, ", (size_t)slice_inx(tensor_shape(t), i));
+  // Single element tuples need the trailing comma, others drop it
+  if(t.ndim > 1) len -= 2;
+  else if(t.ndim == 1) len -= 1;
+  len += snprintf(dict + len, sizeof(dict) - (uptr)len, "), }");
+  // Padded with spaces and a newline so the data is aligned
+  const uptr header = TENSOR_NPY_MAGIC_LEN + 4;
+  uptr dict_len = (uptr)len + 1;
+  dict_len += (TENSOR_NPY_ALIGN - (header + dict_len) % TENSOR_NPY_ALIGN) % TENSOR_NPY_ALIGN;
+  memset(dict + len, ' ', dict_len - (uptr)len);
+  dict[dict_len - 1] = '\n';
+
+  unsigned char prefix[TENSOR_NPY_MAGIC_LEN + 4] = TENSOR_NPY_MAGIC;
+  prefix[TENSOR_NPY_MAGIC_LEN] = 1;
+  prefix[TENSOR_NPY_MAGIC_LEN + 1] = 0;
+  tensor_put_le(prefix + TENSOR_NPY_MAGIC_LEN + 2, dict_len, 2);
+  bool ok = tensor_write_tracked(file, prefix, sizeof(prefix), crc, written);
+  ok = ok && tensor_write_tracked(file, dict, dict_len, crc, written);
+  if(!ok) return false;
+
+  const uptr count = tensor_size(t);
+  if(c_order || f_order){
+    return tensor_write_tracked(file, tensor_base_ptr(t), count * sizeof(f32), crc, written);
+  }
+  Tensor copy = tensor_contiguous(allocr, t);
+  ok = tensor_write_tracked(file, copy.storage.data, count * sizeof(f32), crc, written);
+  tensor_free(allocr, &copy);
+  return ok;
+}
+
+bool tensor_save_npy(Alloc_Interface allocr, Tensor t, const char* path){
+  FILE* file = fopen(path, "wb");
+  if(file == nullptr) return false;
+  uint32_t crc = 0;
+  uptr written = 0;
+  bool ok = tensor_npy_write(allocr, file, t, &crc, &written);
+  if(fclose(file) != 0) ok = false;
+  return ok;
+}
+
+bool tensor_save_npz(Alloc_Interface allocr, const char* path, Tensor_Slice ts, const char* const names[]){
+  FILE* file = fopen(path, "wb");
+  if(file == nullptr) return false;
+
+  uptr_Slice locals = SLICE_ALLOC(allocr, uptr, 2 * ts.count);
+  if(ts.count > 0) MEMCHK(locals.data);
+  uint32_t* crcs = (uint32_t*)(locals.data + ts.count);
+  uptr pos = 0;
+  bool ok = true;
+  for_slice(ts, i){
+    // Local header, crc and size are patched after writing the data
+    const uptr name_len = strlen(names[i]) + 4;
+    uptr pad = (TENSOR_NPY_ALIGN - (pos + TENSOR_ZIP_LOCAL_SIZE + name_len) % TENSOR_NPY_ALIGN) % TENSOR_NPY_ALIGN;
+    if(pad > 0 && pad < 4) pad += TENSOR_NPY_ALIGN;
+    unsigned char local[TENSOR_ZIP_LOCAL_SIZE + 2 * TENSOR_NPY_ALIGN] = {0};
+    tensor_put_le(local + 0, TENSOR_ZIP_LOCAL_SIG, 4);
+    tensor_put_le(local + 4, 20, 2);
+    tensor_put_le(local + 12, 0x21, 2);
+    tensor_put_le(local + 26, name_len, 2);
+    tensor_put_le(local + 28, pad, 2);
+    ok = ok && (fwrite(local, 1, TENSOR_ZIP_LOCAL_SIZE, file) == TENSOR_ZIP_LOCAL_SIZE);
+    ok = ok && (fprintf(file, "%s.npy", names[i]) == (int)name_len);
+    if(pad > 0){
+      unsigned char* extra = local + TENSOR_ZIP_LOCAL_SIZE;
+      tensor_put_le(extra, TENSOR_ZIP_PAD_ID, 2);
+      tensor_put_le(extra + 2, pad - 4, 2);
+      ok = ok && (fwrite(extra, 1, pad, file) == pad);
+    }
+    if(!ok) break;
+
+    uint32_t crc = 0;
+    uptr size = 0;
+    ok = tensor_npy_write(allocr, file, slice_inx(ts, i), &crc, &size);
+    ok = ok && (size <= 0xffffffffu);
+    if(!ok) break;
+    tensor_put_le(local + 14, crc, 4);
+    tensor_put_le(local + 18, size, 4);
+    tensor_put_le(local + 22, size, 4);
+    ok = ok && (fseek(file, pos + 14, SEEK_SET) == 0);
+    ok = ok && (fwrite(local + 14, 1, 12, file) == 12);
+    ok = ok && (fseek(file, 0, SEEK_END) == 0);
+    slice_inx(locals, i) = pos;
+    crcs[2 * i] = crc;
+    crcs[2 * i + 1] = (uint32_t)size;
+    pos += TENSOR_ZIP_LOCAL_SIZE + name_len + pad + size;
+    ok = ok && (pos <= 0xffffffffu);
+  }
+
+  // Central directory and the end record
+  const uptr central = pos;
+  for_slice(ts, i){
+    if(!ok) break;
+    const uptr name_len = strlen(names[i]) + 4;
+    unsigned char entry[TENSOR_ZIP_CENTRAL_SIZE] = {0};
+    tensor_put_le(entry + 0, TENSOR_ZIP_CENTRAL_SIG, 4);
+    tensor_put_le(entry + 4, 20, 2);
+    tensor_put_le(entry + 6, 20, 2);
+    tensor_put_le(entry + 14, 0x21, 2);
+    tensor_put_le(entry + 16, crcs[2 * i], 4);
+    tensor_put_le(entry + 20, crcs[2 * i + 1], 4);
+    tensor_put_le(entry + 24, crcs[2 * i + 1], 4);
+    tensor_put_le(entry + 28, name_len, 2);
+    tensor_put_le(entry + 42, slice_inx(locals, i), 4);
+    ok = (fwrite(entry, 1, sizeof(entry), file) == sizeof(entry));
+    ok = ok && (fprintf(file, "%s.npy", names[i]) == (int)name_len);
+    pos += sizeof(entry) + name_len;
+  }
+  if(ok){
+    unsigned char end[TENSOR_ZIP_END_SIZE] = {0};
+    tensor_put_le(end + 0, TENSOR_ZIP_END_SIG, 4);
+    tensor_put_le(end + 8, ts.count, 2);
+    tensor_put_le(end + 10, ts.count, 2);
+    tensor_put_le(end + 12, pos - central, 4);
+    tensor_put_le(end + 16, central, 4);
+    ok = (fwrite(end, 1, sizeof(end), file) == sizeof(end));
+  }
+  SLICE_FREE(allocr, locals);
+  if(fclose(file) != 0) ok = false;
+  return ok;
+}
+
+// Chunked tensors
+//   The elements live in a file as a grid of fixed shape tiles, each stored row major
+//   (edge tiles are padded to the full tile shape). Only a bounded number of tiles are
+//   kept in memory, evicting the least recently used one and writing it back if it
+//   was modified. Operations walk the tiles in file order, and ask the OS to start
+//   reading the next few tiles while the current one is being worked on.
+#define TENSOR_CHUNKED_MAGIC "CTCHUNK"
+#define TENSOR_CHUNKED_VERSION 1
+#define TENSOR_CHUNKED_ALIGN 4096
+#define TENSOR_CHUNKED_DEFAULT_READAHEAD 4
+
+typedef struct Tensor_Chunked_Header Tensor_Chunked_Header;
+struct Tensor_Chunked_Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t dtype;
+  uint64_t ndim;
+  uint64_t data_offset;
+};
+
+typedef struct Tensor_Chunked_Entry Tensor_Chunked_Entry;
+struct Tensor_Chunked_Entry {
+  // Linear index of the tile held, or 'TENSOR_CHUNKED_EMPTY'
+  uptr tile;
+  uptr last_used;
+  bool dirty;
+  f32_Slice data;
+};
+DEF_SLICE(Tensor_Chunked_Entry);
+#define TENSOR_CHUNKED_EMPTY ((uptr)-1)
+
+struct Tensor_Chunked {
+  Alloc_Interface allocr;
+  int fd;
+  bool io_failed;
+  uptr ndim;
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  uptr tile_shape[TENSOR_LOOP_MAX_DIMS];
+  // Tiles along each dimension, and the row major strides inside a tile
+  uptr grid[TENSOR_LOOP_MAX_DIMS];
+  uptr tile_stride[TENSOR_LOOP_MAX_DIMS];
+  uptr tile_elems;
+  uptr tile_count;
+  uptr data_offset;
+  uptr readahead;
+  uptr clock;
+  Tensor_Chunked_Entry_Slice cache;
+};
+DEF_SLICE(Tensor_Chunked);
+
+// Not to be used directly, just a helper fxn
+static uptr tensor_chunked_data_offset(uptr ndim){
+  const uptr dims_bytes = sizeof(Tensor_Chunked_Header) + 2 * ndim * sizeof(uptr);
+  return (dims_bytes + TENSOR_CHUNKED_ALIGN - 1) & ~(uptr)(TENSOR_CHUNKED_ALIGN - 1);
+}
+
+// Not to be used directly, just a helper fxn
+// Number of tiles along a dimension, without the overflow of rounding up by adding
+static uptr tensor_chunked_grid(uptr size, uptr tile){
+  return size / tile + ((size % tile) != 0);
+}
+
+// Not to be used directly, just a helper fxn
+// Checks shapes read from a file, the tile sizes and offsets must not overflow and
+//   every tile must be inside the file, before anything is allocated for them
+static bool tensor_chunked_dims_valid(uptr ndim, const uptr* shape, const uptr* tile_shape,
+				      uptr data_offset, uptr file_bytes){
+  uptr tile_elems = 1, tile_count = 1, bytes;
+  for(uptr d = 0; d < ndim; ++d){
+    if(tile_shape[d] == 0) return false;
+    if(__builtin_mul_overflow(tile_elems, tile_shape[d], &tile_elems)) return false;
+    if(__builtin_mul_overflow(tile_count, tensor_chunked_grid(shape[d], tile_shape[d]), &tile_count))
+      return false;
+  }
+  if(__builtin_mul_overflow(tile_elems, sizeof(f32), &bytes) ||
+     __builtin_mul_overflow(bytes, tile_count, &bytes) ||
+     __builtin_add_overflow(bytes, data_offset, &bytes)) return false;
+  return bytes <= file_bytes;
+}
+
+// Not to be used directly, just a helper fxn
+// Fills the tile geometry and allocates the cache, the shapes must already be set
+static Tensor_Chunked* tensor_chunked_setup(Alloc_Interface allocr, int fd, uptr ndim,
+					    const uptr* shape, const uptr* tile_shape, uptr cache_tiles){
+  Tensor_Chunked_Slice ct = SLICE_ALLOC(allocr, Tensor_Chunked, 1);
+  MEMCHK(ct.data);
+  Tensor_Chunked* c = ct.data;
+  *c = (Tensor_Chunked){
+    .allocr = allocr,
+    .fd = fd,
+    .ndim = ndim,
+    .tile_elems = 1,
+    .tile_count = 1,
+    .readahead = TENSOR_CHUNKED_DEFAULT_READAHEAD,
+  };
+  for(uptr d = ndim; d-- > 0;){
+    c->shape[d] = shape[d];
+    c->tile_shape[d] = tile_shape[d];
+    c->grid[d] = tensor_chunked_grid(shape[d], tile_shape[d]);
+    c->tile_stride[d] = c->tile_elems;
+    c->tile_elems *= tile_shape[d];
+    c->tile_count *= c->grid[d];
+  }
+  c->data_offset = tensor_chunked_data_offset(ndim);
+
+  c->cache = SLICE_ALLOC(allocr, Tensor_Chunked_Entry, (cache_tiles > 0) ? cache_tiles : 1);
+  MEMCHK(c->cache.data);
+  for_slice(c->cache, i){
+    // Empty tensors never load a tile, and their tile shape isnt bounded by the file size
+    slice_inx(c->cache, i) = (Tensor_Chunked_Entry){
+      .tile = TENSOR_CHUNKED_EMPTY,
+      .data = SLICE_ALLOC(allocr, f32, (c->tile_count > 0) ? c->tile_elems : 1),
+    };
+    MEMCHK(slice_inx(c->cache, i).data.data);
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return c;
+}
+
+Tensor_Chunked* tensor_chunked_create(Alloc_Interface allocr, const char* path, Tensor_Inx shape,
+				      Tensor_Inx tile_shape, uptr cache_tiles){
+  assert(((void)"Tile shape must have the same dimensions as the shape", shape.count == tile_shape.count));
+  assert(((void)"Tensor has too many dimensions", shape.count <= TENSOR_LOOP_MAX_DIMS));
+  for_slice(tile_shape, i) assert(((void)"Tiles cannot be empty", slice_inx(tile_shape, i) > 0));
+  const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0) return nullptr;
+  Tensor_Chunked* c = tensor_chunked_setup(allocr, fd, shape.count, shape.data, tile_shape.data, cache_tiles);
+
+  // The tiles start out as a hole in the file, so they read as zeros
+  Tensor_Chunked_Header header = {
+    .magic = TENSOR_CHUNKED_MAGIC,
+    .version = TENSOR_CHUNKED_VERSION,
+    .dtype = TENSOR_FILE_DTYPE_F32,
+    .ndim = c->ndim,
+    .data_offset = c->data_offset,
+  };
+  bool ok = (pwrite(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header));
+  ok = ok && (pwrite(fd, shape.data, uptr_slice_bytes(shape), sizeof(header)) ==
+	      (ssize_t)uptr_slice_bytes(shape));
+  ok = ok && (pwrite(fd, tile_shape.data, uptr_slice_bytes(tile_shape), sizeof(header) + uptr_slice_bytes(shape)) ==
+	      (ssize_t)uptr_slice_bytes(tile_shape));
+  ok = ok && (ftruncate(fd, (off_t)(c->data_offset + c->tile_count * c->tile_elems * sizeof(f32))) == 0);
+  if(!ok){
+    (void)tensor_chunked_close(c);
+    return nullptr;
+  }
+  return c;
+}
+
+Tensor_Chunked* tensor_chunked_open(Alloc_Interface allocr, const char* path, uptr cache_tiles){
+  const int fd = open(path, O_RDWR);
+  if(fd < 0) return nullptr;
+  Tensor_Chunked_Header header;
+  uptr dims[2 * TENSOR_LOOP_MAX_DIMS];
+  bool ok = (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header));
+  ok = ok && (memcmp(header.magic, TENSOR_CHUNKED_MAGIC, sizeof(header.magic)) == 0);
+  ok = ok && (header.version == TENSOR_CHUNKED_VERSION) && (header.dtype == TENSOR_FILE_DTYPE_F32);
+  ok = ok && (header.ndim <= TENSOR_LOOP_MAX_DIMS);
+  ok = ok && (pread(fd, dims, 2 * header.ndim * sizeof(uptr), sizeof(header)) ==
+	      (ssize_t)(2 * header.ndim * sizeof(uptr)));
+  struct stat info;
+  ok = ok && (header.data_offset == tensor_chunked_data_offset(header.ndim)) && (fstat(fd, &info) == 0);
+  ok = ok && tensor_chunked_dims_valid(header.ndim, dims, dims + header.ndim, header.data_offset,
+				       (uptr)info.st_size);
+  if(!ok){
+    close(fd);
+    return nullptr;
+  }
+  return tensor_chunked_setup(allocr, fd, header.ndim, dims, dims + header.ndim, cache_tiles);
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_chunked_write_back(Tensor_Chunked* c, Tensor_Chunked_Entry* e){
+  if(!e->dirty) return;
+  const uptr bytes = c->tile_elems * sizeof(f32);
+  if(pwrite(c->fd, e->data.data, bytes, (off_t)(c->data_offset + e->tile * bytes)) != (ssize_t)bytes)
+    c->io_failed = true;
+  e->dirty = false;
+}
+
+bool tensor_chunked_flush(Tensor_Chunked* c){
+  for_slice(c->cache, i) tensor_chunked_write_back(c, &slice_inx(c->cache, i));
+  return !c->io_failed;
+}
+
+bool tensor_chunked_close(Tensor_Chunked* c){
+  bool ok = tensor_chunked_flush(c);
+  if(close(c->fd) != 0) ok = false;
+  const Alloc_Interface allocr = c->allocr;
+  for_slice(c->cache, i) SLICE_FREE(allocr, slice_inx(c->cache, i).data);
+  SLICE_FREE(allocr, c->cache);
+  Tensor_Chunked_Slice ct = {.data = c, .count = 1};
+  SLICE_FREE(allocr, ct);
+  return ok;
+}
+
+Tensor_Inx tensor_chunked_shape(Tensor_Chunked* c){
+  return init_uptr_slice(c->shape, c->ndim);
+}
+
+void tensor_chunked_set_readahead(Tensor_Chunked* c, uptr tiles){
+  c->readahead = tiles;
+}
+
+// Not to be used directly, just a helper fxn
+// Brings the tile into the cache and returns its memory, 'overwrite' skips reading it
+//   when the caller is going to write every element anyway
+static f32* tensor_chunked_acquire(Tensor_Chunked* c, uptr tile, bool overwrite, bool will_write){
+  Tensor_Chunked_Entry* victim = &slice_inx(c->cache, 0);
+  Tensor_Chunked_Entry* found = nullptr;
+  for_slice(c->cache, i){
+    Tensor_Chunked_Entry* e = &slice_inx(c->cache, i);
+    if(e->tile == tile){
+      found = e;
+      break;
+    }
+    if(e->tile == TENSOR_CHUNKED_EMPTY ||
+       (victim->tile != TENSOR_CHUNKED_EMPTY && e->last_used < victim->last_used)) victim = e;
+  }
+  if(found == nullptr){
+    found = victim;
+    tensor_chunked_write_back(c, found);
+    found->tile = tile;
+    const uptr bytes = c->tile_elems * sizeof(f32);
+    const off_t pos = (off_t)(c->data_offset + tile * bytes);
+    if(!overwrite && pread(c->fd, found->data.data, bytes, pos) != (ssize_t)bytes){
+      c->io_failed = true;
+      memset(found->data.data, 0, bytes);
+    }
+    // Reading ahead, the kernel pulls the following tiles in the background
+    const uptr ahead = ((c->tile_count - tile - 1) < c->readahead) ? (c->tile_count - tile - 1) : c->readahead;
+    if(ahead > 0) posix_fadvise(c->fd, pos + (off_t)bytes, (off_t)(ahead * bytes), POSIX_FADV_WILLNEED);
+  }
+  found->last_used = ++c->clock;
+  if(will_write) found->dirty = true;
+  return found->data.data;
+}
+
+// Not to be used directly, just a helper fxn
+// Position of the tile in the grid, and the view of its valid part
+static Tensor tensor_chunked_tile_view(Tensor_Chunked* c, f32* data, const uptr* coords,
+				       uptr scratch[2 * TENSOR_LOOP_MAX_DIMS]){
+  Tensor t = tensor_temp_view((f32_Slice){.data = data, .count = c->tile_elems}, 0, c->ndim, scratch);
+  for(uptr d = 0; d < c->ndim; ++d){
+    const uptr start = coords[d] * c->tile_shape[d];
+    const uptr left = c->shape[d] - start;
+    slice_inx(tensor_shape(t), d) = (left < c->tile_shape[d]) ? left : c->tile_shape[d];
+    slice_inx(tensor_stride(t), d) = (iptr)c->tile_stride[d];
+  }
+  return t;
+}
+
+// Not to be used directly, just a helper fxn
+// Moves to the next tile in row major (file) order
+static bool tensor_chunked_next_tile(const uptr* grid, uptr ndim, uptr* coords){
+  for(uptr d = ndim; d-- > 0;){
+    if(++coords[d] < grid[d]) return true;
+    coords[d] = 0;
+  }
+  return false;
+}
+
+// Not to be used directly, just a helper fxn
+static void tensor_chunked_assert_same_tiling(const Tensor_Chunked* a, const Tensor_Chunked* b){
+  assert(((void)"Chunked tensors must have the same shape and tile shape", a->ndim == b->ndim));
+  for(uptr d = 0; d < a->ndim; ++d){
+    assert(((void)"Chunked tensors must have the same shape and tile shape",
+	    a->shape[d] == b->shape[d] && a->tile_shape[d] == b->tile_shape[d]));
+  }
+  (void)a, (void)b;
+}
+
+// Not to be used directly, just a helper fxn
+// Copies between the region of 'c' starting at 'start' and 't', in whichever direction
+static void tensor_chunked_copy_region(Tensor_Chunked* c, Tensor_Inx start, Tensor t, bool into_chunked){
+  assert(((void)"Region must have the same dimensions as the chunked tensor",
+	  start.count == c->ndim && t.ndim == c->ndim));
+  uptr first[TENSOR_LOOP_MAX_DIMS], last[TENSOR_LOOP_MAX_DIMS], coords[TENSOR_LOOP_MAX_DIMS];
+  for(uptr d = 0; d < c->ndim; ++d){
+    const uptr size = slice_inx(tensor_shape(t), d);
+    assert(((void)"Region must be inside the chunked tensor", slice_inx(start, d) + size <= c->shape[d]));
+    if(size == 0) return;
+    first[d] = slice_inx(start, d) / c->tile_shape[d];
+    last[d] = (slice_inx(start, d) + size - 1) / c->tile_shape[d];
+    coords[d] = first[d];
+  }
+
+  uptr tile_scratch[2 * TENSOR_LOOP_MAX_DIMS], part_scratch[2 * TENSOR_LOOP_MAX_DIMS];
+  while(true){
+    uptr tile = 0;
+    for(uptr d = 0; d < c->ndim; ++d) tile = tile * c->grid[d] + coords[d];
+    f32* data = tensor_chunked_acquire(c, tile, false, into_chunked);
+
+    // Intersection of the tile and the region, as views into both
+    Tensor tv = tensor_chunked_tile_view(c, data, coords, tile_scratch);
+    Tensor part = tensor_temp_view(t.storage, t.offset, t.ndim, part_scratch);
+    part.dtype = t.dtype;
+    for(uptr d = 0; d < c->ndim; ++d){
+      const uptr tile_start = coords[d] * c->tile_shape[d];
+      const uptr lo = (slice_inx(start, d) > tile_start) ? slice_inx(start, d) : tile_start;
+      const uptr region_end = slice_inx(start, d) + slice_inx(tensor_shape(t), d);
+      const uptr tile_end = tile_start + slice_inx(tensor_shape(tv), d);
+      const uptr hi = (region_end < tile_end) ? region_end : tile_end;
+      tv.offset += (lo - tile_start) * c->tile_stride[d];
+      slice_inx(tensor_shape(tv), d) = hi - lo;
+      part.offset = (uptr)((iptr)part.offset + (iptr)(lo - slice_inx(start, d)) * slice_inx(tensor_stride(t), d));
+      slice_inx(tensor_shape(part), d) = hi - lo;
+      slice_inx(tensor_stride(part), d) = slice_inx(tensor_stride(t), d);
+    }
+    if(into_chunked) tensor_loop_apply(2, (Tensor[]){tv, part}, tensor_copy_kernel, nullptr);
+    else tensor_loop_apply(2, (Tensor[]){part, tv}, tensor_copy_kernel, nullptr);
+
+    // Next tile inside the region
+    uptr d = c->ndim;
+    while(d-- > 0){
+      if(++coords[d] <= last[d]) break;
+      coords[d] = first[d];
+    }
+    if(d == (uptr)-1) break;
   }
-  else{
-    for_slice(iter->inx, i_){
-      uptr i = iter->inx.count - i_ - 1;
-      slice_inx(iter->inx, i) += 1;
-      if(slice_inx(iter->inx, i) < slice_inx(iter->t.shape, i)) break;
+}
+
+void tensor_chunked_store(Tensor_Chunked* c, Tensor_Inx start, Tensor src){
+  tensor_chunked_copy_region(c, start, src, true);
+}
+
+Tensor tensor_chunked_load(Tensor_Iter* out_iter, Tensor_Chunked* c, Tensor_Inx start){
+  tensor_iter_make_writable(out_iter);
+  tensor_chunked_copy_region(c, start, out_iter->t, false);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
+
+void tensor_chunked_map_op(Tensor_Chunked* out, Tensor_Chunked* const ins[], uptr count, f32_binop* op){
+  assert(((void)"There has to be at least 2 tensors for this operation to have meaning", count >= 2));
+  assert(((void)"Too many tensors for a single operation", count < TENSOR_LOOP_MAX_OPS));
+  for(uptr i = 0; i < count; ++i) tensor_chunked_assert_same_tiling(out, ins[i]);
+
+  uptr coords[TENSOR_LOOP_MAX_DIMS] = {0};
+  uptr scratch[TENSOR_LOOP_MAX_OPS][2 * TENSOR_LOOP_MAX_DIMS];
+  Tensor views[TENSOR_LOOP_MAX_OPS];
+  for(uptr tile = 0; tile < out->tile_count; ++tile){
+    bool out_is_input = false;
+    for(uptr i = 0; i < count; ++i){
+      out_is_input = out_is_input || (ins[i] == out);
+      views[i] = tensor_chunked_tile_view(ins[i], tensor_chunked_acquire(ins[i], tile, false, false),
+					  coords, scratch[i]);
     }
-    if((iter->inx.count == 0) || (slice_inx(iter->inx, 0) >= slice_inx(iter->t.shape, 0))) return false;
-    // Modulus the tensor size (a hack, TODO:: remove it)
-    for_slice(iter->inx, i) slice_inx(iter->inx, i) = slice_inx(iter->inx, i) % slice_inx(iter->t.shape, i);
-    return true;
+    f32* out_data = tensor_chunked_acquire(out, tile, !out_is_input, true);
+    Tensor out_view = tensor_chunked_tile_view(out, out_data, coords, scratch[count]);
+    Tensor_Iter it = tensor_iter_init(out->allocr, out_view);
+    (void)tensor_map_op_inp(&it, (Tensor_Slice){.data = views, .count = count}, op);
+    tensor_iter_deinit(out->allocr, &it);
+    (void)tensor_chunked_next_tile(out->grid, out->ndim, coords);
   }
 }
 
+void tensor_chunked_vector_op(Tensor_Chunked* out, f32 sv, f32_binop* op, Tensor_Chunked* in){
+  tensor_chunked_assert_same_tiling(out, in);
+  uptr coords[TENSOR_LOOP_MAX_DIMS] = {0};
+  uptr in_scratch[2 * TENSOR_LOOP_MAX_DIMS], out_scratch[2 * TENSOR_LOOP_MAX_DIMS];
+  for(uptr tile = 0; tile < out->tile_count; ++tile){
+    Tensor in_view = tensor_chunked_tile_view(in, tensor_chunked_acquire(in, tile, false, false),
+					      coords, in_scratch);
+    f32* out_data = tensor_chunked_acquire(out, tile, in != out, true);
+    Tensor out_view = tensor_chunked_tile_view(out, out_data, coords, out_scratch);
+    Tensor_Iter it = tensor_iter_init(out->allocr, out_view);
+    (void)tensor_vector_op_inp(&it, sv, op, in_view);
+    tensor_iter_deinit(out->allocr, &it);
+    (void)tensor_chunked_next_tile(out->grid, out->ndim, coords);
+  }
+}
+
+Tensor tensor_chunked_reduce_op_inp(Tensor_Iter* out_iter, Tensor_Chunked* in, uptr dim, f32_binop* op){
+  tensor_iter_make_writable(out_iter);
+  assert(((void)"The dim to work on should exist in input tensor", dim < in->ndim));
+  assert(((void)"The output tensor's dimension count should be 1 less than input",
+	  out_iter->t.ndim == (in->ndim - 1)));
+  for_slice(tensor_shape(out_iter->t), i){
+    assert(((void)"The dimension of output must match input except for the chosen dimension to work on",
+	    in->shape[(i < dim) ? i : (i + 1)] == slice_inx(tensor_shape(out_iter->t), i)));
+  }
+  assert(((void)"The input tensor to reduce must have non-zero dim in the chosen index", in->shape[dim] > 0));
+
+  // Each tile is reduced on its own, and folded into the output region of the tile
+  //   The first tile along 'dim' writes its result directly
+  const Tensor out = out_iter->t;
+  uptr partial_shape[TENSOR_LOOP_MAX_DIMS];
+  uptr partial_elems = 1;
+  for(uptr d = 0, j = 0; d < in->ndim; ++d){
+    if(d == dim) continue;
+    partial_shape[j++] = in->tile_shape[d];
+    partial_elems *= in->tile_shape[d];
+  }
+  f32_Slice partial = SLICE_ALLOC(in->allocr, f32, partial_elems);
+  MEMCHK(partial.data);
 
+  uptr coords[TENSOR_LOOP_MAX_DIMS] = {0};
+  uptr in_scratch[2 * TENSOR_LOOP_MAX_DIMS], out_scratch[2 * TENSOR_LOOP_MAX_DIMS];
+  uptr part_scratch[2 * TENSOR_LOOP_MAX_DIMS];
+  for(uptr tile = 0; tile < in->tile_count; ++tile){
+    Tensor in_view = tensor_chunked_tile_view(in, tensor_chunked_acquire(in, tile, false, false),
+					      coords, in_scratch);
+    Tensor out_view = tensor_temp_view(out.storage, out.offset, out.ndim, out_scratch);
+    out_view.dtype = out.dtype;
+    Tensor part_view = tensor_temp_view(partial, 0, out.ndim, part_scratch);
+    iptr stride = 1;
+    for(uptr j = out.ndim; j-- > 0;){
+      const uptr d = (j < dim) ? j : (j + 1);
+      out_view.offset = (uptr)((iptr)out_view.offset +
+			       (iptr)(coords[d] * in->tile_shape[d]) * slice_inx(tensor_stride(out), j));
+      slice_inx(tensor_shape(out_view), j) = slice_inx(tensor_shape(in_view), d);
+      slice_inx(tensor_stride(out_view), j) = slice_inx(tensor_stride(out), j);
+      slice_inx(tensor_shape(part_view), j) = slice_inx(tensor_shape(in_view), d);
+      slice_inx(tensor_stride(part_view), j) = stride;
+      stride *= (iptr)partial_shape[j];
+    }
 
+    Tensor_Iter out_it = tensor_iter_init(in->allocr, out_view);
+    if(coords[dim] == 0){
+      (void)tensor_reduce_op_inp(&out_it, in_view, dim, op);
+    } else {
+      Tensor_Iter part_it = tensor_iter_init(in->allocr, part_view);
+      (void)tensor_reduce_op_inp(&part_it, in_view, dim, op);
+      tensor_iter_deinit(in->allocr, &part_it);
+      (void)tensor_bin_op_inp(&out_it, out_view, op, part_view);
+    }
+    tensor_iter_deinit(in->allocr, &out_it);
+    (void)tensor_chunked_next_tile(in->grid, in->ndim, coords);
+  }
+  SLICE_FREE(in->allocr, partial);
+  tensor_iter_finish(out_iter);
+  return out_iter->t;
+}
 
+Tensor tensor_chunked_reduce_op_new(Alloc_Interface allocr, Tensor_Chunked* in, uptr dim, f32_binop* op){
+  assert(((void)"The dim to work on should exist in input tensor", dim < in->ndim));
+  uptr shape[TENSOR_LOOP_MAX_DIMS];
+  for(uptr d = 0, j = 0; d < in->ndim; ++d) if(d != dim) shape[j++] = in->shape[d];
+  Tensor ans = tensor_alloc_(allocr, init_uptr_slice(shape, in->ndim - 1));
+  Tensor_Iter iter = tensor_iter_init(allocr, ans);
+  (void)tensor_chunked_reduce_op_inp(&iter, in, dim, op);
+  tensor_iter_deinit(allocr, &iter);
+  return ans;
+}
@@ -4,44 +4,121 @@
 
 #define UTIL_INCLUDE_ALL
 #include <util_headers.h>
+#include <stdio.h>
+#include <stdint.h>
 
-// Tensor data type -> f32
+// Tensor data type -> f32 by default, see 'Tensor_DType'
 DEF_SLICE(uptr);
 typedef uptr_Slice Tensor_Inx;
 
 void print_tensor_inx(Tensor_Inx);
 bool equal_tensor_inx(Tensor_Inx a, Tensor_Inx b);
 
+// Strides are signed, a negative stride walks its dimension backwards from the offset
+DEF_SLICE(iptr);
+typedef iptr_Slice Tensor_Strides;
+
+void print_tensor_strides(Tensor_Strides);
+
 DEF_SLICE(f32);
+// Tensors with up to this many dimensions keep their shape and stride inline,
+//   so making views of them never allocates
+#define TENSOR_INLINE_DIMS 8
+
+// Reference counted owner of the memory of tensors, shared by all the views into it
+typedef struct Tensor_Storage Tensor_Storage;
+
+// Element types of tensors, zero initialized (and stack) tensors are f32
+typedef enum Tensor_DType Tensor_DType;
+enum Tensor_DType {
+  TENSOR_F32 = 0,
+  TENSOR_F64,
+  // IEEE half and bfloat16, stored as raw 16 bit patterns
+  TENSOR_F16,
+  TENSOR_BF16,
+  TENSOR_I32,
+  TENSOR_I8,
+  TENSOR_DTYPE_COUNT,
+};
+
 typedef struct Tensor Tensor;
 struct Tensor {
+  // For dtypes other than f32, 'data' is just the address of the elements, and the
+  //   count, offset and strides are all in elements of that dtype
   f32_Slice storage;
-  // CAREFUL:: The following 3 slices can be null and still be valid (as long as no of dimensions is also 0)
-  // TODO:: Here, you have to store 'number of dimensions' thrice, fix that
-  Tensor_Inx shape;
-  Tensor_Inx stride;
-  Tensor_Inx offset;
-  // a flag to denote if this tensor owns the storage too
-  // TODO:: Make some external 'manager' later, or make reference counting
+  Tensor_DType dtype;
+  // Null for tensors made over external memory (like 'MAKE_STACK_TENSOR')
+  Tensor_Storage* shared;
+  // Position of the element at index (0, 0, ...) in the storage
+  uptr offset;
+  uptr ndim;
+  // CAREFUL:: Dont access these directly, use 'tensor_shape' and 'tensor_stride'
+  // Above TENSOR_INLINE_DIMS dimensions, shape and then stride are in 'dims_ext'
+  uptr shape_inl[TENSOR_INLINE_DIMS];
+  iptr stride_inl[TENSOR_INLINE_DIMS];
+  uptr* dims_ext;
+  // a flag to denote if this tensor made the storage, instead of being a view of another
+  // Views keep the storage alive too, so they can outlive the tensor they were made from
   bool owner;
 };
 
+static inline uptr* tensor_shape_ptr_(const Tensor* t){
+  return (t->ndim > TENSOR_INLINE_DIMS) ? t->dims_ext : (uptr*)t->shape_inl;
+}
+static inline iptr* tensor_stride_ptr_(const Tensor* t){
+  return (t->ndim > TENSOR_INLINE_DIMS) ? (iptr*)(t->dims_ext + t->ndim) : (iptr*)t->stride_inl;
+}
+// The returned index points inside the tensor, so 't' must be a variable that outlives it
+#define tensor_shape(t) ((Tensor_Inx){.data = tensor_shape_ptr_(&(t)), .count = (t).ndim})
+#define tensor_stride(t) ((Tensor_Strides){.data = tensor_stride_ptr_(&(t)), .count = (t).ndim})
+
 
 // An iterator for using tensors
 typedef struct Tensor_Iter Tensor_Iter;
 struct Tensor_Iter {
   Tensor t;
-  Tensor_Inx inx;
+  // CAREFUL:: Dont access these directly, use 'tensor_iter_inx'
+  uptr inx_inl[TENSOR_INLINE_DIMS];
+  uptr* inx_ext;
   bool first_time;
+  // Set when an inplace op had to clone a shared copy on write output into 't'
+  //   the clone is released by 'tensor_iter_deinit'
+  bool owns_storage;
 };
 
+static inline uptr* tensor_iter_inx_ptr_(const Tensor_Iter* iter){
+  return (iter->t.ndim > TENSOR_INLINE_DIMS) ? iter->inx_ext : (uptr*)iter->inx_inl;
+}
+// Current index of the iterator
+#define tensor_iter_inx(iter) ((Tensor_Inx){.data = tensor_iter_inx_ptr_(&(iter)), .count = (iter).t.ndim})
+
 Tensor_Iter tensor_iter_init(Alloc_Interface allocr, Tensor t);
 void tensor_iter_reset(Tensor_Iter* iter);
 void tensor_iter_deinit(Alloc_Interface allocr, Tensor_Iter* iter);
 bool tensor_iter_next(Tensor_Iter* iter);
 
 
+// Printing options, see 'TENSOR_PRINT_DEFAULTS'
+typedef struct Tensor_Print_Options Tensor_Print_Options;
+struct Tensor_Print_Options {
+  // Digits after the decimal point (at most 64)
+  uptr precision;
+  // Rows are wrapped to stay within this many characters, 0 never wraps
+  uptr line_width;
+  // Tensors with more elements than this are summarized with '...', keeping only
+  //   'edge_items' at both ends of each dimension (like numpy), 0 never summarizes
+  uptr threshold;
+  uptr edge_items;
+};
+#define TENSOR_PRINT_DEFAULTS							\
+  ((Tensor_Print_Options){.precision = 6, .line_width = 0, .threshold = 1000, .edge_items = 3})
+
 void tensor_print(Alloc_Interface allocr, Tensor t);
+// Same as 'tensor_print' but into 'file', returns false if writing failed
+bool tensor_fprint(FILE* file, Tensor t, Tensor_Print_Options opts);
+// Formats into 'buf' like snprintf, the text is cut to fit (always null terminated), and
+//   the return value is the full length, so it can be called with (nullptr, 0) to measure
+uptr tensor_format(char* buf, uptr buf_size, Tensor t, Tensor_Print_Options opts);
 f32* tensor_get_ptr_(Tensor t, Tensor_Inx inx);
 #define tensor_get(t, ...)					\
   (*tensor_get_ptr_((t), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__)))
@@ -56,17 +133,90 @@ Tensor tensor_create_(Alloc_Interface allocr, f32 fill_elem, Tensor_Inx shape);
 #define tensor_create(allocr, fill_elem, ...)				\
   tensor_create_((allocr), (fill_elem), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
 
-// TODO:: Add various types of rngs and dists later
-// Creates a new tensor, storage initialized with uniform random value (using rand())
+// Random numbers come from a counter based generator (Philox4x32-10), the seed picks
+//   the key and 'counter' counts the blocks of values used so far. Every value depends
+//   only on the key and its position, so fills are vectorized and split across threads
+//   without ever depending on the thread count. Setting 'counter' jumps to any point
+typedef struct Tensor_Rng Tensor_Rng;
+struct Tensor_Rng {
+  uint64_t key;
+  uint64_t counter;
+};
+Tensor_Rng tensor_rng_init(uint64_t seed);
+// Reseeds the global generator, used by the 'tensor_random*' functions and by fills
+//   that are passed a nullptr rng. It starts with seed 0
+void tensor_random_seed(uint64_t seed);
+
+// Fills every element of 't' (any view, of any dtype) in row major order with values
+//   drawn from 'rng', or from the global generator if it is nullptr
+// A shared copy on write 't' is made writable first ('tensor_make_writable'), so it
+//   then holds a new storage with the values
+void tensor_fill_uniform(Tensor_Rng* rng, Tensor* t, f32 min_val, f32 max_val);
+void tensor_fill_normal(Tensor_Rng* rng, Tensor* t, f32 mean, f32 std);
+// 1 with probability 'p', 0 otherwise
+void tensor_fill_bernoulli(Tensor_Rng* rng, Tensor* t, f32 p);
+// Normal values limited to [min_val, max_val], drawn by inverting the cdf (no resampling)
+void tensor_fill_truncated_normal(Tensor_Rng* rng, Tensor* t, f32 mean, f32 std, f32 min_val, f32 max_val);
+
+// Creates a new tensor, storage initialized with uniform random values in [min_val, max_val)
 Tensor tensor_random_(Alloc_Interface allocr, f32 min_val, f32 max_val, Tensor_Inx shape);
 #define tensor_random(allocr, min_val, max_val, ...)				\
   tensor_random_((allocr), (min_val), (max_val), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
 
+// Same with normal, bernoulli and truncated normal values, like the fills above
+Tensor tensor_random_normal_(Alloc_Interface allocr, f32 mean, f32 std, Tensor_Inx shape);
+#define tensor_random_normal(allocr, mean, std, ...)				\
+  tensor_random_normal_((allocr), (mean), (std), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+Tensor tensor_random_bernoulli_(Alloc_Interface allocr, f32 p, Tensor_Inx shape);
+#define tensor_random_bernoulli(allocr, p, ...)				\
+  tensor_random_bernoulli_((allocr), (p), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+Tensor tensor_random_truncated_normal_(Alloc_Interface allocr, f32 mean, f32 std,
+				       f32 min_val, f32 max_val, Tensor_Inx shape);
+#define tensor_random_truncated_normal(allocr, mean, std, min_val, max_val, ...) \
+  tensor_random_truncated_normal_((allocr), (mean), (std), (min_val), (max_val), \
+				  MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+
 // Creates a new tensor by forming a range
 Tensor tensor_range_(Alloc_Interface allocr, f32 start_val, f32 step_size, Tensor_Inx shape);
 #define tensor_range(allocr, start_val, step_size, ...)				\
   tensor_range_((allocr), (start_val), (step_size), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
 
+// Tensors of other element types
+//   Views, copies, and the map, binary, vector and reduce ops work on tensors of any
+//   dtype, mixed freely. Values are converted to f32 while loading and back while
+//   storing, so the math itself is always done in f32, and '_new' ops make outputs of
+//   the widest dtype among their inputs. The rest (tensor_get, matmul, lazy graphs,
+//   files) still need f32 tensors, use 'tensor_to_dtype' to convert for those.
+// Size of one element in bytes
+uptr tensor_dtype_size(Tensor_DType dtype);
+const char* tensor_dtype_name(Tensor_DType dtype);
+
+// Creates a new tensor of the given dtype, storage uninitialized
+Tensor tensor_alloc_dtype_(Alloc_Interface allocr, Tensor_DType dtype, Tensor_Inx shape);
+#define tensor_alloc_dtype(allocr, dtype, ...)				\
+  tensor_alloc_dtype_((allocr), (dtype), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+
+// Creates a new tensor of the given dtype, storage initialized with given value
+Tensor tensor_create_dtype_(Alloc_Interface allocr, Tensor_DType dtype, f64 fill_elem, Tensor_Inx shape);
+#define tensor_create_dtype(allocr, dtype, fill_elem, ...)		\
+  tensor_create_dtype_((allocr), (dtype), (fill_elem), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+
+// Creates a new contiguous tensor with the elements of 't' converted to 'dtype'
+// Converting to integers truncates toward zero and saturates, nan becomes 0
+Tensor tensor_to_dtype(Alloc_Interface allocr, Tensor t, Tensor_DType dtype);
+
+// Converts 'count' contiguous elements, same rules as 'tensor_to_dtype'
+// Half types use F16C and AVX-512 BF16 instructions when the cpu has them
+void tensor_convert(Tensor_DType dst_dtype, void* dst, Tensor_DType src_dtype, const void* src, uptr count);
+
+// Reads and writes single elements of tensors of any dtype
+f64 tensor_get_value_(Tensor t, Tensor_Inx inx);
+void tensor_set_value_(Tensor t, Tensor_Inx inx, f64 value);
+#define tensor_get_value(t, ...)					\
+  tensor_get_value_((t), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+#define tensor_set_value(t, value, ...)					\
+  tensor_set_value_((t), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__), (value))
+
 // [start, end)
 Tensor tensor_slice_(Alloc_Interface allocr, Tensor src, Tensor_Inx start, Tensor_Inx end);
 // Send in indexes by wrapping in a bracket 
@@ -75,15 +225,150 @@ Tensor tensor_slice_(Alloc_Interface allocr, Tensor src, Tensor_Inx start, Tenso
 		MAKE_ARRAY_SLICE(uptr, JUST_DO_NOTHING start_inxs),	\
 		MAKE_ARRAY_SLICE(uptr, JUST_DO_NOTHING end_inxs))
 
+// Same as 'tensor_slice', but only every step'th element of [start, end) along each dimension
+//   Negative steps go backwards from the last element of [start, end) (like x[start:end][::step])
+//   The result always shares the storage, the strides just become negative
+Tensor tensor_slice_step_(Alloc_Interface allocr, Tensor src, Tensor_Inx start, Tensor_Inx end,
+			  Tensor_Strides steps);
+#define tensor_slice_step(allocr, tensor, start_inxs, end_inxs, steps)	\
+  tensor_slice_step_((allocr), (tensor),				\
+		     MAKE_ARRAY_SLICE(uptr, JUST_DO_NOTHING start_inxs),	\
+		     MAKE_ARRAY_SLICE(uptr, JUST_DO_NOTHING end_inxs),	\
+		     MAKE_ARRAY_SLICE(iptr, JUST_DO_NOTHING steps))
+
+// Creates a new tensor that shares the storage, with dimension 'dim' in reverse order
+Tensor tensor_flip(Alloc_Interface allocr, Tensor t, uptr dim);
+void tensor_flip_in_place(Tensor* t, uptr dim);
+
+// Creates a new tensor that shares the storage, but is repeated along size 1 or new leading
+//   dimensions to have the given shape (like numpy broadcasting), no data is copied
+// Multiple indexes of the view refer to the same element, so dont write into it
+Tensor tensor_expand_(Alloc_Interface allocr, Tensor src, Tensor_Inx shape);
+#define tensor_expand(allocr, tensor, ...)				\
+  tensor_expand_((allocr), (tensor), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+
+// Creates a tensor with the same elements in row major order, but a different shape
+//   Whenever the strides allow it, this is a view that shares the storage (owner = false),
+//   else the elements are copied into a new contiguous tensor (owner = true)
+//   'copied' (can be null) is set to which of them happened, so hot paths can assert on it
+// One of the dimensions can be TENSOR_INFER_DIM, it is then worked out from the others
+#define TENSOR_INFER_DIM ((uptr)-1)
+Tensor tensor_reshape_(Alloc_Interface allocr, Tensor t, Tensor_Inx shape, bool* copied);
+#define tensor_reshape(allocr, tensor, copied, ...)			\
+  tensor_reshape_((allocr), (tensor), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__), (copied))
+// Reshapes to the shape of 'like', same rules as 'tensor_reshape'
+Tensor tensor_view_as(Alloc_Interface allocr, Tensor t, Tensor like, bool* copied);
+// Merges the dimensions from 'start_dim' to 'end_dim' (both included) into one, same rules as 'tensor_reshape'
+Tensor tensor_flatten(Alloc_Interface allocr, Tensor t, uptr start_dim, uptr end_dim, bool* copied);
+
+// Removes the size 1 dimension 'dim', or all the size 1 dimensions for TENSOR_SQUEEZE_ALL
+// Inserts a size 1 dimension so that it becomes the dimension 'dim' (0 to ndim)
+//   Both always share the storage, as no strides have to change
+#define TENSOR_SQUEEZE_ALL ((uptr)-1)
+Tensor tensor_squeeze(Alloc_Interface allocr, Tensor t, uptr dim);
+Tensor tensor_unsqueeze(Alloc_Interface allocr, Tensor t, uptr dim);
+
 // Creates a new tensor that shares the storage and has permuted indexes
 Tensor tensor_permute(Alloc_Interface allocr, Tensor t, uptr inx1, uptr inx2);
 
 // Seems like this would also be a really important function
-void tensor_permute_in_place(Tensor t, uptr inx1, uptr inx2);
+void tensor_permute_in_place(Tensor* t, uptr inx1, uptr inx2);
 
+// Releases the reference to the storage, which is freed with its last reference
 void tensor_free(Alloc_Interface allocr, Tensor* t);
 uptr tensor_size(Tensor t);
 
+// Reference counted storage
+// Another tensor with same view of the same storage, free it like any other tensor
+Tensor tensor_share(Alloc_Interface allocr, Tensor t);
+// Number of tensors (and views) holding the storage, 0 for external memory
+uptr tensor_storage_refs(Tensor t);
+// In copy on write mode 'tensor_dupe' only shares the storage, and the actual copy is
+//   made by 'tensor_make_writable' if the storage is still shared at that time
+// Inplace ops clone a shared copy on write output before writing, into the iterator's
+//   tensor, which then holds the result (the tensor it was made from keeps the old data)
+void tensor_set_copy_on_write(Tensor t, bool enable);
+// Clones the viewed elements into a new (contiguous) storage if the storage is copy
+//   on write and shared with anything else, returns true if a copy was made
+bool tensor_make_writable(Alloc_Interface allocr, Tensor* t);
+
+// Arena allocator
+// Allocations are bumped out of big blocks, and are all released together by resetting
+//   to a mark taken earlier, freeing single allocations does nothing
+// Useful for the temporaries (views, iterators, intermediate results) of a whole request
+// An arena is not thread safe, give each thread its own
+// CAREFUL:: Tensors allocated after a mark must not be used after resetting to it
+typedef struct Tensor_Arena_Block Tensor_Arena_Block;
+typedef struct Tensor_Arena Tensor_Arena;
+struct Tensor_Arena {
+  Alloc_Interface backing;
+  uptr block_size;
+  Tensor_Arena_Block* first;
+  Tensor_Arena_Block* current;
+};
+typedef struct Tensor_Arena_Mark Tensor_Arena_Mark;
+struct Tensor_Arena_Mark {
+  Tensor_Arena_Block* block;
+  uptr used;
+};
+
+// Blocks are at least 'block_size' bytes, taken from 'backing' when needed
+Tensor_Arena tensor_arena_init(Alloc_Interface backing, uptr block_size);
+// Returns all the blocks to the backing allocator
+void tensor_arena_deinit(Tensor_Arena* arena);
+Alloc_Interface tensor_arena_allocator(Tensor_Arena* arena);
+Tensor_Arena_Mark tensor_arena_mark(Tensor_Arena* arena);
+// Releases everything allocated after the mark, the memory is kept for reuse
+void tensor_arena_reset(Tensor_Arena* arena, Tensor_Arena_Mark mark);
+// Total bytes held from the backing allocator
+uptr tensor_arena_capacity(const Tensor_Arena* arena);
+
+// Buffer pool
+// Caches freed blocks by size class, so that allocating the same shapes again and again
+//   reuses already touched memory instead of going to the allocator each time
+// Blocks are kept until 'cap_bytes' are cached, after that frees go to the backing allocator
+// It is thread safe, tensors can be allocated and freed from any thread
+// Tensors from the pool must be freed with the pool's allocator before destroying it
+typedef struct Tensor_Buffer_Pool Tensor_Buffer_Pool;
+typedef struct Tensor_Buffer_Stats Tensor_Buffer_Stats;
+struct Tensor_Buffer_Stats {
+  // Allocations served from the cache, and the ones that went to the backing allocator
+  uptr hits;
+  uptr misses;
+  // Frees that didnt fit under the cap
+  uptr evictions;
+  // Bytes currently cached
+  uptr retained_bytes;
+  uptr peak_retained_bytes;
+};
+
+Tensor_Buffer_Pool* tensor_buffer_pool_create(Alloc_Interface backing, uptr cap_bytes);
+void tensor_buffer_pool_destroy(Tensor_Buffer_Pool* pool);
+// Gives every cached block back to the backing allocator
+void tensor_buffer_pool_trim(Tensor_Buffer_Pool* pool);
+Tensor_Buffer_Stats tensor_buffer_pool_stats(Tensor_Buffer_Pool* pool);
+Alloc_Interface tensor_buffer_pool_allocator(Tensor_Buffer_Pool* pool);
+
+// Same as tensor_alloc, but with the pool's allocator, free it with that one too
+Tensor tensor_alloc_pooled_(Tensor_Buffer_Pool* pool, Tensor_Inx shape);
+#define tensor_alloc_pooled(pool, ...)				\
+  tensor_alloc_pooled_((pool), MAKE_ARRAY_SLICE(uptr, __VA_ARGS__))
+
+// Threading of the tensor ops
+// Elementwise ops (both '_new' and '_inp' versions) split their work across a
+//   built in thread pool when the output has at least 'threshold' elements
+// Sets the number of threads (including the caller), 0 means number of online cpus
+void tensor_set_num_threads(uptr count);
+uptr tensor_get_num_threads(void);
+// Ops with fewer elements than this run serially on the calling thread
+void tensor_set_parallel_threshold(uptr elem_count);
+// Joins the worker threads, they are started again lazily if needed
+void tensor_threads_shutdown(void);
+// Reductions are always reproducible across thread counts, deterministic mode
+//   also uses a fixed accumulation layout instead of the widest SIMD of the cpu,
+//   so results are bitwise same across machines too
+void tensor_set_deterministic(bool enable);
+
 
 DEF_SLICE(Tensor);
 
@@ -109,6 +394,8 @@ DEF_SLICE(Tensor);
 
 typedef f32 f32_binop(f32 a, f32 b);
 // Some common fp binop functions to be used as fp operation pointers
+// These are recognized by their address inside the ops and run through SIMD kernels
+//   any other function pointer is called per element as usual
 // TODO:: Add test cases for all usages of these functions later
 f32 f32_add_op(f32 a, f32 b);
 f32 f32_prod_op(f32 a, f32 b);
@@ -118,6 +405,9 @@ f32 f32_min_op(f32 a, f32 b);
 
 // Need to send in than more one tensors here
 //   This is otherwise similar to chaining operations from 'elemwise_op'
+// Input tensors are broadcasted like numpy, size 1 or missing leading dimensions are
+//   repeated to match the others (with 0 stride, no copy), eg: (5,1,3) and (4,3) -> (5,4,3)
+// For the '_inp' version, inputs must be broadcastable to the output's shape
 TENSOR_OP_DECLFN(tensor_map_op, Tensor_Slice ts, f32_binop* op);
 #define tensor_map_op(allocr_or_outiter, in_slice, op_fn)	\
   TENSOR_OP_CHOOSE(tensor_map_op, allocr_or_outiter, in_slice, op_fn)
@@ -145,8 +435,12 @@ TENSOR_OP_DECLFN(tensor_vector_op, f32 sv, f32_binop* op, Tensor tv);
 #define tensor_vmin(allocr_or_outiter, fval, tval) tensor_vector_op(allocr_or_outiter, fval, f32_min_op, tval);
 
 // Vectorization like operation, but for small tensor and big tensor
+//   is just 'tensor_bin_op' with broadcasting, see 'tensor_map_op' above
 
 // Reduce operation that uses elemwise many op inside
+// Predefined ops are folded as a fixed pairwise tree over blocks of the reduced dimension
+//   so sums stay accurate for long rows, and the result never depends on the thread count
+// Custom ops are always folded in order, as op(op(x0, x1), x2) ...
 TENSOR_OP_DECLFN(tensor_reduce_op, Tensor tensorv, uptr dim, f32_binop* opfn);
 #define tensor_reduce_op(allocr_or_outiter, tensorv, dim, opfn)	\
   TENSOR_OP_CHOOSE(tensor_reduce_op, allocr_or_outiter, tensorv, dim, opfn)
@@ -156,9 +450,227 @@ TENSOR_OP_DECLFN(tensor_reduce_op, Tensor tensorv, uptr dim, f32_binop* opfn);
 #define tensor_rmax(allocr_or_outiter, tval, dim) tensor_reduce_op(allocr_or_outiter, tval, dim, f32_max_op);
 #define tensor_rmin(allocr_or_outiter, tval, dim) tensor_reduce_op(allocr_or_outiter, tval, dim, f32_min_op);
 
+// Sliding windows of 'size' elements along 'dim', a new one starting every 'step' elements
+//   'dim' becomes the number of windows and the window is the new last dimension
+//   The windows overlap in the storage, nothing is copied, so dont write into it
+Tensor tensor_unfold(Alloc_Interface allocr, Tensor t, uptr dim, uptr size, uptr step);
+
+// Pooling along 'dim', each output element is the op folded over one window of 'tensor_unfold'
+//   The output has the shape of the input, with the number of windows along 'dim'
+//   Window sizes of 1 just copy, a step of 1 gives rolling max, min ...
+TENSOR_OP_DECLFN(tensor_pool_op, Tensor t, uptr dim, uptr size, uptr step, f32_binop* opfn);
+#define tensor_pool_op(allocr_or_outiter, t, dim, size, step, opfn)	\
+  TENSOR_OP_CHOOSE(tensor_pool_op, allocr_or_outiter, t, dim, size, step, opfn)
+#define tensor_max_pool(allocr_or_outiter, t, dim, size, step) tensor_pool_op(allocr_or_outiter, t, dim, size, step, f32_max_op)
+TENSOR_OP_DECLFN(tensor_avg_pool, Tensor t, uptr dim, uptr size, uptr step);
+#define tensor_avg_pool(allocr_or_outiter, t, dim, size, step)		\
+  TENSOR_OP_CHOOSE(tensor_avg_pool, allocr_or_outiter, t, dim, size, step)
+
+// Same over the last 2 dimensions, as a pass along each (so the op should not care about order)
+TENSOR_OP_DECLFN(tensor_pool2d_op, Tensor t, uptr size_h, uptr size_w, uptr step_h, uptr step_w, f32_binop* opfn);
+#define tensor_pool2d_op(allocr_or_outiter, t, size_h, size_w, step_h, step_w, opfn) \
+  TENSOR_OP_CHOOSE(tensor_pool2d_op, allocr_or_outiter, t, size_h, size_w, step_h, step_w, opfn)
+#define tensor_max_pool2d(allocr_or_outiter, t, size_h, size_w, step_h, step_w)	\
+  tensor_pool2d_op(allocr_or_outiter, t, size_h, size_w, step_h, step_w, f32_max_op)
+TENSOR_OP_DECLFN(tensor_avg_pool2d, Tensor t, uptr size_h, uptr size_w, uptr step_h, uptr step_w);
+#define tensor_avg_pool2d(allocr_or_outiter, t, size_h, size_w, step_h, step_w) \
+  TENSOR_OP_CHOOSE(tensor_avg_pool2d, allocr_or_outiter, t, size_h, size_w, step_h, step_w)
+
+// Sums and means of every 'window' consecutive elements along 'dim' (f32 only)
+//   Each window is updated from the one before, so the cost doesnt grow with the window size
+TENSOR_OP_DECLFN(tensor_rolling_sum, Tensor t, uptr dim, uptr window);
+#define tensor_rolling_sum(allocr_or_outiter, t, dim, window)		\
+  TENSOR_OP_CHOOSE(tensor_rolling_sum, allocr_or_outiter, t, dim, window)
+TENSOR_OP_DECLFN(tensor_rolling_mean, Tensor t, uptr dim, uptr window);
+#define tensor_rolling_mean(allocr_or_outiter, t, dim, window)		\
+  TENSOR_OP_CHOOSE(tensor_rolling_mean, allocr_or_outiter, t, dim, window)
+
+// Softmax along 'dim', exp(x - max) / sum(exp(x - max)) over each line (f32 only)
+//   Done in one fused kernel, without temporaries, and stable for large inputs. -inf gives 0
+TENSOR_OP_DECLFN(tensor_softmax, Tensor t, uptr dim);
+#define tensor_softmax(allocr_or_outiter, t, dim)		\
+  TENSOR_OP_CHOOSE(tensor_softmax, allocr_or_outiter, t, dim)
+// Log of the softmax, x - max - log(sum(exp(x - max)))
+TENSOR_OP_DECLFN(tensor_log_softmax, Tensor t, uptr dim);
+#define tensor_log_softmax(allocr_or_outiter, t, dim)		\
+  TENSOR_OP_CHOOSE(tensor_log_softmax, allocr_or_outiter, t, dim)
+// log(sum(exp(x))) along 'dim', which is removed like in 'tensor_reduce_op'
+TENSOR_OP_DECLFN(tensor_logsumexp, Tensor t, uptr dim);
+#define tensor_logsumexp(allocr_or_outiter, t, dim)		\
+  TENSOR_OP_CHOOSE(tensor_logsumexp, allocr_or_outiter, t, dim)
+
+// Matrix multiplication of 2 dimensional tensors, (m, k) x (k, n) -> (m, n)
+// Inputs can be any views (sliced, permuted ..), they are read through their strides
+// The output must not share storage with the inputs
+TENSOR_OP_DECLFN(tensor_matmul, Tensor a, Tensor b);
+#define tensor_matmul(allocr_or_outiter, a, b)			\
+  TENSOR_OP_CHOOSE(tensor_matmul, allocr_or_outiter, a, b)
+
+// Batched matrix multiplication, (..., m, k) x (..., k, n) -> (..., m, n)
+// Leading dimensions are batches, read through their strides (so slices and permutations
+//   are fine) and broadcasted like in 'tensor_map_op', eg: (b, m, k) x (k, n) -> (b, m, n)
+TENSOR_OP_DECLFN(tensor_bmm, Tensor a, Tensor b);
+#define tensor_bmm(allocr_or_outiter, a, b)			\
+  TENSOR_OP_CHOOSE(tensor_bmm, allocr_or_outiter, a, b)
+
+// Convolutions, see 'TENSOR_CONV_DEFAULTS'
+typedef struct Tensor_Conv_Options Tensor_Conv_Options;
+struct Tensor_Conv_Options {
+  // Along (h, w) for 2d convolutions, 1d ones use only the first
+  uptr stride[2];
+  // Zeros added on both sides of the input
+  uptr padding[2];
+  // Spacing between the kernel elements
+  uptr dilation[2];
+  // Channels are split into this many groups, each only sees its own input channels
+  uptr groups;
+};
+#define TENSOR_CONV_DEFAULTS						\
+  ((Tensor_Conv_Options){.stride = {1, 1}, .padding = {0, 0}, .dilation = {1, 1}, .groups = 1})
+
+// 1d convolution (cross correlation, like most libraries), input (n, c_in, l) with
+//   weights (c_out, c_in / groups, k) gives (n, c_out, l_out) (f32 only)
+// Inputs can be any views, channels last ones are (n, l, c) tensors permuted to (n, c, l)
+//   The output of the '_new' version has the same layout as the input
+// The output must not share storage with the inputs
+TENSOR_OP_DECLFN(tensor_conv1d, Tensor in, Tensor weight, Tensor_Conv_Options opts);
+#define tensor_conv1d(allocr_or_outiter, in, weight, opts)		\
+  TENSOR_OP_CHOOSE(tensor_conv1d, allocr_or_outiter, in, weight, opts)
+
+// Same in 2d, input (n, c_in, h, w) with weights (c_out, c_in / groups, kh, kw)
+TENSOR_OP_DECLFN(tensor_conv2d, Tensor in, Tensor weight, Tensor_Conv_Options opts);
+#define tensor_conv2d(allocr_or_outiter, in, weight, opts)		\
+  TENSOR_OP_CHOOSE(tensor_conv2d, allocr_or_outiter, in, weight, opts)
+
+// Integer matrix multiplication of 2 dimensional i8 tensors into an i32 tensor
+// Inputs can be any views, the result is exact as long as it fits in i32
+TENSOR_OP_DECLFN(tensor_matmul_i8, Tensor a, Tensor b);
+#define tensor_matmul_i8(allocr_or_outiter, a, b)		\
+  TENSOR_OP_CHOOSE(tensor_matmul_i8, allocr_or_outiter, a, b)
+
+// Affine quantized tensors, an element stands for scale * (value - zero_point)
+// With an 'axis', every index along it (a channel) has its own scale and zero point
+#define TENSOR_QUANT_PER_TENSOR ((uptr)-1)
+typedef struct Tensor_Quantized Tensor_Quantized;
+struct Tensor_Quantized {
+  // i8 tensor, can be any view (the other fields must then be viewed to match)
+  Tensor values;
+  // Dimension of 'values' that has the channels, or TENSOR_QUANT_PER_TENSOR
+  uptr axis;
+  // f32 and i32 tensors of shape (channels), shape (1) when per tensor
+  Tensor scales;
+  Tensor zero_points;
+};
+
+// Quantizes 't' (of any dtype) to i8, with scales and zero points fitted to the range
+//   of each channel. 'symmetric' keeps the zero points at 0 (usual for weights)
+Tensor_Quantized tensor_quantize(Alloc_Interface allocr, Tensor t, uptr axis, bool symmetric);
+// Same, but with given scales and zero points, rounding to nearest and saturating
+Tensor_Quantized tensor_quantize_with(Alloc_Interface allocr, Tensor t, uptr axis, Tensor scales, Tensor zero_points);
+// Creates a new f32 tensor of the real values
+Tensor tensor_dequantize(Alloc_Interface allocr, Tensor_Quantized q);
+void tensor_quantized_free(Alloc_Interface allocr, Tensor_Quantized* q);
+
+// Matrix multiplication of quantized matrices into an f32 tensor, through 'tensor_matmul_i8'
+// 'a' must be quantized per tensor or per row (axis 0), 'b' per tensor or per column (axis 1)
+TENSOR_OP_DECLFN(tensor_qmatmul, Tensor_Quantized a, Tensor_Quantized b);
+#define tensor_qmatmul(allocr_or_outiter, a, b)			\
+  TENSOR_OP_CHOOSE(tensor_qmatmul, allocr_or_outiter, a, b)
+
+// Lazy evaluation
+// The 'tensor_lazy_*' functions only record the operation as a node in the graph,
+//   and 'tensor_force' computes the expression in one go. Elementwise and vector ops
+//   (and a reduction at the end) are fused into a single pass over the output, without
+//   making any intermediate tensors. Reductions in the middle are computed separately
+// Leaf tensors are not copied, they must stay valid until the expression is forced
+typedef struct Tensor_Expr Tensor_Expr;
+typedef struct Tensor_Graph Tensor_Graph;
+struct Tensor_Graph {
+  Alloc_Interface allocr;
+  Tensor_Expr* nodes;
+};
+Tensor_Graph tensor_graph_init(Alloc_Interface allocr);
+// Frees all the nodes, and the temporaries made while forcing them
+void tensor_graph_deinit(Tensor_Graph* graph);
+
+Tensor_Expr* tensor_lazy(Tensor_Graph* graph, Tensor t);
+// Shapes are broadcasted like in 'tensor_map_op'
+Tensor_Expr* tensor_lazy_bin_op(Tensor_Graph* graph, Tensor_Expr* a, f32_binop* op, Tensor_Expr* b);
+Tensor_Expr* tensor_lazy_vector_op(Tensor_Graph* graph, f32 sv, f32_binop* op, Tensor_Expr* a);
+Tensor_Expr* tensor_lazy_reduce_op(Tensor_Graph* graph, Tensor_Expr* a, uptr dim, f32_binop* op);
+// Shape of the result, points inside the node
+Tensor_Inx tensor_expr_shape(Tensor_Expr* expr);
+
+#define tensor_lazy_add(graph, a, b) tensor_lazy_bin_op(graph, a, f32_add_op, b)
+#define tensor_lazy_prod(graph, a, b) tensor_lazy_bin_op(graph, a, f32_prod_op, b)
+#define tensor_lazy_max(graph, a, b) tensor_lazy_bin_op(graph, a, f32_max_op, b)
+#define tensor_lazy_min(graph, a, b) tensor_lazy_bin_op(graph, a, f32_min_op, b)
+#define tensor_lazy_vadd(graph, fval, a) tensor_lazy_vector_op(graph, fval, f32_add_op, a)
+#define tensor_lazy_vprod(graph, fval, a) tensor_lazy_vector_op(graph, fval, f32_prod_op, a)
+#define tensor_lazy_radd(graph, a, dim) tensor_lazy_reduce_op(graph, a, dim, f32_add_op)
+#define tensor_lazy_rmax(graph, a, dim) tensor_lazy_reduce_op(graph, a, dim, f32_max_op)
+
+// Computes the expression, the output must have the shape of the expression
+TENSOR_OP_DECLFN(tensor_force, Tensor_Expr* expr);
+#define tensor_force(allocr_or_outiter, expr)			\
+  TENSOR_OP_CHOOSE(tensor_force, allocr_or_outiter, expr)
+
+// Binary tensor files
+// The file holds the shape and strides, then the elements (64 byte aligned) in native byte order
+// These return false if the file couldnot be written or read, or isnot a valid tensor file
+bool tensor_save(Alloc_Interface allocr, Tensor t, const char* path);
+bool tensor_load(Alloc_Interface allocr, const char* path, Tensor* out);
+// Maps the file instead of reading it, the storage points into the mapping (owner is false)
+// Pages are shared through the page cache, writing into the tensor only changes a private copy
+// The file is unmapped when the last tensor using it is freed
+bool tensor_load_mmap(Alloc_Interface allocr, const char* path, Tensor* out);
+
+// NumPy files
+// f32 arrays are mapped and used in place (owner is false), like 'tensor_load_mmap'
+// Other dtypes (f16/f64, signed/unsigned ints, bool) are converted while being read
+// Fortran order arrays are loaded as column major strides
+bool tensor_load_npy(Alloc_Interface allocr, const char* path, Tensor* out);
+// Writes '<f4' (or '>f4' on big endian), column major tensors are written as fortran order
+bool tensor_save_npy(Alloc_Interface allocr, Tensor t, const char* path);
+// Only uncompressed archives (np.savez, not np.savez_compressed), 'name' may skip the '.npy'
+bool tensor_load_npz(Alloc_Interface allocr, const char* path, const char* name, Tensor* out);
+// Saves each tensor as 'names[i].npy' of an uncompressed archive
+bool tensor_save_npz(Alloc_Interface allocr, const char* path, Tensor_Slice ts, const char* const names[]);
+
+// Chunked tensors
+// For tensors larger than memory, the elements are kept in a file split into tiles of
+//   'tile_shape', and at most 'cache_tiles' tiles are held in memory at a time
+// Operations go over the tiles in file order, and the next tiles are read ahead
+// Tensors used together in an operation must have the same shape and tile shape
+// One chunked tensor must not be used from many threads at once
+typedef struct Tensor_Chunked Tensor_Chunked;
+// Creates (or overwrites) the file, elements start out as 0, returns nullptr on failure
+Tensor_Chunked* tensor_chunked_create(Alloc_Interface allocr, const char* path, Tensor_Inx shape,
+				      Tensor_Inx tile_shape, uptr cache_tiles);
+Tensor_Chunked* tensor_chunked_open(Alloc_Interface allocr, const char* path, uptr cache_tiles);
+// Writes back the modified tiles, returns false if any file operation failed so far
+bool tensor_chunked_flush(Tensor_Chunked* ct);
+bool tensor_chunked_close(Tensor_Chunked* ct);
+Tensor_Inx tensor_chunked_shape(Tensor_Chunked* ct);
+// Number of tiles to ask the OS to read ahead of the current one
+void tensor_chunked_set_readahead(Tensor_Chunked* ct, uptr tiles);
+
+// Copy an in memory tensor into the region starting at 'start', and back out of it
+void tensor_chunked_store(Tensor_Chunked* ct, Tensor_Inx start, Tensor src);
+Tensor tensor_chunked_load(Tensor_Iter* out_iter, Tensor_Chunked* ct, Tensor_Inx start);
+
+// Same as 'tensor_map_op' and 'tensor_vector_op', tile by tile, 'out' may also be an input
+void tensor_chunked_map_op(Tensor_Chunked* out, Tensor_Chunked* const ins[], uptr count, f32_binop* op);
+void tensor_chunked_vector_op(Tensor_Chunked* out, f32 sv, f32_binop* op, Tensor_Chunked* in);
+// Reduces into an in memory tensor, only the result has to fit in memory
+TENSOR_OP_DECLFN(tensor_chunked_reduce_op, Tensor_Chunked* in, uptr dim, f32_binop* op);
+#define tensor_chunked_reduce_op(allocr_or_outiter, in, dim, opfn)	\
+  TENSOR_OP_CHOOSE(tensor_chunked_reduce_op, allocr_or_outiter, in, dim, opfn)
+
 // Creates a new tensor without trying to make it contiguous if original was not
 Tensor tensor_dupe(Alloc_Interface allocr, Tensor t);
 // Creates a new tensor by always making a new contiguous tensor
+//   Permuted views are copied by transposing in cache sized tiles, over many threads if large
 Tensor tensor_contiguous(Alloc_Interface allocr, Tensor t);
 
 // Some macros to make life easier
@@ -178,13 +690,9 @@ Tensor tensor_assume_contiguous_fix_stride(Tensor in);
   tensor_assume_contiguous_fix_stride					\
   ((Tensor){.storage = {.data = ((f32*)((f32 FOR_EACH_VA(INDEX_ARG_FE, __VA_ARGS__)) JUST_DO_NOTHING tensor_elems)), \
 			.count = (1 FOR_EACH_VA(PROD_FE, __VA_ARGS__)),}, \
-    .shape = {.data = ((uptr[]){__VA_ARGS__}),				\
-	      .count = VA_NARGS(__VA_ARGS__),},				\
-	      .stride = {.data = ((uptr[]){__VA_ARGS__}),		\
-			 .count = VA_NARGS(__VA_ARGS__),},		\
-	      .owner = true,						\
-	      .offset = {.data = ((uptr[VA_NARGS(__VA_ARGS__)]){0}),	\
-			 .count = VA_NARGS(__VA_ARGS__),}		\
+	    .ndim = VA_NARGS(__VA_ARGS__),				\
+	    .shape_inl = {__VA_ARGS__},					\
+	    .owner = true,						\
 	    })
    
 #endif //TENSOR_H
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int arena_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  Tensor_Arena arena = tensor_arena_init(allocr, 1 << 16);
+  const Alloc_Interface temp = tensor_arena_allocator(&arena);
+
+  // The result outlives the arena, so it is taken from the normal allocator
+  Tensor result = tensor_create(allocr, 0.f, 4);
+  Tensor_Iter result_iter = tensor_iter_init(allocr, result);
+
+  void* first_data = nullptr;
+  uptr first_capacity = 0;
+  for(int pass = 0; pass < 3; ++pass){
+    const Tensor_Arena_Mark mark = tensor_arena_mark(&arena);
+
+    // Temporaries, views and iterators of one 'request' are all on the arena
+    Tensor t1 = tensor_range(temp, (f32)pass, 0.5f, 3, 4);
+    Tensor t1_p = tensor_permute(temp, t1, 0, 1);
+    Tensor t2 = tensor_vprod(temp, 2.f, t1_p);
+    Tensor t3 = tensor_radd(temp, t2, 1);
+    (void)tensor_add(&result_iter, result, t3);
+
+    printf("Pass %d, reduced: \n", pass);
+    tensor_print(allocr, t3);
+    printf("\n");
+
+    if(pass == 0){
+      first_data = t1.storage.data;
+      first_capacity = tensor_arena_capacity(&arena);
+    } else {
+      printf("Reused memory: %s, Arena grew: %s\n",
+	     BOOLSTR(first_data == t1.storage.data),
+	     BOOLSTR(first_capacity != tensor_arena_capacity(&arena)));
+    }
+    // Nothing is freed one by one, resetting drops everything at once
+    tensor_arena_reset(&arena, mark);
+  }
+
+  // Allocations bigger than a block get a block of their own
+  const Tensor_Arena_Mark mark = tensor_arena_mark(&arena);
+  Tensor big = tensor_create(temp, 1.f, 128, 256);
+  printf("\nSum of a big tensor: ");
+  Tensor big_rows = tensor_radd(temp, big, 1);
+  Tensor big_sum = tensor_radd(temp, big_rows, 0);
+  tensor_print(allocr, big_sum);
+  printf("\nArena grew: %s\n", BOOLSTR(first_capacity != tensor_arena_capacity(&arena)));
+  tensor_arena_reset(&arena, mark);
+
+  printf("\nAccumulated result: \n");
+  tensor_print(allocr, result);
+
+  tensor_arena_deinit(&arena);
+  tensor_iter_deinit(allocr, &result_iter);
+  tensor_free(allocr, &result);
+
+#undef BOOLSTR
+  return 0;
+}
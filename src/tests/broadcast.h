@@ -0,0 +1,59 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int broadcast_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  // Adding a bias vector to every row
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 2, 3);
+  Tensor bias = MAKE_STACK_TENSOR(({10, 20, 30}), 3);
+  Tensor t2 = tensor_add(allocr, t1, bias);
+  printf("Matrix: \n");
+  tensor_print(allocr, t1);
+  printf("\nPlus bias: \n");
+  tensor_print(allocr, bias);
+  printf("\n=\n");
+  tensor_print(allocr, t2);
+
+  // Column times row gives the outer product
+  Tensor col = tensor_range(allocr, 1.f, 1.f, 3, 1);
+  Tensor row = tensor_range(allocr, 1.f, 1.f, 1, 4);
+  Tensor t3 = tensor_prod(allocr, col, row);
+  printf("\nOuter product of (3,1) and (1,4): \n");
+  print_tensor_inx(tensor_shape(t3));
+  printf("\n");
+  tensor_print(allocr, t3);
+
+  // Explicit view, no data is copied
+  Tensor t4 = tensor_expand(allocr, bias, 4, 3);
+  printf("\nExpanded view: \n");
+  printf("\nShape: ");
+  print_tensor_inx(tensor_shape(t4));
+  printf("\nStride: ");
+  print_tensor_strides(tensor_stride(t4));
+  printf("\nOffset: ");
+  printf("%zu", t4.offset);
+  printf("\nShares storage: %s\n", ((t4.storage.data == bias.storage.data) ? "Yes" : "No"));
+  tensor_print(allocr, t4);
+
+  // Inplace into a slice, with a broadcasted operand
+  Tensor buf = tensor_create(allocr, 0.f, 4, 5);
+  Tensor buf_s = tensor_slice(allocr, buf, (1, 1), (3, 4));
+  Tensor_Iter buf_iter = tensor_iter_init(allocr, buf_s);
+  (void)tensor_max(&buf_iter, t1, MAKE_STACK_TENSOR(({2.5f}), 1));
+  printf("\nAfter inplace max of slice with (1): \n");
+  tensor_print(allocr, buf);
+
+  tensor_iter_deinit(allocr, &buf_iter);
+  tensor_free(allocr, &buf_s);
+  tensor_free(allocr, &buf);
+  tensor_free(allocr, &t4);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &row);
+  tensor_free(allocr, &col);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1);
+  return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include "tensor.h"
+
+// Overwrites the shape and tile shape of a 2d chunked file, they follow the 32 byte header
+static void chunked_patch_dims(const char* path, uint64_t rows, uint64_t cols, uint64_t tile_rows, uint64_t tile_cols){
+  const uint64_t dims[4] = {rows, cols, tile_rows, tile_cols};
+  FILE* file = fopen(path, "r+b");
+  fseek(file, 32, SEEK_SET);
+  fwrite(dims, sizeof(dims[0]), 4, file);
+  fclose(file);
+}
+
+int chunked_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+  const char* path_a = "build/tests/chunked_a.tensor";
+  const char* path_b = "build/tests/chunked_b.tensor";
+
+  // 5x7 tensors in 2x3 tiles, with only 2 tiles in memory at a time
+  Tensor_Chunked* a = tensor_chunked_create(allocr, path_a, MAKE_ARRAY_SLICE(uptr, 5, 7),
+					    MAKE_ARRAY_SLICE(uptr, 2, 3), 2);
+  Tensor_Chunked* b = tensor_chunked_create(allocr, path_b, MAKE_ARRAY_SLICE(uptr, 5, 7),
+					    MAKE_ARRAY_SLICE(uptr, 2, 3), 2);
+  printf("Created: %s\n", BOOLSTR(a != nullptr && b != nullptr));
+
+  // Fill 'a' with a range, and only a part of 'b'
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 5, 7);
+  tensor_chunked_store(a, MAKE_ARRAY_SLICE(uptr, 0, 0), t1);
+  Tensor t2 = tensor_create(allocr, 100.f, 2, 2);
+  tensor_chunked_store(b, MAKE_ARRAY_SLICE(uptr, 2, 3), t2);
+
+  // b = (a + b) * 2, tile by tile
+  tensor_chunked_map_op(b, (Tensor_Chunked*[]){a, b}, 2, f32_add_op);
+  tensor_chunked_vector_op(b, 2.f, f32_prod_op, b);
+  printf("Closed: %s\n", BOOLSTR(tensor_chunked_close(b)));
+
+  b = tensor_chunked_open(allocr, path_b, 3);
+  printf("Reopened: %s, Shape: ", BOOLSTR(b != nullptr));
+  print_tensor_inx(tensor_chunked_shape(b));
+  Tensor t3 = tensor_alloc(allocr, 5, 7);
+  Tensor_Iter t3_iter = tensor_iter_init(allocr, t3);
+  (void)tensor_chunked_load(&t3_iter, b, MAKE_ARRAY_SLICE(uptr, 0, 0));
+  printf("\nContents: \n");
+  tensor_print(allocr, t3);
+
+  // Loading a region crossing tile boundaries into a transposed view
+  Tensor t4 = tensor_create(allocr, 0.f, 4, 3);
+  Tensor t4_t = tensor_permute(allocr, t4, 0, 1);
+  Tensor_Iter t4_iter = tensor_iter_init(allocr, t4_t);
+  (void)tensor_chunked_load(&t4_iter, b, MAKE_ARRAY_SLICE(uptr, 1, 2));
+  printf("\nRegion from (1, 2) of shape (3, 4), transposed: \n");
+  tensor_print(allocr, t4);
+
+  // Reductions fold the tiles into an in memory result
+  Tensor r0 = tensor_chunked_reduce_op(allocr, b, 0, f32_add_op);
+  Tensor r1 = tensor_chunked_reduce_op(allocr, b, 1, f32_max_op);
+  printf("\nSum along dim 0: \n");
+  tensor_print(allocr, r0);
+  printf("\nMax along dim 1: \n");
+  tensor_print(allocr, r1);
+
+  printf("\nOpening a missing file: %s\n",
+	 BOOLSTR(tensor_chunked_open(allocr, "build/tests/missing.tensor", 1) != nullptr));
+
+  // Headers that dont match the file, or whose sizes overflow
+  (void)tensor_chunked_close(a);
+  chunked_patch_dims(path_a, 500, 7, 2, 3);
+  a = tensor_chunked_open(allocr, path_a, 1);
+  printf("Opening with more tiles than the file has: %s\n", BOOLSTR(a != nullptr));
+  chunked_patch_dims(path_a, (uint64_t)1 << 62, 4, (uint64_t)1 << 62, 4);
+  a = tensor_chunked_open(allocr, path_a, 1);
+  printf("Opening with a tile size that overflows: %s\n", BOOLSTR(a != nullptr));
+  chunked_patch_dims(path_a, UINT64_MAX, 7, 2, 3);
+  a = tensor_chunked_open(allocr, path_a, 1);
+  printf("Opening with a tile count that overflows: %s\n", BOOLSTR(a != nullptr));
+  chunked_patch_dims(path_a, 5, 7, 2, 3);
+  a = tensor_chunked_open(allocr, path_a, 1);
+  printf("Opening with the dims put back: %s\n", BOOLSTR(a != nullptr));
+
+  tensor_free(allocr, &r1);
+  tensor_free(allocr, &r0);
+  tensor_iter_deinit(allocr, &t4_iter);
+  tensor_free(allocr, &t4_t);
+  tensor_free(allocr, &t4);
+  tensor_iter_deinit(allocr, &t3_iter);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1);
+  (void)tensor_chunked_close(b);
+  (void)tensor_chunked_close(a);
+  remove(path_b);
+  remove(path_a);
+
+#undef BOOLSTR
+  return 0;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+// Compares every element against reading through the view
+static bool contiguous_matches(Tensor c, Tensor v){
+  const Alloc_Interface allocr = gen_std_allocator();
+  Tensor_Iter iter = tensor_iter_init(allocr, v);
+  bool same = true;
+  while(same && tensor_iter_next(&iter))
+    same = (tensor_get_value_(c, tensor_iter_inx(iter)) == tensor_get_value_(v, tensor_iter_inx(iter)));
+  tensor_iter_deinit(allocr, &iter);
+  return same;
+}
+
+int contiguous_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  // Contiguous source and a slice with contiguous rows
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 3, 4);
+  Tensor c1 = tensor_contiguous(allocr, t1);
+  printf("Copy of a contiguous tensor: \n");
+  tensor_print(allocr, c1);
+  Tensor s1 = tensor_slice(allocr, t1, (1, 1), (3, 4));
+  Tensor c2 = tensor_contiguous(allocr, s1);
+  printf("\nCopy of a slice: \n");
+  tensor_print(allocr, c2);
+
+  // Transposes, large enough to go through the tiles and leave partial ones
+  Tensor t2 = tensor_range(allocr, 0.f, 1.f, 11, 13);
+  Tensor p2 = tensor_permute(allocr, t2, 0, 1);
+  Tensor c3 = tensor_contiguous(allocr, p2);
+  printf("\nCopy of a transposed 11x13 tensor: \n");
+  tensor_print(allocr, c3);
+  printf("Strides of the copy: (%zd, %zd)\n", tensor_stride(c3).data[0], tensor_stride(c3).data[1]);
+
+  // Every permutation of a 3d tensor, in every dtype
+  Tensor t3 = tensor_range(allocr, -500.f, 0.5f, 6, 37, 45);
+  bool all_same = true;
+  for(Tensor_DType d = TENSOR_F32; d < TENSOR_DTYPE_COUNT; ++d){
+    Tensor td = tensor_to_dtype(allocr, t3, d);
+    for_range(uptr, i, 0, 3){
+      for_range(uptr, j, i + 1, 3){
+	Tensor v = tensor_permute(allocr, td, i, j);
+	Tensor c = tensor_contiguous(allocr, v);
+	all_same = all_same && contiguous_matches(c, v);
+	tensor_free(allocr, &c);
+	tensor_free(allocr, &v);
+      }
+    }
+    tensor_free(allocr, &td);
+  }
+  printf("\nPermuted copies match for all dtypes: %s\n", BOOLSTR(all_same));
+
+  // Random fills write into a transposed view through the same copy
+  Tensor t4 = tensor_create(allocr, 0.f, 13, 11);
+  Tensor p4 = tensor_permute(allocr, t4, 0, 1);
+  Tensor_Rng rng = tensor_rng_init(20);
+  tensor_fill_uniform(&rng, &p4, 0.f, 1.f);
+  rng = tensor_rng_init(20);
+  tensor_fill_uniform(&rng, &t2, 0.f, 1.f);
+  printf("Copied back through a transposed view: %s\n", BOOLSTR(contiguous_matches(p4, t2)));
+
+  // Large enough to be split across threads
+  Tensor t5 = tensor_range(allocr, 0.f, 1.f, 300, 700);
+  Tensor p5 = tensor_permute(allocr, t5, 0, 1);
+  Tensor c5 = tensor_contiguous(allocr, p5);
+  printf("Large transposed copy matches: %s\n", BOOLSTR(contiguous_matches(c5, p5)));
+  printf("Element (699, 299) = %g\n", tensor_get_value(c5, 699, 299));
+
+  tensor_free(allocr, &c5);
+  tensor_free(allocr, &p5);
+  tensor_free(allocr, &t5);
+  tensor_free(allocr, &p4);
+  tensor_free(allocr, &t4);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &c3);
+  tensor_free(allocr, &p2);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &c2);
+  tensor_free(allocr, &s1);
+  tensor_free(allocr, &c1);
+  tensor_free(allocr, &t1);
+#undef BOOLSTR
+  return 0;
+}
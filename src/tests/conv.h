@@ -0,0 +1,115 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int conv_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  // 1d, each channel with its own kernel, padding and a stride
+  Tensor s1 = tensor_range(allocr, 0.f, 1.f, 1, 2, 8);
+  Tensor k1 = MAKE_STACK_TENSOR(({{{-1, 0, 1}}, {{1, 2, 1}}}), 2, 1, 3);
+  Tensor_Conv_Options o1 = TENSOR_CONV_DEFAULTS;
+  o1.padding[0] = 1;
+  o1.stride[0] = 2;
+  o1.groups = 2;
+  Tensor c1 = tensor_conv1d(allocr, s1, k1, o1);
+  printf("Series: \n");
+  tensor_print(allocr, s1);
+  printf("\nDifferences and smoothing, padding 1, stride 2: \n");
+  tensor_print(allocr, c1);
+
+  // 2d, a 3x3 box and a cross, over both input channels
+  Tensor img = tensor_range(allocr, 0.f, 1.f, 1, 2, 5, 6);
+  Tensor k2 = tensor_create(allocr, 1.f, 2, 2, 3, 3);
+  for_range(uptr, c, 0, 2){
+    tensor_set_value(k2, 0.f, 1, c, 0, 0);
+    tensor_set_value(k2, 0.f, 1, c, 0, 2);
+    tensor_set_value(k2, 0.f, 1, c, 2, 0);
+    tensor_set_value(k2, 0.f, 1, c, 2, 2);
+  }
+  Tensor_Conv_Options o2 = TENSOR_CONV_DEFAULTS;
+  o2.padding[0] = o2.padding[1] = 1;
+  Tensor c2 = tensor_conv2d(allocr, img, k2, o2);
+  printf("\nImages: \n");
+  tensor_print(allocr, img);
+  printf("\nBox and cross sums, padding 1: \n");
+  tensor_print(allocr, c2);
+  o2.dilation[1] = 2;
+  o2.padding[1] = 2;
+  o2.stride[0] = 2;
+  Tensor c3 = tensor_conv2d(allocr, img, k2, o2);
+  printf("\nDilated by 2 along the width, stride 2 along the height: \n");
+  tensor_print(allocr, c3);
+
+  // Written into a transposed view
+  Tensor c4 = tensor_create(allocr, 0.f, 1, 2, 6, 5);
+  Tensor c4_t = tensor_permute(allocr, c4, 2, 3);
+  Tensor_Iter c4_iter = tensor_iter_init(allocr, c4_t);
+  o2 = TENSOR_CONV_DEFAULTS;
+  o2.padding[0] = o2.padding[1] = 1;
+  (void)tensor_conv2d(&c4_iter, img, k2, o2);
+  printf("\nSame sums written into a transposed tensor: \n");
+  tensor_print(allocr, c4);
+
+  // Channels last inputs are just permuted views, the output keeps their layout
+  Tensor big = tensor_random(allocr, -1.f, 1.f, 2, 16, 24, 12);
+  Tensor big_cl = tensor_permute(allocr, big, 1, 3);
+  tensor_permute_in_place(&big_cl, 2, 3);
+  Tensor big_nchw = tensor_contiguous(allocr, big_cl);
+  Tensor dw = tensor_random(allocr, -1.f, 1.f, 12, 1, 3, 3);
+  Tensor w = tensor_random(allocr, -1.f, 1.f, 32, 12, 3, 3);
+  Tensor_Conv_Options o3 = TENSOR_CONV_DEFAULTS;
+  o3.padding[0] = o3.padding[1] = 1;
+  Tensor r1 = tensor_conv2d(allocr, big_nchw, w, o3);
+  Tensor r2 = tensor_conv2d(allocr, big_cl, w, o3);
+  o3.groups = 12;
+  Tensor r3 = tensor_conv2d(allocr, big_nchw, dw, o3);
+  Tensor r4 = tensor_conv2d(allocr, big_cl, dw, o3);
+  bool same = true;
+  for_range(uptr, n, 0, 2){
+    for_range(uptr, y, 0, 16){
+      for_range(uptr, x, 0, 24){
+	for_range(uptr, c, 0, 32){
+	  const f32 e = tensor_get_value(r1, n, c, y, x) - tensor_get_value(r2, n, c, y, x);
+	  same = same && (e < 1e-4f) && (e > -1e-4f);
+	}
+	for_range(uptr, c, 0, 12){
+	  const f32 e = tensor_get_value(r3, n, c, y, x) - tensor_get_value(r4, n, c, y, x);
+	  same = same && (e < 1e-4f) && (e > -1e-4f);
+	}
+      }
+    }
+  }
+  printf("\n(2, 12, 16, 24) images, 32 output channels, output strides ");
+  print_tensor_strides(tensor_stride(r1));
+  printf(" and channels last ");
+  print_tensor_strides(tensor_stride(r2));
+  printf("\nDepthwise, output strides ");
+  print_tensor_strides(tensor_stride(r3));
+  printf(" and channels last ");
+  print_tensor_strides(tensor_stride(r4));
+  printf("\nBoth layouts give the same results: %s\n", BOOLSTR(same));
+
+  tensor_free(allocr, &r4);
+  tensor_free(allocr, &r3);
+  tensor_free(allocr, &r2);
+  tensor_free(allocr, &r1);
+  tensor_free(allocr, &w);
+  tensor_free(allocr, &dw);
+  tensor_free(allocr, &big_nchw);
+  tensor_free(allocr, &big_cl);
+  tensor_free(allocr, &big);
+  tensor_iter_deinit(allocr, &c4_iter);
+  tensor_free(allocr, &c4_t);
+  tensor_free(allocr, &c4);
+  tensor_free(allocr, &c3);
+  tensor_free(allocr, &c2);
+  tensor_free(allocr, &k2);
+  tensor_free(allocr, &img);
+  tensor_free(allocr, &c1);
+  tensor_free(allocr, &s1);
+#undef BOOLSTR
+  return 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int dtypes_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  // Every dtype made from the same f32 values
+  Tensor t1 = tensor_range(allocr, -2.75f, 1.3f, 2, 4);
+  printf("As f32: \n");
+  tensor_print(allocr, t1);
+  for(Tensor_DType d = TENSOR_F64; d < TENSOR_DTYPE_COUNT; ++d){
+    Tensor td = tensor_to_dtype(allocr, t1, d);
+    printf("\nAs %s (%zu byte elements): \n", tensor_dtype_name(d), tensor_dtype_size(d));
+    tensor_print(allocr, td);
+    tensor_free(allocr, &td);
+  }
+
+  // Rounding and limits of the smaller types
+  Tensor t2 = tensor_create_dtype(allocr, TENSOR_F32, 0.0, 6);
+  const f64 edge_vals[] = {65519.0, 65520.0, 1.00048828125, 300.7, -1e10, 1.0 / 3.0};
+  for(uptr i = 0; i < 6; ++i) tensor_set_value(t2, edge_vals[i], i);
+  Tensor_Print_Options opts = TENSOR_PRINT_DEFAULTS;
+  opts.precision = 8;
+  printf("\nEdge values: \n");
+  (void)tensor_fprint(stdout, t2, opts);
+  for(Tensor_DType d = TENSOR_F16; d < TENSOR_DTYPE_COUNT; ++d){
+    Tensor td = tensor_to_dtype(allocr, t2, d);
+    printf("As %s: \n", tensor_dtype_name(d));
+    (void)tensor_fprint(stdout, td, opts);
+    tensor_free(allocr, &td);
+  }
+
+  // Mixed dtype ops, '_new' outputs get the wider dtype
+  Tensor h = tensor_to_dtype(allocr, t1, TENSOR_F16);
+  Tensor b = tensor_create_dtype(allocr, TENSOR_I8, 3.0, 4);
+  Tensor s1 = tensor_add(allocr, h, b);
+  printf("\nf16 + broadcasted i8 gives %s: \n", tensor_dtype_name(s1.dtype));
+  tensor_print(allocr, s1);
+
+  Tensor i = tensor_to_dtype(allocr, t1, TENSOR_I32);
+  Tensor s2 = tensor_prod(allocr, i, h);
+  printf("\ni32 * f16 gives %s: \n", tensor_dtype_name(s2.dtype));
+  tensor_print(allocr, s2);
+
+  // Views keep the dtype, and can be written through
+  Tensor i_t = tensor_permute(allocr, i, 0, 1);
+  Tensor v = tensor_vmax(allocr, 0.f, i_t);
+  printf("\nmax(0, transposed i32) as %s: \n", tensor_dtype_name(v.dtype));
+  tensor_print(allocr, v);
+
+  Tensor bf = tensor_create_dtype(allocr, TENSOR_BF16, 1.0, 4, 2);
+  Tensor_Iter bf_iter = tensor_iter_init(allocr, bf);
+  (void)tensor_add(&bf_iter, i_t, v);
+  printf("\nWritten into bf16 from i32 ops: \n");
+  tensor_print(allocr, bf);
+  printf("Element (3, 1) = %g\n", tensor_get_value(bf, 3, 1));
+
+  // Reductions convert only while reading the rows
+  Tensor r1 = tensor_radd(allocr, h, 1);
+  printf("\nSum of f16 rows: \n");
+  tensor_print(allocr, r1);
+  Tensor big = tensor_create_dtype(allocr, TENSOR_I8, 100.0, 3000);
+  Tensor out32 = tensor_create_dtype(allocr, TENSOR_I32, 0.0, 1);
+  Tensor big_2d = tensor_expand(allocr, big, 1, 3000);
+  Tensor_Iter out_iter = tensor_iter_init(allocr, out32);
+  (void)tensor_radd(&out_iter, big_2d, 1);
+  printf("Sum of 3000 i8 into an i32: \n");
+  tensor_print(allocr, out32);
+
+  // Contiguous buffers convert directly
+  const f32 raw[4] = {0.1f, -2.f, 1e-8f, 70000.f};
+  uint16_t halfs[4];
+  f32 back[4];
+  tensor_convert(TENSOR_F16, halfs, TENSOR_F32, raw, 4);
+  tensor_convert(TENSOR_F32, back, TENSOR_F16, halfs, 4);
+  printf("\nf16 bits: %04x %04x %04x %04x\n", halfs[0], halfs[1], halfs[2], halfs[3]);
+  printf("Back to f32: %g %g %g %g\n", back[0], back[1], back[2], back[3]);
+
+  tensor_iter_deinit(allocr, &out_iter);
+  tensor_free(allocr, &big_2d);
+  tensor_free(allocr, &out32);
+  tensor_free(allocr, &big);
+  tensor_free(allocr, &r1);
+  tensor_iter_deinit(allocr, &bf_iter);
+  tensor_free(allocr, &bf);
+  tensor_free(allocr, &v);
+  tensor_free(allocr, &i_t);
+  tensor_free(allocr, &s2);
+  tensor_free(allocr, &i);
+  tensor_free(allocr, &s1);
+  tensor_free(allocr, &b);
+  tensor_free(allocr, &h);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1);
+  return 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include "tensor.h"
+
+// Overwrites a stride stored in a saved file, its u64s follow the 40 byte header
+static void fileio_patch_stride(const char* path, uptr ndim, uptr dim, uint64_t stride){
+  FILE* file = fopen(path, "r+b");
+  fseek(file, 40 + (long)((ndim + dim) * sizeof(uint64_t)), SEEK_SET);
+  fwrite(&stride, sizeof(stride), 1, file);
+  fclose(file);
+}
+
+int fileio_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+  const char* path = "build/tests/fileio.tensor";
+
+  // Views are saved contiguously
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 3, 4, 5);
+  Tensor t1_s = tensor_slice(allocr, t1, (0, 1, 0), (3, 3, 5));
+  tensor_permute_in_place(&t1_s, 0, 2);
+  printf("Saving tensor: \n");
+  tensor_print(allocr, t1_s);
+  printf("\nSaved: %s\n", BOOLSTR(tensor_save(allocr, t1_s, path)));
+
+  Tensor t2;
+  printf("Loaded: %s\n", BOOLSTR(tensor_load(allocr, path, &t2)));
+  printf("Shape: ");
+  print_tensor_inx(tensor_shape(t2));
+  printf("\nStride: ");
+  print_tensor_strides(tensor_stride(t2));
+  printf("\n");
+  tensor_print(allocr, t2);
+
+  // Mapped tensors use the file's memory directly
+  Tensor t3;
+  printf("\nMapped: %s\n", BOOLSTR(tensor_load_mmap(allocr, path, &t3)));
+  printf("Owner: %s\n", BOOLSTR(t3.owner));
+  tensor_print(allocr, t3);
+
+  // Views of the mapping keep it alive
+  Tensor t3_s = tensor_slice(allocr, t3, (1, 0, 0), (3, 2, 2));
+  tensor_free(allocr, &t3);
+  printf("\nSlice of the mapping after freeing it: \n");
+  tensor_print(allocr, t3_s);
+
+  // Writing changes only the mapped copy, not the file
+  Tensor_Iter t3s_iter = tensor_iter_init(allocr, t3_s);
+  (void)tensor_vprod(&t3s_iter, -1.f, t3_s);
+  printf("\nAfter negating the slice: \n");
+  tensor_print(allocr, t3_s);
+  Tensor t4;
+  (void)tensor_load_mmap(allocr, path, &t4);
+  Tensor t4_s = tensor_slice(allocr, t4, (1, 0, 0), (3, 2, 2));
+  printf("\nSame slice mapped again: \n");
+  tensor_print(allocr, t4_s);
+
+  // Zero dim tensors work too
+  Tensor t5 = tensor_alloc(allocr);
+  t5.storage.data[0] = 42.f;
+  Tensor t6;
+  (void)tensor_save(allocr, t5, path);
+  printf("\nZero dim tensor loaded back: %s, ",
+	 BOOLSTR(tensor_load(allocr, path, &t6)));
+  tensor_print(allocr, t6);
+
+  // Other files are rejected
+  FILE* junk = fopen(path, "wb");
+  fprintf(junk, "Not a tensor, just some text that is long enough to have a header");
+  fclose(junk);
+  Tensor t7;
+  printf("\nLoading a junk file: %s, Mapping it: %s\n",
+	 BOOLSTR(tensor_load(allocr, path, &t7)), BOOLSTR(tensor_load_mmap(allocr, path, &t7)));
+  printf("Loading a missing file: %s\n", BOOLSTR(tensor_load(allocr, "build/tests/missing.tensor", &t7)));
+
+  // Strides that reach outside the data, even when their sum wraps back inside
+  Tensor t8 = tensor_range(allocr, 0.f, 1.f, 3, 4);
+  (void)tensor_save(allocr, t8, path);
+  fileio_patch_stride(path, 2, 0, (uint64_t)-1);
+  printf("Loading a file with a stride of 2^64 - 1: %s, Mapping it: %s\n",
+	 BOOLSTR(tensor_load(allocr, path, &t7)), BOOLSTR(tensor_load_mmap(allocr, path, &t7)));
+  fileio_patch_stride(path, 2, 0, (uint64_t)1 << 63);
+  printf("Loading a file with a stride of 2^63: %s, Mapping it: %s\n",
+	 BOOLSTR(tensor_load(allocr, path, &t7)), BOOLSTR(tensor_load_mmap(allocr, path, &t7)));
+  fileio_patch_stride(path, 2, 0, 4);
+  printf("Loading it with the stride put back: %s\n", BOOLSTR(tensor_load(allocr, path, &t7)));
+  tensor_free(allocr, &t7);
+  tensor_free(allocr, &t8);
+  remove(path);
+
+  tensor_free(allocr, &t6);
+  tensor_free(allocr, &t5);
+  tensor_free(allocr, &t4_s);
+  tensor_free(allocr, &t4);
+  tensor_iter_deinit(allocr, &t3s_iter);
+  tensor_free(allocr, &t3_s);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1_s);
+  tensor_free(allocr, &t1);
+
+#undef BOOLSTR
+  return 0;
+}
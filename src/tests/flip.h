@@ -0,0 +1,84 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int flip_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 3, 5);
+  printf("Original tensor: \n");
+  tensor_print(allocr, t1);
+
+  // Reversing a dimension only negates its stride
+  Tensor f1 = tensor_flip(allocr, t1, 1);
+  printf("\nFlipped along dim 1, strides ");
+  print_tensor_strides(tensor_stride(f1));
+  printf(", offset %zu: \n", f1.offset);
+  tensor_print(allocr, f1);
+  Tensor f2 = tensor_flip(allocr, f1, 0);
+  printf("\nFlipped along both: \n");
+  tensor_print(allocr, f2);
+  printf("Element (0, 0) = %g, (2, 4) = %g\n", tensor_get_value(f2, 0, 0), tensor_get_value(f2, 2, 4));
+
+  // Every Nth element, forwards and backwards
+  Tensor s1 = tensor_slice_step(allocr, t1, (0, 0), (3, 5), (1, 2));
+  printf("\nEvery 2nd column, strides ");
+  print_tensor_strides(tensor_stride(s1));
+  printf(": \n");
+  tensor_print(allocr, s1);
+  Tensor s2 = tensor_slice_step(allocr, t1, (0, 1), (3, 5), (-2, -3));
+  printf("\nRows [0, 3) step -2, columns [1, 5) step -3: \n");
+  tensor_print(allocr, s2);
+
+  // Ops read and write through negative strides like any other view
+  Tensor sum = tensor_add(allocr, t1, f2);
+  printf("\nOriginal + flipped along both: \n");
+  tensor_print(allocr, sum);
+  Tensor r1 = tensor_radd(allocr, f1, 1);
+  printf("\nRow sums of the flipped tensor: \n");
+  tensor_print(allocr, r1);
+
+  Tensor t2 = tensor_create(allocr, 0.f, 3, 5);
+  Tensor t2_f = tensor_flip(allocr, t2, 1);
+  Tensor_Iter t2_iter = tensor_iter_init(allocr, t2_f);
+  (void)tensor_vprod(&t2_iter, 10.f, t1);
+  printf("\nWritten through a flipped view: \n");
+  tensor_print(allocr, t2);
+
+  // Reversing a sequence of frames, and keeping every 3rd one
+  Tensor frames = tensor_range(allocr, 0.f, 1.f, 10, 2, 2);
+  Tensor rev = tensor_flip(allocr, frames, 0);
+  Tensor every3 = tensor_slice_step(allocr, rev, (0, 0, 0), (10, 2, 2), (3, 1, 1));
+  Tensor packed = tensor_contiguous(allocr, every3);
+  printf("\nEvery 3rd frame of the reversed sequence: \n");
+  tensor_print(allocr, packed);
+  bool copied = true;
+  Tensor rows = tensor_reshape(allocr, every3, &copied, 4, 4);
+  printf("Reshaped into rows without a copy: %s\n", copied ? "No" : "Yes");
+  tensor_print(allocr, rows);
+
+  Tensor t1_t = tensor_permute(allocr, t1, 0, 1);
+  Tensor m1 = tensor_matmul(allocr, f2, t1_t);
+  printf("\nFlipped times transposed: \n");
+  tensor_print(allocr, m1);
+
+  tensor_free(allocr, &m1);
+  tensor_free(allocr, &t1_t);
+  tensor_free(allocr, &rows);
+  tensor_free(allocr, &packed);
+  tensor_free(allocr, &every3);
+  tensor_free(allocr, &rev);
+  tensor_free(allocr, &frames);
+  tensor_iter_deinit(allocr, &t2_iter);
+  tensor_free(allocr, &t2_f);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &r1);
+  tensor_free(allocr, &sum);
+  tensor_free(allocr, &s2);
+  tensor_free(allocr, &s1);
+  tensor_free(allocr, &f2);
+  tensor_free(allocr, &f1);
+  tensor_free(allocr, &t1);
+  return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+static f32 lazy_sub_op(f32 a, f32 b){
+  return a - b;
+}
+
+int lazy_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 3, 4);
+  Tensor t2 = MAKE_STACK_TENSOR(({1, 2, 3, 4}), 4);
+  Tensor t3 = tensor_range(allocr, 4.f, -1.f, 3, 1);
+
+  // Nothing is computed until forced
+  Tensor_Graph graph = tensor_graph_init(allocr);
+  Tensor_Expr* e1 = tensor_lazy(&graph, t1);
+  Tensor_Expr* e2 = tensor_lazy(&graph, t2);
+  Tensor_Expr* e3 = tensor_lazy(&graph, t3);
+  Tensor_Expr* sum = tensor_lazy_prod(&graph, tensor_lazy_add(&graph, e1, e2), e3);
+  Tensor_Expr* expr = tensor_lazy_bin_op(&graph, tensor_lazy_vadd(&graph, 1.f, sum), lazy_sub_op, e1);
+  printf("Shape of (t1 + t2) * t3 + 1 - t1: ");
+  print_tensor_inx(tensor_expr_shape(expr));
+  printf("\n");
+  Tensor r1 = tensor_force(allocr, expr);
+  tensor_print(allocr, r1);
+
+  // Reductions at the end are fused too
+  Tensor r2 = tensor_force(allocr, tensor_lazy_radd(&graph, expr, 1));
+  printf("\nSum along dim 1: \n");
+  tensor_print(allocr, r2);
+  Tensor r3 = tensor_force(allocr, tensor_lazy_rmax(&graph, expr, 0));
+  printf("\nMax along dim 0: \n");
+  tensor_print(allocr, r3);
+
+  // Reduction in the middle of an expression, subtracting the mean of each column
+  Tensor_Expr* centered = tensor_lazy_bin_op(&graph, e1, lazy_sub_op,
+					     tensor_lazy_vprod(&graph, 1.f/3.f, tensor_lazy_radd(&graph, e1, 0)));
+  Tensor r4 = tensor_force(allocr, centered);
+  printf("\nCentered columns: \n");
+  tensor_print(allocr, r4);
+
+  // Inplace into a slice
+  Tensor buf = tensor_create(allocr, 0.f, 4, 5);
+  Tensor buf_s = tensor_slice(allocr, buf, (1, 1), (4, 5));
+  Tensor_Iter buf_iter = tensor_iter_init(allocr, buf_s);
+  (void)tensor_force(&buf_iter, expr);
+  printf("\nAfter forcing into a slice: \n");
+  tensor_print(allocr, buf);
+
+  tensor_iter_deinit(allocr, &buf_iter);
+  tensor_free(allocr, &buf_s);
+  tensor_free(allocr, &buf);
+  tensor_free(allocr, &r4);
+  tensor_free(allocr, &r3);
+  tensor_free(allocr, &r2);
+  tensor_free(allocr, &r1);
+  tensor_graph_deinit(&graph);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &t1);
+  return 0;
+}
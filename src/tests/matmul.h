@@ -0,0 +1,98 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+// Plain triple loop to compare against
+static bool matmul_matches_naive(Tensor c, Tensor a, Tensor b){
+  for_range(uptr, i, 0, slice_inx(tensor_shape(c), 0)){
+    for_range(uptr, j, 0, slice_inx(tensor_shape(c), 1)){
+      double acc = 0;
+      for_range(uptr, k, 0, slice_inx(tensor_shape(a), 1)) acc += (double)tensor_get(a, i, k) * tensor_get(b, k, j);
+      const double diff = acc - tensor_get(c, i, j);
+      if(diff > 1e-3 || diff < -1e-3) return false;
+    }
+  }
+  return true;
+}
+
+int matmul_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  Tensor a = tensor_range(allocr, 1.f, 1.f, 2, 3);
+  Tensor b = tensor_range(allocr, -2.f, 0.5f, 3, 4);
+  Tensor c = tensor_matmul(allocr, a, b);
+  printf("A: \n");
+  tensor_print(allocr, a);
+  printf("\nB: \n");
+  tensor_print(allocr, b);
+  printf("\nA x B: \n");
+  tensor_print(allocr, c);
+
+  // Transposed view is read through its strides
+  Tensor bt = tensor_permute(allocr, b, 0, 1);
+  Tensor at = tensor_permute(allocr, a, 0, 1);
+  Tensor ct = tensor_matmul(allocr, bt, at);
+  printf("\nB' x A': \n");
+  tensor_print(allocr, ct);
+
+  // Larger ones go through the blocked path
+  Tensor la = tensor_random(allocr, -1.f, 1.f, 70, 300);
+  Tensor lb = tensor_random(allocr, -1.f, 1.f, 45, 300);
+  Tensor lb_t = tensor_permute(allocr, lb, 0, 1);
+  Tensor lc = tensor_matmul(allocr, la, lb_t);
+  printf("\nLarge product shape: ");
+  print_tensor_inx(tensor_shape(lc));
+  printf("\nLarge product matches: %s\n", BOOLSTR(matmul_matches_naive(lc, la, lb_t)));
+
+  // Into a slice of a preallocated buffer
+  Tensor buf = tensor_create(allocr, 0.f, 80, 50);
+  Tensor buf_s = tensor_slice(allocr, buf, (5, 2), (75, 47));
+  Tensor_Iter buf_iter = tensor_iter_init(allocr, buf_s);
+  (void)tensor_matmul(&buf_iter, la, lb_t);
+  printf("Inplace into slice matches: %s\n", BOOLSTR(matmul_matches_naive(buf_s, la, lb_t)));
+  printf("Outside of slice untouched: %s\n",
+	 BOOLSTR(tensor_get(buf, 4, 2) == 0.f && tensor_get(buf, 5, 1) == 0.f &&
+		 tensor_get(buf, 75, 46) == 0.f && tensor_get(buf, 74, 47) == 0.f));
+
+  // Batched, with the batch of 'b' being a permuted view, and with shared weights
+  Tensor ba = tensor_range(allocr, 0.f, 1.f, 3, 2, 2);
+  Tensor bb_store = tensor_range(allocr, 1.f, 1.f, 2, 3, 2);
+  Tensor bb = tensor_permute(allocr, bb_store, 0, 1);
+  Tensor bc = tensor_bmm(allocr, ba, bb);
+  printf("\nBatched A: \n");
+  tensor_print(allocr, ba);
+  printf("\nBatched B (permuted view): \n");
+  tensor_print(allocr, bb);
+  printf("\nBatched A x B: \n");
+  tensor_print(allocr, bc);
+  Tensor bw = tensor_matmul(allocr, a, b);
+  Tensor a_exp = tensor_expand(allocr, a, 2, 2, 3);
+  Tensor bs = tensor_bmm(allocr, a_exp, b);
+  printf("\nBroadcasted weights same as matmul: %s\n",
+	 BOOLSTR(matmul_matches_naive(bw, a, b) && tensor_get(bs, 1, 1, 3) == tensor_get(bw, 1, 3)));
+
+  tensor_free(allocr, &bs);
+  tensor_free(allocr, &a_exp);
+  tensor_free(allocr, &bw);
+  tensor_free(allocr, &bc);
+  tensor_free(allocr, &bb);
+  tensor_free(allocr, &bb_store);
+  tensor_free(allocr, &ba);
+  tensor_iter_deinit(allocr, &buf_iter);
+  tensor_free(allocr, &buf_s);
+  tensor_free(allocr, &buf);
+  tensor_free(allocr, &lc);
+  tensor_free(allocr, &lb_t);
+  tensor_free(allocr, &lb);
+  tensor_free(allocr, &la);
+  tensor_free(allocr, &ct);
+  tensor_free(allocr, &at);
+  tensor_free(allocr, &bt);
+  tensor_free(allocr, &c);
+  tensor_free(allocr, &b);
+  tensor_free(allocr, &a);
+#undef BOOLSTR
+  return 0;
+}
@@ -44,7 +44,7 @@ static int arith2_run(int argc, const char* argv[]){
   // Now test case for reduce operation (allocation type)
 
   Tensor t5 = tensor_range(allocr, -1.f, 0.1f, 3,4,2);
-  tensor_permute_in_place(t5, 0, 2);
+  tensor_permute_in_place(&t5, 0, 2);
   Tensor t6 = tensor_rprod(allocr, t5, 0);
   
   printf("\nRange based tensor = \n");
@@ -54,9 +54,9 @@ static int arith2_run(int argc, const char* argv[]){
 
   // Reduce operation (inplace)
   Tensor t7 = tensor_slice(allocr, t6, (0, 0), (3, 3));
-  tensor_permute_in_place(t7, 0, 1);
+  tensor_permute_in_place(&t7, 0, 1);
 
-  Tensor t8 = tensor_alloc(allocr, 3);
+  Tensor t8 = tensor_create(allocr, 0.f, 3);
   Tensor_Iter t8_iter = tensor_iter_init(allocr, t8);
 
   printf("\nSlice to be reduced = \n");
@@ -78,6 +78,7 @@ static int arith2_run(int argc, const char* argv[]){
 
   tensor_iter_deinit(allocr, &t2s1_iter);
   tensor_free(allocr, &t2_s3);
+  tensor_free(allocr, &t2_s2);
   tensor_free(allocr, &t2_s1);
   tensor_iter_deinit(allocr, &t3_iter);
   tensor_free(allocr, &t4);
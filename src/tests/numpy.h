@@ -0,0 +1,93 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include "tensor.h"
+
+// Writes a version 1 .npy by hand, with the given header dict and data
+static void numpy_write_raw(const char* path, const char* dict, const void* data, size_t bytes){
+  FILE* file = fopen(path, "wb");
+  const unsigned short len = (unsigned short)strlen(dict);
+  fwrite("\x93NUMPY\x01\x00", 1, 8, file);
+  fputc(len & 0xff, file);
+  fputc(len >> 8, file);
+  fwrite(dict, 1, len, file);
+  fwrite(data, 1, bytes, file);
+  fclose(file);
+}
+
+int numpy_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+  const char* npy_path = "build/tests/numpy.npy";
+  const char* npz_path = "build/tests/numpy.npz";
+
+  // Transposed tensors are written in fortran order without copying
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 2, 3);
+  Tensor t1_t = tensor_permute(allocr, t1, 0, 1);
+  printf("Saved: %s\n", BOOLSTR(tensor_save_npy(allocr, t1_t, npy_path)));
+  Tensor t2;
+  bool loaded = tensor_load_npy(allocr, npy_path, &t2);
+  printf("Loaded: %s, Owner: %s, Stride: ", BOOLSTR(loaded), BOOLSTR(t2.owner));
+  print_tensor_strides(tensor_stride(t2));
+  printf("\n");
+  tensor_print(allocr, t2);
+
+  // Other dtypes are converted to f32
+  const int32_t ints[] = {-3, -2, -1, 0, 1, 2};
+  numpy_write_raw(npy_path, "{'descr': '<i4', 'fortran_order': False, 'shape': (3, 2), }\n", ints, sizeof(ints));
+  Tensor t3;
+  loaded = tensor_load_npy(allocr, npy_path, &t3);
+  printf("\nLoaded int32: %s, Owner: %s\n", BOOLSTR(loaded), BOOLSTR(t3.owner));
+  tensor_print(allocr, t3);
+
+  const double doubles[] = {0.5, 1.5, 2.5, 3.5};
+  numpy_write_raw(npy_path, "{'descr': '<f8', 'fortran_order': True, 'shape': (2, 2), }\n", doubles, sizeof(doubles));
+  Tensor t4;
+  printf("\nLoaded fortran order f64: %s\n", BOOLSTR(tensor_load_npy(allocr, npy_path, &t4)));
+  tensor_print(allocr, t4);
+
+  const unsigned char halfs_be[] = {0x3c, 0x00, 0xc0, 0x00, 0x35, 0x55};
+  numpy_write_raw(npy_path, "{'descr': '>f2', 'fortran_order': False, 'shape': (3,), }\n", halfs_be, sizeof(halfs_be));
+  Tensor t5;
+  printf("\nLoaded big endian f16: %s\n", BOOLSTR(tensor_load_npy(allocr, npy_path, &t5)));
+  tensor_print(allocr, t5);
+
+  numpy_write_raw(npy_path, "{'descr': '<c8', 'fortran_order': False, 'shape': (1,), }\n", doubles, 8);
+  Tensor t6;
+  printf("\nLoaded complex64: %s\n", BOOLSTR(tensor_load_npy(allocr, npy_path, &t6)));
+
+  // Shapes whose element count would wrap around
+  numpy_write_raw(npy_path, "{'descr': '<f4', 'fortran_order': False, 'shape': (4294967296, 4294967296), }\n", doubles, 8);
+  printf("Loaded shape with wrapping count: %s\n", BOOLSTR(tensor_load_npy(allocr, npy_path, &t6)));
+  numpy_write_raw(npy_path, "{'descr': '<f4', 'fortran_order': False, 'shape': (18446744073709551617,), }\n", doubles, 8);
+  printf("Loaded dim too large for 64 bits: %s\n", BOOLSTR(tensor_load_npy(allocr, npy_path, &t6)));
+
+  // Archives of several arrays
+  const char* names[] = {"weights", "bias"};
+  Tensor t7 = tensor_slice(allocr, t1, (0, 1), (2, 3));
+  printf("\nSaved archive: %s\n",
+	 BOOLSTR(tensor_save_npz(allocr, npz_path, (Tensor_Slice){.data = (Tensor[]){t1_t, t7}, .count = 2}, names)));
+  Tensor t8, t9;
+  loaded = tensor_load_npz(allocr, npz_path, "bias", &t8);
+  printf("Loaded bias: %s, Owner: %s\n", BOOLSTR(loaded), BOOLSTR(t8.owner));
+  tensor_print(allocr, t8);
+  printf("\nLoaded weights.npy: %s\n", BOOLSTR(tensor_load_npz(allocr, npz_path, "weights.npy", &t9)));
+  tensor_print(allocr, t9);
+  printf("\nLoaded missing member: %s\n", BOOLSTR(tensor_load_npz(allocr, npz_path, "weight", &t6)));
+  remove(npz_path);
+  remove(npy_path);
+
+  tensor_free(allocr, &t9);
+  tensor_free(allocr, &t8);
+  tensor_free(allocr, &t7);
+  tensor_free(allocr, &t5);
+  tensor_free(allocr, &t4);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1_t);
+  tensor_free(allocr, &t1);
+
+#undef BOOLSTR
+  return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+static void pool_print_stats(Tensor_Buffer_Pool* pool){
+  const Tensor_Buffer_Stats stats = tensor_buffer_pool_stats(pool);
+  printf("Hits: %zu, Misses: %zu, Hit rate: %.2f, Evictions: %zu, Retained: %zu bytes (peak %zu)\n",
+	 stats.hits, stats.misses,
+	 (stats.hits + stats.misses) ? (double)stats.hits / (double)(stats.hits + stats.misses) : 0.0,
+	 stats.evictions, stats.retained_bytes, stats.peak_retained_bytes);
+}
+
+int pool_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  Tensor_Buffer_Pool* pool = tensor_buffer_pool_create(allocr, 1 << 20);
+  const Alloc_Interface pallocr = tensor_buffer_pool_allocator(pool);
+
+  // Same shapes every step, after the first step everything comes from the cache
+  void* first_data = nullptr;
+  for(int step = 0; step < 4; ++step){
+    Tensor x = tensor_alloc_pooled(pool, 64, 64);
+    for_slice(x.storage, i) slice_inx(x.storage, i) = (f32)step;
+    Tensor y = tensor_vadd(pallocr, 1.f, x);
+    Tensor z = tensor_radd(pallocr, y, 1);
+    Tensor z_s = tensor_slice(pallocr, z, (0), (3));
+
+    printf("Step %d: ", step);
+    tensor_print(allocr, z_s);
+    if(step == 0) first_data = x.storage.data;
+    else printf("Same buffer as the first step: %s\n", BOOLSTR(first_data == x.storage.data));
+
+    tensor_free(pallocr, &z_s);
+    tensor_free(pallocr, &z);
+    tensor_free(pallocr, &y);
+    tensor_free(pallocr, &x);
+    pool_print_stats(pool);
+  }
+
+  // Similar sizes share a size class
+  Tensor a = tensor_alloc_pooled(pool, 63, 65);
+  printf("\nA slightly different shape reused a buffer: %s\n", BOOLSTR(first_data == a.storage.data));
+  tensor_free(pallocr, &a);
+
+  // Buffers that dont fit under the cap are given back
+  Tensor big = tensor_alloc_pooled(pool, 512, 1024);
+  tensor_free(pallocr, &big);
+  printf("\nAfter freeing a buffer larger than the cap:\n");
+  pool_print_stats(pool);
+
+  tensor_buffer_pool_trim(pool);
+  printf("\nAfter trimming:\n");
+  pool_print_stats(pool);
+
+  // Sizes off the 64 byte units are counted the same way when cached and when reused
+  f32_Slice b3 = SLICE_ALLOC(pallocr, f32, 20);
+  SLICE_FREE(pallocr, b3);
+  Tensor c = tensor_alloc_pooled(pool, 5, 7);
+  tensor_free(pallocr, &c);
+  const uptr start_bytes = tensor_buffer_pool_stats(pool).retained_bytes;
+  for(int i = 0; i < 20000; ++i){
+    b3 = SLICE_ALLOC(pallocr, f32, 20);
+    SLICE_FREE(pallocr, b3);
+    c = tensor_alloc_pooled(pool, 5, 7);
+    tensor_free(pallocr, &c);
+  }
+  const Tensor_Buffer_Stats cycled = tensor_buffer_pool_stats(pool);
+  printf("\nRetained bytes same after 20000 more alloc and free cycles: %s, no new evictions: %s\n",
+	 BOOLSTR(cycled.retained_bytes == start_bytes), BOOLSTR(cycled.evictions == 1));
+  tensor_buffer_pool_destroy(pool);
+
+#undef BOOLSTR
+  return 0;
+}
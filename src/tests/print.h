@@ -0,0 +1,49 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int print_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  Tensor t1 = tensor_range(allocr, -1.f, 0.37f, 2, 7);
+  Tensor_Print_Options opts = TENSOR_PRINT_DEFAULTS;
+  opts.precision = 2;
+  printf("With 2 digits: \n");
+  (void)tensor_fprint(stdout, t1, opts);
+
+  opts.precision = 0;
+  printf("\nWith no digits (ties to even): \n");
+  Tensor t2 = tensor_range(allocr, -2.5f, 1.f, 6);
+  (void)tensor_fprint(stdout, t2, opts);
+
+  opts = TENSOR_PRINT_DEFAULTS;
+  opts.line_width = 40;
+  printf("\nWrapped at 40 columns: \n");
+  (void)tensor_fprint(stdout, t1, opts);
+
+  // Big tensors only show the edges of every dimension
+  Tensor t3 = tensor_range(allocr, 0.f, 1.f, 20, 30, 40);
+  printf("\nSummarized: \n");
+  tensor_print(allocr, t3);
+
+  opts = TENSOR_PRINT_DEFAULTS;
+  opts.precision = 1;
+  opts.edge_items = 1;
+  opts.threshold = 10;
+  Tensor t3_s = tensor_slice(allocr, t3, (0, 0, 0), (3, 3, 3));
+  printf("\nSummarized slice with 1 edge item: \n");
+  (void)tensor_fprint(stdout, t3_s, opts);
+
+  // Formatting into a buffer is cut to fit, but tells the full length
+  char small[16];
+  const uptr needed = tensor_format(small, sizeof(small), t2, TENSOR_PRINT_DEFAULTS);
+  printf("\nFormatted into 16 characters: '%s', needed %zu\n", small, needed);
+  printf("Measured with no buffer: %zu\n", tensor_format(nullptr, 0, t2, TENSOR_PRINT_DEFAULTS));
+
+  tensor_free(allocr, &t3_s);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int quant_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  // Per row (axis 0) asymmetric quantization
+  Tensor x = tensor_range(allocr, -1.5f, 0.35f, 3, 5);
+  Tensor_Quantized qx = tensor_quantize(allocr, x, 0, false);
+  printf("Tensor: \n");
+  tensor_print(allocr, x);
+  printf("\nQuantized per row: \n");
+  tensor_print(allocr, qx.values);
+  printf("Scales: \n");
+  tensor_print(allocr, qx.scales);
+  printf("Zero points: \n");
+  tensor_print(allocr, qx.zero_points);
+  Tensor dx = tensor_dequantize(allocr, qx);
+  printf("Dequantized: \n");
+  tensor_print(allocr, dx);
+
+  // Per column (axis 1) symmetric quantization, of a transposed view
+  Tensor w0 = tensor_range(allocr, -0.8f, 0.1f, 4, 5);
+  Tensor w = tensor_permute(allocr, w0, 0, 1);
+  Tensor_Quantized qw = tensor_quantize(allocr, w, 1, true);
+  printf("\nTransposed weights quantized per column: \n");
+  tensor_print(allocr, qw.values);
+  printf("Scales: \n");
+  tensor_print(allocr, qw.scales);
+
+  // Quantized product against the f32 one
+  Tensor y = tensor_matmul(allocr, x, w);
+  Tensor yq = tensor_qmatmul(allocr, qx, qw);
+  printf("\nf32 product: \n");
+  tensor_print(allocr, y);
+  printf("Quantized product: \n");
+  tensor_print(allocr, yq);
+
+  // Integer products are exact, also through the packed kernels
+  Tensor af = tensor_range(allocr, -128.f, 0.37f, 70, 90);
+  Tensor bf = tensor_range(allocr, 127.f, -0.29f, 60, 90);
+  Tensor a = tensor_to_dtype(allocr, af, TENSOR_I8);
+  Tensor b0 = tensor_to_dtype(allocr, bf, TENSOR_I8);
+  Tensor b = tensor_permute(allocr, b0, 0, 1);
+  Tensor c = tensor_matmul_i8(allocr, a, b);
+  uptr mismatches = 0;
+  for(uptr i = 0; i < 70; ++i){
+    for(uptr j = 0; j < 60; ++j){
+      int64_t sum = 0;
+      for(uptr k = 0; k < 90; ++k)
+	sum += (int64_t)tensor_get_value(a, i, k) * (int64_t)tensor_get_value(b, k, j);
+      mismatches += ((int64_t)tensor_get_value(c, i, j) != sum);
+    }
+  }
+  printf("\ni8 x i8 -> %s (70 x 90 x 60), mismatches: %zu\n", tensor_dtype_name(c.dtype), mismatches);
+  Tensor c_s = tensor_slice(allocr, c, (0, 0), (2, 6));
+  tensor_print(allocr, c_s);
+
+  tensor_free(allocr, &c_s);
+  tensor_free(allocr, &c);
+  tensor_free(allocr, &b);
+  tensor_free(allocr, &b0);
+  tensor_free(allocr, &a);
+  tensor_free(allocr, &bf);
+  tensor_free(allocr, &af);
+  tensor_free(allocr, &yq);
+  tensor_free(allocr, &y);
+  tensor_quantized_free(allocr, &qw);
+  tensor_free(allocr, &w);
+  tensor_free(allocr, &w0);
+  tensor_free(allocr, &dx);
+  tensor_quantized_free(allocr, &qx);
+  tensor_free(allocr, &x);
+  return 0;
+}
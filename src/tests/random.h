@@ -0,0 +1,106 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int random_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  // The global generator, reseeded so the values below dont depend on other tests
+  tensor_random_seed(7);
+  Tensor u = tensor_random(allocr, -1.f, 1.f, 2, 5);
+  printf("Uniform in [-1, 1): \n");
+  tensor_print(allocr, u);
+  Tensor n = tensor_random_normal(allocr, 10.f, 2.f, 2, 5);
+  printf("Normal, mean 10 and std 2: \n");
+  tensor_print(allocr, n);
+  Tensor b = tensor_random_bernoulli(allocr, 0.25f, 3, 8);
+  printf("Bernoulli with p = 0.25: \n");
+  tensor_print(allocr, b);
+  Tensor tn = tensor_random_truncated_normal(allocr, 0.f, 1.f, -0.5f, 2.f, 2, 5);
+  printf("Truncated normal in [-0.5, 2]: \n");
+  tensor_print(allocr, tn);
+
+  // Own generators, same seed gives the same values, also into views and other dtypes
+  Tensor_Rng r1 = tensor_rng_init(1234);
+  Tensor_Rng r2 = tensor_rng_init(1234);
+  Tensor a = tensor_alloc(allocr, 3, 4);
+  Tensor c0 = tensor_create_dtype(allocr, TENSOR_F16, 0.0, 4, 3);
+  Tensor c = tensor_permute(allocr, c0, 0, 1);
+  tensor_fill_normal(&r1, &a, 0.f, 1.f);
+  tensor_fill_normal(&r2, &c, 0.f, 1.f);
+  printf("\nNormal values: \n");
+  tensor_print(allocr, a);
+  printf("Same seed, into a transposed f16 view (printed back as 3 x 4): \n");
+  tensor_print(allocr, c);
+
+  // Setting the counter jumps anywhere in the stream
+  Tensor big = tensor_alloc(allocr, 1000);
+  Tensor_Rng r3 = tensor_rng_init(99);
+  tensor_fill_uniform(&r3, &big, 0.f, 1.f);
+  Tensor_Rng r4 = tensor_rng_init(99);
+  r4.counter = 512 / 64 * 16; // 16 blocks per 64 values
+  Tensor part = tensor_alloc(allocr, 4);
+  tensor_fill_uniform(&r4, &part, 0.f, 1.f);
+  Tensor big_s = tensor_slice(allocr, big, (512), (516));
+  printf("\nValues 512 .. 515 of a fill: \n");
+  tensor_print(allocr, big_s);
+  printf("Drawn after jumping ahead: \n");
+  tensor_print(allocr, part);
+  printf("Counter after 1000 values: %zu\n", (uptr)r3.counter);
+
+  // Filling a shared copy on write duplicate clones it first, the original keeps its values
+  Tensor orig = tensor_create(allocr, 5.f, 2, 3);
+  tensor_set_copy_on_write(orig, true);
+  Tensor dup = tensor_dupe(allocr, orig);
+  Tensor_Rng r6 = tensor_rng_init(5);
+  tensor_fill_uniform(&r6, &dup, 0.f, 1.f);
+  printf("\nFilled a shared copy on write duplicate, still shares storage: %s, references: %zu\n",
+	 (dup.storage.data == orig.storage.data) ? "Yes" : "No", tensor_storage_refs(orig));
+  tensor_print(allocr, dup);
+  printf("Original: \n");
+  tensor_print(allocr, orig);
+
+  // Statistics of a large fill, which is split across threads
+  Tensor large = tensor_random_normal(allocr, 0.f, 1.f, 1 << 20);
+  Tensor sum = tensor_radd(allocr, large, 0);
+  Tensor sq = tensor_prod(allocr, large, large);
+  Tensor sum_sq = tensor_radd(allocr, sq, 0);
+  const f64 mean = tensor_get_value(sum) / (1 << 20);
+  printf("\nMean %.2f and variance %.2f of 2^20 normal values\n",
+	 mean, tensor_get_value(sum_sq) / (1 << 20) - mean * mean);
+
+  // The open interval for the normals never reaches 1, which would give a value near -620
+  //   2^25 values, so that each 24 bit pattern comes up a couple of times
+  Tensor_Rng r5 = tensor_rng_init(0);
+  f32 lowest = 0.f, highest = 0.f;
+  for(int k = 0; k < 32; ++k){
+    tensor_fill_normal(&r5, &large, 0.f, 1.f);
+    Tensor lo = tensor_rmin(allocr, large, 0);
+    Tensor hi = tensor_rmax(allocr, large, 0);
+    lowest = f32_min_op(lowest, (f32)tensor_get_value(lo));
+    highest = f32_max_op(highest, (f32)tensor_get_value(hi));
+    tensor_free(allocr, &hi);
+    tensor_free(allocr, &lo);
+  }
+  printf("All of 2^25 normal values within 7 std: %s\n",
+	 (lowest > -7.f && highest < 7.f) ? "Yes" : "No");
+
+  tensor_free(allocr, &sum_sq);
+  tensor_free(allocr, &dup);
+  tensor_free(allocr, &orig);
+  tensor_free(allocr, &sq);
+  tensor_free(allocr, &sum);
+  tensor_free(allocr, &large);
+  tensor_free(allocr, &big_s);
+  tensor_free(allocr, &part);
+  tensor_free(allocr, &big);
+  tensor_free(allocr, &c);
+  tensor_free(allocr, &c0);
+  tensor_free(allocr, &a);
+  tensor_free(allocr, &tn);
+  tensor_free(allocr, &b);
+  tensor_free(allocr, &n);
+  tensor_free(allocr, &u);
+  return 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include "tensor.h"
+
+// Bits of the first 'count' elements of two 1 dimensional results
+static bool reduce_same_bits(Tensor a, Tensor b, uptr count){
+  for(uptr i = 0; i < count; ++i){
+    const f32 x = tensor_get(a, i), y = tensor_get(b, i);
+    if(memcmp(&x, &y, sizeof(f32)) != 0) return false;
+  }
+  return true;
+}
+
+static uint32_t reduce_bits(f32 x){
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+static float reduce_sub_op(float a, float b){
+  return a - b;
+}
+
+int reduce_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  // Columns of a tall tensor, one long row, many short rows, and strided rows
+  Tensor tall = tensor_random(allocr, -1.f, 1.f, 5000, 16);
+  Tensor row = tensor_random(allocr, -1.f, 1.f, 1, 200000);
+  Tensor wide = tensor_random(allocr, -1.f, 1.f, 64, 1000);
+  Tensor wide_t = tensor_permute(allocr, wide, 0, 1);
+  struct { const char* name; Tensor t; uptr dim; uptr outs; f32_binop* op; } cases[] = {
+    {"Sum of (5000, 16) along dim 0", tall, 0, 16, f32_add_op},
+    {"Max of (5000, 16) along dim 0", tall, 0, 16, f32_max_op},
+    {"Sum of (1, 200000) along dim 1", row, 1, 1, f32_add_op},
+    {"Sum of (64, 1000) along dim 1", wide, 1, 64, f32_add_op},
+    {"Sum of its transpose along dim 0", wide_t, 0, 64, f32_add_op},
+    {"Custom op on (5000, 16) along dim 0", tall, 0, 16, reduce_sub_op},
+  };
+  const uptr thread_counts[] = {2, 8, 32};
+
+  tensor_set_parallel_threshold(128);
+  for(int det = 0; det < 2; ++det){
+    tensor_set_deterministic(det);
+    printf("%s mode:\n", det ? "Deterministic" : "Default");
+    for(uptr i = 0; i < _countof(cases); ++i){
+      tensor_set_num_threads(1);
+      Tensor serial = tensor_reduce_op(allocr, cases[i].t, cases[i].dim, cases[i].op);
+      bool same = true;
+      for(uptr k = 0; k < _countof(thread_counts); ++k){
+	tensor_set_num_threads(thread_counts[k]);
+	Tensor threaded = tensor_reduce_op(allocr, cases[i].t, cases[i].dim, cases[i].op);
+	same = same && reduce_same_bits(serial, threaded, cases[i].outs);
+	tensor_free(allocr, &threaded);
+      }
+      printf("  %s, same bits with 1, 2, 8 and 32 threads: %s\n", cases[i].name, BOOLSTR(same));
+      tensor_free(allocr, &serial);
+    }
+  }
+
+  // Deterministic results dont depend on the thread count, so their bits can be recorded
+  tensor_set_num_threads(1);
+  Tensor ramp = tensor_range(allocr, -3.f, 0.001f, 3, 7000);
+  Tensor ramp_sum = tensor_radd(allocr, ramp, 1);
+  Tensor ramp_cols = tensor_radd(allocr, ramp, 0);
+  printf("\nDeterministic row sums of a ramp: %08x %08x %08x\n",
+	 reduce_bits(tensor_get(ramp_sum, 0)), reduce_bits(tensor_get(ramp_sum, 1)),
+	 reduce_bits(tensor_get(ramp_sum, 2)));
+  printf("Deterministic column sums, first and last: %08x %08x\n",
+	 reduce_bits(tensor_get(ramp_cols, 0)), reduce_bits(tensor_get(ramp_cols, 6999)));
+  tensor_set_deterministic(false);
+
+  // Pairwise blocks keep long sums accurate, a running f32 sum of these is off by ~1000
+  Tensor tenths = tensor_create(allocr, 0.1f, 1, 1000000);
+  Tensor tenths_sum = tensor_radd(allocr, tenths, 1);
+  const f32 err = tensor_get(tenths_sum, 0) - 100000.f;
+  printf("Sum of a million 0.1s is within 0.1 of 100000: %s\n", BOOLSTR(err < 0.1f && err > -0.1f));
+
+  tensor_threads_shutdown();
+  tensor_set_num_threads(0);
+  tensor_set_parallel_threshold(1 << 16);
+
+  tensor_free(allocr, &tenths_sum);
+  tensor_free(allocr, &tenths);
+  tensor_free(allocr, &ramp_cols);
+  tensor_free(allocr, &ramp_sum);
+  tensor_free(allocr, &ramp);
+  tensor_free(allocr, &wide_t);
+  tensor_free(allocr, &wide);
+  tensor_free(allocr, &row);
+  tensor_free(allocr, &tall);
+#undef BOOLSTR
+  return 0;
+}
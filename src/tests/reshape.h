@@ -0,0 +1,100 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+// Prints the shape and strides, and whether it is a view
+static void reshape_describe(const char* name, Tensor t, bool copied){
+  printf("%s: shape (", name);
+  for_range(uptr, i, 0, t.ndim) printf((i > 0) ? ", %zu" : "%zu", tensor_shape(t).data[i]);
+  printf("), strides (");
+  for_range(uptr, i, 0, t.ndim) printf((i > 0) ? ", %zd" : "%zd", tensor_stride(t).data[i]);
+  printf("), %s\n", copied ? "copied" : "view");
+}
+
+int reshape_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+  bool copied = true;
+
+  // Contiguous tensors always reshape into views
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 2, 3, 4);
+  Tensor r1 = tensor_reshape(allocr, t1, &copied, 4, TENSOR_INFER_DIM);
+  reshape_describe("(2, 3, 4) -> (4, -1)", r1, copied);
+  tensor_print(allocr, r1);
+  tensor_set_value(r1, -1.0, 3, 5);
+  printf("Written through the view, last element of original = %g\n", tensor_get_value(t1, 1, 2, 3));
+
+  // Slices keep the strides of their parent, only some reshapes fit them
+  Tensor s1 = tensor_slice(allocr, t1, (0, 1, 0), (2, 3, 4));
+  Tensor r2 = tensor_reshape(allocr, s1, &copied, 2, 2, 2, 2);
+  reshape_describe("\nSlice (2, 2, 4) -> (2, 2, 2, 2)", r2, copied);
+  Tensor r3 = tensor_reshape(allocr, s1, &copied, 2, 8);
+  reshape_describe("Slice (2, 2, 4) -> (2, 8)", r3, copied);
+  Tensor r4 = tensor_reshape(allocr, s1, &copied, 16);
+  reshape_describe("Slice (2, 2, 4) -> (16)", r4, copied);
+  tensor_print(allocr, r4);
+  printf("Copy owns its storage: %s\n", r4.owner ? "Yes" : "No");
+
+  // Flattening a transposed tensor has to copy, but its leading dimensions dont
+  Tensor p1 = tensor_permute(allocr, t1, 1, 2);
+  Tensor f1 = tensor_flatten(allocr, p1, 1, 2, &copied);
+  reshape_describe("\nTransposed (2, 4, 3) flattened from 1 to 2", f1, copied);
+  tensor_print(allocr, f1);
+  Tensor f2 = tensor_flatten(allocr, p1, 0, 0, &copied);
+  reshape_describe("Transposed (2, 4, 3) flattened from 0 to 0", f2, copied);
+  Tensor p2 = tensor_permute(allocr, t1, 0, 1);
+  Tensor f3 = tensor_flatten(allocr, p2, 1, 2, &copied);
+  reshape_describe("Transposed (3, 2, 4) flattened from 1 to 2", f3, copied);
+
+  // Size 1 dimensions
+  Tensor u1 = tensor_unsqueeze(allocr, p1, 1);
+  reshape_describe("\nUnsqueezed at 1", u1, false);
+  Tensor u2 = tensor_unsqueeze(allocr, u1, 4);
+  reshape_describe("Unsqueezed at 4", u2, false);
+  Tensor q1 = tensor_squeeze(allocr, u2, 1);
+  reshape_describe("Squeezed at 1", q1, false);
+  Tensor q2 = tensor_squeeze(allocr, u2, TENSOR_SQUEEZE_ALL);
+  reshape_describe("Squeezed all", q2, false);
+  Tensor r5 = tensor_reshape(allocr, u2, &copied, 2, 1, 4, 3);
+  reshape_describe("(2, 1, 4, 3, 1) -> (2, 1, 4, 3)", r5, copied);
+
+  // Reshaping like another tensor
+  Tensor like = tensor_create(allocr, 0.f, 6, 4);
+  Tensor v1 = tensor_view_as(allocr, t1, like, &copied);
+  reshape_describe("\nViewed as (6, 4)", v1, copied);
+
+  // Empty and 0 dim tensors
+  Tensor e1 = tensor_create(allocr, 0.f, 3, 0);
+  Tensor e2 = tensor_reshape(allocr, e1, &copied, 0, 5, 2);
+  reshape_describe("\n(3, 0) -> (0, 5, 2)", e2, copied);
+  Tensor z1 = tensor_create(allocr, 7.f);
+  Tensor z2 = tensor_flatten(allocr, z1, 0, 0, &copied);
+  reshape_describe("0 dim flattened", z2, copied);
+  Tensor z3 = tensor_unsqueeze(allocr, z1, 0);
+  reshape_describe("0 dim unsqueezed", z3, false);
+
+  tensor_free(allocr, &z3);
+  tensor_free(allocr, &z2);
+  tensor_free(allocr, &z1);
+  tensor_free(allocr, &e2);
+  tensor_free(allocr, &e1);
+  tensor_free(allocr, &v1);
+  tensor_free(allocr, &like);
+  tensor_free(allocr, &r5);
+  tensor_free(allocr, &q2);
+  tensor_free(allocr, &q1);
+  tensor_free(allocr, &u2);
+  tensor_free(allocr, &u1);
+  tensor_free(allocr, &f3);
+  tensor_free(allocr, &p2);
+  tensor_free(allocr, &f2);
+  tensor_free(allocr, &f1);
+  tensor_free(allocr, &p1);
+  tensor_free(allocr, &r4);
+  tensor_free(allocr, &r3);
+  tensor_free(allocr, &r2);
+  tensor_free(allocr, &s1);
+  tensor_free(allocr, &r1);
+  tensor_free(allocr, &t1);
+  return 0;
+}
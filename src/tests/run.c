@@ -6,6 +6,27 @@
 #include "viewops.h"
 #include "moreariths.h"
 #include "zerodim.h"
+#include "threads.h"
+#include "reduce.h"
+#include "broadcast.h"
+#include "matmul.h"
+#include "lazy.h"
+#include "storage.h"
+#include "arena.h"
+#include "pool.h"
+#include "fileio.h"
+#include "numpy.h"
+#include "chunked.h"
+#include "print.h"
+#include "dtypes.h"
+#include "quant.h"
+#include "random.h"
+#include "contiguous.h"
+#include "reshape.h"
+#include "flip.h"
+#include "window.h"
+#include "conv.h"
+#include "softmax.h"
 
 int main(int argc, const char* argv[]){
   TestCase cases[] = {
@@ -15,6 +36,27 @@ int main(int argc, const char* argv[]){
     {.entry_fxn = viewops_run, .test_name = "viewops"},
     {.entry_fxn = arith2_run, .test_name = "morearith"},
     {.entry_fxn = zerodim_run, .test_name = "zerodim"},
+    {.entry_fxn = threads_run, .test_name = "threads"},
+    {.entry_fxn = reduce_run, .test_name = "reduce"},
+    {.entry_fxn = broadcast_run, .test_name = "broadcast"},
+    {.entry_fxn = matmul_run, .test_name = "matmul"},
+    {.entry_fxn = lazy_run, .test_name = "lazy"},
+    {.entry_fxn = storage_run, .test_name = "storage"},
+    {.entry_fxn = arena_run, .test_name = "arena"},
+    {.entry_fxn = pool_run, .test_name = "pool"},
+    {.entry_fxn = fileio_run, .test_name = "fileio"},
+    {.entry_fxn = numpy_run, .test_name = "numpy"},
+    {.entry_fxn = chunked_run, .test_name = "chunked"},
+    {.entry_fxn = print_run, .test_name = "print"},
+    {.entry_fxn = dtypes_run, .test_name = "dtypes"},
+    {.entry_fxn = quant_run, .test_name = "quant"},
+    {.entry_fxn = random_run, .test_name = "random"},
+    {.entry_fxn = contiguous_run, .test_name = "contiguous"},
+    {.entry_fxn = reshape_run, .test_name = "reshape"},
+    {.entry_fxn = flip_run, .test_name = "flip"},
+    {.entry_fxn = window_run, .test_name = "window"},
+    {.entry_fxn = conv_run, .test_name = "conv"},
+    {.entry_fxn = softmax_run, .test_name = "softmax"},
   };
   return run_test(cases, _countof(cases),
 		  "test_outs", "build/tests",
@@ -0,0 +1,129 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+static f32 softmax_abs(f32 x){
+  return (x < 0.f) ? -x : x;
+}
+
+// Largest difference of two same shaped 2d tensors
+static f32 softmax_max_diff(Tensor a, Tensor b){
+  f32 max_err = 0.f;
+  for_range(uptr, i, 0, tensor_shape(a).data[0]){
+    for_range(uptr, j, 0, tensor_shape(a).data[1]){
+      const f32 err = softmax_abs(tensor_get_value(a, i, j) - tensor_get_value(b, i, j));
+      max_err = (err > max_err) ? err : max_err;
+    }
+  }
+  return max_err;
+}
+
+int softmax_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  Tensor t1 = tensor_range(allocr, -2.f, 0.5f, 3, 4);
+  printf("Original tensor: \n");
+  tensor_print(allocr, t1);
+
+  Tensor s1 = tensor_softmax(allocr, t1, 1);
+  printf("\nSoftmax along dim 1: \n");
+  tensor_print(allocr, s1);
+  Tensor s2 = tensor_softmax(allocr, t1, 0);
+  printf("\nSoftmax along dim 0: \n");
+  tensor_print(allocr, s2);
+  Tensor l1 = tensor_log_softmax(allocr, t1, 1);
+  printf("\nLog softmax along dim 1: \n");
+  tensor_print(allocr, l1);
+  Tensor e1 = tensor_logsumexp(allocr, t1, 1);
+  printf("\nLogsumexp along dim 1: \n");
+  tensor_print(allocr, e1);
+  Tensor e2 = tensor_logsumexp(allocr, t1, 0);
+  printf("\nLogsumexp along dim 0: \n");
+  tensor_print(allocr, e2);
+
+  // Views work the same, only the walk over them changes
+  Tensor t1_t = tensor_permute(allocr, t1, 0, 1);
+  Tensor s3 = tensor_softmax(allocr, t1_t, 0);
+  printf("\nSoftmax of the transpose along dim 0: \n");
+  tensor_print(allocr, s3);
+  Tensor t1_f = tensor_flip(allocr, t1, 1);
+  Tensor l2 = tensor_log_softmax(allocr, t1_f, 1);
+  printf("\nLog softmax of the mirrored rows: \n");
+  tensor_print(allocr, l2);
+
+  // Masked entries give 0, large values don't overflow
+  Tensor t2 = tensor_create(allocr, 0.f, 2, 5);
+  for_range(uptr, j, 0, 5){
+    tensor_set_value(t2, (j % 2) ? -__builtin_inff() : (f32)j, 0, j);
+    tensor_set_value(t2, 1000.f + (f32)j, 1, j);
+  }
+  Tensor s4 = tensor_softmax(allocr, t2, 1);
+  printf("\nSoftmax with masked entries and large values: \n");
+  tensor_print(allocr, s4);
+  Tensor e3 = tensor_logsumexp(allocr, t2, 1);
+  printf("Their logsumexp: \n");
+  tensor_print(allocr, e3);
+
+  // Writing into a transposed output
+  Tensor out = tensor_create(allocr, 0.f, 4, 3);
+  Tensor out_t = tensor_permute(allocr, out, 0, 1);
+  Tensor_Iter out_iter = tensor_iter_init(allocr, out_t);
+  (void)tensor_softmax(&out_iter, t1, 1);
+  printf("\nSoftmax along dim 1 written into a transposed tensor: \n");
+  tensor_print(allocr, out);
+
+  // Larger inputs, both layouts of the lines and both ways of getting log softmax
+  Tensor big = tensor_random(allocr, -20.f, 20.f, 70, 300);
+  Tensor big_t = tensor_permute(allocr, big, 0, 1);
+  Tensor big_tc = tensor_contiguous(allocr, big_t);
+  Tensor r1 = tensor_softmax(allocr, big, 0);
+  Tensor r2 = tensor_softmax(allocr, big_tc, 1);
+  Tensor r2_t = tensor_permute(allocr, r2, 0, 1);
+  printf("\nSoftmax of (70, 300) along dim 0 matches the contiguous transpose: %s\n",
+	 (softmax_max_diff(r1, r2_t) < 1e-6f) ? "Yes" : "No");
+  Tensor sums = tensor_radd(allocr, r2, 1);
+  f32 sum_err = 0.f;
+  for_range(uptr, i, 0, 300){
+    const f32 err = softmax_abs(tensor_get_value(sums, i) - 1.f);
+    sum_err = (err > sum_err) ? err : sum_err;
+  }
+  printf("All its 300 lines sum to 1: %s\n", (sum_err < 1e-5f) ? "Yes" : "No");
+  Tensor r3 = tensor_log_softmax(allocr, big, 0);
+  Tensor r4 = tensor_logsumexp(allocr, big, 0);
+  Tensor r4_u = tensor_unsqueeze(allocr, r4, 0);
+  Tensor r4_n = tensor_vprod(allocr, -1.f, r4_u);
+  Tensor r5 = tensor_add(allocr, big, r4_n);
+  printf("Log softmax matches the input minus logsumexp: %s\n",
+	 (softmax_max_diff(r3, r5) < 1e-4f) ? "Yes" : "No");
+
+  tensor_free(allocr, &r5);
+  tensor_free(allocr, &r4_n);
+  tensor_free(allocr, &r4_u);
+  tensor_free(allocr, &r4);
+  tensor_free(allocr, &r3);
+  tensor_free(allocr, &sums);
+  tensor_free(allocr, &r2_t);
+  tensor_free(allocr, &r2);
+  tensor_free(allocr, &r1);
+  tensor_free(allocr, &big_tc);
+  tensor_free(allocr, &big_t);
+  tensor_free(allocr, &big);
+  tensor_iter_deinit(allocr, &out_iter);
+  tensor_free(allocr, &out_t);
+  tensor_free(allocr, &out);
+  tensor_free(allocr, &e3);
+  tensor_free(allocr, &s4);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &l2);
+  tensor_free(allocr, &t1_f);
+  tensor_free(allocr, &s3);
+  tensor_free(allocr, &t1_t);
+  tensor_free(allocr, &e2);
+  tensor_free(allocr, &e1);
+  tensor_free(allocr, &l1);
+  tensor_free(allocr, &s2);
+  tensor_free(allocr, &s1);
+  tensor_free(allocr, &t1);
+  return 0;
+}
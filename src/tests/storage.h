@@ -0,0 +1,79 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int storage_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  // Views keep the storage alive after the parent is freed
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 3, 4);
+  Tensor t1_s = tensor_slice(allocr, t1, (1, 1), (3, 3));
+  Tensor t1_p = tensor_permute(allocr, t1_s, 0, 1);
+  printf("References after making 2 views: %zu\n", tensor_storage_refs(t1));
+  tensor_free(allocr, &t1);
+  printf("References after freeing the parent: %zu\n", tensor_storage_refs(t1_s));
+  printf("Slice: \n");
+  tensor_print(allocr, t1_s);
+  printf("\nTransposed slice: \n");
+  tensor_print(allocr, t1_p);
+  tensor_free(allocr, &t1_s);
+  printf("\nReferences of the last view: %zu\n", tensor_storage_refs(t1_p));
+  tensor_free(allocr, &t1_p);
+
+  // Stack tensors dont have a storage object
+  Tensor st = MAKE_STACK_TENSOR(({1, 2, 3}), 3);
+  printf("\nReferences of a stack tensor: %zu\n", tensor_storage_refs(st));
+
+  // Copy on write, duplicates share the storage until written into
+  Tensor t2 = tensor_range(allocr, 1.f, 1.f, 2, 3);
+  tensor_set_copy_on_write(t2, true);
+  Tensor t3 = tensor_dupe(allocr, t2);
+  printf("\nDuplicate shares storage: %s, references: %zu\n",
+	 BOOLSTR(t3.storage.data == t2.storage.data), tensor_storage_refs(t2));
+  printf("Made a copy before writing: %s\n", BOOLSTR(tensor_make_writable(allocr, &t3)));
+  printf("Shares storage after that: %s, references: %zu %zu\n",
+	 BOOLSTR(t3.storage.data == t2.storage.data), tensor_storage_refs(t2), tensor_storage_refs(t3));
+  printf("Made a copy again: %s\n", BOOLSTR(tensor_make_writable(allocr, &t3)));
+  Tensor_Iter t3_iter = tensor_iter_init(allocr, t3);
+  (void)tensor_vprod(&t3_iter, 10.f, t3);
+  printf("\nOriginal: \n");
+  tensor_print(allocr, t2);
+  printf("\nWritten duplicate: \n");
+  tensor_print(allocr, t3);
+
+  // Writable copy of a shared view only has the viewed elements
+  Tensor t2_s = tensor_slice(allocr, t2, (0, 1), (2, 3));
+  Tensor t2_sd = tensor_dupe(allocr, t2_s);
+  (void)tensor_make_writable(allocr, &t2_sd);
+  printf("\nWritable copy of a slice, storage count: %zu\n", t2_sd.storage.count);
+  tensor_print(allocr, t2_sd);
+
+  // Inplace ops clone a shared output on their own, the iterator holds the written copy
+  Tensor t4 = tensor_dupe(allocr, t2);
+  Tensor t4_s = tensor_slice(allocr, t4, (0, 1), (2, 3));
+  Tensor t4_p = tensor_permute(allocr, t4_s, 0, 1);
+  Tensor t4_f = tensor_flip(allocr, t4_p, 1);
+  Tensor_Iter t4_iter = tensor_iter_init(allocr, t4_f);
+  (void)tensor_vadd(&t4_iter, 100.f, t4_f);
+  (void)tensor_vprod(&t4_iter, 2.f, t4_iter.t);
+  printf("\nWritten through an iterator of a mirrored, transposed slice, shares storage: %s, references: %zu\n",
+	 BOOLSTR(t4_iter.t.storage.data == t2.storage.data), tensor_storage_refs(t4_iter.t));
+  tensor_print(allocr, t4_iter.t);
+  printf("Original and duplicate are unchanged: \n");
+  tensor_print(allocr, t2);
+  tensor_print(allocr, t4);
+
+  tensor_iter_deinit(allocr, &t4_iter);
+  tensor_free(allocr, &t4_f);
+  tensor_free(allocr, &t4_p);
+  tensor_free(allocr, &t4_s);
+  tensor_free(allocr, &t4);
+  tensor_free(allocr, &t2_sd);
+  tensor_free(allocr, &t2_s);
+  tensor_iter_deinit(allocr, &t3_iter);
+  tensor_free(allocr, &t3);
+  tensor_free(allocr, &t2);
+  return 0;
+}
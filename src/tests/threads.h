@@ -0,0 +1,83 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+// Compares results of elementwise ops run serially and with many threads
+static bool threads_same_tensor(Tensor a, Tensor b){
+  if(!equal_tensor_inx(tensor_shape(a), tensor_shape(b))) return false;
+  Tensor_Iter iter = tensor_iter_init(gen_std_allocator(), a);
+  bool same = true;
+  while(same && tensor_iter_next(&iter)){
+    same = (*tensor_get_ptr_(a, tensor_iter_inx(iter)) == *tensor_get_ptr_(b, tensor_iter_inx(iter)));
+  }
+  tensor_iter_deinit(gen_std_allocator(), &iter);
+  return same;
+}
+
+static float threads_sub_op(float a, float b){
+  return a - b;
+}
+
+int threads_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+#define BOOLSTR(boolean) ((boolean)? "Yes" : "No")
+
+  Tensor t1 = tensor_random(allocr, -5.f, 5.f, 64, 33, 17);
+  Tensor t2 = tensor_random(allocr, -5.f, 5.f, 64, 17, 33);
+  Tensor t2_p = tensor_permute(allocr, t2, 1, 2);
+
+  // Serial results
+  tensor_set_num_threads(1);
+  Tensor s_add = tensor_add(allocr, t1, t2_p);
+  Tensor s_sub = tensor_bin_op(allocr, t1, threads_sub_op, t2_p);
+  Tensor s_vmax = tensor_vmax(allocr, 0.5f, t2_p);
+  Tensor s_cont = tensor_contiguous(allocr, t2_p);
+
+  // Threaded results, with a small threshold so that everything is split
+  tensor_set_num_threads(4);
+  tensor_set_parallel_threshold(128);
+  printf("Number of threads: %zu\n", tensor_get_num_threads());
+  Tensor p_add = tensor_add(allocr, t1, t2_p);
+  Tensor p_sub = tensor_bin_op(allocr, t1, threads_sub_op, t2_p);
+  Tensor p_vmax = tensor_vmax(allocr, 0.5f, t2_p);
+  Tensor p_cont = tensor_contiguous(allocr, t2_p);
+
+  printf("Add same: %s\n", BOOLSTR(threads_same_tensor(s_add, p_add)));
+  printf("Custom op same: %s\n", BOOLSTR(threads_same_tensor(s_sub, p_sub)));
+  printf("Vectorized max same: %s\n", BOOLSTR(threads_same_tensor(s_vmax, p_vmax)));
+  printf("Contiguous same: %s\n", BOOLSTR(threads_same_tensor(s_cont, p_cont)));
+
+  // Inplace into a slice of preallocated buffer
+  Tensor buf = tensor_create(allocr, 0.f, 64, 40, 20);
+  Tensor buf_s = tensor_slice(allocr, buf, (0, 2, 1), (64, 35, 18));
+  Tensor_Iter buf_iter = tensor_iter_init(allocr, buf_s);
+  (void)tensor_prod(&buf_iter, t1, t2_p);
+  Tensor s_prod = tensor_prod(allocr, t1, t2_p);
+  printf("Inplace slice same: %s\n", BOOLSTR(threads_same_tensor(s_prod, buf_s)));
+  printf("Outside of slice untouched: %s\n",
+	 BOOLSTR((tensor_get(buf, 0, 1, 1) == 0.f) && (tensor_get(buf, 63, 35, 1) == 0.f) &&
+		 (tensor_get(buf, 10, 10, 0) == 0.f) && (tensor_get(buf, 10, 10, 18) == 0.f)));
+
+  tensor_threads_shutdown();
+  tensor_set_num_threads(0);
+  tensor_set_parallel_threshold(1 << 16);
+
+  tensor_free(allocr, &s_prod);
+  tensor_iter_deinit(allocr, &buf_iter);
+  tensor_free(allocr, &buf_s);
+  tensor_free(allocr, &buf);
+  tensor_free(allocr, &p_cont);
+  tensor_free(allocr, &p_vmax);
+  tensor_free(allocr, &p_sub);
+  tensor_free(allocr, &p_add);
+  tensor_free(allocr, &s_cont);
+  tensor_free(allocr, &s_vmax);
+  tensor_free(allocr, &s_sub);
+  tensor_free(allocr, &s_add);
+  tensor_free(allocr, &t2_p);
+  tensor_free(allocr, &t2);
+  tensor_free(allocr, &t1);
+#undef BOOLSTR
+  return 0;
+}
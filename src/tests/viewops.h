@@ -15,11 +15,11 @@ int viewops_run(int argc, const char* argv[]){
 
   printf("\nTensor storage shape: %zu\n", t_og.storage.count);
   printf("\nShape: ");
-  print_tensor_inx(t_og.shape);
+  print_tensor_inx(tensor_shape(t_og));
   printf("\nStride: ");
-  print_tensor_inx(t_og.stride);
+  print_tensor_strides(tensor_stride(t_og));
   printf("\nOffset: ");
-  print_tensor_inx(t_og.offset);
+  printf("%zu", t_og.offset);
   printf("\nOwns Storage: %s", BOOLSTR(t_og.owner));
   printf("\nTensor: \n");
   tensor_print(allocr, t_og);
@@ -27,11 +27,11 @@ int viewops_run(int argc, const char* argv[]){
   Tensor tp1 = tensor_permute(allocr, t_og, 1, 2);
   printf("\nPermuted Tensor: \n");
   printf("\nShape: ");
-  print_tensor_inx(tp1.shape);
+  print_tensor_inx(tensor_shape(tp1));
   printf("\nStride: ");
-  print_tensor_inx(tp1.stride);
+  print_tensor_strides(tensor_stride(tp1));
   printf("\nOffset: ");
-  print_tensor_inx(tp1.offset);
+  printf("%zu", tp1.offset);
   printf("\nOwns Storage: %s", BOOLSTR(tp1.owner));
   printf("\n");
   tensor_print(allocr, tp1);
@@ -39,11 +39,11 @@ int viewops_run(int argc, const char* argv[]){
   printf("\nSliced Tensor: \n");
   Tensor ts1 = tensor_slice(allocr, t_og, (0,1,1), (2, 2, 3));
   printf("\nShape: ");
-  print_tensor_inx(ts1.shape);
+  print_tensor_inx(tensor_shape(ts1));
   printf("\nStride: ");
-  print_tensor_inx(ts1.stride);
+  print_tensor_strides(tensor_stride(ts1));
   printf("\nOffset: ");
-  print_tensor_inx(ts1.offset);
+  printf("%zu", ts1.offset);
   printf("\nOwns Storage: %s", BOOLSTR(ts1.owner));
   printf("\n");
   tensor_print(allocr, ts1);
@@ -60,11 +60,11 @@ int viewops_run(int argc, const char* argv[]){
   printf("\nPermutation of the slice: \n");
   Tensor tp2 = tensor_permute(allocr, ts1, 0,1);
   printf("\nShape: ");
-  print_tensor_inx(tp2.shape);
+  print_tensor_inx(tensor_shape(tp2));
   printf("\nStride: ");
-  print_tensor_inx(tp2.stride);
+  print_tensor_strides(tensor_stride(tp2));
   printf("\nOffset: ");
-  print_tensor_inx(tp2.offset);
+  printf("%zu", tp2.offset);
   printf("\nOwns Storage: %s", BOOLSTR(tp2.owner));
   printf("\n");
   tensor_print(allocr, tp2);
@@ -73,11 +73,11 @@ int viewops_run(int argc, const char* argv[]){
   printf("\nReslicing of the slice: \n");
   Tensor ts2 = tensor_slice(allocr, tp2, (0,0,1,), (1,2,2));
   printf("\nShape: ");
-  print_tensor_inx(ts2.shape);
+  print_tensor_inx(tensor_shape(ts2));
   printf("\nStride: ");
-  print_tensor_inx(ts2.stride);
+  print_tensor_strides(tensor_stride(ts2));
   printf("\nOffset: ");
-  print_tensor_inx(ts2.offset);
+  printf("%zu", ts2.offset);
   printf("\nOwns Storage: %s", BOOLSTR(ts2.owner));
   printf("\n");
   tensor_print(allocr, ts2);
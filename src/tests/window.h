@@ -0,0 +1,90 @@
+#pragma once
+#include <stdio.h>
+#include "tensor.h"
+
+int window_run(int argc, const char* argv[]){
+  (void)argc, (void)argv;
+  const Alloc_Interface allocr = gen_std_allocator();
+
+  Tensor t1 = tensor_range(allocr, 0.f, 1.f, 2, 7);
+  printf("Original tensor: \n");
+  tensor_print(allocr, t1);
+
+  // Overlapping windows only need strides
+  Tensor u1 = tensor_unfold(allocr, t1, 1, 3, 2);
+  printf("\nWindows of 3 every 2 along dim 1, strides ");
+  print_tensor_strides(tensor_stride(u1));
+  printf(": \n");
+  tensor_print(allocr, u1);
+  Tensor u2 = tensor_unfold(allocr, t1, 0, 2, 1);
+  printf("\nWindows of 2 along dim 0: \n");
+  tensor_print(allocr, u2);
+
+  // Pooling
+  Tensor p1 = tensor_max_pool(allocr, t1, 1, 3, 2);
+  printf("\nMax pooling with the same windows: \n");
+  tensor_print(allocr, p1);
+  Tensor p2 = tensor_avg_pool(allocr, t1, 1, 2, 2);
+  printf("\nAverage pooling, 2 every 2: \n");
+  tensor_print(allocr, p2);
+  Tensor p3 = tensor_pool_op(allocr, t1, 1, 3, 1, f32_min_op);
+  printf("\nRolling min of 3: \n");
+  tensor_print(allocr, p3);
+
+  Tensor img = tensor_range(allocr, 0.f, 1.f, 2, 4, 6);
+  Tensor img_f = tensor_flip(allocr, img, 2);
+  Tensor m2 = tensor_max_pool2d(allocr, img_f, 2, 3, 2, 3);
+  printf("\n2x3 max pooling of the mirrored images: \n");
+  tensor_print(allocr, m2);
+  Tensor a2 = tensor_avg_pool2d(allocr, img, 3, 3, 1, 3);
+  printf("\n3x3 average pooling, steps 1 and 3: \n");
+  tensor_print(allocr, a2);
+
+  // Rolling sums and means update each window from the one before
+  Tensor r1 = tensor_rolling_sum(allocr, t1, 1, 4);
+  printf("\nRolling sum of 4 along dim 1: \n");
+  tensor_print(allocr, r1);
+  Tensor r2 = tensor_rolling_mean(allocr, img, 0, 2);
+  printf("\nRolling mean of 2 along dim 0: \n");
+  tensor_print(allocr, r2);
+
+  // Long series, compared against reducing the unfolded windows
+  Tensor series = tensor_range(allocr, -1.f, 0.001f, 3, 5000);
+  Tensor r3 = tensor_rolling_mean(allocr, series, 1, 250);
+  Tensor u3 = tensor_unfold(allocr, series, 1, 250, 1);
+  Tensor r4 = tensor_radd(allocr, u3, 2);
+  f32 max_err = 0.f;
+  for_range(uptr, i, 0, 3){
+    for_range(uptr, j, 0, tensor_shape(r3).data[1]){
+      const f32 err = tensor_get_value(r3, i, j) - tensor_get_value(r4, i, j) / 250.f;
+      max_err = (err < 0.f) ? ((-err > max_err) ? -err : max_err) : ((err > max_err) ? err : max_err);
+    }
+  }
+  printf("\nRolling mean of 250 over (3, 5000), %zu windows, matches the reduction: %s\n",
+	 tensor_shape(r3).data[1], (max_err < 1e-5f) ? "Yes" : "No");
+  Tensor_Iter r1_iter = tensor_iter_init(allocr, r1);
+  Tensor t1_s = tensor_slice(allocr, t1, (0, 1), (2, 7));
+  (void)tensor_rolling_sum(&r1_iter, t1_s, 1, 3);
+  printf("Rolling sum of 3 written into the previous output: \n");
+  tensor_print(allocr, r1);
+
+  tensor_free(allocr, &t1_s);
+  tensor_iter_deinit(allocr, &r1_iter);
+  tensor_free(allocr, &r4);
+  tensor_free(allocr, &u3);
+  tensor_free(allocr, &r3);
+  tensor_free(allocr, &series);
+  tensor_free(allocr, &r2);
+  tensor_free(allocr, &r1);
+  tensor_free(allocr, &a2);
+  tensor_free(allocr, &m2);
+  tensor_free(allocr, &img_f);
+  tensor_free(allocr, &img);
+  tensor_free(allocr, &p3);
+  tensor_free(allocr, &p2);
+  tensor_free(allocr, &p1);
+  tensor_free(allocr, &u2);
+  tensor_free(allocr, &u1);
+  tensor_free(allocr, &t1);
+  return 0;
+}